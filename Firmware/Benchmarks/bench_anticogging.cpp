@@ -0,0 +1,38 @@
+/*
+* @brief Benchmarks of the anticogging map.
+*
+* The map is evaluated in every control loop iteration while anticogging is
+* enabled. The fit runs in the axis thread once per calibration sample and
+* only needs to keep up with the samples.
+*/
+
+#include "benchmark.hpp"
+
+#include <odrive_main.h>
+
+static CoggingMap_t make_map() {
+    CoggingMap_t map;
+    map.offset = 0.01f;
+    for (size_t i = 0; i < map.harmonics.size(); ++i) {
+        map.harmonics[i] = {(uint32_t)(12 * (i + 1)), 0.01f, -0.02f};
+    }
+    return map;
+}
+
+BENCHMARK(cogging_map_eval) {
+    static const std::vector<float> pos = random_floats(-10.0f, 10.0f, 40);
+    static const CoggingMap_t map = make_map();
+    for (size_t i = 0; i < n; ++i) {
+        do_not_optimize(map.eval(pos[i & kInputMask]));
+    }
+}
+
+BENCHMARK(cogging_fit_add_sample) {
+    static const std::vector<float> pos = random_floats(0.0f, 1.0f, 41);
+    static const std::vector<float> torque = random_floats(-0.1f, 0.1f, 42);
+    static CoggingFit fit;
+    for (size_t i = 0; i < n; ++i) {
+        fit.add_sample(pos[i & kInputMask], torque[i & kInputMask]);
+        do_not_optimize(fit);
+    }
+}
@@ -0,0 +1,121 @@
+/*
+* @brief Benchmarks of the FOC output path that runs in the PWM update
+* interrupt.
+*/
+
+#include "benchmark.hpp"
+
+#include <board.h>
+#include <foc.hpp>
+#include <utils.hpp>
+
+#include <cmath>
+
+// Uses measurement and setpoints that are in the range of a typical motor so
+// that the controller doesn't permanently run into modulation saturation.
+static void setup_foc(FieldOrientedController& foc, bool enable_current_control) {
+    foc.pi_gains_ = {0.02f, 100.0f};
+    foc.setpoints_.write({
+        .ctrl_timestamp = 0,
+        .enable_current_control = enable_current_control,
+        .Idq_setpoint = float2D{0.0f, 5.0f},
+        .Vdq_setpoint = float2D{0.0f, enable_current_control ? 0.0f : 2.0f},
+        .phase = 0.0f,
+        .phase_vel = 500.0f
+    });
+    foc.i_timestamp_ = 0;
+    foc.vbus_voltage_measured_ = 24.0f;
+}
+
+// Runs `pwm_updates_per_measurement` PWM updates per current measurement,
+// spread evenly over one current measurement period.
+static void run_foc(FieldOrientedController& foc, size_t n, size_t pwm_updates_per_measurement) {
+    static const std::vector<float> i_alpha = random_floats(-5.0f, 5.0f, 11);
+    static const std::vector<float> i_beta = random_floats(-5.0f, 5.0f, 12);
+    uint32_t pwm_update_period = TIM_1_8_PERIOD_CLOCKS / pwm_updates_per_measurement;
+    for (size_t i = 0; i < n; ++i) {
+        size_t pwm_update = i % pwm_updates_per_measurement;
+        if (pwm_update == 0) {
+            foc.on_measurement(24.0f, float2D{i_alpha[i & kInputMask], i_beta[i & kInputMask]}, 0);
+        }
+        std::optional<float2D> mod_alpha_beta;
+        std::optional<float> ibus;
+        do_not_optimize(foc.get_alpha_beta_output((pwm_update + 1) * pwm_update_period, &mod_alpha_beta, &ibus));
+        do_not_optimize(mod_alpha_beta);
+        do_not_optimize(ibus);
+    }
+}
+
+BENCHMARK(foc_current_control) {
+    FieldOrientedController foc;
+    setup_foc(foc, true);
+    run_foc(foc, n, 1);
+}
+
+BENCHMARK(foc_voltage_control) {
+    FieldOrientedController foc;
+    setup_foc(foc, false);
+    run_foc(foc, n, 1);
+}
+
+// Reports the average cost per PWM update if the PWM is updated at four
+// times the current measurement rate
+BENCHMARK(foc_current_control_4x_pwm_rate) {
+    FieldOrientedController foc;
+    setup_foc(foc, true);
+    run_foc(foc, n, 4);
+}
+
+// Control loop side: publishes the setpoints for the current control interrupt
+BENCHMARK(foc_update) {
+    static const std::vector<float> phase = random_floats(-M_PI, M_PI, 10);
+    float2D Idq_setpoint = {0.0f, 5.0f};
+    float2D Vdq_setpoint = {0.0f, 0.0f};
+    float phase_setpoint = 0.0f;
+    float phase_vel_setpoint = 500.0f;
+    FieldOrientedController foc;
+    foc.Idq_setpoint_src_.connect_to(&Idq_setpoint);
+    foc.Vdq_setpoint_src_.connect_to(&Vdq_setpoint);
+    foc.phase_src_.connect_to(&phase_setpoint);
+    foc.phase_vel_src_.connect_to(&phase_vel_setpoint);
+    for (size_t i = 0; i < n; ++i) {
+        phase_setpoint = phase[i & kInputMask];
+        foc.update((uint32_t)i);
+    }
+    do_not_optimize(foc);
+}
+
+// Full path from the controller to the PWM timings as called by Motor
+BENCHMARK(foc_get_output) {
+    static const std::vector<float> i_alpha = random_floats(-5.0f, 5.0f, 14);
+    static const std::vector<float> i_beta = random_floats(-5.0f, 5.0f, 15);
+    FieldOrientedController foc;
+    setup_foc(foc, true);
+    PhaseControlLaw<3>& control_law = foc;
+    for (size_t i = 0; i < n; ++i) {
+        foc.on_measurement(24.0f, float2D{i_alpha[i & kInputMask], i_beta[i & kInputMask]}, 0);
+        float pwm_timings[3];
+        std::optional<float> ibus;
+        do_not_optimize(control_law.get_output(TIM_1_8_PERIOD_CLOCKS, pwm_timings, &ibus));
+        do_not_optimize(pwm_timings);
+        do_not_optimize(ibus);
+    }
+}
+
+static std::vector<float> random_modulation(bool beta_component) {
+    std::vector<float> angle = random_floats(-M_PI, M_PI, 16);
+    std::vector<float> magnitude = random_floats(0.0f, 0.8f * sqrt3_by_2, 17);
+    std::vector<float> result(kInputCount);
+    for (size_t i = 0; i < kInputCount; ++i) {
+        result[i] = magnitude[i] * (beta_component ? std::sin(angle[i]) : std::cos(angle[i]));
+    }
+    return result;
+}
+
+BENCHMARK(svm) {
+    static const std::vector<float> alpha = random_modulation(false);
+    static const std::vector<float> beta = random_modulation(true);
+    for (size_t i = 0; i < n; ++i) {
+        do_not_optimize(SVM(alpha[i & kInputMask], beta[i & kInputMask]));
+    }
+}
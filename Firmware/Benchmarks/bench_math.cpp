@@ -0,0 +1,75 @@
+/*
+* @brief Benchmarks of the math primitives in MotorControl/utils.hpp that are
+* used in the current control loop.
+*/
+
+#include "benchmark.hpp"
+
+#include <utils.hpp>
+
+BENCHMARK(our_arm_sin_f32) {
+    static const std::vector<float> x = random_floats(-4.0f * M_PI, 4.0f * M_PI, 1);
+    for (size_t i = 0; i < n; ++i) {
+        do_not_optimize(our_arm_sin_f32(x[i & kInputMask]));
+    }
+}
+
+BENCHMARK(our_arm_cos_f32) {
+    static const std::vector<float> x = random_floats(-4.0f * M_PI, 4.0f * M_PI, 2);
+    for (size_t i = 0; i < n; ++i) {
+        do_not_optimize(our_arm_cos_f32(x[i & kInputMask]));
+    }
+}
+
+BENCHMARK(fast_atan2) {
+    static const std::vector<float> y = random_floats(-1.0f, 1.0f, 3);
+    static const std::vector<float> x = random_floats(-1.0f, 1.0f, 4);
+    for (size_t i = 0; i < n; ++i) {
+        do_not_optimize(fast_atan2(y[i & kInputMask], x[i & kInputMask]));
+    }
+}
+
+BENCHMARK(wrap_pm) {
+    static const std::vector<float> x = random_floats(-1000.0f, 1000.0f, 5);
+    for (size_t i = 0; i < n; ++i) {
+        do_not_optimize(wrap_pm(x[i & kInputMask], 2.0f * M_PI));
+    }
+}
+
+BENCHMARK(horner_poly_eval) {
+    // Same polynomial order as a typical thermistor fit
+    static const float coeffs[] = {363.93910201f, -462.15369634f, 307.55129571f, -27.72569531f};
+    static const std::vector<float> x = random_floats(0.0f, 1.0f, 6);
+    for (size_t i = 0; i < n; ++i) {
+        do_not_optimize(horner_poly_eval(x[i & kInputMask], coeffs, sizeof(coeffs) / sizeof(coeffs[0])));
+    }
+}
+
+BENCHMARK(our_arm_sin_cos_f32) {
+    static const std::vector<float> x = random_floats(-4.0f * M_PI, 4.0f * M_PI, 7);
+    for (size_t i = 0; i < n; ++i) {
+        float s, c;
+        our_arm_sin_cos_f32(x[i & kInputMask], &s, &c);
+        do_not_optimize(s);
+        do_not_optimize(c);
+    }
+}
+
+static std::vector<float> map_floats(const std::vector<float>& x, float (*fn)(float)) {
+    std::vector<float> result(x.size());
+    std::transform(x.begin(), x.end(), result.begin(), fn);
+    return result;
+}
+
+BENCHMARK(rotate_sin_cos) {
+    static const std::vector<float> x = random_floats(-M_PI, M_PI, 8);
+    static const std::vector<float> sin_x = map_floats(x, std::sin);
+    static const std::vector<float> cos_x = map_floats(x, std::cos);
+    static const std::vector<float> delta = random_floats(-rotate_sin_cos_max_delta, rotate_sin_cos_max_delta, 9);
+    for (size_t i = 0; i < n; ++i) {
+        float s, c;
+        rotate_sin_cos(sin_x[i & kInputMask], cos_x[i & kInputMask], delta[i & kInputMask], &s, &c);
+        do_not_optimize(s);
+        do_not_optimize(c);
+    }
+}
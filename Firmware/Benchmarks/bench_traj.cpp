@@ -0,0 +1,50 @@
+/*
+* @brief Benchmarks of the trajectory planners.
+*
+* Planning runs in the control loop whenever a new position is commanded, so
+* its worst case adds to the control loop time, not just its average.
+*/
+
+#include "benchmark.hpp"
+
+#include <odrive_main.h>
+
+BENCHMARK(trap_traj_plan) {
+    static const std::vector<float> goal = random_floats(-10.0f, 10.0f, 30);
+    static const std::vector<float> vel = random_floats(-20.0f, 20.0f, 31);
+    TrapezoidalTrajectory traj;
+    for (size_t i = 0; i < n; ++i) {
+        do_not_optimize(traj.planTrapezoidal(goal[i & kInputMask], 0.0f, vel[i & kInputMask],
+                                             10.0f, 50.0f, 50.0f));
+        do_not_optimize(traj);
+    }
+}
+
+BENCHMARK(trap_traj_eval) {
+    static const std::vector<float> t = random_floats(0.0f, 2.0f, 32);
+    TrapezoidalTrajectory traj;
+    traj.planTrapezoidal(10.0f, 0.0f, 0.0f, 10.0f, 50.0f, 50.0f);
+    for (size_t i = 0; i < n; ++i) {
+        do_not_optimize(traj.eval(t[i & kInputMask]));
+    }
+}
+
+BENCHMARK(scurve_traj_plan) {
+    static const std::vector<float> goal = random_floats(-10.0f, 10.0f, 30);
+    static const std::vector<float> vel = random_floats(-20.0f, 20.0f, 31);
+    SCurveTrajectory traj;
+    for (size_t i = 0; i < n; ++i) {
+        do_not_optimize(traj.planSCurve(goal[i & kInputMask], 0.0f, vel[i & kInputMask], 0.0f,
+                                        10.0f, 50.0f, 50.0f, 500.0f));
+        do_not_optimize(traj);
+    }
+}
+
+BENCHMARK(scurve_traj_eval) {
+    static const std::vector<float> t = random_floats(0.0f, 2.0f, 32);
+    SCurveTrajectory traj;
+    traj.planSCurve(10.0f, 0.0f, 0.0f, 0.0f, 10.0f, 50.0f, 50.0f, 500.0f);
+    for (size_t i = 0; i < n; ++i) {
+        do_not_optimize(traj.eval(t[i & kInputMask]));
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef __BENCHMARK_HPP
+#define __BENCHMARK_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+/**
+ * @brief Minimal microbenchmark harness.
+ *
+ * A benchmark is a function that runs the code under test `n` times. It
+ * should read its inputs from a precomputed table (see random_floats()) and
+ * pass every result to do_not_optimize() so that the compiler can't drop or
+ * hoist the calls.
+ *
+ * Benchmarks are registered with the BENCHMARK() macro and run by
+ * benchmark_runner.cpp.
+ */
+
+using benchmark_fn_t = void (*)(size_t n);
+
+struct BenchmarkRegistration {
+    BenchmarkRegistration(const char* name, benchmark_fn_t fn);
+    const char* name;
+    benchmark_fn_t fn;
+};
+
+#define BENCHMARK(name) \
+    static void name(size_t n); \
+    static BenchmarkRegistration name##_registration{#name, name}; \
+    static void name(size_t n)
+
+template<typename T>
+inline void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Number of precomputed inputs per benchmark. This is a power of two so
+// that the index can be wrapped with a mask and large enough that a branch
+// predictor can't learn the sequence.
+constexpr size_t kInputCount = 4096;
+constexpr size_t kInputMask = kInputCount - 1;
+
+/**
+ * @brief Returns kInputCount uniformly distributed values in [min, max).
+ *
+ * The seed is fixed so that every run sees the same inputs.
+ */
+inline std::vector<float> random_floats(float min, float max, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(min, max);
+    std::vector<float> result(kInputCount);
+    for (float& val: result) {
+        val = dist(rng);
+    }
+    return result;
+}
+
+#endif // __BENCHMARK_HPP
@@ -0,0 +1,241 @@
+/*
+* @brief Runs all registered microbenchmarks and optionally compares the
+* results against a baseline file.
+*
+* Usage:
+*   benchmark_runner.exe [filter]
+*   benchmark_runner.exe --baseline FILE [filter]
+*   benchmark_runner.exe --update-baseline FILE [filter]
+*
+* With --baseline the exit code is nonzero if any benchmark got slower than
+* the tolerance. Wall time is only comparable on the machine that produced
+* the baseline. Instruction counts are comparable across machines with the
+* same compiler and are therefore checked with a tighter tolerance, but they
+* are only available if the kernel exposes hardware performance counters.
+*/
+
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static constexpr size_t kCallsPerRun = 100000;
+static constexpr size_t kRuns = 50;
+static constexpr double kTimeTolerance = 0.25; // relative
+static constexpr double kInstructionTolerance = 0.05; // relative
+
+static std::vector<BenchmarkRegistration*>& registry() {
+    static std::vector<BenchmarkRegistration*> benchmarks;
+    return benchmarks;
+}
+
+BenchmarkRegistration::BenchmarkRegistration(const char* name, benchmark_fn_t fn)
+    : name(name), fn(fn) {
+    registry().push_back(this);
+}
+
+/**
+ * @brief Counts the user space instructions retired by the calling thread.
+ */
+class InstructionCounter {
+public:
+    InstructionCounter() {
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~InstructionCounter() {
+#ifdef __linux__
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+#endif
+    }
+
+    bool available() { return fd_ >= 0; }
+
+    void start() {
+#ifdef __linux__
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t stop() {
+        uint64_t count = 0;
+#ifdef __linux__
+        if (fd_ >= 0) {
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+struct Result {
+    double ns_per_call;
+    double instructions_per_call; // negative if not available
+};
+
+static Result run_benchmark(BenchmarkRegistration& benchmark, InstructionCounter& counter) {
+    benchmark.fn(kCallsPerRun); // warm up caches and initialize the input tables
+
+    Result result = {1e9, -1.0};
+    for (size_t i = 0; i < kRuns; ++i) {
+        counter.start();
+        auto start = std::chrono::steady_clock::now();
+        benchmark.fn(kCallsPerRun);
+        auto end = std::chrono::steady_clock::now();
+        uint64_t instructions = counter.stop();
+
+        // The minimum is the least disturbed by other activity on the machine
+        double ns = std::chrono::duration<double, std::nano>(end - start).count() / kCallsPerRun;
+        result.ns_per_call = std::min(result.ns_per_call, ns);
+        if (counter.available()) {
+            double ipc = (double)instructions / kCallsPerRun;
+            result.instructions_per_call = (result.instructions_per_call < 0.0) ? ipc : std::min(result.instructions_per_call, ipc);
+        }
+    }
+    return result;
+}
+
+// Baseline file format: one line per benchmark with the columns
+// "name ns_per_call instructions_per_call", where the instruction count is
+// "-" if it wasn't available. Lines starting with '#' are ignored.
+static bool load_baseline(const char* path, std::map<std::string, Result>* baseline) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char name[128];
+        char instructions[64];
+        double ns;
+        if (line[0] == '#' || sscanf(line, "%127s %lf %63s", name, &ns, instructions) != 3) {
+            continue;
+        }
+        double ipc = (strcmp(instructions, "-") == 0) ? -1.0 : atof(instructions);
+        (*baseline)[name] = {ns, ipc};
+    }
+    fclose(file);
+    return true;
+}
+
+static bool save_baseline(const char* path, const std::vector<std::pair<std::string, Result>>& results) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    fprintf(file, "# name ns_per_call instructions_per_call\n");
+    fprintf(file, "# Generated by benchmark_runner.exe --update-baseline\n");
+    for (auto& [name, result]: results) {
+        if (result.instructions_per_call < 0.0) {
+            fprintf(file, "%s %.2f -\n", name.c_str(), result.ns_per_call);
+        } else {
+            fprintf(file, "%s %.2f %.1f\n", name.c_str(), result.ns_per_call, result.instructions_per_call);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const char* baseline_path = nullptr;
+    const char* update_path = nullptr;
+    const char* filter = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--update-baseline") == 0 && i + 1 < argc) {
+            update_path = argv[++i];
+        } else if (argv[i][0] != '-') {
+            filter = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [--baseline FILE | --update-baseline FILE] [filter]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::map<std::string, Result> baseline;
+    if (baseline_path && !load_baseline(baseline_path, &baseline)) {
+        fprintf(stderr, "failed to read baseline %s\n", baseline_path);
+        return 2;
+    }
+
+    InstructionCounter counter;
+    if (!counter.available()) {
+        printf("hardware instruction counter not available, only measuring time\n");
+    }
+
+    std::vector<std::pair<std::string, Result>> results;
+    bool regression = false;
+
+    printf("%-24s %10s %10s %10s %10s\n", "benchmark", "ns/call", "instr/call", "base ns", "base instr");
+    for (BenchmarkRegistration* benchmark: registry()) {
+        if (filter && !strstr(benchmark->name, filter)) {
+            continue;
+        }
+
+        Result result = run_benchmark(*benchmark, counter);
+        results.push_back({benchmark->name, result});
+
+        char instructions[32] = "n/a";
+        if (result.instructions_per_call >= 0.0) {
+            snprintf(instructions, sizeof(instructions), "%.1f", result.instructions_per_call);
+        }
+        printf("%-24s %10.2f %10s", benchmark->name, result.ns_per_call, instructions);
+
+        auto it = baseline.find(benchmark->name);
+        if (it != baseline.end()) {
+            const Result& base = it->second;
+            bool slower = result.ns_per_call > base.ns_per_call * (1.0 + kTimeTolerance);
+            bool more_instructions = result.instructions_per_call >= 0.0 && base.instructions_per_call >= 0.0
+                    && result.instructions_per_call > base.instructions_per_call * (1.0 + kInstructionTolerance);
+            char base_instructions[32] = "n/a";
+            if (base.instructions_per_call >= 0.0) {
+                snprintf(base_instructions, sizeof(base_instructions), "%.1f", base.instructions_per_call);
+            }
+            printf(" %10.2f %10s%s", base.ns_per_call, base_instructions,
+                   (slower || more_instructions) ? "  REGRESSION" : "");
+            regression = regression || slower || more_instructions;
+        }
+        printf("\n");
+    }
+
+    if (update_path && !save_baseline(update_path, results)) {
+        fprintf(stderr, "failed to write baseline %s\n", update_path);
+        return 2;
+    }
+
+    return regression ? 1 : 0;
+}
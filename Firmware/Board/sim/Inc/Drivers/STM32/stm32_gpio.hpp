@@ -0,0 +1,55 @@
+#ifndef __STM32_GPIO_HPP
+#define __STM32_GPIO_HPP
+
+// Simulator replacement for Drivers/STM32/stm32_gpio.hpp.
+// The GPIO ports are backed by RAM (see sim_hal.h). Interrupt subscriptions
+// are accepted but edges are never generated.
+
+#include "stm32_system.h"
+
+class Stm32Gpio {
+public:
+    static const Stm32Gpio none;
+
+    Stm32Gpio() : port_(nullptr), pin_mask_(0) {}
+    constexpr Stm32Gpio(GPIO_TypeDef* port, uint16_t pin) : port_(port), pin_mask_(pin) {}
+
+    operator bool() const { return port_ && pin_mask_; }
+    bool operator==(Stm32Gpio other) const { return port_ == other.port_ && pin_mask_ == other.pin_mask_; }
+
+    bool config(uint32_t mode, uint32_t pull,
+        uint32_t speed = GPIO_SPEED_FREQ_LOW, uint32_t alternate_function = 0) const {
+        return true;
+    }
+
+    void write(bool state) {
+        if (port_) {
+            HAL_GPIO_WritePin(port_, pin_mask_, state ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        }
+    }
+
+    bool read() const {
+        return port_ && (port_->IDR & pin_mask_);
+    }
+
+    bool subscribe(bool rising_edge, bool falling_edge, void (*callback)(void*), void* ctx) {
+        return true;
+    }
+
+    void unsubscribe() {}
+
+    uint16_t get_pin_number() const {
+        uint16_t pin_number = 0;
+        uint16_t pin_mask = pin_mask_ >> 1;
+        while (pin_mask) {
+            pin_mask >>= 1;
+            pin_number++;
+        }
+        return pin_number;
+    }
+
+    GPIO_TypeDef* port_;
+    uint16_t pin_mask_;
+};
+
+#endif // __STM32_GPIO_HPP
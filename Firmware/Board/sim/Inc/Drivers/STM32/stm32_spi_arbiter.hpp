@@ -0,0 +1,55 @@
+#ifndef __STM32_SPI_ARBITER_HPP
+#define __STM32_SPI_ARBITER_HPP
+
+// Simulator replacement for Drivers/STM32/stm32_spi_arbiter.hpp.
+// There are no SPI devices on the simulated board: every transfer completes
+// immediately and unsuccessfully.
+
+#include "stm32_gpio.hpp"
+
+struct Stm32Spi {
+    struct Config {
+        uint32_t max_baud_rate;
+        uint32_t clk_polarity;
+        uint32_t clk_phase;
+    };
+};
+
+class Stm32SpiArbiter {
+public:
+    struct SpiTask {
+        Stm32Spi::Config config;
+        Stm32Gpio ncs_gpio;
+        const uint8_t* tx_buf;
+        uint8_t* rx_buf;
+        size_t length;
+        void (*on_complete)(void*, bool);
+        void* on_complete_ctx;
+        bool is_in_use = false;
+        struct SpiTask* next;
+    };
+
+    static bool acquire_task(SpiTask* task) {
+        if (task->is_in_use) {
+            return false;
+        }
+        task->is_in_use = true;
+        return true;
+    }
+
+    static void release_task(SpiTask* task) {
+        task->is_in_use = false;
+    }
+
+    void transfer_async(SpiTask* task) {
+        if (task->on_complete) {
+            task->on_complete(task->on_complete_ctx, false);
+        }
+    }
+
+    bool transfer(Stm32Spi::Config config, Stm32Gpio ncs_gpio, const uint8_t* tx_buf, uint8_t* rx_buf, size_t length, uint32_t timeout_ms) {
+        return false;
+    }
+};
+
+#endif // __STM32_SPI_ARBITER_HPP
@@ -0,0 +1,56 @@
+#ifndef __STM32_SYSTEM_H
+#define __STM32_SYSTEM_H
+
+// Simulator replacement for Drivers/STM32/stm32_system.h.
+// All simulated interrupts and threads run on the same host thread and
+// never preempt each other, so critical sections are no-ops.
+
+#include <sim_hal.h>
+
+// C/C++ definitions
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COUNT_IRQ(irqn) ((void)0)
+#define GET_IRQ_COUNTER(irqn) 0
+
+static inline uint32_t cpu_enter_critical() {
+    return 0;
+}
+
+static inline void cpu_exit_critical(uint32_t priority_mask) {
+    (void)priority_mask;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+
+// C++ only definitions
+
+#ifdef __cplusplus
+
+struct CriticalSectionContext {
+    CriticalSectionContext(const CriticalSectionContext&) = delete;
+    CriticalSectionContext(const CriticalSectionContext&&) = delete;
+    void operator=(const CriticalSectionContext&) = delete;
+    void operator=(const CriticalSectionContext&&) = delete;
+    operator bool() { return true; };
+    CriticalSectionContext() : mask_(cpu_enter_critical()) {}
+    ~CriticalSectionContext() { cpu_exit_critical(mask_); }
+    uint32_t mask_;
+    bool exit_ = false;
+};
+
+#ifdef __clang__
+#define CRITICAL_SECTION() for (CriticalSectionContext __critical_section_context; !__critical_section_context.exit_; __critical_section_context.exit_ = true)
+#else
+#define CRITICAL_SECTION() if (CriticalSectionContext __critical_section_context{})
+#endif
+
+#endif
+
+#endif // __STM32_SYSTEM_H
@@ -0,0 +1,12 @@
+#ifndef __STM32_USART_HPP
+#define __STM32_USART_HPP
+
+// Simulator replacement for Drivers/STM32/stm32_usart.hpp.
+// The simulated board has no UARTs. This only exists so that the UART related
+// declarations in the communication headers compile.
+
+struct Stm32Usart {
+    bool init(uint32_t baudrate) { return false; }
+};
+
+#endif // __STM32_USART_HPP
@@ -0,0 +1,10 @@
+#ifndef __SIM_ARM_COMMON_TABLES_H
+#define __SIM_ARM_COMMON_TABLES_H
+
+#include "arm_math.h"
+
+// Defined in sin_table.c. On the real hardware this table comes from the
+// precompiled CMSIS-DSP library.
+extern const float32_t sinTable_f32[FAST_MATH_TABLE_SIZE + 1];
+
+#endif // __SIM_ARM_COMMON_TABLES_H
@@ -0,0 +1,21 @@
+/*
+* @brief The few CMSIS-DSP definitions needed by the firmware, without pulling
+* in the Cortex-M core headers.
+*/
+
+#ifndef __SIM_ARM_MATH_H
+#define __SIM_ARM_MATH_H
+
+#include <stdint.h>
+#include <math.h>
+
+typedef int8_t q7_t;
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+typedef int64_t q63_t;
+typedef float float32_t;
+typedef double float64_t;
+
+#define FAST_MATH_TABLE_SIZE  512
+
+#endif // __SIM_ARM_MATH_H
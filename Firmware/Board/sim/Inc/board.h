@@ -0,0 +1,148 @@
+/*
+* @brief Contains board specific configuration for the host simulator.
+*
+* The simulated board mimics a two-axis ODrive v3.x. Instead of the STM32
+* peripherals it is backed by a motor plant model (see pmsm_model.hpp) and the
+* cooperative scheduler in cmsis_os.cpp.
+*/
+
+#ifndef __BOARD_CONFIG_H
+#define __BOARD_CONFIG_H
+
+#include <stdbool.h>
+
+#include <sim_hal.h>
+#include "cmsis_os.h"
+
+#include <arm_math.h>
+
+#include <Drivers/STM32/stm32_system.h>
+
+#ifndef HW_VERSION_MAJOR
+#define HW_VERSION_MAJOR 3
+#endif
+#ifndef HW_VERSION_MINOR
+#define HW_VERSION_MINOR 6
+#endif
+#ifndef HW_VERSION_VOLTAGE
+#define HW_VERSION_VOLTAGE 24
+#endif
+
+// Same timer configuration as on ODrive v3.x (see Board/v3/Inc/main.h)
+#define TIM_1_8_CLOCK_HZ 168000000
+#define TIM_1_8_PERIOD_CLOCKS 3500
+#define TIM_1_8_DEADTIME_CLOCKS 20
+#define TIM_APB1_CLOCK_HZ 84000000
+#define TIM_APB1_PERIOD_CLOCKS 4096
+#define TIM_APB1_DEADTIME_CLOCKS 40
+#define TIM_1_8_RCR 2
+
+#define SHUNT_RESISTANCE (500e-6f)
+
+#define AXIS_COUNT (2)
+
+#define GPIO_COUNT  (17)
+
+#define DEFAULT_BRAKE_RESISTANCE (2.0f) // [ohm]
+
+#define DEFAULT_ERROR_PIN 0
+#define DEFAULT_MIN_DC_VOLTAGE 8.0f
+
+#define DEFAULT_GPIO_MODES \
+    ODriveIntf::GPIO_MODE_DIGITAL, \
+    ODriveIntf::GPIO_MODE_DIGITAL, \
+    ODriveIntf::GPIO_MODE_DIGITAL, \
+    ODriveIntf::GPIO_MODE_ANALOG_IN, \
+    ODriveIntf::GPIO_MODE_ANALOG_IN, \
+    ODriveIntf::GPIO_MODE_ANALOG_IN, \
+    ODriveIntf::GPIO_MODE_DIGITAL, \
+    ODriveIntf::GPIO_MODE_DIGITAL, \
+    ODriveIntf::GPIO_MODE_DIGITAL, \
+    ODriveIntf::GPIO_MODE_ENC0, \
+    ODriveIntf::GPIO_MODE_ENC0, \
+    ODriveIntf::GPIO_MODE_DIGITAL_PULL_DOWN, \
+    ODriveIntf::GPIO_MODE_ENC1, \
+    ODriveIntf::GPIO_MODE_ENC1, \
+    ODriveIntf::GPIO_MODE_DIGITAL_PULL_DOWN, \
+    ODriveIntf::GPIO_MODE_DIGITAL, \
+    ODriveIntf::GPIO_MODE_DIGITAL,
+
+// Free running microsecond counter that resets every millisecond (used by micros())
+extern TIM_TypeDef sim_time_base;
+#define TIM_TIME_BASE (&sim_time_base)
+
+// Simulated time in microseconds, wraps around at 32 bits
+extern volatile uint32_t sim_time_us;
+
+// Run control loop at the same frequency as the current measurements.
+#define CONTROL_TIMER_PERIOD_TICKS  (2 * TIM_1_8_PERIOD_CLOCKS * (TIM_1_8_RCR + 1))
+
+#define TIM1_INIT_COUNT (TIM_1_8_PERIOD_CLOCKS / 2 - 1 * 128)
+
+// The delta from the control loop timestamp to the current sense timestamp is
+// exactly 0 for M0 and TIM1_INIT_COUNT for M1.
+#define MAX_CONTROL_LOOP_UPDATE_TO_CURRENT_UPDATE_DELTA (TIM_1_8_PERIOD_CLOCKS / 2 + 1 * 128)
+
+#ifdef __cplusplus
+#include <Drivers/STM32/stm32_gpio.hpp>
+#include <Drivers/STM32/stm32_spi_arbiter.hpp>
+#include <Drivers/STM32/stm32_usart.hpp>
+#include <interfaces/canbus.hpp>
+#include <interfaces/pwm_output_group.hpp>
+#include <MotorControl/thermistor.hpp>
+#include <sim_gate_driver.hpp>
+
+using TGateDriver = SimGateDriver;
+using TOpAmp = SimGateDriver;
+
+#include <MotorControl/motor.hpp>
+#include <MotorControl/encoder.hpp>
+
+
+#include <interfaces/board_support_package.hpp>
+
+struct BoardTraits {
+    constexpr static const unsigned _AXIS_COUNT = AXIS_COUNT;
+    constexpr static const unsigned _GPIO_COUNT = GPIO_COUNT;
+    constexpr static const unsigned UART_COUNT = 0;
+    constexpr static const unsigned CANBUS_COUNT = 1;
+    constexpr static const unsigned SPI_COUNT = 1;
+    constexpr static const unsigned INC_ENC_COUNT = 2;
+};
+using BoardSupportPackage = BoardSupportPackageBase<BoardTraits>;
+
+extern BoardSupportPackage board;
+
+
+extern std::array<Axis, AXIS_COUNT> axes;
+extern Motor motors[AXIS_COUNT];
+extern Encoder encoders[AXIS_COUNT];
+
+extern Stm32SpiArbiter& ext_spi_arbiter;
+
+extern PwmOutputGroup<1>& brake_resistor_output;
+
+// Points to a counter that resets at the main control loop frequency. The unit
+// of this counter is an implementation detail. The period is indicated by
+// `board_control_loop_counter_period`.
+extern volatile uint32_t& board_control_loop_counter;
+extern uint32_t board_control_loop_counter_period;
+
+// Points to a free running counter that timestamps trace events (see
+// trace.hpp). It wraps around at 32 bits.
+extern volatile uint32_t& board_trace_counter;
+extern uint32_t board_trace_counter_hz;
+#endif
+
+// Period in [s]
+#define CURRENT_MEAS_PERIOD ( (float)2*TIM_1_8_PERIOD_CLOCKS*(TIM_1_8_RCR+1) / (float)TIM_1_8_CLOCK_HZ )
+static const float current_meas_period = CURRENT_MEAS_PERIOD;
+
+// Frequency in [Hz]
+#define CURRENT_MEAS_HZ ( (float)(TIM_1_8_CLOCK_HZ) / (float)(2*TIM_1_8_PERIOD_CLOCKS*(TIM_1_8_RCR+1)) )
+static const int current_meas_hz = CURRENT_MEAS_HZ;
+
+
+void start_timers();
+
+#endif // __BOARD_CONFIG_H
@@ -0,0 +1,105 @@
+/*
+* @brief Subset of the CMSIS-RTOS API for the simulator.
+*
+* Threads are implemented as cooperative coroutines that all run on the host's
+* main thread. A thread only gives up the CPU when it calls a blocking function
+* (osDelay(), osSignalWait(), ...). Time does not advance by itself but is
+* driven by the simulated board, which makes simulation runs deterministic and
+* allows them to run much faster than real-time.
+*/
+
+#ifndef __SIM_CMSIS_OS_H
+#define __SIM_CMSIS_OS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum  {
+  osPriorityIdle          = -3,
+  osPriorityLow           = -2,
+  osPriorityBelowNormal   = -1,
+  osPriorityNormal        =  0,
+  osPriorityAboveNormal   = +1,
+  osPriorityHigh          = +2,
+  osPriorityRealtime      = +3,
+  osPriorityError         =  0x84
+} osPriority;
+
+#define osWaitForever     0xFFFFFFFF
+
+typedef enum  {
+  osOK                    =     0,
+  osEventSignal           =  0x08,
+  osEventMessage          =  0x10,
+  osEventTimeout          =  0x40,
+  osErrorParameter        =  0x80,
+  osErrorResource         =  0x81,
+  osErrorOS               =  0xFF,
+  os_status_reserved      =  0x7FFFFFFF
+} osStatus;
+
+typedef void (*os_pthread) (void *argument);
+
+typedef uint32_t StackType_t;
+
+typedef struct sim_thread* osThreadId;
+typedef struct sim_queue* osMessageQId;
+typedef struct sim_semaphore* osSemaphoreId;
+
+typedef struct os_thread_def  {
+  const char             *name;
+  os_pthread             pthread;
+  osPriority             tpriority;
+  uint32_t               instances;
+  uint32_t               stacksize;
+} osThreadDef_t;
+
+typedef struct  {
+  osStatus                 status;
+  union  {
+    uint32_t                    v;
+    void                       *p;
+    int32_t               signals;
+  } value;
+} osEvent;
+
+#define osThreadDef(name, thread, priority, instances, stacksz)  \
+const osThreadDef_t os_thread_def_##name = \
+{ #name, (thread), (priority), (instances), (stacksz)}
+
+#define osThread(name)  \
+&os_thread_def_##name
+
+#define osKernelSysTickFrequency 1000
+
+uint32_t osKernelSysTick(void);
+
+osThreadId osThreadCreate(const osThreadDef_t *thread_def, void *argument);
+osThreadId osThreadGetId(void);
+osStatus osThreadYield(void);
+osStatus osDelay(uint32_t millisec);
+int32_t osSignalSet(osThreadId thread_id, int32_t signals);
+osEvent osSignalWait(int32_t signals, uint32_t millisec);
+
+/**
+ * @brief Advances the simulated time by the specified number of microseconds
+ * and resumes all threads that became ready in the meantime.
+ *
+ * Must only be called from outside of any thread (i.e. from the simulated
+ * hardware).
+ */
+void sim_os_advance(uint32_t microseconds);
+
+/**
+ * @brief Returns the simulated time in microseconds since startup.
+ */
+uint64_t sim_os_micros(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __SIM_CMSIS_OS_H
@@ -0,0 +1,76 @@
+#ifndef __PMSM_MODEL_HPP
+#define __PMSM_MODEL_HPP
+
+#include <stdint.h>
+
+/**
+ * @brief Plant model of a star connected permanent magnet synchronous motor
+ * with sinusoidal back-EMF and an attached rigid inertia.
+ *
+ * The electrical part is modeled in the rotor (dq) frame. The inverter is
+ * modeled as ideal switches driven by the average PWM duty cycle of each half
+ * bridge over one simulation step.
+ */
+class PmsmModel {
+public:
+    struct Config_t {
+        uint32_t pole_pairs = 7;
+        float phase_resistance = 0.05f; // [Ohm]
+        float phase_inductance = 20e-6f; // [H]
+        float torque_constant = 8.27f / 270.0f; // [Nm/A]
+        float inertia = 1e-4f; // [kg m^2]
+        float viscous_friction = 1e-4f; // [Nm/(rad/s)]
+        float coulomb_friction = 0.0f; // [Nm]
+        float load_torque = 0.0f; // [Nm]
+        int32_t encoder_cpr = 8192;
+        float encoder_offset = 0.0f; // [rad] mechanical angle at which the encoder reads zero
+        uint32_t substeps = 4; // number of integration steps per call to step()
+    };
+
+    /**
+     * @brief Advances the model by dt seconds.
+     *
+     * @param duty: Duty cycle of each half bridge in [0, 1]. Ignored if
+     *        enabled is false.
+     * @param enabled: False if all switches are open. The model assumes that
+     *        the phase currents then decay to zero within one step.
+     * @param vbus: DC link voltage [V]
+     * @param dt: Duration of the step [s]
+     */
+    void step(const float duty[3], bool enabled, float vbus, float dt);
+
+    /**
+     * @brief Returns the current phase currents [A] (positive into the motor).
+     */
+    void get_phase_currents(float* ia, float* ib, float* ic) const;
+
+    /**
+     * @brief Returns the power drawn from the DC link [W], averaged over the
+     * most recent step.
+     */
+    float get_dc_power() const { return dc_power_; }
+
+    /**
+     * @brief Returns the current quadrature encoder count (wrapping at 16 bits
+     * like the STM32 timer counter).
+     */
+    uint16_t get_encoder_count() const;
+
+    float pos() const { return (float)theta_; } // [rad] mechanical
+    float vel() const { return omega_; } // [rad/s] mechanical
+    float id() const { return id_; }
+    float iq() const { return iq_; }
+    float torque() const { return torque_; } // [Nm] electromagnetic
+
+    Config_t config_;
+
+private:
+    double theta_ = 0.0; // [rad] (double to avoid losing resolution after many turns)
+    float omega_ = 0.0f; // [rad/s]
+    float id_ = 0.0f; // [A]
+    float iq_ = 0.0f; // [A]
+    float torque_ = 0.0f; // [Nm]
+    float dc_power_ = 0.0f; // [W]
+};
+
+#endif // __PMSM_MODEL_HPP
@@ -0,0 +1,32 @@
+#ifndef __SIM_BOARD_HPP
+#define __SIM_BOARD_HPP
+
+#include <board.h>
+#include "pmsm_model.hpp"
+
+/**
+ * @brief Plant models of the motors that are connected to M0 and M1.
+ *
+ * Must be configured before the first call to sim_run_control_period().
+ */
+extern PmsmModel motor_models[AXIS_COUNT];
+
+extern SimGateDriver m0_gate_driver;
+extern SimGateDriver m1_gate_driver;
+
+/**
+ * @brief Voltage of the (ideal) DC supply [V].
+ */
+extern float sim_supply_voltage;
+
+/**
+ * @brief Advances the simulated board by one control loop period
+ * (CURRENT_MEAS_PERIOD).
+ *
+ * This runs the same interrupt handler sequence as the v3 board, applies the
+ * resulting PWM outputs to the motor models and then lets all threads run
+ * that became ready during this period.
+ */
+void sim_run_control_period();
+
+#endif // __SIM_BOARD_HPP
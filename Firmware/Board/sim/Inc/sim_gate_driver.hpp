@@ -0,0 +1,53 @@
+#ifndef __SIM_GATE_DRIVER_HPP
+#define __SIM_GATE_DRIVER_HPP
+
+#include <interfaces/gate_driver.hpp>
+#include <stdint.h>
+
+/**
+ * @brief Ideal gate driver and current sense amplifier.
+ *
+ * Accepts any gain and never faults. The fault injection members can be used
+ * by a simulation scenario to exercise the firmware's error handling.
+ */
+class SimGateDriver : public GateDriverBase, public OpAmpBase {
+public:
+    bool config(float requested_gain, float* actual_gain) {
+        gain_ = requested_gain;
+        *actual_gain = requested_gain;
+        return true;
+    }
+
+    bool init() {
+        is_ready_ = true;
+        return !inject_fault_;
+    }
+
+    void do_checks() {
+        if (inject_fault_) {
+            is_ready_ = false;
+        }
+    }
+
+    bool is_ready() final { return is_ready_; }
+
+    bool set_enabled(bool enabled) final { return true; }
+
+    uint32_t get_error() { return inject_fault_ ? 1 : 0; }
+
+    float get_midpoint() final {
+        return 0.5f;
+    }
+
+    float get_max_output_swing() final {
+        return 1.35f / 1.65f;
+    }
+
+    bool inject_fault_ = false;
+
+private:
+    float gain_ = 1.0f;
+    bool is_ready_ = false;
+};
+
+#endif // __SIM_GATE_DRIVER_HPP
@@ -0,0 +1,129 @@
+/*
+* @brief Minimal stand-ins for the STM32 HAL types and macros that are used by
+* the hardware independent parts of the firmware.
+*
+* Only the registers that the motor control code actually touches are modeled.
+* They are plain memory so the simulated board can read back what the firmware
+* wrote (e.g. PWM compare values) and feed in what the hardware would produce
+* (e.g. encoder counts).
+*/
+
+#ifndef __SIM_HAL_H
+#define __SIM_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    volatile uint32_t CR1;
+    volatile uint32_t CNT;
+    volatile uint32_t CCR1;
+    volatile uint32_t CCR2;
+    volatile uint32_t CCR3;
+    volatile uint32_t CCR4;
+    volatile uint32_t CCER;
+    volatile uint32_t BDTR;
+} TIM_TypeDef;
+
+typedef struct {
+    TIM_TypeDef* Instance;
+} TIM_HandleTypeDef;
+
+typedef struct {
+    volatile uint32_t IDR;
+    volatile uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+#define TIM_BDTR_AOE        (1UL << 14)
+#define TIM_BDTR_MOE        (1UL << 15)
+#define TIM_BDTR_MOE_Msk    TIM_BDTR_MOE
+#define TIM_CR1_DIR         (1UL << 4)
+
+#define TIM_CHANNEL_1       0x00000000U
+#define TIM_CHANNEL_2       0x00000004U
+#define TIM_CHANNEL_3       0x00000008U
+#define TIM_CHANNEL_4       0x0000000CU
+#define TIM_CHANNEL_ALL     0x0000003CU
+#define TIM_CCx_ENABLE      0x00000001U
+#define TIM_CCxN_ENABLE     0x00000004U
+
+#define __HAL_TIM_MOE_DISABLE_UNCONDITIONALLY(__HANDLE__) ((__HANDLE__)->Instance->BDTR &= ~(TIM_BDTR_MOE))
+
+static inline HAL_StatusTypeDef HAL_TIM_Encoder_Start(TIM_HandleTypeDef* htim, uint32_t channel) {
+    (void)htim; (void)channel;
+    return HAL_OK;
+}
+
+#define GPIO_PIN_0          ((uint16_t)0x0001)
+#define GPIO_PIN_1          ((uint16_t)0x0002)
+#define GPIO_PIN_2          ((uint16_t)0x0004)
+#define GPIO_PIN_3          ((uint16_t)0x0008)
+#define GPIO_PIN_4          ((uint16_t)0x0010)
+#define GPIO_PIN_5          ((uint16_t)0x0020)
+#define GPIO_PIN_6          ((uint16_t)0x0040)
+#define GPIO_PIN_7          ((uint16_t)0x0080)
+#define GPIO_PIN_8          ((uint16_t)0x0100)
+#define GPIO_PIN_9          ((uint16_t)0x0200)
+#define GPIO_PIN_10         ((uint16_t)0x0400)
+#define GPIO_PIN_11         ((uint16_t)0x0800)
+#define GPIO_PIN_12         ((uint16_t)0x1000)
+#define GPIO_PIN_13         ((uint16_t)0x2000)
+#define GPIO_PIN_14         ((uint16_t)0x4000)
+#define GPIO_PIN_15         ((uint16_t)0x8000)
+
+#define GPIO_MODE_INPUT     0x00000000U
+#define GPIO_MODE_OUTPUT_PP 0x00000001U
+#define GPIO_MODE_AF_PP     0x00000002U
+#define GPIO_MODE_ANALOG    0x00000003U
+#define GPIO_NOPULL         0x00000000U
+#define GPIO_PULLUP         0x00000001U
+#define GPIO_PULLDOWN       0x00000002U
+#define GPIO_SPEED_FREQ_LOW       0x00000000U
+#define GPIO_SPEED_FREQ_VERY_HIGH 0x00000003U
+
+#define SPI_POLARITY_LOW    0x00000000U
+#define SPI_POLARITY_HIGH   0x00000002U
+#define SPI_PHASE_1EDGE     0x00000000U
+#define SPI_PHASE_2EDGE     0x00000001U
+
+// The GPIO ports are backed by RAM so that Stm32Gpio can be used unmodified.
+extern GPIO_TypeDef sim_gpio_ports[4];
+#define GPIOA (&sim_gpio_ports[0])
+#define GPIOB (&sim_gpio_ports[1])
+#define GPIOC (&sim_gpio_ports[2])
+#define GPIOD (&sim_gpio_ports[3])
+
+static inline void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state) {
+    if (state == GPIO_PIN_SET) {
+        port->ODR |= pin;
+    } else {
+        port->ODR &= ~(uint32_t)pin;
+    }
+}
+
+uint32_t HAL_GetTick(void);
+void NVIC_SystemReset(void);
+
+#define __NOP() ((void)0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __SIM_HAL_H
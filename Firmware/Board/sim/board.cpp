@@ -0,0 +1,373 @@
+/*
+* @brief Contains board specific variables and the simulated hardware of the
+* host simulator.
+*
+* The objects are laid out like on ODrive v3.x (see Board/v3/board.cpp) so that
+* the motor control code runs unmodified. Where the v3 board reacts to timer
+* and ADC interrupts, this board is driven by sim_run_control_period().
+*/
+
+#include <board.h>
+
+#include <odrive_main.h>
+
+#include <Drivers/STM32/stm32_basic_pwm_output.hpp>
+
+#include "sim_board.hpp"
+
+// this should technically be in task_timer.cpp but let's not make a one-line file
+bool TaskTimer::enabled = false;
+uint16_t TaskTimer::next_trace_id = Trace::TRACE_SOURCE_TASK_TIMERS;
+
+GPIO_TypeDef sim_gpio_ports[4] = {};
+
+const Stm32Gpio Stm32Gpio::none{nullptr, 0};
+
+TIM_TypeDef sim_tim1 = {};
+TIM_TypeDef sim_tim2 = {};
+TIM_TypeDef sim_tim3 = {};
+TIM_TypeDef sim_tim4 = {};
+TIM_TypeDef sim_tim8 = {};
+
+TIM_HandleTypeDef htim1 = {&sim_tim1};
+TIM_HandleTypeDef htim3 = {&sim_tim3};
+TIM_HandleTypeDef htim4 = {&sim_tim4};
+TIM_HandleTypeDef htim8 = {&sim_tim8};
+
+
+/* External GPIOs ------------------------------------------------------------*/
+
+template<> const std::array<Stm32Gpio, GPIO_COUNT> BoardSupportPackage::gpios = {{
+    {nullptr, 0}, // dummy GPIO0 so that PCB labels and software numbers match
+
+    {GPIOA, GPIO_PIN_0}, // GPIO1
+    {GPIOA, GPIO_PIN_1}, // GPIO2
+    {GPIOA, GPIO_PIN_2}, // GPIO3
+    {GPIOA, GPIO_PIN_3}, // GPIO4
+    {GPIOC, GPIO_PIN_4}, // GPIO5
+    {GPIOB, GPIO_PIN_2}, // GPIO6
+    {GPIOA, GPIO_PIN_15}, // GPIO7
+    {GPIOB, GPIO_PIN_3}, // GPIO8
+
+    {GPIOB, GPIO_PIN_4}, // ENC0_A
+    {GPIOB, GPIO_PIN_5}, // ENC0_B
+    {GPIOC, GPIO_PIN_9}, // ENC0_Z
+    {GPIOB, GPIO_PIN_6}, // ENC1_A
+    {GPIOB, GPIO_PIN_7}, // ENC1_B
+    {GPIOC, GPIO_PIN_15}, // ENC1_Z
+    {GPIOB, GPIO_PIN_8}, // CAN_R
+    {GPIOB, GPIO_PIN_9}, // CAN_D
+}};
+
+template<> const int BoardSupportPackage::uart_tx_gpios[] = {};
+template<> const int BoardSupportPackage::uart_rx_gpios[] = {};
+
+template<> const int BoardSupportPackage::inc_enc_a_gpios[] = {9, 12};
+template<> const int BoardSupportPackage::inc_enc_b_gpios[] = {10, 13};
+
+template<> const int BoardSupportPackage::spi_miso_gpios[] = {-1};
+template<> const int BoardSupportPackage::spi_mosi_gpios[] = {-1};
+template<> const int BoardSupportPackage::spi_sck_gpios[] = {-1};
+
+template<> const int BoardSupportPackage::can_r_gpios[] = {15};
+template<> const int BoardSupportPackage::can_d_gpios[] = {16};
+
+std::array<int, 5> adc_gpios = {1, 2, 3, 4, 5};
+
+
+/* Communication interfaces --------------------------------------------------*/
+
+Stm32SpiArbiter spi_arbiter;
+Stm32SpiArbiter& ext_spi_arbiter = spi_arbiter;
+
+template<> const std::array<Stm32Usart*, board.UART_COUNT> BoardSupportPackage::uarts = {};
+
+/**
+ * @brief CAN bus without any other nodes. Messages are accepted and dropped.
+ */
+class SimCanBus : public CanBusBase {
+public:
+    bool is_valid_baud_rate(uint32_t nominal_baud_rate, uint32_t data_baud_rate) final {
+        return true;
+    }
+    bool start(uint32_t nominal_baud_rate, uint32_t data_baud_rate, on_event_cb_t rx_event_loop, on_error_cb_t on_error) final {
+        return true;
+    }
+    bool stop() final {
+        return true;
+    }
+    bool send_message(uint32_t tx_slot, const can_Message_t& message, on_sent_cb_t on_sent) final {
+        return true;
+    }
+    bool subscribe(uint32_t rx_slot, const MsgIdFilterSpecs& filter, on_received_cb_t on_received, CanSubscription** handle) final {
+        return true;
+    }
+    bool unsubscribe(CanSubscription* handle) final {
+        return true;
+    }
+};
+
+SimCanBus can_a;
+
+template<> const std::array<CanBusBase*, 1> BoardSupportPackage::can_busses = {&can_a};
+
+
+/* Onboard devices -----------------------------------------------------------*/
+
+SimGateDriver m0_gate_driver;
+SimGateDriver m1_gate_driver;
+
+Motor motors[AXIS_COUNT] = {
+    {
+        &htim1, // timer
+        0b110, // current_sensor_mask
+        1.0f / SHUNT_RESISTANCE, // shunt_conductance [S]
+        m0_gate_driver, // gate_driver
+        m0_gate_driver, // opamp
+        &board.motor_fet_temperatures[0],
+    },
+    {
+        &htim8, // timer
+        0b110, // current_sensor_mask
+        1.0f / SHUNT_RESISTANCE, // shunt_conductance [S]
+        m1_gate_driver, // gate_driver
+        m1_gate_driver, // opamp
+        &board.motor_fet_temperatures[1],
+    }
+};
+
+Encoder encoders[AXIS_COUNT] = {
+    {
+        &htim3, // timer
+        board.gpios[11], // index_gpio
+        board.gpios[9], // hallA_gpio
+        board.gpios[10], // hallB_gpio
+        board.gpios[11], // hallC_gpio
+        &spi_arbiter // spi_arbiter
+    },
+    {
+        &htim4, // timer
+        board.gpios[14], // index_gpio
+        board.gpios[12], // hallA_gpio
+        board.gpios[13], // hallB_gpio
+        board.gpios[14], // hallC_gpio
+        &spi_arbiter // spi_arbiter
+    }
+};
+
+// TODO: this has no hardware dependency and should be allocated depending on config
+Endstop endstops[2 * AXIS_COUNT];
+MechanicalBrake mechanical_brakes[AXIS_COUNT];
+
+SensorlessEstimator sensorless_estimators[AXIS_COUNT];
+Controller controllers[AXIS_COUNT];
+TrapezoidalTrajectory trap[AXIS_COUNT];
+
+std::array<Axis, AXIS_COUNT> axes{{
+    {
+        0, // axis_num
+        1, // step_gpio_pin
+        2, // dir_gpio_pin
+        (osPriority)(osPriorityHigh + (osPriority)1), // thread_priority
+        encoders[0], // encoder
+        sensorless_estimators[0], // sensorless_estimator
+        controllers[0], // controller
+        motors[0], // motor
+        trap[0], // trap
+        endstops[0], endstops[1], // min_endstop, max_endstop
+        mechanical_brakes[0], // mechanical brake
+    },
+    {
+        1, // axis_num
+        7, // step_gpio_pin
+        8, // dir_gpio_pin
+        osPriorityHigh, // thread_priority
+        encoders[1], // encoder
+        sensorless_estimators[1], // sensorless_estimator
+        controllers[1], // controller
+        motors[1], // motor
+        trap[1], // trap
+        endstops[2], endstops[3], // min_endstop, max_endstop
+        mechanical_brakes[1], // mechanical brake
+    },
+}};
+
+Stm32BasicPwmOutput<TIM_APB1_PERIOD_CLOCKS, TIM_APB1_DEADTIME_CLOCKS> brake_resistor_output_impl{sim_tim2.CCR3, sim_tim2.CCR4};
+PwmOutputGroup<1>& brake_resistor_output = brake_resistor_output_impl;
+
+template<> PwmOutputGroup<1>* BoardSupportPackage::fan_output = nullptr;
+
+PmsmModel motor_models[AXIS_COUNT];
+
+float sim_supply_voltage = 24.0f;
+
+
+/* Misc Variables ------------------------------------------------------------*/
+
+// Execution times on the host say nothing about the execution times on the
+// target, so the task timers are fed by a counter that never advances.
+static volatile uint32_t control_loop_counter = 0;
+volatile uint32_t& board_control_loop_counter = control_loop_counter;
+uint32_t board_control_loop_counter_period = CONTROL_TIMER_PERIOD_TICKS / 2;
+volatile uint32_t& board_trace_counter = sim_time_us;
+uint32_t board_trace_counter_hz = 1000000;
+
+BoardSupportPackage board;
+
+
+template<> bool BoardSupportPackage::init() {
+    return true;
+}
+
+template<> bool BoardSupportPackage::config(const BoardConfig& config) {
+    if (!validate_gpios(config)) {
+        return false;
+    }
+
+    // Cannot disable SPI because it's used by gate drivers on the real board
+    if (!config.spi_config[0].enabled) {
+        return false;
+    }
+
+    return true;
+}
+
+static bool timers_started_ = false;
+
+void start_timers() {
+    sim_tim1.CNT = TIM1_INIT_COUNT;
+    sim_tim8.CNT = 0;
+    timers_started_ = true;
+}
+
+// Linear range of the DRV8301 opamp output (see Board/v3/board.cpp)
+#define CURRENT_SENSE_MIN_VOLT  0.3f
+#define CURRENT_SENSE_MAX_VOLT  3.0f
+
+/**
+ * @brief Emulates the current sense amplifier and ADC of one motor.
+ *
+ * Like on the v3 board only phases B and C are measured and phase A is
+ * inferred.
+ */
+static std::optional<Iph_ABC_t> sample_currents(Motor& motor, SimGateDriver& gate_driver, PmsmModel& model) {
+    if (!gate_driver.is_ready()) {
+        return std::nullopt;
+    }
+
+    float ia, ib, ic;
+    model.get_phase_currents(&ia, &ib, &ic);
+
+    const float max_current = (CURRENT_SENSE_MAX_VOLT - CURRENT_SENSE_MIN_VOLT) / 2.0f
+                            * motor.phase_current_rev_gain_ / SHUNT_RESISTANCE;
+    if (std::abs(ib) > max_current || std::abs(ic) > max_current) {
+        motor.error_ |= Motor::ERROR_CURRENT_SENSE_SATURATION;
+        return std::nullopt;
+    }
+
+    return Iph_ABC_t{-ib - ic, ib, ic};
+}
+
+/**
+ * @brief Emulates the timer update event at which the compare values and the
+ * automatic output enable take effect.
+ */
+static void latch_pwm_outputs(TIM_TypeDef* tim, float duty[3]) {
+    if (tim->BDTR & TIM_BDTR_AOE) {
+        tim->BDTR |= TIM_BDTR_MOE;
+    }
+
+    // TIM1 and TIM8 run in PWM mode 2, so the compare values are the rising
+    // edge timings of the high side switches.
+    duty[0] = 1.0f - (float)tim->CCR1 / (float)TIM_1_8_PERIOD_CLOCKS;
+    duty[1] = 1.0f - (float)tim->CCR2 / (float)TIM_1_8_PERIOD_CLOCKS;
+    duty[2] = 1.0f - (float)tim->CCR3 / (float)TIM_1_8_PERIOD_CLOCKS;
+}
+
+static constexpr uint32_t kControlLoopPeriodUs = (uint64_t)CONTROL_TIMER_PERIOD_TICKS * 1000000ULL / TIM_1_8_CLOCK_HZ;
+
+static uint32_t timestamp_ = 0;
+static float m0_duty_[3] = {0.5f, 0.5f, 0.5f};
+static float m1_duty_[3] = {0.5f, 0.5f, 0.5f};
+
+void sim_run_control_period() {
+    if (!timers_started_) {
+        sim_os_advance(kControlLoopPeriodUs);
+        return;
+    }
+
+    // TIM8 update event while counting up. The compare values that were
+    // written by the previous control loop interrupt take effect now and stay
+    // in effect for the whole period, so like on the real hardware there is
+    // one period of delay between a current measurement and the first output
+    // that reacts to it.
+    latch_pwm_outputs(&sim_tim1, m0_duty_);
+    latch_pwm_outputs(&sim_tim8, m1_duty_);
+
+    timestamp_ += TIM_1_8_PERIOD_CLOCKS * (TIM_1_8_RCR + 1);
+
+    sim_tim3.CNT = motor_models[0].get_encoder_count();
+    sim_tim4.CNT = motor_models[1].get_encoder_count();
+
+    TaskTimer::enabled = odrv.task_timers_armed_;
+    odrv.sampling_cb();
+
+    // Control loop interrupt
+    uint32_t timestamp = timestamp_;
+
+    board.vbus_voltage = sim_supply_voltage;
+    for (int gpio: adc_gpios) {
+        board.gpio_adc_values[gpio] = 0.0f;
+    }
+    for (size_t i = 0; i < AXIS_COUNT; ++i) {
+        board.motor_fet_temperatures[i] = 25.0f;
+    }
+
+    std::optional<Iph_ABC_t> current0 = sample_currents(motors[0], m0_gate_driver, motor_models[0]);
+    std::optional<Iph_ABC_t> current1 = sample_currents(motors[1], m1_gate_driver, motor_models[1]);
+
+    // If the motor FETs are not switching then we can't measure the current
+    // (see Board/v3/board.cpp).
+    if (!(sim_tim1.BDTR & TIM_BDTR_MOE_Msk)) {
+        current0 = {0.0f, 0.0f};
+    }
+    if (!(sim_tim8.BDTR & TIM_BDTR_MOE_Msk)) {
+        current1 = {0.0f, 0.0f};
+    }
+
+    motors[0].current_meas_cb(timestamp - TIM1_INIT_COUNT, current0);
+    motors[1].current_meas_cb(timestamp, current1);
+
+    odrv.control_loop_cb(timestamp);
+
+    // TIM8 update event while counting down (this happens while the control
+    // loop interrupt is still running). Tentatively reset all PWM outputs to
+    // 50% duty cycles.
+    timestamp_ += TIM_1_8_PERIOD_CLOCKS * (TIM_1_8_RCR + 1);
+    sim_tim1.CCR1 = sim_tim1.CCR2 = sim_tim1.CCR3 = TIM_1_8_PERIOD_CLOCKS / 2;
+    sim_tim8.CCR1 = sim_tim8.CCR2 = sim_tim8.CCR3 = TIM_1_8_PERIOD_CLOCKS / 2;
+
+    // The DC calibration samples are taken in SVM vector 7 where no current
+    // flows through the shunts. The simulated amplifiers have no offset.
+    std::optional<Iph_ABC_t> dc_current0 = m0_gate_driver.is_ready() ? std::make_optional(Iph_ABC_t{0.0f, 0.0f, 0.0f}) : std::nullopt;
+    std::optional<Iph_ABC_t> dc_current1 = m1_gate_driver.is_ready() ? std::make_optional(Iph_ABC_t{0.0f, 0.0f, 0.0f}) : std::nullopt;
+
+    motors[0].dc_calib_cb(timestamp + TIM_1_8_PERIOD_CLOCKS * (TIM_1_8_RCR + 1) - TIM1_INIT_COUNT, dc_current0);
+    motors[1].dc_calib_cb(timestamp + TIM_1_8_PERIOD_CLOCKS * (TIM_1_8_RCR + 1), dc_current1);
+
+    motors[0].pwm_update_cb(timestamp + 3 * TIM_1_8_PERIOD_CLOCKS * (TIM_1_8_RCR + 1) - TIM1_INIT_COUNT);
+    motors[1].pwm_update_cb(timestamp + 3 * TIM_1_8_PERIOD_CLOCKS * (TIM_1_8_RCR + 1));
+
+    odrv.brake_resistor_.update();
+    brake_resistor_output_impl.update(timestamp + 3 * TIM_1_8_PERIOD_CLOCKS * (TIM_1_8_RCR + 1) - TIM1_INIT_COUNT);
+
+    odrv.task_timers_armed_ = odrv.task_timers_armed_ && !TaskTimer::enabled;
+    TaskTimer::enabled = false;
+
+    // Disarming clears MOE immediately, so a motor that was disarmed during
+    // the interrupt is already switched off for the rest of this period.
+    motor_models[0].step(m0_duty_, sim_tim1.BDTR & TIM_BDTR_MOE, board.vbus_voltage, current_meas_period);
+    motor_models[1].step(m1_duty_, sim_tim8.BDTR & TIM_BDTR_MOE, board.vbus_voltage, current_meas_period);
+
+    sim_os_advance(kControlLoopPeriodUs);
+}
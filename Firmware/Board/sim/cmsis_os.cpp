@@ -0,0 +1,211 @@
+/*
+* @brief Cooperative implementation of the CMSIS-RTOS subset in cmsis_os.h.
+*
+* Every thread runs on its own stack (ucontext) but only one thread runs at a
+* time and switches happen exclusively inside blocking calls. The simulated
+* hardware calls sim_os_advance() after each control loop interrupt, which
+* resumes all threads that became ready, highest priority first.
+*
+* Threads are entered for the first time through ucontext. All later switches
+* use _setjmp/_longjmp which, unlike swapcontext, don't save and restore the
+* signal mask with a system call. The axis threads are woken up in every
+* control loop period so this makes a large difference to the simulation
+* speed.
+*/
+
+// The fortified longjmp refuses to jump to a different stack
+#undef _FORTIFY_SOURCE
+
+#include "cmsis_os.h"
+#include "sim_hal.h"
+
+#include <setjmp.h>
+#include <ucontext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+struct sim_thread {
+    const char* name;
+    os_pthread fn;
+    void* arg;
+    osPriority priority;
+    ucontext_t ctx; // only used to enter the thread for the first time
+    jmp_buf jmp;
+    bool started = false;
+    std::vector<uint8_t> stack;
+
+    uint64_t wake_time_us = 0; // valid if waiting_for_time
+    bool waiting_for_time = false;
+    int32_t signals = 0;
+    int32_t waiting_for_signals = 0; // 0 if not waiting for signals
+    bool finished = false;
+};
+
+// Host threads get a generous stack regardless of what the firmware requests
+// because host code (printf, sanitizers, unoptimized builds) is far less
+// frugal than the target code.
+static constexpr size_t kMinStackSize = 256 * 1024;
+
+static std::vector<sim_thread*> threads_;
+static sim_thread* current_ = nullptr;
+static jmp_buf scheduler_jmp_;
+static uint64_t now_us_ = 0;
+
+// Sub-millisecond part of the simulated time, see micros() in utils.cpp
+TIM_TypeDef sim_time_base = {};
+volatile uint32_t sim_time_us = 0;
+
+static void thread_entry(unsigned int lo, unsigned int hi) {
+    sim_thread* thread = (sim_thread*)(((uintptr_t)hi << 32) | (uintptr_t)lo);
+    thread->fn(thread->arg);
+    thread->finished = true;
+    _longjmp(scheduler_jmp_, 1);
+}
+
+static bool is_ready(sim_thread* thread) {
+    if (thread->finished) {
+        return false;
+    }
+    if (thread->waiting_for_signals && (thread->signals & thread->waiting_for_signals)) {
+        return true;
+    }
+    if (thread->waiting_for_time && now_us_ >= thread->wake_time_us) {
+        return true;
+    }
+    return !thread->waiting_for_signals && !thread->waiting_for_time;
+}
+
+// Switches from the current thread back to the scheduler.
+static void block() {
+    sim_thread* thread = current_;
+    if (!thread) {
+        fprintf(stderr, "blocking call outside of a thread\n");
+        abort();
+    }
+    if (!_setjmp(thread->jmp)) {
+        _longjmp(scheduler_jmp_, 1);
+    }
+}
+
+static void run_ready_threads() {
+    // A thread can make another thread ready (osSignalSet), so keep going
+    // until no thread is ready anymore.
+    for (bool progress = true; progress; ) {
+        progress = false;
+        for (sim_thread* thread: threads_) {
+            if (is_ready(thread)) {
+                current_ = thread;
+                if (!_setjmp(scheduler_jmp_)) {
+                    if (!thread->started) {
+                        thread->started = true;
+                        setcontext(&thread->ctx);
+                    } else {
+                        _longjmp(thread->jmp, 1);
+                    }
+                }
+                current_ = nullptr;
+                progress = true;
+                break; // restart from the highest priority thread
+            }
+        }
+    }
+}
+
+uint32_t osKernelSysTick(void) {
+    return (uint32_t)(now_us_ / 1000);
+}
+
+osThreadId osThreadCreate(const osThreadDef_t *thread_def, void *argument) {
+    sim_thread* thread = new sim_thread{};
+    thread->name = thread_def->name;
+    thread->fn = thread_def->pthread;
+    thread->arg = argument;
+    thread->priority = thread_def->tpriority;
+    thread->stack.resize(std::max((size_t)thread_def->stacksize * sizeof(StackType_t), kMinStackSize));
+
+    getcontext(&thread->ctx);
+    thread->ctx.uc_stack.ss_sp = thread->stack.data();
+    thread->ctx.uc_stack.ss_size = thread->stack.size();
+    thread->ctx.uc_link = nullptr;
+    uintptr_t ptr = (uintptr_t)thread;
+    makecontext(&thread->ctx, (void (*)())thread_entry, 2, (unsigned int)(ptr & 0xffffffff), (unsigned int)(ptr >> 32));
+
+    // Keep the list sorted by descending priority. New threads go after
+    // existing threads of the same priority.
+    auto it = std::find_if(threads_.begin(), threads_.end(), [&](sim_thread* t) {
+        return t->priority < thread->priority;
+    });
+    threads_.insert(it, thread);
+
+    // The new thread starts running at the next scheduling point
+    thread->waiting_for_time = true;
+    thread->wake_time_us = now_us_;
+    return thread;
+}
+
+osThreadId osThreadGetId(void) {
+    return current_;
+}
+
+osStatus osThreadYield(void) {
+    return osDelay(0);
+}
+
+osStatus osDelay(uint32_t millisec) {
+    // Like on FreeRTOS a delay of N ticks returns at the Nth tick boundary
+    // from now, which may be less than N full ticks.
+    uint64_t now_ms = now_us_ / 1000;
+    current_->waiting_for_time = true;
+    current_->wake_time_us = (now_ms + (millisec ? millisec : 1)) * 1000;
+    block();
+    current_->waiting_for_time = false;
+    return osEventTimeout;
+}
+
+int32_t osSignalSet(osThreadId thread_id, int32_t signals) {
+    int32_t previous = thread_id->signals;
+    thread_id->signals |= signals;
+    return previous;
+}
+
+osEvent osSignalWait(int32_t signals, uint32_t millisec) {
+    osEvent evt = {};
+    sim_thread* thread = current_;
+
+    if (!(thread->signals & signals) && millisec != 0) {
+        thread->waiting_for_signals = signals;
+        if (millisec != osWaitForever) {
+            thread->waiting_for_time = true;
+            thread->wake_time_us = now_us_ + (uint64_t)millisec * 1000;
+        }
+        block();
+        thread->waiting_for_signals = 0;
+        thread->waiting_for_time = false;
+    }
+
+    if (thread->signals & signals) {
+        evt.status = osEventSignal;
+        evt.value.signals = thread->signals & signals;
+        thread->signals &= ~signals;
+    } else {
+        evt.status = osEventTimeout;
+    }
+    return evt;
+}
+
+uint32_t HAL_GetTick(void) {
+    return (uint32_t)(now_us_ / 1000);
+}
+
+void sim_os_advance(uint32_t microseconds) {
+    now_us_ += microseconds;
+    sim_time_base.CNT = (uint32_t)(now_us_ % 1000);
+    sim_time_us = (uint32_t)now_us_;
+    run_ready_threads();
+}
+
+uint64_t sim_os_micros(void) {
+    return now_us_;
+}
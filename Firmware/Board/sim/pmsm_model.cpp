@@ -0,0 +1,91 @@
+#include "pmsm_model.hpp"
+
+#include <cmath>
+
+static constexpr float one_by_sqrt3 = 0.57735026919f;
+static constexpr float sqrt3_by_2 = 0.86602540378f;
+
+void PmsmModel::step(const float duty[3], bool enabled, float vbus, float dt) {
+    const float h = dt / (float)config_.substeps;
+    const float pp = (float)config_.pole_pairs;
+    const float R = config_.phase_resistance;
+    const float L = config_.phase_inductance;
+    const float flux_linkage = config_.torque_constant / (1.5f * pp); // [Wb]
+    const float decay = std::exp(-R * h / L);
+
+    // Phase-to-neutral voltages of a star connected motor followed by a
+    // magnitude invariant Clarke transform
+    float v_alpha = 0.0f;
+    float v_beta = 0.0f;
+    if (enabled) {
+        float v_mean = (duty[0] + duty[1] + duty[2]) * (vbus / 3.0f);
+        float va = duty[0] * vbus - v_mean;
+        float vb = duty[1] * vbus - v_mean;
+        float vc = duty[2] * vbus - v_mean;
+        v_alpha = (2.0f / 3.0f) * (va - 0.5f * vb - 0.5f * vc);
+        v_beta = one_by_sqrt3 * (vb - vc);
+    } else {
+        // With all switches open the current decays through the body diodes
+        // much faster than the simulation step. Regeneration through the
+        // diodes at speeds where the back-EMF exceeds vbus is not modeled.
+        id_ = 0.0f;
+        iq_ = 0.0f;
+    }
+
+    float energy = 0.0f;
+
+    for (uint32_t i = 0; i < config_.substeps; ++i) {
+        float theta_e = (float)std::fmod(pp * theta_, 2.0 * M_PI);
+        float c = std::cos(theta_e);
+        float s = std::sin(theta_e);
+        float omega_e = pp * omega_;
+
+        if (enabled) {
+            float vd = c * v_alpha + s * v_beta;
+            float vq = c * v_beta - s * v_alpha;
+
+            // Exact solution of the RL circuit assuming constant voltage,
+            // cross coupling and back-EMF over the substep
+            float drive_d = vd + omega_e * L * iq_;
+            float drive_q = vq - omega_e * L * id_ - omega_e * flux_linkage;
+            id_ = decay * id_ + (1.0f - decay) * drive_d / R;
+            iq_ = decay * iq_ + (1.0f - decay) * drive_q / R;
+
+            energy += 1.5f * (vd * id_ + vq * iq_) * h;
+        }
+
+        torque_ = config_.torque_constant * iq_;
+
+        float net_torque = torque_ - config_.load_torque - config_.viscous_friction * omega_;
+        if (omega_ == 0.0f && std::abs(net_torque) <= config_.coulomb_friction) {
+            continue; // static friction holds the rotor
+        }
+        float direction = (omega_ != 0.0f) ? std::copysign(1.0f, omega_) : std::copysign(1.0f, net_torque);
+        net_torque -= direction * config_.coulomb_friction;
+
+        float new_omega = omega_ + net_torque / config_.inertia * h;
+        if (config_.coulomb_friction > 0.0f && omega_ != 0.0f && std::signbit(new_omega) != std::signbit(omega_)) {
+            new_omega = 0.0f; // friction can stop the rotor but not reverse it
+        }
+        theta_ += 0.5 * (double)(omega_ + new_omega) * h;
+        omega_ = new_omega;
+    }
+
+    dc_power_ = energy / dt;
+}
+
+void PmsmModel::get_phase_currents(float* ia, float* ib, float* ic) const {
+    float theta_e = (float)std::fmod(config_.pole_pairs * theta_, 2.0 * M_PI);
+    float c = std::cos(theta_e);
+    float s = std::sin(theta_e);
+    float i_alpha = c * id_ - s * iq_;
+    float i_beta = s * id_ + c * iq_;
+    *ia = i_alpha;
+    *ib = -0.5f * i_alpha + sqrt3_by_2 * i_beta;
+    *ic = -0.5f * i_alpha - sqrt3_by_2 * i_beta;
+}
+
+uint16_t PmsmModel::get_encoder_count() const {
+    double turns = (theta_ - config_.encoder_offset) / (2.0 * M_PI);
+    return (uint16_t)(int64_t)std::floor(turns * (double)config_.encoder_cpr);
+}
@@ -0,0 +1,245 @@
+/*
+* @brief Entry point of the host simulator.
+*
+* Boots the motor control code like MotorControl/main.cpp does on the target,
+* but without the communication stack and non-volatile storage. A short
+* scenario then calibrates M0 and runs it in closed loop velocity control
+* against the motor model.
+*
+* Usage: odrive_sim [duration in seconds]
+*/
+
+#include <odrive_main.h>
+
+#include "sim_board.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+uint32_t _reboot_cookie = 0;
+
+ODrive odrv{};
+
+uint64_t serial_number = 0x53494d554c41ULL;
+char serial_number_str[13] = "53494D554C41";
+
+USBStats_t usb_stats_;
+I2CStats_t i2c_stats_;
+
+
+bool ODrive::save_configuration(void) {
+    return false; // no non-volatile storage on the simulator
+}
+
+void ODrive::erase_configuration(void) {
+}
+
+void ODrive::enter_dfu_mode() {
+}
+
+uint32_t ODrive::get_interrupt_status(int32_t irqn) {
+    return 0xffffffff;
+}
+
+uint32_t ODrive::get_dma_status(uint8_t stream_num) {
+    return 0xffffffff;
+}
+
+uint32_t ODrive::get_gpio_states() {
+    uint32_t val = 0;
+    for (size_t i = 0; i < GPIO_COUNT; ++i) {
+        val |= ((board.gpios[i].read() ? 1UL : 0UL) << i);
+    }
+    return val;
+}
+
+// There is no UART on the simulated board
+void uart_poll(void) {
+}
+
+// There is no USB on the simulated board, so telemetry frames are never sent
+void usb_notify_telemetry() {
+}
+
+// There is no communication stack on the simulator, so endpoint references
+// never resolve
+bool fibre::is_endpoint_ref_valid(endpoint_ref_t endpoint_ref) {
+    return false;
+}
+
+bool fibre::get_endpoint_property(endpoint_ref_t endpoint_ref, Introspectable* property) {
+    return false;
+}
+
+extern "C" void NVIC_SystemReset(void) {
+    printf("system reset requested\n");
+    exit(1);
+}
+
+static bool config_apply_all() {
+    bool success = true;
+    for (size_t i = 0; (i < AXIS_COUNT) && success; ++i) {
+        success = encoders[i].apply_config(motors[i].config_.motor_type)
+               && axes[i].controller_.apply_config()
+               && axes[i].min_endstop_.apply_config()
+               && axes[i].max_endstop_.apply_config()
+               && motors[i].apply_config()
+               && axes[i].apply_config();
+    }
+    return success;
+}
+
+static void print_errors(const char* when) {
+    if (odrv.error_) {
+        printf("%s: system error 0x%x\n", when, (unsigned)odrv.error_);
+    }
+    for (size_t i = 0; i < AXIS_COUNT; ++i) {
+        Axis& axis = axes[i];
+        if (axis.error_ || axis.motor_.error_ || axis.encoder_.error_ || axis.controller_.error_) {
+            printf("%s: axis%zu error 0x%x, motor error 0x%llx, encoder error 0x%x, controller error 0x%x\n",
+                   when, i, (unsigned)axis.error_, (unsigned long long)axis.motor_.error_,
+                   (unsigned)axis.encoder_.error_, (unsigned)axis.controller_.error_);
+        }
+    }
+}
+
+static void wait_for_idle(Axis& axis) {
+    osDelay(10); // give the axis thread time to pick up the requested state
+    while (axis.current_state_ != Axis::AXIS_STATE_IDLE) {
+        osDelay(1);
+    }
+}
+
+static bool scenario_done_ = false;
+static float vel_setpoint_ = 10.0f; // [turn/s]
+
+/**
+ * @brief Counterpart of rtos_main() in MotorControl/main.cpp followed by the
+ * simulation scenario.
+ */
+static void sim_main_thread(void*) {
+    for (auto& axis: axes) {
+        axis.motor_.setup();
+    }
+
+    for (auto& axis: axes) {
+        axis.encoder_.setup();
+    }
+
+    for (auto& axis: axes) {
+        axis.acim_estimator_.idq_src_.connect_to(&axis.motor_.Idq_setpoint_);
+    }
+
+    for (auto& axis: axes) {
+        axis.motor_.disarm();
+    }
+
+    for (Motor& motor: motors) {
+        int half_load = TIM_1_8_PERIOD_CLOCKS / 2;
+        motor.timer_->Instance->CCR1 = half_load;
+        motor.timer_->Instance->CCR2 = half_load;
+        motor.timer_->Instance->CCR3 = half_load;
+    }
+
+    start_timers();
+
+    if (odrv.config_.enable_brake_resistor) {
+        odrv.brake_resistor_.arm();
+    }
+
+    for (size_t i = 0; i < 2000; ++i) {
+        bool motors_ready = std::all_of(axes.begin(), axes.end(), [](auto& axis) {
+            return axis.motor_.current_meas_.has_value();
+        });
+        if (motors_ready) {
+            break;
+        }
+        osDelay(1);
+    }
+
+    for (auto& axis: axes) {
+        axis.sensorless_estimator_.error_ &= ~SensorlessEstimator::ERROR_UNKNOWN_CURRENT_MEASUREMENT;
+    }
+
+    for (size_t i = 0; i < AXIS_COUNT; ++i) {
+        axes[i].start_thread();
+    }
+
+    odrv.system_stats_.fully_booted = true;
+
+    Axis& axis = axes[0];
+
+    printf("[%7.3fs] full calibration sequence\n", sim_os_micros() * 1e-6);
+    axis.requested_state_ = Axis::AXIS_STATE_FULL_CALIBRATION_SEQUENCE;
+    wait_for_idle(axis);
+    print_errors("calibration");
+
+    printf("[%7.3fs] phase resistance: %.4f Ohm (model: %.4f Ohm)\n", sim_os_micros() * 1e-6,
+           axis.motor_.config_.phase_resistance, motor_models[0].config_.phase_resistance);
+    printf("[%7.3fs] phase inductance: %.2f uH (model: %.2f uH)\n", sim_os_micros() * 1e-6,
+           axis.motor_.config_.phase_inductance * 1e6f, motor_models[0].config_.phase_inductance * 1e6f);
+    printf("[%7.3fs] encoder direction: %d, phase offset: %d counts\n", sim_os_micros() * 1e-6,
+           (int)axis.encoder_.config_.direction, (int)axis.encoder_.config_.phase_offset);
+
+    axis.controller_.config_.control_mode = Controller::CONTROL_MODE_VELOCITY_CONTROL;
+    axis.controller_.config_.input_mode = Controller::INPUT_MODE_PASSTHROUGH;
+    axis.controller_.config_.vel_limit = 2.0f * vel_setpoint_;
+    axis.controller_.input_vel_ = vel_setpoint_;
+
+    printf("[%7.3fs] closed loop control, velocity setpoint %.1f turn/s\n", sim_os_micros() * 1e-6, vel_setpoint_);
+    axis.requested_state_ = Axis::AXIS_STATE_CLOSED_LOOP_CONTROL;
+
+    scenario_done_ = true;
+    for (;;) {
+        osDelay(1000);
+    }
+}
+
+int main(int argc, char** argv) {
+    float duration = (argc > 1) ? (float)atof(argv[1]) : 20.0f; // [s]
+
+    for (size_t i = 0; i < AXIS_COUNT; ++i) {
+        axes[i].controller_.config_.load_encoder_axis = i;
+        axes[i].clear_config();
+    }
+    // The ideal supply of the simulated board cannot sink current, so any
+    // regenerated energy must go to the brake resistor.
+    odrv.config_.enable_brake_resistor = true;
+
+    if (!board.init() || !config_apply_all()) {
+        printf("failed to apply configuration\n");
+        return 1;
+    }
+
+    osThreadDef(sim_main_thread_def, sim_main_thread, osPriorityNormal, 0, 0);
+    osThreadCreate(osThread(sim_main_thread_def), NULL);
+
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t end_us = (uint64_t)(duration * 1e6f);
+    uint64_t next_report_us = 0;
+    while (sim_os_micros() < end_us) {
+        sim_run_control_period();
+
+        if (scenario_done_ && sim_os_micros() >= next_report_us) {
+            next_report_us = sim_os_micros() + 1000000;
+            printf("[%7.3fs] state %d, vel %7.3f turn/s (model %7.3f turn/s), Iq %6.3f A, Ibus %6.3f A\n",
+                   sim_os_micros() * 1e-6, (int)axes[0].current_state_,
+                   axes[0].encoder_.vel_estimate_.any().value_or(0.0f),
+                   motor_models[0].vel() / (2.0f * (float)M_PI),
+                   motor_models[0].iq(), odrv.ibus_);
+        }
+    }
+
+    auto wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    print_errors("end");
+    printf("simulated %.3f s in %.3f s wall time (%.1fx real time)\n",
+           sim_os_micros() * 1e-6, wall_time, sim_os_micros() * 1e-6 / wall_time);
+
+    bool any_error = odrv.error_ || std::any_of(axes.begin(), axes.end(), [](Axis& axis) {
+        return axis.error_ || axis.motor_.error_ || axis.encoder_.error_ || axis.controller_.error_;
+    });
+    return any_error ? 1 : 0;
+}
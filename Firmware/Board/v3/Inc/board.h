@@ -124,6 +124,11 @@ extern PwmOutputGroup<1>& brake_resistor_output;
 // `board_control_loop_counter_period`.
 extern volatile uint32_t& board_control_loop_counter;
 extern uint32_t board_control_loop_counter_period;
+
+// Points to a free running counter that timestamps trace events (see
+// trace.hpp). It wraps around at 32 bits.
+extern volatile uint32_t& board_trace_counter;
+extern uint32_t board_trace_counter_hz;
 #endif
 
 // Period in [s]
@@ -21,6 +21,7 @@
 
 // this should technically be in task_timer.cpp but let's not make a one-line file
 bool TaskTimer::enabled = false;
+uint16_t TaskTimer::next_trace_id = Trace::TRACE_SOURCE_TASK_TIMERS;
 
 extern "C" void SystemClock_Config(void); // defined in main.c generated by CubeMX
 
@@ -383,6 +384,8 @@ template<> PwmOutputGroup<1>* BoardSupportPackage::fan_output = nullptr;
 
 volatile uint32_t& board_control_loop_counter = TIM13->CNT;
 uint32_t board_control_loop_counter_period = CONTROL_TIMER_PERIOD_TICKS / 2; // TIM13 is on a clock that's only half as fast as TIM1
+volatile uint32_t& board_trace_counter = DWT->CYCCNT; // enabled in BoardSupportPackage::init()
+uint32_t board_trace_counter_hz = TIM_1_8_CLOCK_HZ; // same as the core clock
 
 constexpr size_t ADC_CHANNEL_COUNT = adc_gpios.size() + AXIS_COUNT; // Sample all ADC-capable GPIOs and one FET thermistor per axis.
 std::array<uint16_t, ADC_CHANNEL_COUNT> adc_measurements_ = {};
@@ -403,6 +406,11 @@ template<> bool BoardSupportPackage::init() {
     // Configure the system clock
     SystemClock_Config();
 
+    // Enable the cycle counter for trace timestamps
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
     // If the OTP is pristine, use the fake-otp in RAM instead
     const uint8_t* otp_ptr = (const uint8_t*)FLASH_OTP_BASE;
     if (*otp_ptr == 0xff) {
@@ -345,6 +345,13 @@ bool Axis::start_closed_loop_control() {
 
 bool Axis::stop_closed_loop_control() {
     motor_.disarm();
+
+    // Without this connection the controller has no consumer anymore, so the
+    // control loop skips it until the next start_closed_loop_control().
+    CRITICAL_SECTION() {
+        motor_.torque_setpoint_src_.disconnect(0.0f);
+    }
+
     return check_for_errors();
 }
 
@@ -353,8 +360,10 @@ bool Axis::run_closed_loop_control_loop() {
     set_step_dir_active(config_.enable_step_dir);
 
     while ((requested_state_ == AXIS_STATE_UNDEFINED) && motor_.is_armed_) {
+        controller_.update_anticogging_fit();
         osDelay(1);
     }
+    controller_.cancel_anticogging_calibration();
 
     set_step_dir_active(config_.enable_step_dir && config_.step_dir_always_on);
     stop_closed_loop_control();
@@ -480,6 +489,8 @@ void Axis::run_state_machine_loop() {
 
         // Note that current_state is a reference to task_chain_[0]
 
+        trace.instant(Trace::TRACE_SOURCE_AXIS0_STATE + axis_num_, current_state_);
+
         // Run the specified state
         // Handlers should exit if requested_state != AXIS_STATE_UNDEFINED
         bool status;
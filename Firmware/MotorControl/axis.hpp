@@ -9,6 +9,7 @@ class Axis;
 #include "controller.hpp"
 #include "open_loop_controller.hpp"
 #include "trapTraj.hpp"
+#include "scurveTraj.hpp"
 #include "endstop.hpp"
 #include "mechanical_brake.hpp"
 #include "utils.hpp"
@@ -160,6 +161,7 @@ public:
     OpenLoopController open_loop_controller_;
     Motor& motor_;
     TrapezoidalTrajectory& trap_traj_;
+    SCurveTrajectory scurve_traj_;
     Endstop& min_endstop_;
     Endstop& max_endstop_;
     MechanicalBrake& mechanical_brake_;
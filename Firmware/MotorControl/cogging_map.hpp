@@ -0,0 +1,361 @@
+#ifndef __COGGING_MAP_HPP
+#define __COGGING_MAP_HPP
+
+#include "utils.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+/**
+ * @brief Cogging torque as a function of the mechanical position, stored as a
+ * sparse Fourier series.
+ *
+ * Cogging torque is periodic with the mechanical revolution and most of its
+ * energy is in a few harmonics (multiples of the slot count and of the pole
+ * pair count, see analysis/cogging_torque/cogging_harmonics.py). Storing only
+ * the strongest harmonics takes a fraction of the space of a lookup table and
+ * doesn't depend on the encoder resolution.
+ *
+ * This is part of the configuration and therefore must stay trivially
+ * copyable.
+ */
+struct CoggingMap_t {
+    static constexpr size_t kHarmonics = 16;
+
+    struct Harmonic_t {
+        uint32_t order;  // [1/turn] 0 for unused entries
+        float cos_coeff; // [Nm]
+        float sin_coeff; // [Nm]
+    };
+
+    float offset = 0.0f; // [Nm]
+
+    // Sorted by order. Unused entries are at the end.
+    std::array<Harmonic_t, kHarmonics> harmonics = {};
+
+    /**
+     * @brief Returns the cogging torque at the specified position.
+     * @param pos: Mechanical position [turn]. Can be outside of [0, 1).
+     */
+    float eval(float pos) const {
+        float x = 2.0f * M_PI * (pos - std::floor(pos)); // [rad] in [0, 2pi)
+        float torque = offset;
+        for (const Harmonic_t& harmonic: harmonics) {
+            if (!harmonic.order) {
+                break;
+            }
+            float s, c;
+            our_arm_sin_cos_f32((float)harmonic.order * x, &s, &c);
+            torque += harmonic.cos_coeff * c + harmonic.sin_coeff * s;
+        }
+        return torque;
+    }
+};
+
+/**
+ * @brief Fits a CoggingMap_t to torque samples.
+ *
+ * The samples are accumulated into the Fourier coefficients of all orders up
+ * to kMaxOrder so that they don't have to be stored. The harmonics of each
+ * sample are obtained from one sin/cos evaluation and a rotation recurrence.
+ *
+ * The samples must be evenly spaced over one or more full turns.
+ */
+class CoggingFit {
+public:
+    static constexpr size_t kMaxOrder = 256;
+
+    void reset() {
+        n_samples_ = 0;
+        sum_ = 0.0f;
+        cos_sums_ = {};
+        sin_sums_ = {};
+    }
+
+    /**
+     * @param pos: Mechanical position [turn]
+     * @param torque: Torque needed to hold that position [Nm]
+     */
+    void add_sample(float pos, float torque) {
+        float x = 2.0f * M_PI * (pos - std::floor(pos));
+        float s1, c1;
+        our_arm_sin_cos_f32(x, &s1, &c1);
+
+        // (c + i*s) = e^(i*k*x), starting at k = 1
+        float s = s1;
+        float c = c1;
+        for (size_t k = 0; k < kMaxOrder; ++k) {
+            cos_sums_[k] += torque * c;
+            sin_sums_[k] += torque * s;
+            float next_c = c * c1 - s * s1;
+            s = s * c1 + c * s1;
+            c = next_c;
+        }
+
+        sum_ += torque;
+        n_samples_++;
+    }
+
+    uint32_t n_samples() const {
+        return n_samples_;
+    }
+
+    /**
+     * @brief Stores the offset and the kHarmonics strongest harmonics in map.
+     * @returns false if there are no samples.
+     */
+    bool fit(CoggingMap_t* map) const {
+        if (!n_samples_) {
+            return false;
+        }
+
+        // Magnitudes of the selected harmonics, used to find the weakest one
+        std::array<float, CoggingMap_t::kHarmonics> selected_mag = {};
+        std::array<uint32_t, CoggingMap_t::kHarmonics> selected = {};
+        size_t weakest = 0;
+
+        for (size_t k = 0; k < kMaxOrder; ++k) {
+            float mag = cos_sums_[k] * cos_sums_[k] + sin_sums_[k] * sin_sums_[k];
+            if (mag <= selected_mag[weakest]) {
+                continue;
+            }
+            selected_mag[weakest] = mag;
+            selected[weakest] = k + 1;
+            for (size_t i = 0; i < selected_mag.size(); ++i) {
+                if (selected_mag[i] < selected_mag[weakest]) {
+                    weakest = i;
+                }
+            }
+        }
+
+        // Sort by order with unused entries (order 0) at the end
+        std::sort(selected.begin(), selected.end(), [](uint32_t a, uint32_t b) {
+            return (a - 1) < (b - 1);
+        });
+
+        float scale = 2.0f / (float)n_samples_;
+        map->offset = sum_ / (float)n_samples_;
+        for (size_t i = 0; i < selected.size(); ++i) {
+            uint32_t order = selected[i];
+            map->harmonics[i] = {
+                order,
+                order ? scale * cos_sums_[order - 1] : 0.0f,
+                order ? scale * sin_sums_[order - 1] : 0.0f
+            };
+        }
+        return true;
+    }
+
+private:
+    uint32_t n_samples_ = 0;
+    float sum_ = 0.0f;
+    std::array<float, kMaxOrder> cos_sums_ = {}; // Index k is order k + 1
+    std::array<float, kMaxOrder> sin_sums_ = {};
+};
+
+/**
+ * @brief Hands torque samples over from the control loop to the thread that
+ * feeds them to a CoggingFit.
+ *
+ * push() is the producer side and pop() / reset() are the consumer side. The
+ * two sides can run in different threads or interrupts without locking, but
+ * there must be only one producer and one consumer at a time.
+ */
+class CoggingSampleQueue {
+public:
+    static constexpr size_t kCapacity = 32;
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "capacity must be a power of two");
+
+    struct Sample_t {
+        float pos;    // [turn]
+        float torque; // [Nm]
+    };
+
+    /**
+     * @brief Appends a sample. Returns false if the queue is full.
+     */
+    bool push(const Sample_t& sample) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= kCapacity) {
+            return false;
+        }
+        samples_[tail & (kCapacity - 1)] = sample;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest sample. Returns false if the queue is empty.
+     */
+    bool pop(Sample_t* sample) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *sample = samples_[head & (kCapacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    void reset() {
+        head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    std::array<Sample_t, kCapacity> samples_ = {};
+    std::atomic<uint32_t> head_ = 0; // Written by the consumer
+    std::atomic<uint32_t> tail_ = 0; // Written by the producer
+};
+
+/**
+ * @brief Bins torque samples that were taken while sweeping over the
+ * mechanical turn at a constant velocity.
+ *
+ * The samples of the forward and the reverse sweep are kept apart so that the
+ * Coulomb friction, which has the same magnitude but opposite sign in the two
+ * directions, cancels out. The difference between the two directions is
+ * reported as a measure of how well the calibration converged.
+ *
+ * Once all samples are in, the bins are fed to a CoggingFit one at a time
+ * (see fit_next()) so that the work can be spread out over time.
+ */
+class CoggingSweep {
+public:
+    static constexpr size_t kBins = 512; // Resolves orders up to kBins / 2
+
+    struct Stats_t {
+        uint32_t n_samples = 0;
+        uint32_t min_bin_samples = 0;      // Fewest samples of any bin in either direction
+        float friction_torque = 0.0f;      // [Nm] Half the difference between the directions
+        float cogging_rms = 0.0f;          // [Nm] RMS of the cogging torque (without offset)
+        float direction_mismatch_rms = 0.0f; // [Nm] RMS difference between the directions after removing friction
+        float fit_residual_rms = 0.0f;     // [Nm] RMS of the cogging torque that the fitted map doesn't capture
+    };
+
+    void reset() {
+        bins_ = {};
+        n_samples_ = 0;
+        next_fit_bin_ = 0;
+    }
+
+    /**
+     * @param pos: Mechanical position [turn]
+     * @param torque: Torque that was applied at that position [Nm]
+     * @param forward: True if the sweep is moving in positive direction
+     */
+    void add_sample(float pos, float torque, bool forward) {
+        size_t i = std::min((size_t)((pos - std::floor(pos)) * (float)kBins), kBins - 1);
+        size_t dir = forward ? kForward : kReverse;
+        if (bins_[i].count[dir] < UINT16_MAX) {
+            bins_[i].sum[dir] += torque;
+            bins_[i].count[dir]++;
+            n_samples_++;
+        }
+    }
+
+    /**
+     * @brief Returns true if every bin has at least one sample in each
+     * direction.
+     */
+    bool complete() const {
+        return std::all_of(bins_.begin(), bins_.end(), [](const Bin_t& bin) {
+            return bin.count[kForward] && bin.count[kReverse];
+        });
+    }
+
+    /**
+     * @brief Adds the next bin to fit. Call reset() on fit before the first
+     * call. Returns true once all bins were added.
+     */
+    bool fit_next(CoggingFit* fit) {
+        if (next_fit_bin_ < kBins) {
+            const Bin_t& bin = bins_[next_fit_bin_];
+            fit->add_sample(((float)next_fit_bin_ + 0.5f) / (float)kBins, bin.torque());
+            next_fit_bin_++;
+        }
+        return next_fit_bin_ >= kBins;
+    }
+
+    /**
+     * @brief Computes the statistics of the binned samples.
+     * @param map: The map that was fitted to the bins.
+     */
+    Stats_t stats(const CoggingMap_t& map) const {
+        Stats_t stats;
+        stats.n_samples = n_samples_;
+        stats.min_bin_samples = UINT16_MAX;
+
+        float fwd_mean = 0.0f;
+        float rev_mean = 0.0f;
+        for (const Bin_t& bin: bins_) {
+            stats.min_bin_samples = std::min<uint32_t>(stats.min_bin_samples, std::min(bin.count[kForward], bin.count[kReverse]));
+            fwd_mean += bin.mean(kForward);
+            rev_mean += bin.mean(kReverse);
+        }
+        fwd_mean /= (float)kBins;
+        rev_mean /= (float)kBins;
+        stats.friction_torque = 0.5f * (fwd_mean - rev_mean);
+
+        float cogging_sq = 0.0f;
+        float mismatch_sq = 0.0f;
+        for (const Bin_t& bin: bins_) {
+            float cogging = bin.torque() - 0.5f * (fwd_mean + rev_mean);
+            float mismatch = (bin.mean(kForward) - fwd_mean) - (bin.mean(kReverse) - rev_mean);
+            cogging_sq += cogging * cogging;
+            mismatch_sq += mismatch * mismatch;
+        }
+        cogging_sq /= (float)kBins;
+        stats.cogging_rms = std::sqrt(cogging_sq);
+        stats.direction_mismatch_rms = std::sqrt(mismatch_sq / (float)kBins);
+
+        // By Parseval's theorem each harmonic contributes half its squared
+        // amplitude to the mean square.
+        float fitted_sq = 0.0f;
+        for (const CoggingMap_t::Harmonic_t& harmonic: map.harmonics) {
+            fitted_sq += 0.5f * (harmonic.cos_coeff * harmonic.cos_coeff + harmonic.sin_coeff * harmonic.sin_coeff);
+        }
+        stats.fit_residual_rms = std::sqrt(std::max(0.0f, cogging_sq - fitted_sq));
+
+        return stats;
+    }
+
+private:
+    static constexpr size_t kForward = 0;
+    static constexpr size_t kReverse = 1;
+
+    // The counts of both directions share one word (12 bytes per bin)
+    struct Bin_t {
+        float sum[2] = {0.0f, 0.0f}; // [Nm] Indexed by kForward / kReverse
+        uint16_t count[2] = {0, 0};
+
+        float mean(size_t dir) const {
+            return count[dir] ? sum[dir] / (float)count[dir] : 0.0f;
+        }
+
+        float torque() const {
+            return 0.5f * (mean(kForward) + mean(kReverse));
+        }
+    };
+    static_assert(sizeof(Bin_t) == 12, "bins should be packed");
+
+    std::array<Bin_t, kBins> bins_ = {};
+    uint32_t n_samples_ = 0;
+    size_t next_fit_bin_ = 0;
+};
+
+/**
+ * @brief Scratch state of an anticogging calibration.
+ *
+ * This is only needed while a calibration is running, so there is a single
+ * instance that all axes share (see Controller::start_anticogging_calibration()).
+ */
+struct CoggingCalibration_t {
+    CoggingSampleQueue samples; // Stepped calibration
+    CoggingSweep sweep;         // Sweep calibration
+    CoggingFit fit;
+};
+
+#endif // __COGGING_MAP_HPP
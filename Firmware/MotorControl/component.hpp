@@ -20,22 +20,67 @@ public:
 };
 
 
+/**
+ * @brief Number of the current control loop iteration.
+ * 
+ * Incrementing this at the beginning of a control loop iteration marks the
+ * values of all output ports as outdated at once (see OutputPort).
+ * 
+ * This will eventually overflow so present() could theoretically return a
+ * very old value however it is very likely that the motor will be long
+ * disarmed by then.
+ */
+inline uint32_t control_loop_epoch = 0;
+
+/**
+ * @brief Incremented whenever an input port is connected or disconnected.
+ * 
+ * This allows users of the port graph (see Pipeline) to cache information
+ * that depends on the connections.
+ */
+inline uint32_t port_connection_version = 0;
+
 template<typename T>
 class InputPort;
 
+/**
+ * @brief Type independent base of OutputPort. Used to identify the producer of
+ * a value when inspecting the port graph.
+ */
+class OutputPortBase {
+};
+
+/**
+ * @brief Type independent base of InputPort.
+ */
+class InputPortBase {
+public:
+    /**
+     * @brief Returns the output port to which this input port is connected or
+     * nullptr if it is not connected to an output port.
+     */
+    const OutputPortBase* source() const {
+        return source_;
+    }
+
+protected:
+    const OutputPortBase* source_ = nullptr;
+};
+
 /**
  * @brief An output port stores a value for consumption by a connecting input
  * port.
  * 
- * Output ports are supposed to be reset at the beginning of a control loop
- * iteration. This ensures that connecting input ports don't use an outdated
- * value and, more importantly, ensures proper handling if the producer of the
- * value is incapable of producing the value for any reason.
+ * A value is only considered present during the control loop iteration
+ * (control_loop_epoch) in which it was set. This ensures that connecting
+ * input ports don't use an outdated value and, more importantly, ensures
+ * proper handling if the producer of the value is incapable of producing the
+ * value for any reason.
  * 
  * Member functions of this class are not thread-safe unless noted otherwise.
  */
 template<typename T>
-class OutputPort {
+class OutputPort : public OutputPortBase {
 public:
     /**
      * @brief Initializes the output port with the specified value.
@@ -51,19 +96,7 @@ public:
      */
     void operator=(T value) {
         content_ = value;
-        age_ = 0;
-    }
-
-    /**
-     * @brief Marks the contained value as outdated. The value is not actually
-     * deleted and can still be accessed through some of the member functions
-     * of this class.
-     */
-    void reset() {
-        // This will eventually overflow to 0 so present() could
-        // theoretically return a very old value however it is very likely that
-        // the motor will be long disarmed by then.
-        age_++;
+        epoch_ = control_loop_epoch;
     }
 
     /**
@@ -71,7 +104,7 @@ public:
      * if the value was not yet set during this control loop iteration.
      */
     std::optional<T> present() {
-        if (age_ == 0) {
+        if (epoch_ == control_loop_epoch) {
             return content_;
         } else {
             return std::nullopt;
@@ -86,7 +119,7 @@ public:
      * std::nullopt.
      */
     std::optional<T> previous() {
-        if (age_ == 1) {
+        if (epoch_ == control_loop_epoch - 1) {
             return content_;
         } else {
             return std::nullopt;
@@ -104,7 +137,7 @@ public:
     }
     
 private:
-    uint32_t age_ = 2; // Age in number of control loop iterations
+    uint32_t epoch_ = control_loop_epoch - 2; // control loop iteration in which the value was set
     T content_;
 };
 
@@ -120,18 +153,34 @@ private:
  * Member functions of this class are not thread-safe unless otherwise noted.
  */
 template<typename T>
-class InputPort {
+class InputPort : public InputPortBase {
 public:
     void connect_to(OutputPort<T>* input_port) {
         content_ = input_port;
+        source_ = input_port;
+        port_connection_version++;
     }
 
     void connect_to(T* input_ptr) {
         content_ = input_ptr;
+        source_ = nullptr;
+        port_connection_version++;
     }
 
     void disconnect() {
         content_ = (OutputPort<T>*)nullptr;
+        source_ = nullptr;
+        port_connection_version++;
+    }
+
+    /**
+     * @brief Disconnects the port from its source and makes it provide the
+     * specified value instead, like a port that was never connected.
+     */
+    void disconnect(T value) {
+        content_ = value;
+        source_ = nullptr;
+        port_connection_version++;
     }
 
     std::optional<T> present() {
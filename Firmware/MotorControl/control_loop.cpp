@@ -0,0 +1,284 @@
+/*
+* @brief Hardware independent part of the ODrive system object: the periodic
+* sampling and control loop callbacks and system level error handling.
+*
+* These functions are called by the board support package from interrupt
+* context (see ControlLoop_IRQHandler in Board/v3/board.cpp).
+*/
+
+#include "odrive_main.h"
+#include "pipeline.hpp"
+
+// Stages per axis, see init_control_pipeline()
+static constexpr size_t kStagesPerAxis = 9;
+
+static Pipeline<AXIS_COUNT * kStagesPerAxis> control_pipeline_;
+
+bool ODrive::any_error() {
+    return error_ != ODrive::ERROR_NONE
+        || std::any_of(axes.begin(), axes.end(), [](Axis& axis){
+            return axis.error_ != Axis::ERROR_NONE
+                || axis.motor_.error_ != Motor::ERROR_NONE
+                || axis.sensorless_estimator_.error_ != SensorlessEstimator::ERROR_NONE
+                || axis.encoder_.error_ != Encoder::ERROR_NONE
+                || axis.controller_.error_ != Controller::ERROR_NONE;
+        });
+}
+
+uint64_t ODrive::get_drv_fault() {
+#if AXIS_COUNT == 1
+    return motors[0].gate_driver_.get_error();
+#elif AXIS_COUNT == 2
+    return (uint64_t)motors[0].gate_driver_.get_error() | ((uint64_t)motors[1].gate_driver_.get_error() << 32ULL);
+#else
+    #error "not supported"
+#endif
+}
+
+void ODrive::clear_errors() {
+    for (auto& axis: axes) {
+        axis.motor_.error_ = Motor::ERROR_NONE;
+        axis.controller_.error_ = Controller::ERROR_NONE;
+        axis.sensorless_estimator_.error_ = SensorlessEstimator::ERROR_NONE;
+        axis.encoder_.error_ = Encoder::ERROR_NONE;
+        axis.encoder_.spi_error_rate_ = 0.0f;
+        axis.error_ = Axis::ERROR_NONE;
+    }
+    error_ = ERROR_NONE;
+    if (odrv.config_.enable_brake_resistor) {
+        brake_resistor_.arm();
+    }
+}
+
+/**
+ * @brief Runs system-level checks that need to be as real-time as possible.
+ * 
+ * This function is called after every current measurement of every motor.
+ * It should finish as quickly as possible.
+ */
+void ODrive::do_fast_checks() {
+    if (!(vbus_voltage_ >= config_.dc_bus_undervoltage_trip_level))
+        disarm_with_error(ERROR_DC_BUS_UNDER_VOLTAGE);
+    if (!(vbus_voltage_ <= config_.dc_bus_overvoltage_trip_level))
+        disarm_with_error(ERROR_DC_BUS_OVER_VOLTAGE);
+}
+
+/**
+ * @brief Floats all power phases on the system (all motors and brake resistors).
+ *
+ * This should be called if a system level exception ocurred that makes it
+ * unsafe to run power through the system in general.
+ */
+void ODrive::disarm_with_error(Error error) {
+    CRITICAL_SECTION() {
+        for (auto& axis: axes) {
+            axis.motor_.disarm_with_error(Motor::ERROR_SYSTEM_LEVEL);
+        }
+        odrv.brake_resistor_.disarm();
+        error_ |= error;
+    }
+}
+
+/**
+ * @brief Runs the periodic sampling tasks
+ * 
+ * All components that need to sample real-world data should do it in this
+ * function as it runs on a high interrupt priority and provides lowest possible
+ * timing jitter.
+ * 
+ * All function called from this function should adhere to the following rules:
+ *  - Try to use the same number of CPU cycles in every iteration.
+ *    (reason: Tasks that run later in the function still want lowest possible timing jitter)
+ *  - Use as few cycles as possible.
+ *    (reason: The interrupt blocks other important interrupts (TODO: which ones?))
+ *  - Not call any FreeRTOS functions.
+ *    (reason: The interrupt priority is higher than the max allowed priority for syscalls)
+ * 
+ * Time consuming and undeterministic logic/arithmetic should live on
+ * control_loop_cb() instead.
+ */
+void ODrive::sampling_cb() {
+    n_evt_sampling_++;
+
+    MEASURE_TIME(task_times_.sampling) {
+        for (auto& axis: axes) {
+            axis.encoder_.sample_now();
+        }
+    }
+}
+
+/**
+ * @brief Adds the update functions of all axis components to the control loop
+ * pipeline.
+ * 
+ * The stages are added in an order that is valid by itself. The pipeline only
+ * deviates from it if the port connections require so.
+ */
+static void init_control_pipeline() {
+    for (Axis& axis: axes) {
+        // Sub-components should use set_error which will propegate to this error_
+        control_pipeline_.add_stage({
+            .update = [](void* ctx, uint32_t timestamp) {
+                Axis& axis = *(Axis*)ctx;
+                axis.motor_.fet_thermistor_.update();
+                axis.motor_.motor_thermistor_.update();
+            },
+            .ctx = &axis,
+            .timer = &axis.task_times_.thermistor_update,
+        });
+
+        control_pipeline_.add_stage({
+            .update = [](void* ctx, uint32_t timestamp) {
+                ((Axis*)ctx)->encoder_.update();
+            },
+            .ctx = &axis,
+            .timer = &axis.task_times_.encoder_update,
+            .outputs = {&axis.encoder_.phase_, &axis.encoder_.phase_vel_,
+                        &axis.encoder_.pos_estimate_, &axis.encoder_.vel_estimate_,
+                        &axis.encoder_.pos_circular_},
+        });
+    }
+
+    // Controller of either axis might use the encoder estimate of the other
+    // axis so we add both encoders before we continue.
+
+    for (Axis& axis: axes) {
+        // Keeps running when its outputs are not used so that the estimate
+        // is already converged when switching over from lock-in spin.
+        control_pipeline_.add_stage({
+            .update = [](void* ctx, uint32_t timestamp) {
+                ((Axis*)ctx)->sensorless_estimator_.update();
+            },
+            .ctx = &axis,
+            .timer = &axis.task_times_.sensorless_estimator_update,
+            .outputs = {&axis.sensorless_estimator_.phase_, &axis.sensorless_estimator_.phase_vel_,
+                        &axis.sensorless_estimator_.vel_estimate_},
+        });
+
+        control_pipeline_.add_stage({
+            .update = [](void* ctx, uint32_t timestamp) {
+                Axis& axis = *(Axis*)ctx;
+                axis.min_endstop_.update();
+                axis.max_endstop_.update();
+            },
+            .ctx = &axis,
+            .timer = &axis.task_times_.endstop_update,
+        });
+
+        control_pipeline_.add_stage({
+            .update = [](void* ctx, uint32_t timestamp) {
+                ((Axis*)ctx)->controller_.update(); // uses position and velocity from encoder
+            },
+            .ctx = &axis,
+            .timer = &axis.task_times_.controller_update,
+            .always_run = false,
+            .inputs = {&axis.controller_.pos_estimate_linear_src_, &axis.controller_.pos_estimate_circular_src_,
+                       &axis.controller_.vel_estimate_src_, &axis.controller_.pos_wrap_src_},
+            .outputs = {&axis.controller_.torque_output_},
+        });
+
+        control_pipeline_.add_stage({
+            .update = [](void* ctx, uint32_t timestamp) {
+                ((Axis*)ctx)->open_loop_controller_.update(timestamp);
+            },
+            .ctx = &axis,
+            .timer = &axis.task_times_.open_loop_controller_update,
+            .always_run = false,
+            .outputs = {&axis.open_loop_controller_.Idq_setpoint_, &axis.open_loop_controller_.Vdq_setpoint_,
+                        &axis.open_loop_controller_.phase_, &axis.open_loop_controller_.phase_vel_,
+                        &axis.open_loop_controller_.total_distance_},
+        });
+
+        control_pipeline_.add_stage({
+            .update = [](void* ctx, uint32_t timestamp) {
+                ((Axis*)ctx)->motor_.update(timestamp); // uses torque from controller and phase_vel from encoder
+            },
+            .ctx = &axis,
+            .timer = &axis.task_times_.motor_update,
+            .inputs = {&axis.motor_.torque_setpoint_src_, &axis.motor_.phase_vel_src_},
+            .outputs = {&axis.motor_.Idq_setpoint_, &axis.motor_.Vdq_setpoint_},
+        });
+
+        // The ACIM estimator runs in the current measurement interrupt. This
+        // stage only keeps the producers of its inputs running.
+        control_pipeline_.add_stage({
+            .inputs = {&axis.acim_estimator_.rotor_phase_src_, &axis.acim_estimator_.rotor_phase_vel_src_,
+                       &axis.acim_estimator_.idq_src_},
+        });
+
+        control_pipeline_.add_stage({
+            .update = [](void* ctx, uint32_t timestamp) {
+                // uses the output of controller_ or open_loop_contoller_ and encoder_ or sensorless_estimator_ or acim_estimator_
+                ((Axis*)ctx)->motor_.current_control_.update(timestamp);
+            },
+            .ctx = &axis,
+            .timer = &axis.task_times_.current_controller_update,
+            .inputs = {&axis.motor_.current_control_.Idq_setpoint_src_, &axis.motor_.current_control_.Vdq_setpoint_src_,
+                       &axis.motor_.current_control_.phase_src_, &axis.motor_.current_control_.phase_vel_src_},
+        });
+    }
+}
+
+/**
+ * @brief Runs the periodic control loop.
+ * 
+ * This function is executed in a low priority interrupt context and is allowed
+ * to call CMSIS functions.
+ * 
+ * Yet it runs at a higher priority than communication workloads.
+ * 
+ * @param update_cnt: The true count of update events (wrapping around at 16
+ *        bits). This is used for timestamp calculation in the face of
+ *        potentially missed timer update interrupts. Therefore this counter
+ *        must not rely on any interrupts.
+ */
+void ODrive::control_loop_cb(uint32_t timestamp) {
+    trace.begin(Trace::TRACE_SOURCE_CONTROL_LOOP);
+    last_update_timestamp_ = timestamp;
+    n_evt_control_loop_++;
+
+    MEASURE_TIME(task_times_.control_loop_misc) {
+        // Start a new epoch so that all output ports are outdated and we are
+        // certain about the freshness of all values that we use.
+        control_loop_epoch++;
+
+        uart_poll();
+        odrv.oscilloscope_.update();
+        odrv.telemetry_.update();
+    }
+
+    MEASURE_TIME(task_times_.control_loop_checks) {
+        for (auto& axis: axes) {
+            // look for errors at axis level and also all subcomponents
+            bool checks_ok = axis.do_checks(timestamp);
+
+            // make sure the watchdog is being fed. 
+            bool watchdog_ok = axis.watchdog_check();
+
+            if (!checks_ok || !watchdog_ok) {
+                axis.motor_.disarm();
+            }
+        }
+    }
+
+    if (!control_pipeline_.size()) {
+        init_control_pipeline();
+    }
+
+    control_pipeline_.run([timestamp](PipelineStage& stage) {
+        if (stage.update) {
+            MEASURE_TIME(*stage.timer)
+                stage.update(stage.ctx, timestamp);
+        }
+    });
+
+    // Tell the axis threads that the control loop has finished
+    for (auto& axis: axes) {
+        if (axis.thread_id_) {
+            osSignalSet(axis.thread_id_, 0x0001);
+        }
+    }
+
+    get_gpio(odrv.config_.error_gpio_pin).write(odrv.any_error());
+    trace.end(Trace::TRACE_SOURCE_CONTROL_LOOP);
+}
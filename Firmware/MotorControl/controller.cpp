@@ -4,6 +4,7 @@
 
 bool Controller::apply_config() {
     config_.parent = this;
+    config_.anticogging.calib_anticogging = false; // The calibration state is not saved
     update_filter_gains();
     return true;
 }
@@ -13,6 +14,7 @@ void Controller::reset() {
     vel_setpoint_ = 0.0f;
     vel_integrator_torque_ = 0.0f;
     torque_setpoint_ = 0.0f;
+    pvt_queue_.reset();
 }
 
 void Controller::set_error(Error error) {
@@ -44,11 +46,61 @@ void Controller::move_incremental(float displacement, bool from_input_pos = true
     input_pos_updated();
 }
 
-void Controller::start_anticogging_calibration() {
-    // Ensure the cogging map was correctly allocated earlier and that the motor is capable of calibrating
-    if (axis_->error_ == Axis::ERROR_NONE) {
-        config_.anticogging.calib_anticogging = true;
+bool Controller::push_pvt(float pos, float vel, float dt) {
+    // Points can come from different threads (USB, CAN, ...)
+    bool success = false;
+    CRITICAL_SECTION() {
+        success = pvt_queue_.push({pos, vel, dt});
     }
+    return success;
+}
+
+// Scratch state of the anticogging calibration. It is only used while
+// calibrating, so the axes share it and only one of them can calibrate at a
+// time.
+static CoggingCalibration_t cogging_calibration;
+static std::atomic<Controller*> cogging_calibration_owner = nullptr;
+
+bool Controller::start_anticogging_calibration() {
+    // Ensure that the motor is capable of calibrating
+    if (axis_->error_ != Axis::ERROR_NONE) {
+        return false;
+    }
+
+    // An axis can restart its own calibration but not take over the workspace
+    // from another axis.
+    Controller* owner = nullptr;
+    if (!cogging_calibration_owner.compare_exchange_strong(owner, this) && owner != this) {
+        return false;
+    }
+
+    cogging_calibration.samples.reset();
+    cogging_calibration.fit.reset();
+    cogging_calibration.sweep.reset();
+    anticogging_fit_pending_ = false;
+    sweep_phase_ = SweepPhase::kStart;
+    sweep_sampling_ = false;
+    config_.anticogging.index = 0;
+    anticogging_valid_ = false; // Measure without the old map
+    config_.anticogging.calib_anticogging = true;
+    return true;
+}
+
+/*
+ * Stops a calibration that didn't finish and releases the calibration
+ * workspace for the other axis. The old map stays disabled.
+ */
+void Controller::cancel_anticogging_calibration() {
+    if (cogging_calibration_owner.load() != this) {
+        return;
+    }
+    CRITICAL_SECTION() {
+        config_.anticogging.index = 0;
+        sweep_sampling_ = false;
+        config_.anticogging.calib_anticogging = false;
+        anticogging_fit_pending_ = false;
+    }
+    cogging_calibration_owner = nullptr;
 }
 
 
@@ -57,13 +109,20 @@ void Controller::start_anticogging_calibration() {
  * waits for zero velocity & position error,
  * then samples the current required to maintain that position.
  * 
- * This holding current is added as a feedforward term in the control loop.
+ * The samples are fitted with a sparse Fourier series (see CoggingMap_t) which
+ * is added as a feedforward term in the control loop. The fit runs in the axis
+ * thread. If it falls behind, the position is held until the sample can be
+ * queued.
  */
 bool Controller::anticogging_calibration(float pos_estimate, float vel_estimate) {
+    if (anticogging_fit_pending_) {
+        return true; // Waiting for update_anticogging_fit()
+    }
     float pos_err = input_pos_ - pos_estimate;
     if (std::abs(pos_err) <= config_.anticogging.calib_pos_threshold / (float)axis_->encoder_.config_.cpr &&
-        std::abs(vel_estimate) < config_.anticogging.calib_vel_threshold / (float)axis_->encoder_.config_.cpr) {
-        config_.anticogging.cogging_map[std::clamp<uint32_t>(config_.anticogging.index++, 0, 3600)] = vel_integrator_torque_;
+        std::abs(vel_estimate) < config_.anticogging.calib_vel_threshold / (float)axis_->encoder_.config_.cpr &&
+        cogging_calibration.samples.push({config_.anticogging.index * axis_->encoder_.getCoggingRatio(), vel_integrator_torque_})) {
+        config_.anticogging.index++;
     }
     if (config_.anticogging.index < 3600) {
         config_.control_mode = CONTROL_MODE_POSITION_CONTROL;
@@ -73,18 +132,117 @@ bool Controller::anticogging_calibration(float pos_estimate, float vel_estimate)
         input_pos_updated();
         return false;
     } else {
-        config_.anticogging.index = 0;
         config_.control_mode = CONTROL_MODE_POSITION_CONTROL;
         input_pos_ = 0.0f;  // Send the motor home
         input_vel_ = 0.0f;
         input_torque_ = 0.0f;
         input_pos_updated();
-        anticogging_valid_ = true;
-        config_.anticogging.calib_anticogging = false;
+        anticogging_fit_pending_.store(true, std::memory_order_release);
         return true;
     }
 }
 
+/*
+ * This anti-cogging implementation moves the axis at a constant velocity
+ * (calib_sweep_vel) over calib_sweep_turns turns, first forward then back.
+ * The torque along the way is binned by position (see CoggingSweep) and
+ * fitted in the axis thread once the axis is back at the start.
+ *
+ * The first and last 0.05 turn of each direction are not sampled to let the
+ * axis settle after reversing.
+ */
+bool Controller::anticogging_sweep(float pos_estimate) {
+    constexpr float settle_distance = 0.05f; // [turn]
+    float vel = std::abs(config_.anticogging.calib_sweep_vel);
+    float length = (float)config_.anticogging.calib_sweep_turns + 2.0f * settle_distance;
+
+    switch (sweep_phase_) {
+        case SweepPhase::kStart: {
+            sweep_origin_ = pos_estimate;
+            sweep_pos_ = 0.0f;
+            sweep_phase_ = SweepPhase::kForward;
+        } break;
+        case SweepPhase::kForward: {
+            sweep_pos_ += vel * current_meas_period;
+            if (sweep_pos_ >= length) {
+                sweep_pos_ = length;
+                sweep_phase_ = SweepPhase::kReverse;
+            }
+        } break;
+        case SweepPhase::kReverse: {
+            sweep_pos_ -= vel * current_meas_period;
+            if (sweep_pos_ <= 0.0f) {
+                sweep_pos_ = 0.0f;
+                sweep_phase_ = SweepPhase::kFit;
+                anticogging_fit_pending_.store(true, std::memory_order_release);
+            }
+        } break;
+        case SweepPhase::kFit: {
+            // Hold the position until update_anticogging_fit() is done
+        } break;
+    }
+
+    sweep_sampling_ = (sweep_phase_ == SweepPhase::kForward || sweep_phase_ == SweepPhase::kReverse)
+                   && sweep_pos_ >= settle_distance && sweep_pos_ <= length - settle_distance;
+
+    config_.control_mode = CONTROL_MODE_POSITION_CONTROL;
+    input_pos_ = sweep_origin_ + sweep_pos_;
+    input_vel_ = (sweep_phase_ == SweepPhase::kForward) ? vel : (sweep_phase_ == SweepPhase::kReverse) ? -vel : 0.0f;
+    input_torque_ = 0.0f;
+    input_pos_updated();
+    return false;
+}
+
+/*
+ * Feeds the anticogging calibration samples to the fit and, once they are all
+ * in, stores the fitted map. Adding a sample is too slow for the control loop
+ * so this is called periodically from the axis thread.
+ */
+void Controller::update_anticogging_fit() {
+    if (cogging_calibration_owner.load() != this) {
+        return;
+    }
+    CoggingFit& fit = cogging_calibration.fit;
+    CoggingSweep& cogging_sweep = cogging_calibration.sweep;
+    bool pending = anticogging_fit_pending_.load(std::memory_order_acquire);
+
+    CoggingSampleQueue::Sample_t sample;
+    while (cogging_calibration.samples.pop(&sample)) {
+        fit.add_sample(sample.pos, sample.torque);
+    }
+    if (!pending) {
+        return;
+    }
+
+    bool sweep = config_.anticogging.calib_sweep_vel != 0.0f;
+    if (sweep && cogging_sweep.complete()) {
+        // A few bins at a time to let the other threads run
+        bool all_bins = false;
+        for (size_t i = 0; i < 16 && !all_bins; ++i) {
+            all_bins = cogging_sweep.fit_next(&fit);
+        }
+        if (!all_bins) {
+            return;
+        }
+    }
+
+    CoggingMap_t map = config_.anticogging.cogging_map;
+    bool valid = (!sweep || cogging_sweep.complete()) && fit.fit(&map);
+    if (sweep) {
+        anticogging_stats_ = cogging_sweep.stats(map);
+    }
+
+    CRITICAL_SECTION() {
+        config_.anticogging.cogging_map = map;
+        anticogging_valid_ = valid;
+        config_.anticogging.index = 0;
+        sweep_sampling_ = false;
+        config_.anticogging.calib_anticogging = false;
+        anticogging_fit_pending_ = false;
+    }
+    cogging_calibration_owner = nullptr;
+}
+
 void Controller::update_filter_gains() {
     float bandwidth = std::min(config_.input_filter_bandwidth, 0.25f * current_meas_hz);
     input_filter_ki_ = 2.0f * bandwidth;  // basic conversion to discrete time
@@ -112,8 +270,13 @@ bool Controller::update() {
             return false;
         }
         // non-blocking
-        anticogging_calibration(*anticogging_pos_estimate, *anticogging_vel_estimate);
+        if (config_.anticogging.calib_sweep_vel != 0.0f) {
+            anticogging_sweep(*anticogging_pos_estimate);
+        } else {
+            anticogging_calibration(*anticogging_pos_estimate, *anticogging_vel_estimate);
+        }
     }
+    float sweep_pos_estimate = anticogging_pos_estimate.value_or(0.0f);
 
     // TODO also enable circular deltas for 2nd order filter, etc.
     if (config_.circular_setpoints) {
@@ -200,6 +363,53 @@ bool Controller::update() {
             }
             anticogging_pos_estimate = pos_setpoint_; // FF the position setpoint instead of the pos_estimate
         } break;
+        case INPUT_MODE_SCURVE_TRAJ: {
+            SCurveTrajectory& traj = axis_->scurve_traj_;
+            if(input_pos_updated_){
+                // The running trajectory (if any) keeps going while the new
+                // one is planned, so plan from the state it will be in when
+                // the new one takes over.
+                SCurveTrajectory::Step_t handover = trajectory_done_
+                    ? SCurveTrajectory::Step_t{pos_setpoint_, vel_setpoint_, 0.0f}
+                    : traj.eval(traj.t_ + SCurveTrajectory::kPlanningCycles * current_meas_period);
+                if (!traj.start_planning(input_pos_, handover.Y, handover.Yd, handover.Ydd,
+                                         traj.config_.vel_limit, traj.config_.accel_limit,
+                                         traj.config_.decel_limit, traj.config_.jerk_limit)) {
+                    set_error(ERROR_INVALID_INPUT_MODE);
+                    return false;
+                }
+                input_pos_updated_ = false;
+            } else if (traj.is_planning() && traj.continue_planning()) {
+                traj.t_ = 0.0f;
+                trajectory_done_ = false;
+            }
+            // Avoid updating uninitialized trajectory
+            if (trajectory_done_)
+                break;
+
+            if (traj.t_ > traj.Tf_) {
+                // Drop into position control mode when done to avoid problems on loop counter delta overflow
+                config_.control_mode = CONTROL_MODE_POSITION_CONTROL;
+                pos_setpoint_ = traj.Xf_; // input_pos_ may be the goal that is being planned
+                vel_setpoint_ = 0.0f;
+                torque_setpoint_ = 0.0f;
+                trajectory_done_ = true;
+            } else {
+                SCurveTrajectory::Step_t traj_step = traj.eval(traj.t_);
+                pos_setpoint_ = traj_step.Y;
+                vel_setpoint_ = traj_step.Yd;
+                torque_setpoint_ = traj_step.Ydd * config_.inertia;
+                traj.t_ += current_meas_period;
+            }
+            anticogging_pos_estimate = pos_setpoint_; // FF the position setpoint instead of the pos_estimate
+        } break;
+        case INPUT_MODE_PVT: {
+            PvtQueue::Step_t step = pvt_queue_.step(current_meas_period, pos_setpoint_, vel_setpoint_);
+            pos_setpoint_ = step.Y;
+            vel_setpoint_ = step.Yd;
+            torque_setpoint_ = step.Ydd * config_.inertia;
+            anticogging_pos_estimate = pos_setpoint_; // FF the position setpoint instead of the pos_estimate
+        } break;
         case INPUT_MODE_TUNING: {
             autotuning_phase_ = wrap_pm_pi(autotuning_phase_ + (2.0f * M_PI * autotuning_.frequency * current_meas_period));
             pos_setpoint_ = autotuning_.pos_amplitude * our_arm_sin_f32(autotuning_phase_ + autotuning_.pos_phase);
@@ -284,14 +494,12 @@ bool Controller::update() {
 
     // Anti-cogging is enabled after calibration
     // We get the current position and apply a current feed-forward
-    // ensuring that we handle negative encoder positions properly (-1 == motor->encoder.encoder_cpr - 1)
     if (anticogging_valid_ && config_.anticogging.anticogging_enabled) {
         if (!anticogging_pos_estimate.has_value()) {
             set_error(ERROR_INVALID_ESTIMATE);
             return false;
         }
-        float anticogging_pos = *anticogging_pos_estimate / axis_->encoder_.getCoggingRatio();
-        torque += config_.anticogging.cogging_map[std::clamp(mod((int)anticogging_pos, 3600), 0, 3600)];
+        torque += config_.anticogging.cogging_map.eval(*anticogging_pos_estimate);
     }
 
     float v_err = 0.0f;
@@ -342,6 +550,10 @@ bool Controller::update() {
         }
     }
 
+    if (config_.anticogging.calib_anticogging && sweep_sampling_ && !limited) {
+        cogging_calibration.sweep.add_sample(sweep_pos_estimate, torque, sweep_phase_ == SweepPhase::kForward);
+    }
+
     torque_output_ = torque;
 
     // TODO: this is inconsistent with the other errors which are sticky.
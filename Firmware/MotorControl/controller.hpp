@@ -1,17 +1,22 @@
 #ifndef __CONTROLLER_HPP
 #define __CONTROLLER_HPP
 
+#include "cogging_map.hpp"
+#include "pvt_queue.hpp"
+
 class Controller : public ODriveIntf::ControllerIntf {
 public:
     struct Anticogging_t {
         uint32_t index = 0;
-        float cogging_map[3600];
+        CoggingMap_t cogging_map;
         bool pre_calibrated = false;
         bool calib_anticogging = false;
         float calib_pos_threshold = 1.0f;
         float calib_vel_threshold = 1.0f;
         float cogging_ratio = 1.0f;
         bool anticogging_enabled = true;
+        float calib_sweep_vel = 0.2f; // [turn/s] 0 to step through 3600 positions instead
+        uint32_t calib_sweep_turns = 2;
     };
 
     struct Autotuning_t {
@@ -71,10 +76,16 @@ public:
     // Trajectory-Planned control
     void move_to_pos(float goal_point);
     void move_incremental(float displacement, bool from_goal_point);
+
+    // Streaming trajectory (INPUT_MODE_PVT)
+    bool push_pvt(float pos, float vel, float dt);
     
     // TODO: make this more similar to other calibration loops
-    void start_anticogging_calibration();
+    bool start_anticogging_calibration();
+    void cancel_anticogging_calibration();
     bool anticogging_calibration(float pos_estimate, float vel_estimate);
+    bool anticogging_sweep(float pos_estimate);
+    void update_anticogging_fit();
 
     void update_filter_gains();
     bool update();
@@ -110,7 +121,22 @@ public:
     
     bool trajectory_done_ = true;
 
+    PvtQueue pvt_queue_;
+
+    // The control loop only collects the anticogging calibration samples. They
+    // are fitted in the axis thread (see update_anticogging_fit()). The samples
+    // and the fit are kept in a workspace that the axes share.
+    std::atomic<bool> anticogging_fit_pending_ = false; // Set once all samples are in
+
+    // State of the continuous anticogging calibration (see anticogging_sweep())
+    enum class SweepPhase { kStart, kForward, kReverse, kFit };
+    SweepPhase sweep_phase_ = SweepPhase::kStart;
+    float sweep_origin_ = 0.0f; // [turn]
+    float sweep_pos_ = 0.0f;    // [turn] relative to sweep_origin_
+    bool sweep_sampling_ = false;
+
     bool anticogging_valid_ = false;
+    CoggingSweep::Stats_t anticogging_stats_;
 
     // Outputs
     OutputPort<float> torque_output_ = 0.0f;
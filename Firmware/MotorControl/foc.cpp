@@ -49,6 +49,7 @@ void FieldOrientedController::reset() {
     v_current_control_integral_q_ = 0.0f;
     vbus_voltage_measured_ = std::nullopt;
     Ialpha_beta_measured_ = std::nullopt;
+    dq_output_valid_ = false;
 }
 
 Motor::Error FieldOrientedController::on_measurement(
@@ -58,6 +59,7 @@ Motor::Error FieldOrientedController::on_measurement(
     i_timestamp_ = input_timestamp;
     vbus_voltage_measured_ = vbus_voltage;
     Ialpha_beta_measured_ = Ialpha_beta;
+    dq_output_valid_ = false;
 
     return Motor::ERROR_NONE;
 }
@@ -66,42 +68,89 @@ ODriveIntf::MotorIntf::Error FieldOrientedController::get_alpha_beta_output(
         uint32_t output_timestamp, std::optional<float2D>* mod_alpha_beta,
         std::optional<float>* ibus) {
 
+    // This runs at a higher priority than update()
+    uint32_t setpoints_version = setpoints_.version();
+    const Setpoints& setpoints = setpoints_.read_uninterruptible();
+
     if (!vbus_voltage_measured_.has_value() || !Ialpha_beta_measured_.has_value()) {
         // FOC didn't receive a current measurement yet.
         return Motor::ERROR_CONTROLLER_INITIALIZING;
-    } else if (abs((int32_t)(i_timestamp_ - ctrl_timestamp_)) > MAX_CONTROL_LOOP_UPDATE_TO_CURRENT_UPDATE_DELTA) {
+    } else if (abs((int32_t)(i_timestamp_ - setpoints.ctrl_timestamp)) > MAX_CONTROL_LOOP_UPDATE_TO_CURRENT_UPDATE_DELTA) {
         // Data from control loop and current measurement are too far apart.
         return Motor::ERROR_BAD_TIMING;
     }
 
-    // TODO: improve efficiency in case PWM updates are requested at a higher
-    // rate than current sensor updates. In this case we can reuse mod_d and
-    // mod_q from a previous iteration.
-
-    if (!Vdq_setpoint_.has_value()) {
+    if (!setpoints.Vdq_setpoint.has_value()) {
         return Motor::ERROR_UNKNOWN_VOLTAGE_COMMAND;
-    } else if (!phase_.has_value() || !phase_vel_.has_value()) {
+    } else if (!setpoints.phase.has_value() || !setpoints.phase_vel.has_value()) {
         return Motor::ERROR_UNKNOWN_PHASE_ESTIMATE;
     } else if (!vbus_voltage_measured_.has_value()) {
         return Motor::ERROR_UNKNOWN_VBUS_VOLTAGE;
     }
 
-    auto [Vd, Vq] = *Vdq_setpoint_;
-    float phase = *phase_;
-    float phase_vel = *phase_vel_;
+    float phase_vel = *setpoints.phase_vel;
+
+    // If PWM updates are requested at a higher rate than current measurements
+    // arrive, the dq-frame modulation from the last measurement is still
+    // valid and only the inverse Park transform needs to be redone for the
+    // new PWM phase. This also keeps the integrator from running faster than
+    // current_meas_period.
+    if (!reuse_dq_output_ || !dq_output_valid_ || dq_output_setpoints_version_ != setpoints_version) {
+        Motor::Error status = update_dq_output(setpoints);
+        if (status != Motor::ERROR_NONE) {
+            return status;
+        }
+        dq_output_setpoints_version_ = setpoints_version;
+    }
+
+    // Inverse park transform
+    // The PWM phase is usually only a fraction of a PWM period ahead of the
+    // current measurement phase, so instead of another table lookup we rotate
+    // the sin/cos pair from the Park transform by the difference.
+    float pwm_phase_delta = phase_vel * ((float)(int32_t)(output_timestamp - i_timestamp_) / (float)TIM_1_8_CLOCK_HZ);
+    float c_p;
+    float s_p;
+    if (std::abs(pwm_phase_delta) <= rotate_sin_cos_max_delta) {
+        rotate_sin_cos(s_I_, c_I_, pwm_phase_delta, &s_p, &c_p);
+    } else {
+        our_arm_sin_cos_f32(I_phase_ + pwm_phase_delta, &s_p, &c_p);
+    }
+    float mod_alpha = c_p * mod_d_ - s_p * mod_q_;
+    float mod_beta = c_p * mod_q_ + s_p * mod_d_;
+
+    // Report final applied voltage in stationary frame (for sensorless estimator)
+    final_v_alpha_ = mod_to_V_ * mod_alpha;
+    final_v_beta_ = mod_to_V_ * mod_beta;
+
+    *mod_alpha_beta = {mod_alpha, mod_beta};
+    *ibus = ibus_;
+
+    return Motor::ERROR_NONE;
+}
+
+/**
+ * @brief Runs the Park transform and the current controller on the latest
+ * measurement and stores the resulting dq-frame modulation.
+ *
+ * Must only be called after the preconditions in get_alpha_beta_output()
+ * were checked.
+ */
+ODriveIntf::MotorIntf::Error FieldOrientedController::update_dq_output(const Setpoints& setpoints) {
+    auto [Vd, Vq] = *setpoints.Vdq_setpoint;
+    float phase = *setpoints.phase;
+    float phase_vel = *setpoints.phase_vel;
     float vbus_voltage = *vbus_voltage_measured_;
 
     std::optional<float2D> Idq;
+    I_phase_ = phase + phase_vel * ((float)(int32_t)(i_timestamp_ - setpoints.ctrl_timestamp) / (float)TIM_1_8_CLOCK_HZ);
+    our_arm_sin_cos_f32(I_phase_, &s_I_, &c_I_);
 
     // Park transform
     if (Ialpha_beta_measured_.has_value()) {
         auto [Ialpha, Ibeta] = *Ialpha_beta_measured_;
-        float I_phase = phase + phase_vel * ((float)(int32_t)(i_timestamp_ - ctrl_timestamp_) / (float)TIM_1_8_CLOCK_HZ);
-        float c_I = our_arm_cos_f32(I_phase);
-        float s_I = our_arm_sin_f32(I_phase);
         Idq = {
-            c_I * Ialpha + s_I * Ibeta,
-            c_I * Ibeta - s_I * Ialpha
+            c_I_ * Ialpha + s_I_ * Ibeta,
+            c_I_ * Ibeta - s_I_ * Ialpha
         };
         Id_measured_ += I_measured_report_filter_k_ * (Idq->first - Id_measured_);
         Iq_measured_ += I_measured_report_filter_k_ * (Idq->second - Iq_measured_);
@@ -116,20 +165,20 @@ ODriveIntf::MotorIntf::Error FieldOrientedController::get_alpha_beta_output(
     float mod_d;
     float mod_q;
 
-    if (enable_current_control_) {
+    if (setpoints.enable_current_control) {
         // Current control mode
 
         if (!pi_gains_.has_value()) {
             return Motor::ERROR_UNKNOWN_GAINS;
         } else if (!Idq.has_value()) {
             return Motor::ERROR_UNKNOWN_CURRENT_MEASUREMENT;
-        } else if (!Idq_setpoint_.has_value()) {
+        } else if (!setpoints.Idq_setpoint.has_value()) {
             return Motor::ERROR_UNKNOWN_CURRENT_COMMAND;
         }
 
         auto [p_gain, i_gain] = *pi_gains_;
         auto [Id, Iq] = *Idq;
-        auto [Id_setpoint, Iq_setpoint] = *Idq_setpoint_;
+        auto [Id_setpoint, Iq_setpoint] = *setpoints.Idq_setpoint;
 
         float Ierr_d = Id_setpoint - Id;
         float Ierr_q = Iq_setpoint - Iq;
@@ -158,34 +207,27 @@ ODriveIntf::MotorIntf::Error FieldOrientedController::get_alpha_beta_output(
         mod_q = V_to_mod * Vq;
     }
 
-    // Inverse park transform
-    float pwm_phase = phase + phase_vel * ((float)(int32_t)(output_timestamp - ctrl_timestamp_) / (float)TIM_1_8_CLOCK_HZ);
-    float c_p = our_arm_cos_f32(pwm_phase);
-    float s_p = our_arm_sin_f32(pwm_phase);
-    float mod_alpha = c_p * mod_d - s_p * mod_q;
-    float mod_beta = c_p * mod_q + s_p * mod_d;
-
-    // Report final applied voltage in stationary frame (for sensorless estimator)
-    final_v_alpha_ = mod_to_V * mod_alpha;
-    final_v_beta_ = mod_to_V * mod_beta;
-
-    *mod_alpha_beta = {mod_alpha, mod_beta};
-
+    mod_to_V_ = mod_to_V;
+    mod_d_ = mod_d;
+    mod_q_ = mod_q;
     if (Idq.has_value()) {
         auto [Id, Iq] = *Idq;
-        *ibus = mod_d * Id + mod_q * Iq;
+        ibus_ = mod_d * Id + mod_q * Iq;
+    } else {
+        ibus_ = std::nullopt;
     }
-    
+    dq_output_valid_ = true;
+
     return Motor::ERROR_NONE;
 }
 
 void FieldOrientedController::update(uint32_t timestamp) {
-    CRITICAL_SECTION() {
-        ctrl_timestamp_ = timestamp;
-        enable_current_control_ = enable_current_control_src_;
-        Idq_setpoint_ = Idq_setpoint_src_.present();
-        Vdq_setpoint_ = Vdq_setpoint_src_.present();
-        phase_ = phase_src_.present();
-        phase_vel_ = phase_vel_src_.present();
-    }
+    setpoints_.write({
+        .ctrl_timestamp = timestamp,
+        .enable_current_control = enable_current_control_src_,
+        .Idq_setpoint = Idq_setpoint_src_.present(),
+        .Vdq_setpoint = Vdq_setpoint_src_.present(),
+        .phase = phase_src_.present(),
+        .phase_vel = phase_vel_src_.present()
+    });
 }
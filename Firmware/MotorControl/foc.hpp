@@ -3,6 +3,7 @@
 
 #include "phase_control_law.hpp"
 #include "component.hpp"
+#include "snapshot.hpp"
 
 /**
  * @brief Field oriented controller.
@@ -29,6 +30,7 @@ public:
     // Config - these values are set while this controller is inactive
     std::optional<float2D> pi_gains_; // [V/A, V/As] should be auto set after resistance and inductance measurement
     float I_measured_report_filter_k_ = 1.0f;
+    bool reuse_dq_output_ = true; // if true, PWM updates without a new current measurement or setpoint only rerun the inverse Park transform
 
     // Inputs
     bool enable_current_control_src_ = false;
@@ -37,14 +39,18 @@ public:
     InputPort<float> phase_src_;
     InputPort<float> phase_vel_src_;
 
-    // These values are set atomically by the update() function and read by the
-    // calculate() function in an interrupt context.
-    uint32_t ctrl_timestamp_; // [HCLK ticks]
-    bool enable_current_control_ = false; // true: FOC runs in current control mode using I{dq}_setpoint, false: FOC runs in voltage control mode using V{dq}_setpoint
-    std::optional<float2D> Idq_setpoint_; // [A] only used if enable_current_control_ == true
-    std::optional<float2D> Vdq_setpoint_; // [V] feed-forward voltage term (or standalone setpoint if enable_current_control_ == false)
-    std::optional<float> phase_; // [rad]
-    std::optional<float> phase_vel_; // [rad/s]
+    struct Setpoints {
+        uint32_t ctrl_timestamp = 0; // [HCLK ticks]
+        bool enable_current_control = false; // true: FOC runs in current control mode using I{dq}_setpoint, false: FOC runs in voltage control mode using V{dq}_setpoint
+        std::optional<float2D> Idq_setpoint; // [A] only used if enable_current_control == true
+        std::optional<float2D> Vdq_setpoint; // [V] feed-forward voltage term (or standalone setpoint if enable_current_control == false)
+        std::optional<float> phase; // [rad]
+        std::optional<float> phase_vel; // [rad/s]
+    };
+
+    // Published by the update() function and read by get_alpha_beta_output()
+    // in an interrupt context.
+    Snapshot<Setpoints> setpoints_;
 
     // These values (or some of them) are updated inside on_measurement() and get_alpha_beta_output()
     uint32_t i_timestamp_;
@@ -54,12 +60,20 @@ public:
     float Iq_measured_; // [A]
     float v_current_control_integral_d_ = 0.0f; // [V]
     float v_current_control_integral_q_ = 0.0f; // [V]
-    //float mod_to_V_ = 0.0f;
-    //float mod_d_ = 0.0f;
-    //float mod_q_ = 0.0f;
-    //float ibus_ = 0.0f;
+    float mod_to_V_ = 0.0f;
+    float mod_d_ = 0.0f;
+    float mod_q_ = 0.0f;
+    std::optional<float> ibus_;
+    float I_phase_ = 0.0f; // [rad] phase at i_timestamp_
+    float s_I_ = 0.0f; // sin(I_phase_)
+    float c_I_ = 1.0f; // cos(I_phase_)
+    bool dq_output_valid_ = false; // true if the values above correspond to the latest measurement
+    uint32_t dq_output_setpoints_version_ = 0; // version of setpoints_ that the values above correspond to
     float final_v_alpha_ = 0.0f; // [V]
     float final_v_beta_ = 0.0f; // [V]
+
+private:
+    ODriveIntf::MotorIntf::Error update_dq_output(const Setpoints& setpoints);
 };
 
 #endif // __FOC_HPP
\ No newline at end of file
@@ -89,6 +89,7 @@ static bool config_read_all(size_t* size) {
                   board.nvm.read(&axes[i].sensorless_estimator_.config_) &&
                   board.nvm.read(&axes[i].controller_.config_) &&
                   board.nvm.read(&axes[i].trap_traj_.config_) &&
+                  board.nvm.read(&axes[i].scurve_traj_.config_) &&
                   board.nvm.read(&axes[i].min_endstop_.config_) &&
                   board.nvm.read(&axes[i].max_endstop_.config_) &&
                   board.nvm.read(&axes[i].mechanical_brake_.config_) &&
@@ -114,6 +115,7 @@ static bool config_write_all() {
                   board.nvm.write(&axes[i].sensorless_estimator_.config_) &&
                   board.nvm.write(&axes[i].controller_.config_) &&
                   board.nvm.write(&axes[i].trap_traj_.config_) &&
+                  board.nvm.write(&axes[i].scurve_traj_.config_) &&
                   board.nvm.write(&axes[i].min_endstop_.config_) &&
                   board.nvm.write(&axes[i].max_endstop_.config_) &&
                   board.nvm.write(&axes[i].mechanical_brake_.config_) &&
@@ -134,6 +136,7 @@ static void config_clear_all() {
         axes[i].controller_.config_ = {};
         axes[i].controller_.config_.load_encoder_axis = i;
         axes[i].trap_traj_.config_ = {};
+        axes[i].scurve_traj_.config_ = {};
         axes[i].min_endstop_.config_ = {};
         axes[i].max_endstop_.config_ = {};
         axes[i].mechanical_brake_.config_ = {};
@@ -213,42 +216,6 @@ void ODrive::enter_dfu_mode() {
     }
 }
 
-bool ODrive::any_error() {
-    return error_ != ODrive::ERROR_NONE
-        || std::any_of(axes.begin(), axes.end(), [](Axis& axis){
-            return axis.error_ != Axis::ERROR_NONE
-                || axis.motor_.error_ != Motor::ERROR_NONE
-                || axis.sensorless_estimator_.error_ != SensorlessEstimator::ERROR_NONE
-                || axis.encoder_.error_ != Encoder::ERROR_NONE
-                || axis.controller_.error_ != Controller::ERROR_NONE;
-        });
-}
-
-uint64_t ODrive::get_drv_fault() {
-#if AXIS_COUNT == 1
-    return motors[0].gate_driver_.get_error();
-#elif AXIS_COUNT == 2
-    return (uint64_t)motors[0].gate_driver_.get_error() | ((uint64_t)motors[1].gate_driver_.get_error() << 32ULL);
-#else
-    #error "not supported"
-#endif
-}
-
-void ODrive::clear_errors() {
-    for (auto& axis: axes) {
-        axis.motor_.error_ = Motor::ERROR_NONE;
-        axis.controller_.error_ = Controller::ERROR_NONE;
-        axis.sensorless_estimator_.error_ = SensorlessEstimator::ERROR_NONE;
-        axis.encoder_.error_ = Encoder::ERROR_NONE;
-        axis.encoder_.spi_error_rate_ = 0.0f;
-        axis.error_ = Axis::ERROR_NONE;
-    }
-    error_ = ERROR_NONE;
-    if (odrv.config_.enable_brake_resistor) {
-        brake_resistor_.arm();
-    }
-}
-
 // TODO: this could probably be part of the main control loop
 static void analog_polling_thread(void *) {
     while (true) {
@@ -316,176 +283,6 @@ void vApplicationIdleHook(void) {
 }
 }
 
-/**
- * @brief Runs system-level checks that need to be as real-time as possible.
- * 
- * This function is called after every current measurement of every motor.
- * It should finish as quickly as possible.
- */
-void ODrive::do_fast_checks() {
-    if (!(vbus_voltage_ >= config_.dc_bus_undervoltage_trip_level))
-        disarm_with_error(ERROR_DC_BUS_UNDER_VOLTAGE);
-    if (!(vbus_voltage_ <= config_.dc_bus_overvoltage_trip_level))
-        disarm_with_error(ERROR_DC_BUS_OVER_VOLTAGE);
-}
-
-/**
- * @brief Floats all power phases on the system (all motors and brake resistors).
- *
- * This should be called if a system level exception ocurred that makes it
- * unsafe to run power through the system in general.
- */
-void ODrive::disarm_with_error(Error error) {
-    CRITICAL_SECTION() {
-        for (auto& axis: axes) {
-            axis.motor_.disarm_with_error(Motor::ERROR_SYSTEM_LEVEL);
-        }
-        odrv.brake_resistor_.disarm();
-        error_ |= error;
-    }
-}
-
-/**
- * @brief Runs the periodic sampling tasks
- * 
- * All components that need to sample real-world data should do it in this
- * function as it runs on a high interrupt priority and provides lowest possible
- * timing jitter.
- * 
- * All function called from this function should adhere to the following rules:
- *  - Try to use the same number of CPU cycles in every iteration.
- *    (reason: Tasks that run later in the function still want lowest possible timing jitter)
- *  - Use as few cycles as possible.
- *    (reason: The interrupt blocks other important interrupts (TODO: which ones?))
- *  - Not call any FreeRTOS functions.
- *    (reason: The interrupt priority is higher than the max allowed priority for syscalls)
- * 
- * Time consuming and undeterministic logic/arithmetic should live on
- * control_loop_cb() instead.
- */
-void ODrive::sampling_cb() {
-    n_evt_sampling_++;
-
-    MEASURE_TIME(task_times_.sampling) {
-        for (auto& axis: axes) {
-            axis.encoder_.sample_now();
-        }
-    }
-}
-
-/**
- * @brief Runs the periodic control loop.
- * 
- * This function is executed in a low priority interrupt context and is allowed
- * to call CMSIS functions.
- * 
- * Yet it runs at a higher priority than communication workloads.
- * 
- * @param update_cnt: The true count of update events (wrapping around at 16
- *        bits). This is used for timestamp calculation in the face of
- *        potentially missed timer update interrupts. Therefore this counter
- *        must not rely on any interrupts.
- */
-void ODrive::control_loop_cb(uint32_t timestamp) {
-    last_update_timestamp_ = timestamp;
-    n_evt_control_loop_++;
-
-    // TODO: use a configurable component list for most of the following things
-
-    MEASURE_TIME(task_times_.control_loop_misc) {
-        // Reset all output ports so that we are certain about the freshness of
-        // all values that we use.
-        // If we forget to reset a value here the worst that can happen is that
-        // this safety check doesn't work.
-        // TODO: maybe we should add a check to output ports that prevents
-        // double-setting the value.
-        for (auto& axis: axes) {
-            axis.acim_estimator_.slip_vel_.reset();
-            axis.acim_estimator_.stator_phase_vel_.reset();
-            axis.acim_estimator_.stator_phase_.reset();
-            axis.controller_.torque_output_.reset();
-            axis.encoder_.phase_.reset();
-            axis.encoder_.phase_vel_.reset();
-            axis.encoder_.pos_estimate_.reset();
-            axis.encoder_.vel_estimate_.reset();
-            axis.encoder_.pos_circular_.reset();
-            axis.motor_.Vdq_setpoint_.reset();
-            axis.motor_.Idq_setpoint_.reset();
-            axis.open_loop_controller_.Idq_setpoint_.reset();
-            axis.open_loop_controller_.Vdq_setpoint_.reset();
-            axis.open_loop_controller_.phase_.reset();
-            axis.open_loop_controller_.phase_vel_.reset();
-            axis.open_loop_controller_.total_distance_.reset();
-            axis.sensorless_estimator_.phase_.reset();
-            axis.sensorless_estimator_.phase_vel_.reset();
-            axis.sensorless_estimator_.vel_estimate_.reset();
-        }
-
-        uart_poll();
-        odrv.oscilloscope_.update();
-    }
-
-    MEASURE_TIME(task_times_.control_loop_checks) {
-        for (auto& axis: axes) {
-            // look for errors at axis level and also all subcomponents
-            bool checks_ok = axis.do_checks(timestamp);
-
-            // make sure the watchdog is being fed. 
-            bool watchdog_ok = axis.watchdog_check();
-
-            if (!checks_ok || !watchdog_ok) {
-                axis.motor_.disarm();
-            }
-        }
-    }
-
-    for (auto& axis: axes) {
-        // Sub-components should use set_error which will propegate to this error_
-        MEASURE_TIME(axis.task_times_.thermistor_update) {
-            axis.motor_.fet_thermistor_.update();
-            axis.motor_.motor_thermistor_.update();
-        }
-
-        MEASURE_TIME(axis.task_times_.encoder_update)
-            axis.encoder_.update();
-    }
-
-    // Controller of either axis might use the encoder estimate of the other
-    // axis so we process both encoders before we continue.
-
-    for (auto& axis: axes) {
-        MEASURE_TIME(axis.task_times_.sensorless_estimator_update)
-            axis.sensorless_estimator_.update();
-
-        MEASURE_TIME(axis.task_times_.endstop_update) {
-            axis.min_endstop_.update();
-            axis.max_endstop_.update();
-        }
-
-        MEASURE_TIME(axis.task_times_.controller_update)
-            axis.controller_.update(); // uses position and velocity from encoder
-
-        MEASURE_TIME(axis.task_times_.open_loop_controller_update)
-            axis.open_loop_controller_.update(timestamp);
-
-        MEASURE_TIME(axis.task_times_.motor_update)
-            axis.motor_.update(timestamp); // uses torque from controller and phase_vel from encoder
-
-        MEASURE_TIME(axis.task_times_.current_controller_update)
-            axis.motor_.current_control_.update(timestamp); // uses the output of controller_ or open_loop_contoller_ and encoder_ or sensorless_estimator_ or acim_estimator_
-    }
-
-    // Tell the axis threads that the control loop has finished
-    for (auto& axis: axes) {
-        if (axis.thread_id_) {
-            osSignalSet(axis.thread_id_, 0x0001);
-        }
-    }
-
-    get_gpio(odrv.config_.error_gpio_pin).write(odrv.any_error());
-}
-
-
 /** @brief For diagnostics only */
 uint32_t ODrive::get_interrupt_status(int32_t irqn) {
     if ((irqn < -14) || (irqn >= 240)) {
@@ -806,7 +603,7 @@ extern "C" int main(void) {
     uart_event_queue = osMessageCreate(osMessageQ(uart_event_queue), NULL);
 
     // Create an event queue for USB
-    osMessageQDef(usb_event_queue, 7, uint32_t);
+    osMessageQDef(usb_event_queue, 8, uint32_t);
     usb_event_queue = osMessageCreate(osMessageQ(usb_event_queue), NULL);
 
     osSemaphoreDef(sem_can);
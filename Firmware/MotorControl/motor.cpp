@@ -596,6 +596,7 @@ void Motor::current_meas_cb(uint32_t timestamp, std::optional<Iph_ABC_t> current
     } else {
         current_meas_ = std::nullopt;
     }
+    current_meas_snapshot_.write(current_meas_);
 
     // Run system-level checks (e.g. overvoltage/undervoltage condition)
     // The motor might be disarmed in this function. In this case the
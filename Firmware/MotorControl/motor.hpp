@@ -114,6 +114,7 @@ public:
     uint8_t armed_state_ = 0;
     bool is_calibrated_ = false; // Set in apply_config()
     std::optional<Iph_ABC_t> current_meas_;
+    Snapshot<std::optional<Iph_ABC_t>> current_meas_snapshot_; // copy of current_meas_ for readers in lower priority contexts
     Iph_ABC_t DC_calib_ = {0.0f, 0.0f, 0.0f};
     float dc_calib_running_since_ = 0.0f; // current sensor calibration needs some time to settle
     float I_bus_ = 0.0f; // this motors contribution to the bus current
@@ -144,10 +144,12 @@ inline ENUMTYPE operator ~ (ENUMTYPE a) { return static_cast<ENUMTYPE>(~static_c
 #include <current_limiter.hpp>
 #include <thermistor.hpp>
 #include <trapTraj.hpp>
+#include <scurveTraj.hpp>
 #include <endstop.hpp>
 #include <mechanical_brake.hpp>
 #include <axis.hpp>
 #include <oscilloscope.hpp>
+#include <telemetry.hpp>
 #include <communication/communication.h>
 #include <communication/can/odrive_can.hpp>
 #include <brake_resistor.hpp>
@@ -219,12 +221,9 @@ public:
 
     SystemStats_t system_stats_;
 
-    // Edit these to suit your capture needs
-    Oscilloscope oscilloscope_{
-        nullptr, // trigger_src
-        0.5f, // trigger_threshold
-        nullptr // data_src TODO: change data type
-    };
+    Oscilloscope oscilloscope_;
+    Telemetry telemetry_;
+    Trace& trace_ = trace; // global so that the task timers can reach it
 
     ODriveCAN can_{*board.can_busses[0]};
 
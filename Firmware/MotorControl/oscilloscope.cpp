@@ -1,27 +1,135 @@
+#include <odrive_main.h>
 
-#include "oscilloscope.hpp"
+bool Oscilloscope::arm() {
+    stop();
 
-// if you use the oscilloscope feature you can bump up this value
-#define OSCILLOSCOPE_SIZE 4096
+    // Resolve the channels outside of the control loop
+    size_t n_channels = 0;
+    size_t trigger_slot = kMaxChannels;
+    for (size_t i = 0; i < kMaxChannels; ++i) {
+        const Channel_t& channel = config_.channels[i];
+        ActiveChannel_t& active = active_channels_[n_channels];
+        if (!fibre::is_endpoint_ref_valid(channel.endpoint)
+                || !fibre::get_endpoint_property(channel.endpoint, &active.property)) {
+            continue;
+        }
+        active.type_info = dynamic_cast<const FloatGettableTypeInfo*>(active.property.get_type_info());
+        if (!active.type_info) {
+            return false; // not a number
+        }
+        active.decimation = std::max<uint32_t>(channel.decimation, 1);
+        active.countdown = 0;
+        active.value = NAN;
+        if (i == config_.trigger_channel) {
+            trigger_slot = n_channels;
+        }
+        n_channels++;
+    }
+
+    if (!n_channels || (config_.trigger_mode != OSCILLOSCOPE_TRIGGER_MODE_IMMEDIATE && trigger_slot >= n_channels)) {
+        return false;
+    }
+
+    n_channels_ = n_channels;
+    n_records_ = OSCILLOSCOPE_SIZE / n_channels;
+    size_ = n_records_ * n_channels;
+    pre_trigger_ = std::min(config_.pre_trigger, n_records_ - 1);
+    trigger_slot_ = (trigger_slot < n_channels) ? trigger_slot : 0;
+    countdown_ = 0;
+    write_record_ = 0;
+    n_written_ = 0;
+    remaining_ = 0;
+    last_trigger_value_ = NAN;
+
+    CRITICAL_SECTION() {
+        state_ = OSCILLOSCOPE_STATE_ARMED;
+    }
+    return true;
+}
+
+void Oscilloscope::stop() {
+    CRITICAL_SECTION() {
+        if (state_ != OSCILLOSCOPE_STATE_DONE) {
+            state_ = OSCILLOSCOPE_STATE_IDLE;
+        }
+    }
+}
+
+float Oscilloscope::get_val(uint32_t index) {
+    if (state_ != OSCILLOSCOPE_STATE_DONE || index >= size_) {
+        return NAN;
+    }
+    // The oldest record is the one that would have been written next
+    uint32_t record = (write_record_ + index / n_channels_) % n_records_;
+    return data_[record * n_channels_ + index % n_channels_];
+}
+
+uint32_t Oscilloscope::read_block(uint32_t offset, float* values, uint32_t count) {
+    if (state_ != OSCILLOSCOPE_STATE_DONE || offset >= size_) {
+        return 0;
+    }
+    count = std::min(count, size_ - offset);
+
+    // Copy in up to two contiguous pieces, split where the ring buffer wraps
+    uint32_t start = (write_record_ * n_channels_ + offset) % size_;
+    uint32_t n_first = std::min(count, size_ - start);
+    std::copy_n(&data_[start], n_first, values);
+    std::copy_n(&data_[0], count - n_first, values + n_first);
+    return count;
+}
+
+void Oscilloscope::write_record() {
+    float* record = &data_[write_record_ * n_channels_];
+    for (size_t i = 0; i < n_channels_; ++i) {
+        ActiveChannel_t& channel = active_channels_[i];
+        if (!channel.countdown) {
+            channel.countdown = channel.decimation;
+            if (!channel.type_info->get_float(channel.property, &channel.value)) {
+                channel.value = NAN;
+            }
+        }
+        channel.countdown--;
+        record[i] = channel.value;
+    }
+    write_record_ = (write_record_ + 1 == n_records_) ? 0 : write_record_ + 1;
+    n_written_ = std::min(n_written_ + 1, n_records_);
+}
 
 void Oscilloscope::update() {
-    float trigger_data = trigger_src_ ? *trigger_src_ : 0.0f;
-    float trigger_threshold = trigger_threshold_;
-    float sample_data = data_src_ ? **data_src_ : 0.0f;
-
-    if (trigger_data < trigger_threshold) {
-        ready_ = true;
-    }
-    if (ready_ && trigger_data >= trigger_threshold) {
-        capturing_ = true;
-        ready_ = false;
-    }
-    if (capturing_) {
-        if (pos_ < OSCILLOSCOPE_SIZE) {
-            data_[pos_++] = sample_data;
-        } else {
-            pos_ = 0;
-            capturing_ = false;
+    if (state_ != OSCILLOSCOPE_STATE_ARMED && state_ != OSCILLOSCOPE_STATE_TRIGGERED) {
+        return;
+    }
+    if (countdown_) {
+        countdown_--;
+        return;
+    }
+    countdown_ = std::max<uint32_t>(config_.decimation, 1) - 1;
+
+    write_record();
+
+    if (state_ == OSCILLOSCOPE_STATE_ARMED) {
+        float value = active_channels_[trigger_slot_].value;
+        float level = config_.trigger_level;
+        bool fired = false;
+        switch (config_.trigger_mode) {
+            case OSCILLOSCOPE_TRIGGER_MODE_IMMEDIATE: fired = true; break;
+            case OSCILLOSCOPE_TRIGGER_MODE_RISING: fired = (last_trigger_value_ < level) && (value >= level); break;
+            case OSCILLOSCOPE_TRIGGER_MODE_FALLING: fired = (last_trigger_value_ > level) && (value <= level); break;
+            case OSCILLOSCOPE_TRIGGER_MODE_LEVEL: fired = (value >= level); break;
+            default: break;
         }
+        last_trigger_value_ = value;
+
+        // The trigger record is the first one after the pre-trigger records
+        if (fired && n_written_ > pre_trigger_) {
+            state_ = OSCILLOSCOPE_STATE_TRIGGERED;
+            remaining_ = n_records_ - pre_trigger_ - 1;
+        }
+    } else {
+        remaining_--;
+    }
+
+    if (state_ == OSCILLOSCOPE_STATE_TRIGGERED && !remaining_) {
+        state_ = OSCILLOSCOPE_STATE_DONE;
     }
 }
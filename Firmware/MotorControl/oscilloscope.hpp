@@ -2,30 +2,82 @@
 #define __OSCILLOSCOPE_HPP
 
 #include <autogen/interfaces.hpp>
+#include <fibre/introspection.hpp>
 
-// if you use the oscilloscope feature you can bump up this value
+#include <array>
+
+// Number of values (summed over all channels) that can be captured.
+// If you use the oscilloscope feature you can bump up this value.
 #define OSCILLOSCOPE_SIZE 4096
 
+/**
+ * @brief Captures up to kMaxChannels properties in the control loop.
+ *
+ * Each control loop iteration (or every config_.decimation-th iteration)
+ * appends one record with one value per active channel to a ring buffer.
+ * Once armed, the oscilloscope records continuously until the trigger fires
+ * and then stops such that config_.pre_trigger records from before the trigger
+ * are kept.
+ *
+ * The channels are resolved when the oscilloscope is armed, so update() only
+ * reads the properties and doesn't depend on the size of the object tree.
+ */
 class Oscilloscope : public ODriveIntf::OscilloscopeIntf {
 public:
-    Oscilloscope(float* trigger_src, float trigger_threshold, float** data_src)
-        : trigger_src_(trigger_src), trigger_threshold_(trigger_threshold), data_src_(data_src) {}
+    static constexpr size_t kMaxChannels = 8;
+
+    struct Channel_t {
+        endpoint_ref_t endpoint = {0, 0};
+
+        // The property is read every decimation-th record and held in between
+        uint32_t decimation = 1;
+    };
+
+    struct Config_t {
+        std::array<Channel_t, kMaxChannels> channels;
+        uint32_t decimation = 1; // [control loop iterations] per record
+        uint32_t pre_trigger = 0; // [records]
+        OscilloscopeTriggerMode trigger_mode = OSCILLOSCOPE_TRIGGER_MODE_IMMEDIATE;
+        uint32_t trigger_channel = 0;
+        float trigger_level = 0.0f;
+    };
 
-    float get_val(uint32_t index) override {
-        return index < OSCILLOSCOPE_SIZE ? data_[index] : NAN;
-    }
+    bool arm() override;
+    void stop() override;
+    float get_val(uint32_t index) override;
+    uint32_t read_block(uint32_t offset, float* values, uint32_t count) override;
 
     void update();
 
-    const uint32_t size_ = OSCILLOSCOPE_SIZE;
-    const float* trigger_src_;
-    const float trigger_threshold_;
-    float* const * data_src_;
+    Config_t config_;
+    OscilloscopeState state_ = OSCILLOSCOPE_STATE_IDLE;
+    uint32_t n_channels_ = 0;
+    uint32_t size_ = 0; // n_channels_ times the number of records
+
+private:
+    void write_record();
+
+    struct ActiveChannel_t {
+        Introspectable property;
+        const FloatGettableTypeInfo* type_info;
+        uint32_t decimation;
+        uint32_t countdown;
+        float value;
+    };
+
+    std::array<ActiveChannel_t, kMaxChannels> active_channels_;
+    size_t trigger_slot_ = 0;
+    uint32_t n_records_ = 0;
+    uint32_t pre_trigger_ = 0;
+
+    // State of the capture
+    uint32_t countdown_ = 0;       // Control loop iterations until the next record
+    uint32_t write_record_ = 0;    // Index of the next record to write
+    uint32_t n_written_ = 0;       // Records since arming (saturates at n_records_)
+    uint32_t remaining_ = 0;       // Records to write after the trigger fired
+    float last_trigger_value_ = 0.0f;
 
     float data_[OSCILLOSCOPE_SIZE] = {0};
-    size_t pos_ = 0;
-    bool ready_ = false;
-    bool capturing_ = false;
 };
 
-#endif // __OSCILLOSCOPE_HPP
\ No newline at end of file
+#endif // __OSCILLOSCOPE_HPP
@@ -0,0 +1,166 @@
+#ifndef __PIPELINE_HPP
+#define __PIPELINE_HPP
+
+#include "component.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+
+struct TaskTimer;
+
+/**
+ * @brief A stage of a Pipeline.
+ *
+ * A stage usually runs the update function of one component and lists the
+ * ports through which that component exchanges data with other stages.
+ *
+ * A stage without update function can be used to declare the inputs of a
+ * component that runs outside of the pipeline (e.g. in the current
+ * measurement interrupt). This keeps the producers of these inputs active.
+ */
+struct PipelineStage {
+    static constexpr size_t kMaxPorts = 5;
+
+    void (*update)(void* ctx, uint32_t timestamp) = nullptr;
+    void* ctx = nullptr;
+    TaskTimer* timer = nullptr;
+
+    // If false, the stage only runs while one of its outputs is consumed by
+    // another stage that runs. Only stages that have no side effects besides
+    // their output ports should set this to false.
+    bool always_run = true;
+
+    std::array<const InputPortBase*, kMaxPorts> inputs = {};
+    std::array<const OutputPortBase*, kMaxPorts> outputs = {};
+};
+
+/**
+ * @brief Runs a fixed set of stages in an order that is derived from the
+ * connections between their ports.
+ *
+ * A stage runs after all stages that produce its inputs and is skipped if
+ * always_run is false and none of its outputs are consumed by a running stage.
+ *
+ * Some components read the state of other components directly and not through
+ * ports, so the graph doesn't capture all dependencies. Stages that were added
+ * earlier therefore take precedence whenever the port graph allows it and the
+ * order in which stages are added should be a valid order by itself.
+ *
+ * The schedule is recomputed whenever a port was connected or disconnected
+ * since the last run (see port_connection_version).
+ *
+ * Member functions of this class are not thread-safe.
+ */
+template<size_t N>
+class Pipeline {
+    static_assert(N <= 32, "dependency sets are stored as 32-bit masks");
+
+public:
+    bool add_stage(const PipelineStage& stage) {
+        if (n_stages_ >= N) {
+            return false;
+        }
+        stages_[n_stages_++] = stage;
+        schedule_valid_ = false;
+        return true;
+    }
+
+    size_t size() const {
+        return n_stages_;
+    }
+
+    /**
+     * @brief Calls run_stage(stage) for all stages that need to run in the
+     * order in which they need to run.
+     *
+     * run_stage is responsible for calling stage.update (if it's not null).
+     */
+    template<typename TFunc>
+    void run(TFunc&& run_stage) {
+        if (!schedule_valid_ || scheduled_version_ != port_connection_version) {
+            schedule();
+        }
+        for (size_t i = 0; i < n_scheduled_; ++i) {
+            run_stage(stages_[schedule_[i]]);
+        }
+    }
+
+    /**
+     * @brief Returns the number of stages that ran in the last call to run().
+     */
+    size_t n_scheduled() const {
+        return n_scheduled_;
+    }
+
+private:
+    // Returns the index of the stage that produces the specified output port
+    // or -1 if it's not produced by any stage.
+    int find_producer(const OutputPortBase* port) const {
+        for (size_t i = 0; port && i < n_stages_; ++i) {
+            for (const OutputPortBase* output: stages_[i].outputs) {
+                if (output == port) {
+                    return (int)i;
+                }
+            }
+        }
+        return -1;
+    }
+
+    void schedule() {
+        scheduled_version_ = port_connection_version;
+        schedule_valid_ = true;
+
+        std::array<uint32_t, N> dependencies = {};
+        uint32_t active = 0;
+        for (size_t i = 0; i < n_stages_; ++i) {
+            for (const InputPortBase* input: stages_[i].inputs) {
+                int producer = input ? find_producer(input->source()) : -1;
+                if (producer >= 0 && (size_t)producer != i) {
+                    dependencies[i] |= 1UL << producer;
+                }
+            }
+            if (stages_[i].always_run) {
+                active |= 1UL << i;
+            }
+        }
+
+        // Activate all stages that a running stage depends on
+        for (uint32_t prev_active = 0; prev_active != active; ) {
+            prev_active = active;
+            for (size_t i = 0; i < n_stages_; ++i) {
+                if (active & (1UL << i)) {
+                    active |= dependencies[i];
+                }
+            }
+        }
+
+        // Topological sort that prefers the lowest stage index. A dependency
+        // cycle is broken at the lowest pending index.
+        n_scheduled_ = 0;
+        uint32_t pending = active;
+        while (pending) {
+            size_t next = N;
+            for (size_t i = 0; i < n_stages_; ++i) {
+                if ((pending & (1UL << i)) && !(dependencies[i] & pending)) {
+                    next = i;
+                    break;
+                }
+            }
+            if (next == N) {
+                next = __builtin_ctz(pending);
+            }
+            pending &= ~(1UL << next);
+            schedule_[n_scheduled_++] = (uint8_t)next;
+        }
+    }
+
+    std::array<PipelineStage, N> stages_;
+    size_t n_stages_ = 0;
+    std::array<uint8_t, N> schedule_ = {};
+    size_t n_scheduled_ = 0;
+    bool schedule_valid_ = false;
+    uint32_t scheduled_version_ = 0;
+};
+
+#endif // __PIPELINE_HPP
@@ -0,0 +1,143 @@
+#ifndef __PVT_QUEUE_HPP
+#define __PVT_QUEUE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include <atomic>
+
+/**
+ * @brief Queue of position/velocity/time (PVT) points that are interpolated
+ * with cubic Hermite segments.
+ *
+ * A host streams points ahead of time and the control loop moves through them
+ * without stopping at each point. Each point specifies the position and
+ * velocity that should be reached `dt` seconds after the previous point. The
+ * first segment starts at the setpoints at the time when it's started.
+ *
+ * push() is the producer side and step() / reset() are the consumer side. The
+ * two sides can run in different threads or interrupts without locking, but
+ * there must be only one producer and one consumer at a time.
+ */
+class PvtQueue {
+public:
+    static constexpr size_t kCapacity = 64;
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "capacity must be a power of two");
+
+    struct Point_t {
+        float pos; // [turn]
+        float vel; // [turn/s]
+        float dt;  // [s] time since the previous point
+    };
+
+    struct Step_t {
+        float Y;
+        float Yd;
+        float Ydd;
+    };
+
+    /**
+     * @brief Appends a point to the queue. Returns false if the queue is full
+     * or if dt is not positive.
+     */
+    bool push(const Point_t& point) {
+        if (!(point.dt > 0.0f)) {
+            return false;
+        }
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= kCapacity) {
+            return false;
+        }
+        points_[tail & (kCapacity - 1)] = point;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Returns the number of points that were not reached yet.
+     */
+    uint32_t depth() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Discards all queued points and stops the current segment.
+     */
+    void reset() {
+        head_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+        running_ = false;
+    }
+
+    /**
+     * @brief Advances by dt and returns the new setpoints.
+     *
+     * @param pos, vel: The current setpoints. They are held if the queue is
+     *        empty and become the start of the first segment when new points
+     *        arrive.
+     *
+     * If the queue runs empty while the last point had a non-zero velocity,
+     * the axis stops at that point and underrun_count_ is incremented.
+     */
+    Step_t step(float dt, float pos, float vel) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+
+        if (!running_) {
+            if (head == tail) {
+                return {pos, 0.0f, 0.0f};
+            }
+            p0_ = pos;
+            v0_ = vel;
+            t_ = 0.0f;
+            running_ = true;
+        }
+
+        t_ += dt;
+        while (head != tail && t_ >= points_[head & (kCapacity - 1)].dt) {
+            const Point_t& point = points_[head & (kCapacity - 1)];
+            t_ -= point.dt;
+            p0_ = point.pos;
+            v0_ = point.vel;
+            head++;
+        }
+        head_.store(head, std::memory_order_release);
+
+        if (head == tail) {
+            running_ = false;
+            if (v0_ != 0.0f) {
+                underrun_count_++;
+            }
+            return {p0_, 0.0f, 0.0f};
+        }
+
+        // Cubic Hermite interpolation between (p0, v0) and the next point
+        const Point_t& p1 = points_[head & (kCapacity - 1)];
+        float T = p1.dt;
+        float s = t_ / T;
+        float dp = p1.pos - p0_;
+        float m0 = v0_ * T;
+        float m1 = p1.vel * T;
+        float a = m0 + m1 - 2.0f * dp; // p(s) = p0 + m0*s + b*s^2 + a*s^3
+        float b = 3.0f * dp - 2.0f * m0 - m1;
+        return {
+            p0_ + ((a * s + b) * s + m0) * s,
+            ((3.0f * a * s + 2.0f * b) * s + m0) / T,
+            (6.0f * a * s + 2.0f * b) / (T * T)
+        };
+    }
+
+    uint32_t underrun_count_ = 0;
+
+private:
+    std::array<Point_t, kCapacity> points_ = {};
+    std::atomic<uint32_t> head_ = 0; // Written by the consumer
+    std::atomic<uint32_t> tail_ = 0; // Written by the producer
+
+    // State of the consumer
+    bool running_ = false;
+    float p0_ = 0.0f; // Position at the start of the current segment
+    float v0_ = 0.0f; // Velocity at the start of the current segment
+    float t_ = 0.0f;  // Time since the start of the current segment
+};
+
+#endif // __PVT_QUEUE_HPP
@@ -0,0 +1,217 @@
+#include "scurveTraj.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Symbol                     Description
+// Xi, Vi and Ai              Initial conditions
+// Xf                         Position set-point
+// s                          Direction (sign) of the cruise velocity (if any)
+// r                          Direction (sign) of a velocity ramp
+// Vmax, Amax, Dmax and Jmax  Kinematic bounds
+// Vr                         Reached (cruise) velocity
+
+namespace {
+
+struct State_t {
+    float Y;
+    float Yd;
+    float Ydd;
+
+    // Integrates the motion over a segment of constant jerk J and duration T
+    void advance(float J, float T) {
+        Y += (Yd + (0.5f * Ydd + J * T / 6.0f) * T) * T;
+        Yd += (Ydd + 0.5f * J * T) * T;
+        Ydd += J * T;
+    }
+};
+
+// Takes the velocity from v0 to v1 and the acceleration from a0 to zero:
+// Ramp the acceleration to Ap (T1), hold it (T2) and ramp it back to zero (T3).
+struct Ramp_t {
+    float J1; // Jerk during T1
+    float J3; // Jerk during T3
+    float T1;
+    float T2;
+    float T3;
+
+    void apply(State_t& state) const {
+        state.advance(J1, T1);
+        state.advance(0.0f, T2);
+        state.advance(J3, T3);
+    }
+};
+
+// Velocity that is reached by ramping the acceleration a0 to zero right away
+float coast_vel(float v0, float a0, float Jmax) {
+    return v0 + a0 * std::abs(a0) / (2.0f * Jmax);
+}
+
+Ramp_t plan_ramp(float v0, float a0, float v1, float r, float a_limit, float Jmax) {
+    // Solve in the frame where the velocity increases
+    float dv = r * (v1 - v0);
+    float a0r = r * a0;
+
+    // Peak acceleration if there is no constant acceleration phase:
+    // dv = (2*Ap^2 - a0^2) / (2*Jmax)
+    float Ap = std::sqrt(std::max(Jmax * dv + 0.5f * a0r * a0r, 0.0f));
+    float T1 = std::max((Ap - a0r) / Jmax, 0.0f);
+    float T2 = 0.0f;
+    if (Ap > a_limit) {
+        // If a0 is above the limit, T1 ramps the acceleration down to the limit
+        Ap = a_limit;
+        T1 = std::abs(Ap - a0r) / Jmax;
+        T2 = std::max((dv - 0.5f * (a0r + Ap) * T1 - 0.5f * Ap * Ap / Jmax) / Ap, 0.0f);
+    }
+
+    return {std::copysign(Jmax, r * (Ap - a0r)), -r * Jmax, T1, T2, Ap / Jmax};
+}
+
+struct Profile_t {
+    Ramp_t accel; // From the initial conditions to Vr
+    Ramp_t decel; // From Vr to standstill
+    float dX;     // Displacement, not including the cruise phase
+};
+
+Profile_t plan_profile(float Vi, float Ai, float Vr, float s,
+                       float Amax, float Dmax, float Jmax) {
+    float coast = coast_vel(Vi, Ai, Jmax);
+    float r = std::copysign(1.0f, Vr - coast);
+
+    // Speeding up towards the goal is limited by Amax and slowing down by
+    // Dmax. Turning around involves both so it's limited by the smaller one.
+    // This makes dX grow monotonically with s*Vr (see planSCurve).
+    float a_limit = (r != s) ? Dmax
+                  : (s * coast < 0.0f) ? std::min(Amax, Dmax)
+                  : Amax;
+
+    Profile_t profile;
+    profile.accel = plan_ramp(Vi, Ai, Vr, r, a_limit, Jmax);
+    profile.decel = plan_ramp(Vr, 0.0f, 0.0f, std::copysign(1.0f, -Vr), Dmax, Jmax);
+
+    State_t state = {0.0f, Vi, Ai};
+    profile.accel.apply(state);
+    state.Yd = Vr; // Remove rounding errors
+    state.Ydd = 0.0f;
+    profile.decel.apply(state);
+    profile.dX = state.Y;
+    return profile;
+}
+
+} // namespace
+
+bool SCurveTrajectory::planSCurve(float Xf, float Xi, float Vi, float Ai,
+                                  float Vmax, float Amax, float Dmax, float Jmax) {
+    if (!start_planning(Xf, Xi, Vi, Ai, Vmax, Amax, Dmax, Jmax)) {
+        return false;
+    }
+    while (!continue_planning()) {}
+    return true;
+}
+
+bool SCurveTrajectory::start_planning(float Xf, float Xi, float Vi, float Ai,
+                                      float Vmax, float Amax, float Dmax, float Jmax) {
+    if (!(Vmax > 0.0f && Amax > 0.0f && Dmax > 0.0f && Jmax > 0.0f)) {
+        return false;
+    }
+
+    float dX = Xf - Xi; // Distance to travel
+
+    // Minimum stopping displacement
+    float coast = coast_vel(Vi, Ai, Jmax);
+    State_t stop = {0.0f, Vi, Ai};
+    plan_ramp(Vi, Ai, 0.0f, std::copysign(1.0f, -coast), Dmax, Jmax).apply(stop);
+    float s = std::copysign(1.0f, dX - stop.Y); // Sign of cruise velocity (if any)
+
+    // Try to reach the velocity limit
+    Profile_t profile = plan_profile(Vi, Ai, s * Vmax, s, Amax, Dmax, Jmax);
+
+    plan_ = {Xf, Xi, Vi, Ai, Amax, Dmax, Jmax, s, 0.0f, Vmax, 0.0f, false, 0, kPlanningCycles};
+    if (std::abs(dX - stop.Y) <= 4.0f * FLT_EPSILON * std::max(std::abs(Xf), std::abs(Xi))) {
+        // The goal is where stopping ends up, down to the resolution of the
+        // position. Just stop: planning a move back by less than that would
+        // only restart the same move on every replan.
+    } else if (s * profile.dX <= s * dX) {
+        // Long move (with cruise phase)
+        plan_.lo = Vmax;
+        plan_.Tv = (dX - profile.dX) / (s * Vmax);
+    } else {
+        // Short move: the velocity limit is not reached. The displacement
+        // grows monotonically with the reached velocity, so it can be found by
+        // bisection between standstill (which doesn't overshoot) and Vmax
+        // (which does). The last few ULPs of position are left to the final
+        // condition in eval().
+        plan_.is_short = true;
+    }
+    return true;
+}
+
+bool SCurveTrajectory::continue_planning() {
+    if (!plan_.cycles_left) {
+        return true;
+    }
+    const Plan_t& p = plan_;
+    float dX = p.Xf - p.Xi;
+
+    // Spread the bisection evenly over the planning cycles. The last one
+    // additionally puts the trajectory in place.
+    size_t steps_end = plan_.is_short
+        ? kBisectionSteps * (kPlanningCycles - plan_.cycles_left + 1) / kPlanningCycles
+        : 0;
+    for (; plan_.steps_done < steps_end; ++plan_.steps_done) {
+        float mid = 0.5f * (p.lo + p.hi);
+        Profile_t profile = plan_profile(p.Vi, p.Ai, p.s * mid, p.s, p.Amax, p.Dmax, p.Jmax);
+        if (p.s * profile.dX > p.s * dX) {
+            plan_.hi = mid;
+        } else {
+            plan_.lo = mid;
+        }
+    }
+    if (--plan_.cycles_left) {
+        return false;
+    }
+
+    Vr_ = p.s * p.lo;
+    Profile_t profile = plan_profile(p.Vi, p.Ai, Vr_, p.s, p.Amax, p.Dmax, p.Jmax);
+
+    const Ramp_t& acc = profile.accel;
+    const Ramp_t& dec = profile.decel;
+    const float T[7] = {acc.T1, acc.T2, acc.T3, p.Tv, dec.T1, dec.T2, dec.T3};
+    const float J[7] = {acc.J1, 0.0f, acc.J3, 0.0f, dec.J1, 0.0f, dec.J3};
+
+    // Fill in the rest of the values used at evaluation-time
+    State_t state = {p.Xi, p.Vi, p.Ai};
+    Tf_ = 0.0f;
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        segments_[i] = {T[i], J[i], state.Y, state.Yd, state.Ydd};
+        state.advance(J[i], T[i]);
+        Tf_ += T[i];
+    }
+    Xi_ = p.Xi;
+    Xf_ = p.Xf;
+    Vi_ = p.Vi;
+    Ai_ = p.Ai;
+
+    return true;
+}
+
+SCurveTrajectory::Step_t SCurveTrajectory::eval(float t) {
+    if (t < 0.0f) {  // Initial Condition
+        return {Xi_, Vi_, Ai_};
+    }
+
+    if (t < Tf_) {
+        for (const Segment_t& segment: segments_) {
+            if (t < segment.T) {
+                State_t state = {segment.Y, segment.Yd, segment.Ydd};
+                state.advance(segment.J, t);
+                return {state.Y, state.Yd, state.Ydd};
+            }
+            t -= segment.T;
+        }
+    }
+
+    // Final Condition
+    return {Xf_, 0.0f, 0.0f};
+}
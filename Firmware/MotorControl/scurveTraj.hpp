@@ -0,0 +1,88 @@
+#ifndef _SCURVE_TRAJ_H
+#define _SCURVE_TRAJ_H
+
+#include <array>
+#include <cstddef>
+
+/**
+ * @brief Jerk-limited (S-curve) point-to-point trajectory planner.
+ *
+ * Like TrapezoidalTrajectory but the acceleration is ramped with a limited
+ * jerk instead of being switched on and off. A trajectory consists of seven
+ * constant-jerk segments: three to get from the initial velocity to the cruise
+ * velocity, one at cruise velocity and three to come to a stop at the goal.
+ * Any of them can have zero duration.
+ *
+ * The planner accepts an initial acceleration so that a trajectory can be
+ * replanned while another one is running without a step in acceleration.
+ *
+ * Planning a move that doesn't reach the velocity limit takes a bisection
+ * which is too slow for a single control loop iteration. The controller
+ * therefore calls start_planning() and then continue_planning() once per
+ * control cycle. The latter does a fixed share of the work and puts the new
+ * trajectory in place on its kPlanningCycles-th call. Until then, segments_
+ * still hold the running trajectory.
+ */
+class SCurveTrajectory {
+public:
+    struct Config_t {
+        float vel_limit = 2.0f;   // [turn/s]
+        float accel_limit = 0.5f; // [turn/s^2]
+        float decel_limit = 0.5f; // [turn/s^2]
+        float jerk_limit = 2.0f;  // [turn/s^3]
+    };
+
+    struct Step_t {
+        float Y;
+        float Yd;
+        float Ydd;
+    };
+
+    static constexpr size_t kBisectionSteps = 24;
+    static constexpr size_t kPlanningCycles = 4;
+
+    // Plans the whole trajectory at once
+    bool planSCurve(float Xf, float Xi, float Vi, float Ai,
+                    float Vmax, float Amax, float Dmax, float Jmax);
+    bool start_planning(float Xf, float Xi, float Vi, float Ai,
+                        float Vmax, float Amax, float Dmax, float Jmax);
+    bool continue_planning();
+    bool is_planning() const { return plan_.cycles_left > 0; }
+    Step_t eval(float t);
+
+    Config_t config_;
+
+    float Xi_ = 0.0f;
+    float Xf_ = 0.0f;
+    float Vi_ = 0.0f;
+    float Ai_ = 0.0f;
+
+    float Vr_ = 0.0f; // Reached (cruise) velocity
+
+    struct Segment_t {
+        float T;  // Duration
+        float J;  // Jerk during this segment
+        float Y;  // Position at the start of this segment
+        float Yd; // Velocity at the start of this segment
+        float Ydd; // Acceleration at the start of this segment
+    };
+    std::array<Segment_t, 7> segments_ = {};
+
+    float Tf_ = 0.0f;
+
+    float t_ = 0.0f;
+
+    // State of the trajectory that is being planned
+    struct Plan_t {
+        float Xf, Xi, Vi, Ai;
+        float Amax, Dmax, Jmax;
+        float s;      // Sign of cruise velocity (if any)
+        float lo, hi; // Bisection interval of the reached speed (short move)
+        float Tv;     // Duration of the cruise phase (long move)
+        bool is_short;
+        size_t steps_done;
+        size_t cycles_left;
+    } plan_ = {};
+};
+
+#endif
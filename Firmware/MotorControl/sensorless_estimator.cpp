@@ -33,9 +33,9 @@ bool SensorlessEstimator::update() {
         return false;
     }
 
-    // TODO: we read values here which are modified by a higher priority interrupt.
-    // This is not thread-safe.    
-    auto current_meas = axis_->motor_.current_meas_;
+    // The current measurement is updated by a higher priority interrupt so we
+    // read it through the snapshot to get a consistent copy.
+    auto current_meas = axis_->motor_.current_meas_snapshot_.read();
     if (!axis_->motor_.is_armed_) {
         // While the motor is disarmed the current is not measurable so we
         // assume that it's zero.
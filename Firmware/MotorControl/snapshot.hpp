@@ -0,0 +1,84 @@
+#ifndef __SNAPSHOT_HPP
+#define __SNAPSHOT_HPP
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief Passes a value from one writer to any number of readers that run in
+ * different interrupt priorities on the same core, without disabling
+ * interrupts.
+ *
+ * The value is double-buffered: The writer fills the inactive buffer and then
+ * publishes it by incrementing a sequence number. The least significant bit of
+ * the sequence number selects the active buffer.
+ *
+ *  - A reader with higher priority than the writer can't be interrupted by the
+ *    writer and always gets the last published value on the first attempt,
+ *    even if it interrupted the writer in the middle of filling the inactive
+ *    buffer.
+ *  - A reader with lower priority than the writer retries if the writer
+ *    published a new value while the reader was copying (seqlock).
+ *
+ * A write costs one copy of T and a read costs one copy of T (plus retries in
+ * the low priority case) instead of a critical section that adds jitter to
+ * all other interrupts.
+ *
+ * Only one context may call write().
+ */
+template<typename T>
+class Snapshot {
+public:
+    Snapshot() = default;
+    Snapshot(const T& value) : buffers_{value, value} {}
+
+    /**
+     * @brief Publishes a new value.
+     */
+    void write(const T& value) {
+        uint32_t seq = seq_.load(std::memory_order_relaxed);
+        buffers_[(seq + 1) & 1] = value;
+        std::atomic_signal_fence(std::memory_order_release);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Returns a consistent copy of the last published value.
+     */
+    T read() const {
+        for (;;) {
+            uint32_t seq = seq_.load(std::memory_order_relaxed);
+            std::atomic_signal_fence(std::memory_order_acquire);
+            T value = buffers_[seq & 1];
+            std::atomic_signal_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == seq) {
+                return value;
+            }
+        }
+    }
+
+    /**
+     * @brief Returns a reference to the last published value without copying
+     * it.
+     *
+     * Must only be used by readers that can't be interrupted by the writer
+     * (i.e. that run at a higher priority than the writer). The reference
+     * stays valid until the reader returns.
+     */
+    const T& read_uninterruptible() const {
+        return buffers_[seq_.load(std::memory_order_relaxed) & 1];
+    }
+
+    /**
+     * @brief Returns a number that changes whenever a new value is published.
+     */
+    uint32_t version() const {
+        return seq_.load(std::memory_order_relaxed);
+    }
+
+private:
+    T buffers_[2] = {};
+    std::atomic<uint32_t> seq_ = 0;
+};
+
+#endif // __SNAPSHOT_HPP
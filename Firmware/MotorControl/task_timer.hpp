@@ -3,27 +3,78 @@
 
 #include <stdint.h>
 #include <board.h>
+#include <autogen/interfaces.hpp>
+#include "trace.hpp"
+#include "task_timer_histogram.hpp"
+
+#include <algorithm>
+#include <array>
 
 #define MEASURE_START_TIME
 #define MEASURE_END_TIME
 #define MEASURE_LENGTH
 #define MEASURE_MAX_LENGTH
+#define MEASURE_OVERRUNS
+#define MEASURE_HISTOGRAM
+#define MEASURE_TRACE
+
+/**
+ * @brief Measures how long a task takes in ticks of board_control_loop_counter.
+ *
+ * start_time_, end_time_ and length_ are only updated while `enabled` is set
+ * (i.e. for a single control loop iteration requested by a profiler).
+ * max_length_, n_overruns_ and the histogram are updated on every
+ * measurement.
+ *
+ * Each timer also records its start and end in the trace (see trace.hpp)
+ * under its own trace_id_.
+ *
+ * The histogram has two logarithmic bins per octave (see TaskTimerHistogram).
+ */
+struct TaskTimer : ODriveIntf::TaskTimerIntf {
+    static constexpr size_t kHistogramBins = TaskTimerHistogram::kBins;
 
-struct TaskTimer {
     uint32_t start_time_ = 0;
     uint32_t end_time_ = 0;
     uint32_t length_ = 0;
     uint32_t max_length_ = 0;
+    uint32_t budget_ = 0; // [ticks] 0 to disable the overrun counter
+    uint32_t n_overruns_ = 0;
+    std::array<uint32_t, kHistogramBins> histogram_ = {};
+    uint16_t trace_id_;
 
     static bool enabled;
+    static uint16_t next_trace_id;
+
+    TaskTimer() : trace_id_(next_trace_id++) {}
+
+    uint32_t read_histogram(uint32_t offset, uint32_t* values, uint32_t count) final {
+        if (offset >= kHistogramBins) {
+            return 0;
+        }
+        count = std::min<uint32_t>(count, kHistogramBins - offset);
+        std::copy_n(&histogram_[offset], count, values);
+        return count;
+    }
+
+    void reset_histogram() final {
+        histogram_ = {};
+        n_overruns_ = 0;
+    }
 
     uint32_t start() {
+#ifdef MEASURE_TRACE
+        trace.begin(trace_id_);
+#endif
         return board_control_loop_counter;
     }
 
     void stop(uint32_t start_time) {
         uint32_t end_time = board_control_loop_counter;
         uint32_t length = end_time - start_time;
+#ifdef MEASURE_TRACE
+        trace.end(trace_id_);
+#endif
 
         if (enabled) {
 #ifdef MEASURE_START_TIME
@@ -38,6 +89,17 @@ struct TaskTimer {
         }
 #ifdef MEASURE_MAX_LENGTH
         max_length_ = std::max(max_length_, length);
+#endif
+#ifdef MEASURE_OVERRUNS
+        if (budget_ && length > budget_) {
+            n_overruns_++;
+#ifdef MEASURE_TRACE
+            trace.overrun(trace_id_);
+#endif
+        }
+#endif
+#ifdef MEASURE_HISTOGRAM
+        histogram_[TaskTimerHistogram::get_histogram_bin(length)]++;
 #endif
     }
 };
@@ -0,0 +1,33 @@
+#ifndef __TASK_TIMER_HISTOGRAM_HPP
+#define __TASK_TIMER_HISTOGRAM_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+
+/**
+ * @brief Bins of the TaskTimer histogram.
+ *
+ * There are two logarithmic bins per octave: bin 0 counts lengths of 0, bin 1
+ * lengths of 1 and bin i >= 2 counts lengths in
+ * [get_histogram_bin_start(i), get_histogram_bin_start(i + 1)). The last bin
+ * also counts everything beyond.
+ */
+struct TaskTimerHistogram {
+    static constexpr size_t kBins = 32;
+
+    static constexpr size_t get_histogram_bin(uint32_t length) {
+        if (length < 2) {
+            return length;
+        }
+        uint32_t msb = 31 - __builtin_clz(length);
+        uint32_t half = (length >> (msb - 1)) & 1;
+        return std::min<size_t>(2 * msb + half, kBins - 1);
+    }
+
+    static constexpr uint32_t get_histogram_bin_start(size_t bin) {
+        return bin < 2 ? bin : (2 + (bin & 1)) << (bin / 2 - 1);
+    }
+};
+
+#endif // __TASK_TIMER_HISTOGRAM_HPP
@@ -0,0 +1,122 @@
+#include <odrive_main.h>
+
+#include <fibre/../../legacy_protocol.hpp>
+#include <fibre/simple_serdes.hpp>
+
+static constexpr uint32_t kLoopPeriodUs = 1000000 / current_meas_hz;
+
+bool Telemetry::start() {
+    stop();
+
+    uint32_t sample_size = 0;
+    for (uint32_t bit = 1; bit <= TELEMETRY_SIGNAL_VBUS; bit <<= 1) {
+        if (config_.signals & bit) {
+            sample_size += 4;
+        }
+    }
+    if (!sample_size) {
+        return false;
+    }
+
+    signals_ = config_.signals;
+    decimation_ = std::clamp<uint32_t>(config_.decimation, 1, UINT16_MAX / kLoopPeriodUs);
+    sample_size_ = sample_size;
+    samples_per_frame_ = (kFrameSize - kHeaderSize) / sample_size;
+    frame_size_ = kHeaderSize + samples_per_frame_ * sample_size;
+    countdown_ = 0;
+    n_samples_ = 0;
+    n_frames_ = 0;
+    n_dropped_ = 0;
+
+    CRITICAL_SECTION() {
+        active_ = true;
+    }
+    return true;
+}
+
+void Telemetry::stop() {
+    CRITICAL_SECTION() {
+        active_ = false;
+    }
+}
+
+void Telemetry::write_sample(uint8_t* buf) {
+    for (size_t i = 0; i < AXIS_COUNT; ++i) {
+        Axis& axis = axes[i];
+        uint32_t shift = 4 * i;
+        if (signals_ & (TELEMETRY_SIGNAL_AXIS0_POS << shift)) {
+            buf += write_le<float>(axis.encoder_.pos_estimate_.any().value_or(NAN), buf);
+        }
+        if (signals_ & (TELEMETRY_SIGNAL_AXIS0_VEL << shift)) {
+            buf += write_le<float>(axis.encoder_.vel_estimate_.any().value_or(NAN), buf);
+        }
+        if (signals_ & (TELEMETRY_SIGNAL_AXIS0_IQ << shift)) {
+            buf += write_le<float>(axis.motor_.current_control_.Iq_measured_, buf);
+        }
+        if (signals_ & (TELEMETRY_SIGNAL_AXIS0_ERROR << shift)) {
+            buf += write_le<uint32_t>(axis.error_, buf);
+        }
+    }
+    if (signals_ & TELEMETRY_SIGNAL_VBUS) {
+        buf += write_le<float>(odrv.vbus_voltage_, buf);
+    }
+}
+
+void Telemetry::update() {
+    if (!active_) {
+        return;
+    }
+    if (countdown_) {
+        countdown_--;
+        return;
+    }
+    countdown_ = decimation_ - 1;
+
+    Frame_t& frame = frames_[write_frame_];
+
+    if (!n_samples_) {
+        dropping_ = (frame.state.load(std::memory_order_acquire) != kFree);
+        if (!dropping_) {
+            frame.size = frame_size_;
+            uint8_t* header = frame.buf;
+            header += write_le<uint16_t>(fibre::STREAM_PACKET_MARKER, header);
+            header += write_le<uint16_t>(seqno_, header);
+            header += write_le<uint32_t>(odrv.n_evt_control_loop_ * kLoopPeriodUs, header);
+            header += write_le<uint16_t>(signals_, header);
+            header += write_le<uint16_t>(decimation_ * kLoopPeriodUs, header);
+        }
+    }
+
+    if (!dropping_) {
+        write_sample(&frame.buf[kHeaderSize + n_samples_ * sample_size_]);
+    }
+
+    if (++n_samples_ < samples_per_frame_) {
+        return;
+    }
+
+    n_samples_ = 0;
+    seqno_++;
+    if (dropping_) {
+        n_dropped_++;
+    } else {
+        frame.state.store(kReady, std::memory_order_release);
+        write_frame_ ^= 1;
+        n_frames_++;
+    }
+    usb_notify_telemetry(); // also when dropping, in case a notification got lost
+}
+
+fibre::cbufptr_t Telemetry::get_frame() {
+    Frame_t& frame = frames_[read_frame_];
+    if (frame.state.load(std::memory_order_acquire) != kReady) {
+        return {nullptr, nullptr};
+    }
+    frame.state.store(kSending, std::memory_order_relaxed);
+    return {frame.buf, frame.size};
+}
+
+void Telemetry::release_frame() {
+    frames_[read_frame_].state.store(kFree, std::memory_order_release);
+    read_frame_ ^= 1;
+}
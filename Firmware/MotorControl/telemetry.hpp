@@ -0,0 +1,88 @@
+#ifndef __TELEMETRY_HPP
+#define __TELEMETRY_HPP
+
+#include <autogen/interfaces.hpp>
+#include <fibre/bufptr.hpp>
+
+#include <atomic>
+
+/**
+ * @brief Streams a configurable set of signals from the control loop to the
+ * host without being polled.
+ *
+ * Every config_.decimation-th control loop iteration, update() appends one
+ * sample (one value per selected signal) to the current frame. Full frames are
+ * handed to the USB thread which sends them as stream packets on the native
+ * interface (see docs/protocol.md). A frame holds as many samples as fit into
+ * one USB packet.
+ *
+ * There are two frame buffers. The control loop writes directly into the free
+ * buffer, which is then transmitted in place. If neither buffer is free when a
+ * new frame starts (because USB didn't keep up), that frame is dropped. The
+ * sequence number still advances so the host can see the gap.
+ *
+ * Frame layout (little endian):
+ *  - uint16 stream packet marker (fibre::STREAM_PACKET_MARKER)
+ *  - uint16 sequence number
+ *  - uint32 timestamp of the first sample [us]
+ *  - uint16 selected signals (TelemetrySignal flags)
+ *  - uint16 interval between samples [us]
+ *  - samples, each with the selected signals in ascending bit order. Errors
+ *    are uint32, all other signals are float32.
+ */
+class Telemetry : public ODriveIntf::TelemetryIntf {
+public:
+    static constexpr size_t kFrameSize = 63; // must be smaller than one USB packet (see interface_usb.cpp)
+    static constexpr size_t kHeaderSize = 12;
+
+    struct Config_t {
+        TelemetrySignal signals = TELEMETRY_SIGNAL_AXIS0_POS | TELEMETRY_SIGNAL_AXIS0_VEL;
+        uint32_t decimation = 8; // [control loop iterations] per sample
+    };
+
+    bool start() override;
+    void stop() override;
+
+    void update();
+
+    // Called by the USB thread. Returns the next full frame or an empty buffer
+    // if there is none. Each frame must be released with release_frame() once
+    // it was sent.
+    fibre::cbufptr_t get_frame();
+    void release_frame();
+
+    Config_t config_;
+    bool active_ = false;
+    uint32_t frame_size_ = 0; // [bytes]
+    uint32_t n_frames_ = 0;
+    uint32_t n_dropped_ = 0;
+
+private:
+    enum FrameState : uint8_t { kFree, kReady, kSending };
+
+    struct Frame_t {
+        uint8_t buf[kFrameSize];
+        size_t size = 0; // [bytes] depends on the signals at the time the frame was written
+        // Hands buf and size over between the control loop and the USB thread
+        std::atomic<FrameState> state = kFree;
+    };
+
+    void write_sample(uint8_t* buf);
+
+    Frame_t frames_[2];
+    size_t write_frame_ = 0; // frame that the control loop fills next
+    size_t read_frame_ = 0;  // frame that the USB thread sends next
+
+    TelemetrySignal signals_;
+    uint32_t decimation_ = 1;
+    uint32_t samples_per_frame_ = 0;
+    uint32_t sample_size_ = 0; // [bytes]
+
+    // State of the frame that is being filled
+    uint32_t countdown_ = 0;   // Control loop iterations until the next sample
+    uint32_t n_samples_ = 0;   // Samples in the current frame
+    uint16_t seqno_ = 0;
+    bool dropping_ = false;    // No buffer was free when the current frame started
+};
+
+#endif // __TELEMETRY_HPP
@@ -0,0 +1,24 @@
+#include <odrive_main.h>
+
+Trace trace;
+
+void Trace::start() {
+    CRITICAL_SECTION() {
+        enabled_ = false;
+    }
+    buffer_.reset();
+    CRITICAL_SECTION() {
+        enabled_ = true;
+    }
+}
+
+void Trace::stop() {
+    buffer_.stop_after(0);
+}
+
+uint32_t Trace::read_block(uint32_t offset, uint32_t* values, uint32_t count) {
+    if (!buffer_.is_stopped()) {
+        return 0;
+    }
+    return buffer_.read(offset, values, count);
+}
@@ -0,0 +1,70 @@
+#ifndef __TRACE_HPP
+#define __TRACE_HPP
+
+#include <board.h>
+#include <autogen/interfaces.hpp>
+#include "trace_buffer.hpp"
+
+// Number of events that the trace holds (8 bytes each). Must be a power of two.
+// If you use the trace feature you can bump up this value.
+#define TRACE_SIZE 1024
+
+/**
+ * @brief Records timestamped events from interrupts and threads so that the
+ * host can show them on one timeline.
+ *
+ * Every TaskTimer (and thus every MEASURE_TIME scope) records a begin and an
+ * end event with its trace_id_ as source, plus an overrun event when it
+ * exceeds its budget. The USB and CAN handlers and the axis state machine
+ * record events with fixed sources (see TraceSource).
+ *
+ * An event costs two words in the buffer: the value of board_trace_counter
+ * and an info word with the source in bits 0-15, the TraceEventType in bits
+ * 16-23 and an argument in bits 24-31 (e.g. the new axis state).
+ *
+ * Recording costs a few cycles per event and nothing while the trace is not
+ * started. odrive.utils.dump_trace() downloads the trace and converts it to
+ * the Chrome trace format.
+ */
+class Trace : public ODriveIntf::TraceIntf {
+public:
+    struct Config_t {
+        bool stop_on_overrun = false;
+        uint32_t post_trigger = TRACE_SIZE / 2; // [events] recorded after the overrun
+    };
+
+    void start() override;
+    void stop() override;
+    uint32_t read_block(uint32_t offset, uint32_t* values, uint32_t count) override;
+
+    bool is_active() const { return enabled_ && !buffer_.is_stopped(); }
+    uint32_t get_n_events() const { return buffer_.get_n_events(); }
+
+    void begin(uint16_t source, uint8_t arg = 0) { record(TRACE_EVENT_TYPE_BEGIN, source, arg); }
+    void end(uint16_t source, uint8_t arg = 0) { record(TRACE_EVENT_TYPE_END, source, arg); }
+    void instant(uint16_t source, uint8_t arg = 0) { record(TRACE_EVENT_TYPE_INSTANT, source, arg); }
+
+    void overrun(uint16_t source) {
+        record(TRACE_EVENT_TYPE_OVERRUN, source, 0);
+        if (enabled_ && config_.stop_on_overrun) {
+            buffer_.stop_after(config_.post_trigger);
+        }
+    }
+
+    Config_t config_;
+    uint32_t timestamp_hz_ = board_trace_counter_hz;
+
+private:
+    void record(TraceEventType type, uint16_t source, uint8_t arg) {
+        if (enabled_) {
+            buffer_.write(board_trace_counter, (uint32_t)source | ((uint32_t)type << 16) | ((uint32_t)arg << 24));
+        }
+    }
+
+    bool enabled_ = false;
+    TraceBuffer<TRACE_SIZE> buffer_;
+};
+
+extern Trace trace; // defined in trace.cpp
+
+#endif // __TRACE_HPP
@@ -0,0 +1,114 @@
+#ifndef __TRACE_BUFFER_HPP
+#define __TRACE_BUFFER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+
+/**
+ * @brief Ring buffer of timestamped events that interrupts and threads of any
+ * priority on the same core can write to without disabling interrupts.
+ *
+ * A writer reserves a slot by atomically incrementing the write index and then
+ * fills it. A writer that preempts another writer between these two steps
+ * takes the next slot, so neighbouring events can be slightly out of order
+ * with respect to their timestamps. Readers must sort them.
+ *
+ * When the buffer is full, the oldest events are overwritten. stop_after()
+ * freezes the buffer once a given number of further events were written, e.g.
+ * to keep the history before and after an overrun. The buffer should only be
+ * read once it is stopped (see is_stopped()). A writer that was preempted by
+ * the reader between reserving and filling its slot can still leave one stale
+ * event in this case.
+ */
+template<size_t kSize>
+class TraceBuffer {
+public:
+    static_assert((kSize & (kSize - 1)) == 0, "size must be a power of two");
+
+    static constexpr size_t kWordsPerEvent = 2;
+
+    struct Event_t {
+        uint32_t timestamp;
+        uint32_t info;
+    };
+
+    /**
+     * @brief Discards all events and starts recording. Must not be called
+     * while another context might write.
+     */
+    void reset() {
+        stopping_.store(false, std::memory_order_relaxed);
+        stop_index_ = 0;
+        write_index_.store(0, std::memory_order_release);
+    }
+
+    void write(uint32_t timestamp, uint32_t info) {
+        if (is_stopped()) {
+            return; // don't let the index run away while stopped
+        }
+        uint32_t index = write_index_.fetch_add(1, std::memory_order_relaxed);
+        if (stopping_.load(std::memory_order_acquire) && (int32_t)(index - stop_index_) >= 0) {
+            return;
+        }
+        events_[index & (kSize - 1)] = {timestamp, info};
+    }
+
+    /**
+     * @brief Stops recording after n_events more events. If the buffer is
+     * already stopping, the earlier stop index is kept.
+     */
+    void stop_after(uint32_t n_events) {
+        if (!stopping_.load(std::memory_order_acquire)) {
+            stop_index_ = write_index_.load(std::memory_order_relaxed) + n_events;
+            stopping_.store(true, std::memory_order_release);
+        }
+    }
+
+    bool is_stopped() const {
+        return stopping_.load(std::memory_order_acquire)
+            && (int32_t)(write_index_.load(std::memory_order_relaxed) - stop_index_) >= 0;
+    }
+
+    /**
+     * @brief Returns the number of events that were recorded since reset(),
+     * including the ones that were overwritten.
+     */
+    uint32_t get_n_events() const {
+        uint32_t n_events = write_index_.load(std::memory_order_acquire);
+        if (stopping_.load(std::memory_order_acquire) && (int32_t)(n_events - stop_index_) > 0) {
+            n_events = stop_index_;
+        }
+        return n_events;
+    }
+
+    /**
+     * @brief Copies up to `count` words starting at word `offset`, where word
+     * 0 is the timestamp of the oldest event that is still in the buffer.
+     * Each event consists of kWordsPerEvent words (see Event_t). Returns the
+     * number of words copied.
+     */
+    uint32_t read(uint32_t offset, uint32_t* values, uint32_t count) const {
+        uint32_t n_events = get_n_events();
+        uint32_t first = n_events - std::min<uint32_t>(n_events, kSize);
+        uint32_t size = (n_events - first) * kWordsPerEvent;
+        if (offset >= size) {
+            return 0;
+        }
+        count = std::min(count, size - offset);
+        for (uint32_t i = 0; i < count; ++i) {
+            const Event_t& event = events_[(first + (offset + i) / kWordsPerEvent) & (kSize - 1)];
+            values[i] = ((offset + i) % kWordsPerEvent) ? event.info : event.timestamp;
+        }
+        return count;
+    }
+
+private:
+    Event_t events_[kSize] = {};
+    std::atomic<uint32_t> write_index_{0};
+    std::atomic<bool> stopping_{false};
+    uint32_t stop_index_ = 0; // only valid while stopping_ is set
+};
+
+#endif // __TRACE_BUFFER_HPP
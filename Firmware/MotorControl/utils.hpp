@@ -75,6 +75,7 @@ void delay_us(uint32_t us);
 extern "C" {
 float our_arm_sin_f32(float x);
 float our_arm_cos_f32(float x);
+void our_arm_sin_cos_f32(float x, float* sin_val, float* cos_val);
 }
 
 // ----------------
@@ -140,6 +141,22 @@ inline float wrap_pm_pi(float x) {
     return wrap_pm(x, 2 * M_PI);
 }
 
+// Largest angle for which rotate_sin_cos() is at least as accurate as the
+// sine table lookup
+constexpr float rotate_sin_cos_max_delta = 0.25f; // [rad]
+
+// Rotates a sine/cosine pair by a small angle: Given s = sin(x) and
+// c = cos(x), this returns sin(x + delta) and cos(x + delta) without a table
+// lookup. The sine and cosine of delta are approximated by their Taylor
+// series, so |delta| should not exceed rotate_sin_cos_max_delta.
+inline void rotate_sin_cos(float s, float c, float delta, float* sin_val, float* cos_val) {
+    float delta_sq = delta * delta;
+    float s_d = delta * (1.0f - delta_sq * (1.0f / 6.0f));
+    float c_d = 1.0f - delta_sq * (0.5f - delta_sq * (1.0f / 24.0f));
+    *sin_val = s * c_d + c * s_d;
+    *cos_val = c * c_d - s * s_d;
+}
+
 // Evaluate polynomials in an efficient way
 // coeffs[0] is highest order, as per numpy.polyfit
 // p(x) = coeffs[0] * x^deg + ... + coeffs[deg], for some degree "deg"
@@ -0,0 +1,106 @@
+#ifndef __TESTS_FAKE_CHANNEL_HPP
+#define __TESTS_FAKE_CHANNEL_HPP
+
+#include <fibre/async_stream.hpp>
+#include <fibre/simple_serdes.hpp>
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief Takes the place of the USB endpoints below a
+ * LegacyProtocolPacketBased.
+ *
+ * Transfers only complete when the test calls finish_write(), receive() or
+ * close(), so the test decides in which order things happen.
+ */
+class FakeChannel : public fibre::AsyncStreamSource, public fibre::AsyncStreamSink {
+public:
+    void start_read(fibre::bufptr_t buffer, fibre::TransferHandle* handle, fibre::Callback<void, fibre::ReadResult> completer) final {
+        read_buf_ = buffer;
+        read_completer_ = completer;
+        if (handle) {
+            *handle = 1;
+        }
+    }
+
+    void cancel_read(fibre::TransferHandle transfer_handle) final {
+        read_completer_.invoke_and_clear({fibre::kStreamCancelled, read_buf_.begin()});
+    }
+
+    void start_write(fibre::cbufptr_t buffer, fibre::TransferHandle* handle, fibre::Callback<void, fibre::WriteResult> completer) final {
+        packet_.assign(buffer.begin(), buffer.end());
+        write_buf_ = buffer;
+        write_completer_ = completer;
+        if (handle) {
+            *handle = 1;
+        }
+    }
+
+    void cancel_write(fibre::TransferHandle transfer_handle) final {
+        write_completer_.invoke_and_clear({fibre::kStreamCancelled, write_buf_.begin()});
+    }
+
+    // True while a write is waiting for finish_write()
+    bool writing() {
+        return write_completer_;
+    }
+
+    // The packet of the ongoing write
+    const std::vector<uint8_t>& packet() const {
+        return packet_;
+    }
+
+    void finish_write(fibre::StreamStatus status = fibre::kStreamOk) {
+        write_completer_.invoke_and_clear({status, write_buf_.end()});
+    }
+
+    // Completes the ongoing read with the specified packet
+    void receive(const std::vector<uint8_t>& packet) {
+        size_t n_copy = std::min(packet.size(), read_buf_.size());
+        memcpy(read_buf_.begin(), packet.data(), n_copy);
+        read_completer_.invoke_and_clear({fibre::kStreamOk, read_buf_.begin() + n_copy});
+    }
+
+    void close() {
+        read_completer_.invoke_and_clear({fibre::kStreamClosed, read_buf_.begin()});
+    }
+
+private:
+    fibre::bufptr_t read_buf_ = {nullptr, nullptr};
+    fibre::Callback<void, fibre::ReadResult> read_completer_;
+    fibre::cbufptr_t write_buf_ = {nullptr, nullptr};
+    fibre::Callback<void, fibre::WriteResult> write_completer_;
+    std::vector<uint8_t> packet_;
+};
+
+/**
+ * @brief Plays the device for every request that the protocol sends until it
+ * stops sending.
+ *
+ * handler(endpoint_id, input, output) runs the endpoint operation and returns
+ * the number of bytes it wrote to output.
+ */
+template<typename THandler>
+void serve(FakeChannel& channel, THandler handler) {
+    while (channel.writing()) {
+        std::vector<uint8_t> request = channel.packet();
+        channel.finish_write();
+
+        // [seqno, endpoint ID | 0x8000, expected response length, payload, trailer]
+        fibre::cbufptr_t buf = {request.data(), request.data() + request.size()};
+        uint16_t seqno = *read_le<uint16_t>(&buf);
+        uint16_t endpoint_id = *read_le<uint16_t>(&buf) & 0x7fff;
+        uint16_t response_length = *read_le<uint16_t>(&buf);
+        fibre::cbufptr_t input = {buf.begin(), buf.end() - 2};
+
+        std::vector<uint8_t> response(2 + response_length);
+        write_le<uint16_t>(seqno | 0x8000, response.data());
+        size_t n_output = handler(endpoint_id, input, fibre::bufptr_t{response.data() + 2, response_length});
+        response.resize(2 + n_output);
+        channel.receive(response);
+    }
+}
+
+#endif // __TESTS_FAKE_CHANNEL_HPP
@@ -0,0 +1,148 @@
+
+#include <doctest.h>
+#include "MotorControl/cogging_map.hpp"
+
+#include <cmath>
+
+// The firmware uses a table based implementation (arm_sin_cos_f32.c) which
+// is not built for the tests.
+void our_arm_sin_cos_f32(float x, float* sin_val, float* cos_val) {
+    *sin_val = std::sin(x);
+    *cos_val = std::cos(x);
+}
+
+TEST_SUITE("Cogging Map") {
+    TEST_CASE("empty") {
+        CoggingMap_t map;
+        CHECK(map.eval(0.3f) == 0.0f);
+
+        CoggingFit fit;
+        CHECK(!fit.fit(&map));
+    }
+
+    TEST_CASE("eval") {
+        CoggingMap_t map;
+        map.offset = 0.1f;
+        map.harmonics[0] = {2, 0.5f, 0.0f};
+        map.harmonics[1] = {7, 0.0f, 0.25f};
+
+        for (float pos: {0.0f, 0.1f, 0.375f, 0.9f}) {
+            float expected = 0.1f + 0.5f * std::cos(2.0f * M_PI * 2 * pos)
+                           + 0.25f * std::sin(2.0f * M_PI * 7 * pos);
+            CHECK(map.eval(pos) == doctest::Approx(expected).epsilon(1e-4));
+            CHECK(map.eval(pos + 3.0f) == doctest::Approx(expected).epsilon(1e-4));
+            CHECK(map.eval(pos - 2.0f) == doctest::Approx(expected).epsilon(1e-4));
+        }
+    }
+
+    TEST_CASE("fit") {
+        // Cogging torque of a motor with 12 slots and 7 pole pairs
+        auto cogging = [](float pos) {
+            float x = 2.0f * M_PI * pos;
+            return 0.02f + 0.1f * std::sin(84 * x + 0.3f)
+                 + 0.04f * std::cos(12 * x) + 0.01f * std::sin(168 * x - 1.0f);
+        };
+
+        const size_t n_samples = 3600;
+        CoggingFit fit;
+        for (size_t i = 0; i < n_samples; ++i) {
+            float pos = (float)i / (float)n_samples;
+            fit.add_sample(pos, cogging(pos));
+        }
+        CHECK(fit.n_samples() == n_samples);
+
+        CoggingMap_t map;
+        REQUIRE(fit.fit(&map));
+        CHECK(map.offset == doctest::Approx(0.02f).epsilon(1e-3));
+
+        // The strongest harmonics are sorted by order and the unused entries
+        // are at the end.
+        CHECK(map.harmonics[0].order == 12);
+        CHECK(map.harmonics[0].cos_coeff == doctest::Approx(0.04f).epsilon(1e-2));
+        for (size_t i = 1; i < map.harmonics.size(); ++i) {
+            CHECK((!map.harmonics[i].order || map.harmonics[i].order > map.harmonics[i - 1].order));
+        }
+
+        float max_err = 0.0f;
+        for (size_t i = 0; i < 1000; ++i) {
+            float pos = (float)i / 997.0f;
+            max_err = std::max(max_err, std::abs(map.eval(pos) - cogging(pos)));
+        }
+        CHECK(max_err < 0.002f);
+    }
+
+    TEST_CASE("sample-queue") {
+        CoggingSampleQueue queue;
+        CoggingSampleQueue::Sample_t sample;
+        CHECK(!queue.pop(&sample));
+
+        // Go around the ring a few times
+        for (size_t round = 0; round < 3; ++round) {
+            for (size_t i = 0; i < CoggingSampleQueue::kCapacity; ++i) {
+                CHECK(queue.push({(float)i, (float)round}));
+            }
+            CHECK(!queue.push({0.0f, 0.0f}));
+            for (size_t i = 0; i < CoggingSampleQueue::kCapacity; ++i) {
+                REQUIRE(queue.pop(&sample));
+                CHECK(sample.pos == (float)i);
+                CHECK(sample.torque == (float)round);
+            }
+            CHECK(!queue.pop(&sample));
+        }
+
+        CHECK(queue.push({1.0f, 2.0f}));
+        queue.reset();
+        CHECK(!queue.pop(&sample));
+    }
+
+    TEST_CASE("sweep") {
+        auto cogging = [](float pos) {
+            float x = 2.0f * M_PI * pos;
+            return 0.05f * std::sin(84 * x) + 0.02f * std::cos(12 * x);
+        };
+        const float friction = 0.03f;
+
+        // Two turns in each direction with an offset start and a slight
+        // direction dependent lag.
+        CoggingSweep sweep;
+        const size_t n_steps = 40000;
+        for (size_t i = 0; i < n_steps; ++i) {
+            float pos = -0.3f + 2.0f * (float)i / (float)n_steps;
+            sweep.add_sample(pos, cogging(pos - 0.0001f) + friction, true);
+            sweep.add_sample(pos, cogging(pos + 0.0001f) - friction, false);
+        }
+        REQUIRE(sweep.complete());
+
+        CoggingFit fit;
+        size_t n_bins = 0;
+        while (!sweep.fit_next(&fit)) {
+            n_bins++;
+        }
+        CHECK(n_bins + 1 == CoggingSweep::kBins);
+        CHECK(fit.n_samples() == CoggingSweep::kBins);
+
+        CoggingMap_t map;
+        REQUIRE(fit.fit(&map));
+        CHECK(std::abs(map.offset) < 1e-4f);
+        for (size_t i = 0; i < 100; ++i) {
+            float pos = (float)i / 97.0f;
+            CHECK(map.eval(pos) == doctest::Approx(cogging(pos)).epsilon(0.05).scale(0.05));
+        }
+
+        CoggingSweep::Stats_t stats = sweep.stats(map);
+        CHECK(stats.n_samples == 2 * n_steps);
+        CHECK(stats.min_bin_samples >= 70);
+        CHECK(stats.friction_torque == doctest::Approx(friction).epsilon(1e-3));
+        CHECK(stats.cogging_rms == doctest::Approx(std::sqrt((0.05f * 0.05f + 0.02f * 0.02f) / 2.0f)).epsilon(0.01));
+        CHECK(stats.direction_mismatch_rms < 0.1f * stats.cogging_rms);
+        CHECK(stats.fit_residual_rms < 0.01f * stats.cogging_rms);
+    }
+
+    TEST_CASE("sweep-incomplete") {
+        CoggingSweep sweep;
+        sweep.add_sample(0.5f, 1.0f, true);
+        sweep.add_sample(0.5f, 1.0f, false);
+        CHECK(!sweep.complete());
+        CHECK(sweep.stats(CoggingMap_t{}).min_bin_samples == 0);
+    }
+}
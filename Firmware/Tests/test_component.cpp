@@ -0,0 +1,39 @@
+#include <doctest.h>
+#include "MotorControl/component.hpp"
+#include <stdint.h>
+
+TEST_CASE("OutputPort freshness") {
+    OutputPort<float> output = 1.0f;
+    InputPort<float> input;
+    input.connect_to(&output);
+
+    // The initialization value is only available through any()
+    CHECK(!output.present().has_value());
+    CHECK(!output.previous().has_value());
+    CHECK(output.any() == 1.0f);
+    CHECK(!input.present().has_value());
+
+    control_loop_epoch++;
+    output = 2.0f;
+    CHECK(output.present() == 2.0f);
+    CHECK(input.present() == 2.0f);
+    CHECK(!output.previous().has_value());
+
+    control_loop_epoch++;
+    CHECK(!output.present().has_value());
+    CHECK(!input.present().has_value());
+    CHECK(output.previous() == 2.0f);
+    CHECK(input.any() == 2.0f);
+
+    control_loop_epoch++;
+    CHECK(!output.present().has_value());
+    CHECK(!output.previous().has_value());
+
+    SUBCASE("epoch overflow") {
+        control_loop_epoch = UINT32_MAX;
+        output = 3.0f;
+        control_loop_epoch++;
+        CHECK(!output.present().has_value());
+        CHECK(output.previous() == 3.0f);
+    }
+}
@@ -0,0 +1,375 @@
+#include <doctest.h>
+
+// The client is compiled into the test and runs on top of the protocol from
+// test_legacy_protocol.cpp. serve() plays the device.
+#define FIBRE_ENABLE_CLIENT 1
+#define FIBRE_MAX_LOG_VERBOSITY 0
+#include "fibre-cpp/legacy_object_client.cpp"
+#include "fake_channel.hpp"
+
+#include <string.h>
+#include <vector>
+
+using namespace fibre;
+
+namespace {
+
+// A protocol instance with a root object and without discovery
+struct Connection {
+    FakeChannel channel;
+    LegacyProtocolPacketBased protocol{&channel, &channel, 64};
+    LegacyObject obj{&protocol.client_, 0, nullptr, false};
+
+    Connection() {
+        protocol.start(nullptr, nullptr, nullptr);
+    }
+
+    // Calls func with the encoded input arguments args and lets handler serve
+    // the endpoint operations that this causes. Returns the result of the
+    // call.
+    template<typename THandler>
+    CallBufferRelease call(LegacyFunction& func, std::vector<uint8_t> args, bufptr_t rx_buf, THandler handler) {
+        std::vector<uint8_t> tx_buf(sizeof(uintptr_t));
+        LegacyObject* obj_ptr = &obj;
+        memcpy(tx_buf.data(), &obj_ptr, sizeof(obj_ptr));
+        tx_buf.insert(tx_buf.end(), args.begin(), args.end());
+
+        std::optional<CallBufferRelease> result;
+        auto on_finished = [&result](CallBufferRelease release) -> std::optional<CallBuffers> {
+            result = release;
+            return std::nullopt;
+        };
+
+        void* handle = nullptr;
+        std::optional<CallBufferRelease> sync_result = func.call(&handle,
+            {kFibreClosed, tx_buf, rx_buf}, on_finished);
+        if (sync_result.has_value()) {
+            result = sync_result;
+        }
+        serve(channel, handler);
+        delete reinterpret_cast<LegacyCallContext*>(handle);
+
+        REQUIRE(result.has_value());
+        CHECK(result->tx_end == tx_buf.data() + tx_buf.size());
+        return *result;
+    }
+};
+
+// Serves block reads on endpoint 42 like a function whose element i is the
+// value i and of which only the first n_available elements exist.
+struct BlockDevice {
+    size_t n_available;
+    size_t n_requests = 0;
+    uint16_t endpoint_id = 0;
+    uint32_t offset = 0;
+    uint32_t count = 0;
+
+    size_t operator()(uint16_t ep, cbufptr_t input, bufptr_t output) {
+        n_requests++;
+        endpoint_id = ep;
+        offset = *read_le<uint32_t>(&input);
+        count = *read_le<uint32_t>(&input);
+
+        uint8_t* output_end = output.begin();
+        for (size_t i = offset; i < offset + count && i < n_available && output_end + 4 <= output.end(); ++i) {
+            float value = (float)i;
+            memcpy(output_end, &value, sizeof(value));
+            output_end += sizeof(value);
+        }
+        return output_end - output.begin();
+    }
+};
+
+// Serves a function on endpoint 12 that takes a and b as inputs on endpoints
+// 10 and 11 and returns their sum and product as outputs on endpoints 13 and
+// 14. Call requests are only understood if call_supported is set.
+struct CallDevice {
+    bool call_supported = true;
+    uint8_t call_status = 1;
+    uint32_t a = 0;
+    uint32_t b = 0;
+    std::vector<uint16_t> endpoints;
+    std::vector<uint8_t> call_input;
+
+    uint32_t sum() { return a + b; }
+    uint16_t product() { return (uint16_t)(a * b); }
+
+    size_t operator()(uint16_t ep, cbufptr_t input, bufptr_t output) {
+        endpoints.push_back(ep);
+        switch (ep) {
+            case CALL_ENDPOINT_ID: {
+                if (!call_supported) {
+                    return 0;
+                }
+                call_input.assign(input.begin(), input.end());
+                uint16_t func_ep = *read_le<uint16_t>(&input);
+                if (func_ep != 12) {
+                    return 0;
+                }
+                a = *read_le<uint32_t>(&input);
+                b = *read_le<uint32_t>(&input);
+                output[0] = call_status;
+                write_le<uint32_t>(sum(), output.begin() + 1);
+                write_le<uint16_t>(product(), output.begin() + 5);
+                return 7;
+            }
+            case 10: a = *read_le<uint32_t>(&input); return 0;
+            case 11: b = *read_le<uint32_t>(&input); return 0;
+            case 12: return 0;
+            case 13: write_le<uint32_t>(sum(), output.begin()); return 4;
+            case 14: write_le<uint16_t>(product(), output.begin()); return 2;
+            default: return 0;
+        }
+    }
+};
+
+// Serves batch requests like batch_endpoint_handler() but with a response
+// buffer of only max_response bytes. Endpoint i outside of a batch is a
+// uint32 property with the value 1000 + i. Endpoint 0 serves a JSON definition
+// with an empty root object.
+struct BatchDevice {
+    bool batch_supported = true;
+    size_t max_response = 62;
+    std::vector<uint16_t> endpoints; // endpoints of the requests
+    std::vector<size_t> n_run; // number of entries run per batch request
+    std::vector<uint8_t> batch_input; // payload of the last batch request
+
+    size_t run(uint16_t ep, bufptr_t output) {
+        if (ep == CALL_ENDPOINT_ID || output.size() < 4) {
+            return 0;
+        }
+        write_le<uint32_t>(1000 + ep, output.begin());
+        return 4;
+    }
+
+    size_t operator()(uint16_t ep, cbufptr_t input, bufptr_t output) {
+        endpoints.push_back(ep);
+
+        if (ep == 0) {
+            const char json[] = "[]";
+            uint32_t offset = *read_le<uint32_t>(&input);
+            if (offset >= sizeof(json) - 1) {
+                return 0; // also for the version ID and the compression info
+            }
+            memcpy(output.begin(), json + offset, sizeof(json) - 1 - offset);
+            return sizeof(json) - 1 - offset;
+        } else if (ep != BATCH_ENDPOINT_ID) {
+            return run(ep, output);
+        } else if (!batch_supported) {
+            return 0;
+        }
+
+        batch_input.assign(input.begin(), input.end());
+        bufptr_t response = output.take(max_response);
+        n_run.push_back(0);
+        while (input.size()) {
+            uint16_t entry_ep = *read_le<uint16_t>(&input);
+            uint8_t input_length = *read_le<uint8_t>(&input);
+            uint8_t output_length = *read_le<uint8_t>(&input);
+            if (response.size() < 1 + (size_t)output_length) {
+                break;
+            }
+            input = input.skip(input_length);
+            size_t n_written = run(entry_ep, response.skip(1).take(output_length));
+            response[0] = (uint8_t)n_written;
+            response = response.skip(1 + n_written);
+            n_run.back()++;
+        }
+        return response.begin() - output.begin();
+    }
+};
+
+}
+
+// Calls read_block(offset, count) and returns the number of elements received
+static size_t read_block(BlockDevice& device, uint32_t offset, uint32_t count, float* values, size_t max_values) {
+    Connection connection;
+    LegacyFunction func{42, &connection.obj,
+        {{"offset", "uint32", "uint32", 4, 4, 0}, {"count", "uint32", "uint32", 4, 4, 0}},
+        {{"values", "float[]", "float[]", 0, 0, 0}}};
+
+    std::vector<uint8_t> args(8);
+    write_le<uint32_t>(offset, args.data());
+    write_le<uint32_t>(count, args.data() + 4);
+
+    CallBufferRelease result = connection.call(func, args,
+        {(uint8_t*)values, max_values * sizeof(float)}, std::ref(device));
+    CHECK(result.status == kFibreClosed);
+    return (result.rx_end - (uint8_t*)values) / sizeof(float);
+}
+
+// Calls the function of CallDevice and checks the outputs if the call succeeds
+static Status call_sum(Connection& connection, CallDevice& device, uint32_t a, uint32_t b) {
+    LegacyFunction func{12, &connection.obj,
+        {{"a", "uint32", "uint32", 4, 4, 10}, {"b", "uint32", "uint32", 4, 4, 11}},
+        {{"sum", "uint32", "uint32", 4, 4, 13}, {"product", "uint16", "uint16", 2, 2, 14}}};
+
+    std::vector<uint8_t> args(8);
+    write_le<uint32_t>(a, args.data());
+    write_le<uint32_t>(b, args.data() + 4);
+
+    uint8_t outputs[6] = {0};
+    CallBufferRelease result = connection.call(func, args, outputs, std::ref(device));
+    if (result.status == kFibreClosed) {
+        CHECK(result.rx_end == outputs + 6);
+        cbufptr_t output_buf = outputs;
+        CHECK(*read_le<uint32_t>(&output_buf) == a + b);
+        CHECK(*read_le<uint16_t>(&output_buf) == (uint16_t)(a * b));
+    }
+    return result.status;
+}
+
+// Reads endpoints 1 to n_items with one batch and checks the values
+static void read_batch(Connection& connection, BatchDevice& device, size_t n_items) {
+    std::vector<uint8_t> values(4 * n_items);
+    std::vector<LegacyBatchItem> items;
+    for (size_t i = 0; i < n_items; ++i) {
+        items.push_back({i + 1, {}, {values.data() + 4 * i, 4}});
+    }
+
+    std::optional<StreamStatus> status;
+    auto on_finished = [&status](StreamStatus result) { status = result; };
+    connection.protocol.client_.start_batch(items.data(), items.size(), on_finished);
+    serve(connection.channel, std::ref(device));
+
+    REQUIRE(status.has_value());
+    CHECK(*status == kStreamOk);
+    for (size_t i = 0; i < n_items; ++i) {
+        CAPTURE(i);
+        CHECK(items[i].rx_buf.size() == 0);
+        cbufptr_t value = {values.data() + 4 * i, 4};
+        CHECK(*read_le<uint32_t>(&value) == 1001 + i);
+    }
+}
+
+TEST_SUITE("Legacy Object Client") {
+    TEST_CASE("block read") {
+        BlockDevice device{1000};
+        float values[16];
+        CHECK(read_block(device, 100, 5, values, 16) == 5);
+        CHECK(device.n_requests == 1);
+        CHECK(device.endpoint_id == 42);
+        CHECK(device.offset == 100);
+        CHECK(device.count == 5);
+        for (size_t i = 0; i < 5; ++i) {
+            CHECK(values[i] == (float)(100 + i));
+        }
+    }
+
+    TEST_CASE("block read past the end") {
+        BlockDevice device{10};
+        float values[16];
+        CHECK(read_block(device, 7, 8, values, 16) == 3);
+        CHECK(device.offset == 7);
+        CHECK(device.count == 8);
+        CHECK(values[0] == 7.0f);
+        CHECK(values[2] == 9.0f);
+    }
+
+    TEST_CASE("call request") {
+        Connection connection;
+        CallDevice device;
+        CHECK(call_sum(connection, device, 3, 4) == kFibreClosed);
+
+        // One request with the function's endpoint and all inputs
+        CHECK(device.endpoints == std::vector<uint16_t>{CALL_ENDPOINT_ID});
+        CHECK(device.call_input == std::vector<uint8_t>{12, 0, 3, 0, 0, 0, 4, 0, 0, 0});
+        CHECK(connection.protocol.client_.call_supported_);
+    }
+
+    TEST_CASE("call request on a server without call requests") {
+        Connection connection;
+        CallDevice device;
+        device.call_supported = false;
+        CHECK(call_sum(connection, device, 3, 4) == kFibreClosed);
+
+        // Falls back to writing the inputs, triggering the function and
+        // reading the outputs
+        CHECK(device.endpoints == std::vector<uint16_t>{CALL_ENDPOINT_ID, 10, 11, 12, 13, 14});
+        CHECK(!connection.protocol.client_.call_supported_);
+
+        // Later calls don't try again
+        device.endpoints.clear();
+        CHECK(call_sum(connection, device, 5, 6) == kFibreClosed);
+        CHECK(device.endpoints == std::vector<uint16_t>{10, 11, 12, 13, 14});
+    }
+
+    TEST_CASE("failed call request") {
+        Connection connection;
+        CallDevice device;
+        device.call_status = 0;
+        CHECK(call_sum(connection, device, 3, 4) == kFibreInternalError);
+        CHECK(device.endpoints == std::vector<uint16_t>{CALL_ENDPOINT_ID});
+        CHECK(connection.protocol.client_.call_supported_);
+    }
+
+    TEST_CASE("batch probe") {
+        for (bool batch_supported: {true, false}) {
+            CAPTURE(batch_supported);
+            FakeChannel channel;
+            LegacyProtocolPacketBased protocol{&channel, &channel, 64};
+            BatchDevice device;
+            device.batch_supported = batch_supported;
+
+            bool found = false;
+            auto on_found = [&found](LegacyObjectClient*, std::shared_ptr<LegacyObject>) { found = true; };
+            auto on_stopped = [](LegacyProtocolPacketBased*, StreamStatus) {};
+            protocol.start(on_found, nullptr, on_stopped);
+            serve(channel, std::ref(device));
+
+            // The root object is only reported once the probe completed
+            CHECK(found);
+            CHECK(device.endpoints.back() == BATCH_ENDPOINT_ID);
+            CHECK(protocol.client_.batch_supported_ == batch_supported);
+            if (batch_supported) {
+                CHECK(device.batch_input == std::vector<uint8_t>{0xfe, 0x7f, 0, 0});
+            }
+        }
+    }
+
+    TEST_CASE("batch across the MTU") {
+        Connection connection;
+        connection.protocol.client_.batch_supported_ = true;
+        BatchDevice device;
+
+        // 12 entries of 5 response bytes fit into one response of 62 bytes
+        read_batch(connection, device, 30);
+        CHECK(device.endpoints == std::vector<uint16_t>(3, BATCH_ENDPOINT_ID));
+        CHECK(device.n_run == std::vector<size_t>{12, 12, 6});
+    }
+
+    TEST_CASE("partial batch response") {
+        Connection connection;
+        connection.protocol.client_.batch_supported_ = true;
+        BatchDevice device;
+        device.max_response = 25;
+
+        // The server runs 5 of the 12 entries per request. The client sends
+        // the rest again.
+        read_batch(connection, device, 12);
+        CHECK(device.n_run == std::vector<size_t>{5, 5, 2});
+        CHECK(connection.protocol.client_.batch_supported_);
+    }
+
+    TEST_CASE("batch request without progress") {
+        Connection connection;
+        connection.protocol.client_.batch_supported_ = true;
+        BatchDevice device;
+        device.max_response = 3;
+
+        // No entry fits into the server's response, so each item is sent on
+        // its own after an empty batch response. This doesn't mean that the
+        // server lacks batch support.
+        read_batch(connection, device, 3);
+        CHECK(device.endpoints == std::vector<uint16_t>{BATCH_ENDPOINT_ID, 1, BATCH_ENDPOINT_ID, 2, 3});
+        CHECK(connection.protocol.client_.batch_supported_);
+    }
+
+    TEST_CASE("batch on a server without batch support") {
+        Connection connection;
+        BatchDevice device;
+        device.batch_supported = false;
+        read_batch(connection, device, 3);
+        CHECK(device.endpoints == std::vector<uint16_t>{1, 2, 3});
+    }
+}
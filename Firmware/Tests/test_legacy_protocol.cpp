@@ -0,0 +1,221 @@
+#include <doctest.h>
+
+// The protocol is compiled into the test and talks to a FakeChannel. The
+// client on top of it comes from test_legacy_object_client.cpp, which must use
+// the same options.
+#define FIBRE_ENABLE_CLIENT 1
+#define FIBRE_MAX_LOG_VERBOSITY 0
+#include "fibre-cpp/legacy_protocol.cpp"
+#include "fake_channel.hpp"
+
+#include <vector>
+
+using namespace fibre;
+
+static constexpr size_t kWindow = FIBRE_LEGACY_PROTOCOL_WINDOW;
+static constexpr size_t kMaxWaiting = FIBRE_LEGACY_PROTOCOL_MAX_WAITING;
+
+namespace {
+
+// An endpoint operation whose result the test can inspect
+struct Operation {
+    uint8_t tx_buf[4] = {0};
+    uint8_t rx_buf[4] = {0};
+    EndpointOperationHandle handle = 0;
+    std::optional<EndpointOperationResult> result;
+    size_t* completion_counter = nullptr;
+    size_t completion_index = 0; // value of *completion_counter at completion
+
+    void on_finished(EndpointOperationResult res) {
+        result = res;
+        if (completion_counter) {
+            completion_index = (*completion_counter)++;
+        }
+    }
+};
+
+struct Fixture {
+    FakeChannel channel;
+    LegacyProtocolPacketBased protocol{&channel, &channel, 64};
+    std::vector<Operation> ops;
+    size_t n_completed = 0;
+
+    // Room for all operations that a test can start
+    Fixture() : ops(kWindow + kMaxWaiting + 1) {
+        protocol.start(nullptr, nullptr, nullptr); // no client discovery
+    }
+
+    void start(size_t i, uint16_t endpoint_id = 1) {
+        ops[i].completion_counter = &n_completed;
+        protocol.start_endpoint_operation(endpoint_id, ops[i].tx_buf, ops[i].rx_buf, &ops[i].handle, MEMBER_CB(&ops[i], on_finished));
+    }
+
+    // Finishes the ongoing and all following writes and returns the sequence
+    // numbers of the packets that were sent
+    std::vector<uint16_t> flush() {
+        std::vector<uint16_t> seqnos;
+        while (channel.writing()) {
+            cbufptr_t packet = {channel.packet().data(), channel.packet().data() + channel.packet().size()};
+            seqnos.push_back(*read_le<uint16_t>(&packet));
+            channel.finish_write();
+        }
+        return seqnos;
+    }
+
+    void ack(uint16_t seqno, uint8_t value = 0) {
+        std::vector<uint8_t> packet(3);
+        write_le<uint16_t>(seqno | 0x8000, packet.data());
+        packet[2] = value;
+        channel.receive(packet);
+    }
+};
+
+}
+
+TEST_SUITE("Legacy Protocol") {
+    TEST_CASE("window") {
+        Fixture f;
+        for (size_t i = 0; i < kWindow; ++i) {
+            f.start(i);
+        }
+
+        // All operations are on the wire before the first response
+        std::vector<uint16_t> seqnos = f.flush();
+        REQUIRE(seqnos.size() == kWindow);
+        for (size_t i = 1; i < kWindow; ++i) {
+            CHECK(seqnos[i] != seqnos[0]);
+        }
+
+        for (size_t i = 0; i < kWindow; ++i) {
+            CHECK(!f.ops[i].result.has_value());
+            f.ack(seqnos[i], (uint8_t)i);
+            REQUIRE(f.ops[i].result.has_value());
+            CHECK(f.ops[i].result->status == kStreamOk);
+            CHECK(f.ops[i].result->rx_end == f.ops[i].rx_buf + 1);
+            CHECK(f.ops[i].rx_buf[0] == i);
+            CHECK(f.ops[i].completion_index == i);
+        }
+        CHECK(f.n_completed == kWindow);
+    }
+
+    TEST_CASE("out of order responses") {
+        Fixture f;
+        f.start(0);
+        f.start(1);
+        std::vector<uint16_t> seqnos = f.flush();
+        REQUIRE(seqnos.size() == 2);
+
+        f.ack(seqnos[1], 11);
+        CHECK(!f.ops[0].result.has_value());
+        REQUIRE(f.ops[1].result.has_value());
+        CHECK(f.ops[1].rx_buf[0] == 11);
+
+        f.ack(seqnos[0], 10);
+        REQUIRE(f.ops[0].result.has_value());
+        CHECK(f.ops[0].rx_buf[0] == 10);
+    }
+
+    TEST_CASE("waiting operations enter freed slots") {
+        Fixture f;
+        for (size_t i = 0; i < kWindow + 2; ++i) {
+            f.start(i);
+        }
+        std::vector<uint16_t> seqnos = f.flush();
+        REQUIRE(seqnos.size() == kWindow); // the last two wait for a slot
+
+        // Operation kWindow takes the slot of operation 0, so it stays
+        // waiting when operation 1 completes first. Operation kWindow + 1 must
+        // not overtake it.
+        f.ack(seqnos[1]);
+        CHECK(f.flush().empty());
+
+        f.ack(seqnos[0]);
+        std::vector<uint16_t> promoted = f.flush();
+        CHECK(promoted.size() == 2);
+
+        for (size_t i = 0; i < promoted.size(); ++i) {
+            f.ack(promoted[i], (uint8_t)(100 + i));
+        }
+        REQUIRE(f.ops[kWindow].result.has_value());
+        REQUIRE(f.ops[kWindow + 1].result.has_value());
+        CHECK(f.ops[kWindow].rx_buf[0] == 100);
+        CHECK(f.ops[kWindow + 1].rx_buf[0] == 101);
+        CHECK(f.ops[kWindow].completion_index < f.ops[kWindow + 1].completion_index);
+    }
+
+    TEST_CASE("too many waiting operations") {
+        Fixture f;
+        for (size_t i = 0; i < kWindow + kMaxWaiting; ++i) {
+            f.start(i);
+            CHECK(!f.ops[i].result.has_value());
+        }
+
+        // Fails synchronously and can't be cancelled
+        f.start(kWindow + kMaxWaiting);
+        Operation& op = f.ops[kWindow + kMaxWaiting];
+        REQUIRE(op.result.has_value());
+        CHECK(op.result->status == kStreamError);
+        CHECK(op.handle == 0);
+        f.protocol.cancel_endpoint_operation(op.handle);
+        CHECK(f.n_completed == 1);
+    }
+
+    TEST_CASE("cancel") {
+        Fixture f;
+        for (size_t i = 0; i < kWindow + 2; ++i) {
+            f.start(i);
+        }
+
+        // Waiting for a slot. It is never sent.
+        f.protocol.cancel_endpoint_operation(f.ops[kWindow + 1].handle);
+        REQUIRE(f.ops[kWindow + 1].result.has_value());
+        CHECK(f.ops[kWindow + 1].result->status == kStreamCancelled);
+
+        // Being written. Operation kWindow takes its slot.
+        f.protocol.cancel_endpoint_operation(f.ops[0].handle);
+        REQUIRE(f.ops[0].result.has_value());
+        CHECK(f.ops[0].result->status == kStreamCancelled);
+
+        std::vector<uint16_t> seqnos = f.flush();
+        REQUIRE(seqnos.size() == kWindow); // operations 1 to kWindow
+
+        // Sent, waiting for the response
+        f.protocol.cancel_endpoint_operation(f.ops[1].handle);
+        REQUIRE(f.ops[1].result.has_value());
+        CHECK(f.ops[1].result->status == kStreamCancelled);
+
+        // A late response for it is ignored
+        size_t n_completed = f.n_completed;
+        f.ack(seqnos[0]);
+        CHECK(f.n_completed == n_completed);
+
+        f.ack(seqnos.back(), 42);
+        REQUIRE(f.ops[kWindow].result.has_value());
+        CHECK(f.ops[kWindow].result->status == kStreamOk);
+        CHECK(f.ops[kWindow].rx_buf[0] == 42);
+        CHECK(f.flush().empty());
+    }
+
+    TEST_CASE("close") {
+        Fixture f;
+        for (size_t i = 0; i < kWindow + 3; ++i) {
+            f.start(i);
+        }
+        std::vector<uint16_t> seqnos = f.flush();
+        f.ack(seqnos[0]);
+        REQUIRE(f.ops[0].result.has_value());
+        CHECK(f.ops[0].result->status == kStreamOk);
+        f.start(kWindow + 3);
+
+        // The operations in flight, the one that is being written and the
+        // waiting ones all fail
+        REQUIRE(f.channel.writing());
+        f.channel.close();
+        for (size_t i = 1; i < kWindow + 4; ++i) {
+            CAPTURE(i);
+            REQUIRE(f.ops[i].result.has_value());
+            CHECK(f.ops[i].result->status == kStreamClosed);
+        }
+        CHECK(f.n_completed == kWindow + 4);
+    }
+}
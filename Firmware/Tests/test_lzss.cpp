@@ -0,0 +1,71 @@
+#include <doctest.h>
+#include "fibre-cpp/lzss.hpp"
+#include "fibre-cpp/legacy_protocol.hpp"
+
+// Generated from Tests/lzss_test_vectors_template.j2 with the same encoder
+// that compresses the JSON definition
+#include "autogen/lzss_test_vectors.hpp"
+
+#include <string.h>
+#include <vector>
+
+using namespace fibre;
+
+// Decodes the whole input and checks that the decoder stops at its end
+static std::vector<uint8_t> decode(LzssDecoder& decoder, size_t max_length) {
+    std::vector<uint8_t> output;
+    uint8_t byte;
+    while (output.size() <= max_length && decoder.get(&byte)) {
+        output.push_back(byte);
+    }
+    return output;
+}
+
+TEST_SUITE("LZSS") {
+    TEST_CASE("parameters") {
+        CHECK(kLzssTestWindowBits == JSON_WINDOW_BITS);
+        CHECK(kLzssTestLookaheadBits == JSON_LOOKAHEAD_BITS);
+    }
+
+    TEST_CASE("round trip") {
+        uint8_t window[1 << kLzssTestWindowBits];
+
+        for (const LzssTestVector_t& vector: lzss_test_vectors) {
+            CAPTURE(vector.name);
+            LzssDecoder decoder{vector.compressed, vector.compressed_length, window, kLzssTestWindowBits, kLzssTestLookaheadBits};
+
+            std::vector<uint8_t> output = decode(decoder, vector.input_length);
+            REQUIRE(output.size() == vector.input_length);
+            CHECK(memcmp(output.data(), vector.input, vector.input_length) == 0);
+            CHECK(decoder.get_position() == vector.input_length);
+        }
+    }
+
+    TEST_CASE("compression") {
+        // Runs must be encoded as back references
+        for (const LzssTestVector_t& vector: lzss_test_vectors) {
+            CAPTURE(vector.name);
+            if (vector.input_length > 1000) {
+                CHECK(vector.compressed_length < vector.input_length / 2);
+            }
+        }
+    }
+
+    TEST_CASE("reset") {
+        // The server restarts the decoder when a client seeks backwards
+        const LzssTestVector_t& vector = lzss_test_vectors[0];
+        uint8_t window[1 << kLzssTestWindowBits];
+        LzssDecoder decoder{vector.compressed, vector.compressed_length, window, kLzssTestWindowBits, kLzssTestLookaheadBits};
+
+        uint8_t byte;
+        for (size_t i = 0; i < 5000; ++i) {
+            REQUIRE(decoder.get(&byte));
+        }
+        decoder.reset();
+        CHECK(decoder.get_position() == 0);
+
+        std::vector<uint8_t> output = decode(decoder, vector.input_length);
+        REQUIRE(output.size() == vector.input_length);
+        CHECK(memcmp(output.data(), vector.input, vector.input_length) == 0);
+    }
+}
@@ -0,0 +1,97 @@
+
+#include <doctest.h>
+#include "fibre-cpp/platform_support/mpsc_queue.hpp"
+
+#include <thread>
+#include <vector>
+
+using fibre::MpscQueue;
+
+TEST_SUITE("MPSC Queue") {
+    TEST_CASE("fifo") {
+        MpscQueue<int, 4> queue;
+        int item = 0;
+        CHECK(queue.empty());
+        CHECK(!queue.pop(&item));
+
+        // Go around the ring a few times
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < 4; ++i) {
+                CHECK(queue.push(round * 10 + i));
+            }
+            CHECK(!queue.push(99)); // full
+            CHECK(!queue.empty());
+
+            for (int i = 0; i < 4; ++i) {
+                REQUIRE(queue.pop(&item));
+                CHECK(item == round * 10 + i);
+            }
+            CHECK(!queue.pop(&item));
+            CHECK(queue.empty());
+        }
+    }
+
+    TEST_CASE("interleaved") {
+        MpscQueue<int, 8> queue;
+        int next_push = 0;
+        int next_pop = 0;
+        for (int i = 0; i < 100; ++i) {
+            for (int j = 0; j < i % 5; ++j) {
+                if (queue.push(next_push)) {
+                    next_push++;
+                }
+            }
+            for (int j = 0; j < i % 3; ++j) {
+                int item;
+                if (queue.pop(&item)) {
+                    CHECK(item == next_pop++);
+                }
+            }
+        }
+        CHECK(next_pop <= next_push);
+        CHECK(next_push - next_pop <= 8);
+    }
+
+    TEST_CASE("multiple producers") {
+        // Each producer pushes an increasing sequence. The consumer must see
+        // every item exactly once and the items of each producer in order.
+        const size_t n_producers = 4;
+        const size_t n_items = 50000;
+        MpscQueue<std::pair<size_t, size_t>, 64> queue;
+
+        std::vector<std::thread> producers;
+        for (size_t p = 0; p < n_producers; ++p) {
+            producers.emplace_back([&queue, p, n_items]() {
+                for (size_t i = 0; i < n_items; ++i) {
+                    while (!queue.push({p, i})) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        std::vector<size_t> next(n_producers, 0);
+        size_t n_received = 0;
+        bool ok = true;
+        while (n_received < n_producers * n_items) {
+            std::pair<size_t, size_t> item;
+            if (queue.pop(&item)) {
+                ok = ok && (item.first < n_producers) && (item.second == next[item.first]);
+                next[item.first] = item.second + 1;
+                n_received++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        for (auto& producer: producers) {
+            producer.join();
+        }
+
+        CHECK(ok);
+        CHECK(queue.empty());
+        for (size_t p = 0; p < n_producers; ++p) {
+            CHECK(next[p] == n_items);
+        }
+    }
+}
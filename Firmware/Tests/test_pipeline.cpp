@@ -0,0 +1,86 @@
+#include <doctest.h>
+#include "MotorControl/pipeline.hpp"
+#include <stdint.h>
+#include <string>
+
+static std::string trace;
+
+static void run_stage(PipelineStage& stage) {
+    if (stage.update) {
+        stage.update(stage.ctx, 0);
+    }
+}
+
+static void append_name(void* ctx, uint32_t) {
+    trace += *(const char*)ctx;
+}
+
+TEST_CASE("Pipeline") {
+    OutputPort<float> estimate = 0.0f;
+    OutputPort<float> open_loop_estimate = 0.0f;
+    OutputPort<float> setpoint = 0.0f;
+    InputPort<float> setpoint_estimate_src;
+    InputPort<float> output_setpoint_src;
+
+    Pipeline<4> pipeline;
+    // Added in the wrong order on purpose
+    pipeline.add_stage({append_name, (void*)"o", nullptr, true, {&output_setpoint_src}, {}});
+    pipeline.add_stage({append_name, (void*)"c", nullptr, false, {&setpoint_estimate_src}, {&setpoint}});
+    pipeline.add_stage({append_name, (void*)"e", nullptr, true, {}, {&estimate}});
+    pipeline.add_stage({append_name, (void*)"l", nullptr, false, {}, {&open_loop_estimate}});
+
+    SUBCASE("unconnected stages run in the order they were added") {
+        trace = "";
+        pipeline.run(run_stage);
+        CHECK(trace == "oe");
+    }
+
+    SUBCASE("producers run before consumers") {
+        setpoint_estimate_src.connect_to(&estimate);
+        output_setpoint_src.connect_to(&setpoint);
+        trace = "";
+        pipeline.run(run_stage);
+        CHECK(trace == "eco");
+        CHECK(pipeline.n_scheduled() == 3);
+
+        // Reconnecting updates the schedule on the next run
+        setpoint_estimate_src.connect_to(&open_loop_estimate);
+        trace = "";
+        pipeline.run(run_stage);
+        CHECK(trace == "elco");
+
+        float constant_setpoint = 1.0f;
+        output_setpoint_src.connect_to(&constant_setpoint);
+        trace = "";
+        pipeline.run(run_stage);
+        CHECK(trace == "oe");
+    }
+
+    SUBCASE("disconnecting the last consumer skips the producer") {
+        output_setpoint_src.connect_to(&setpoint);
+        trace = "";
+        pipeline.run(run_stage);
+        CHECK(trace == "coe");
+
+        // Like Axis::stop_closed_loop_control() does with the torque setpoint
+        output_setpoint_src.disconnect(0.0f);
+        trace = "";
+        pipeline.run(run_stage);
+        CHECK(trace == "oe");
+        CHECK(pipeline.n_scheduled() == 2);
+        CHECK(output_setpoint_src.present() == 0.0f);
+    }
+
+    SUBCASE("cycles don't prevent stages from running") {
+        InputPort<float> estimate_setpoint_src;
+        estimate_setpoint_src.connect_to(&setpoint);
+        setpoint_estimate_src.connect_to(&estimate);
+        output_setpoint_src.connect_to(&setpoint);
+        Pipeline<2> cyclic_pipeline;
+        cyclic_pipeline.add_stage({append_name, (void*)"c", nullptr, true, {&setpoint_estimate_src}, {&setpoint}});
+        cyclic_pipeline.add_stage({append_name, (void*)"e", nullptr, true, {&estimate_setpoint_src}, {&estimate}});
+        trace = "";
+        cyclic_pipeline.run(run_stage);
+        CHECK(trace == "ce");
+    }
+}
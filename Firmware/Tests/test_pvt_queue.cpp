@@ -0,0 +1,109 @@
+
+#include <doctest.h>
+#include "MotorControl/pvt_queue.hpp"
+
+#include <cmath>
+
+TEST_SUITE("PVT Queue") {
+    TEST_CASE("empty") {
+        PvtQueue queue;
+        PvtQueue::Step_t step = queue.step(0.001f, 1.5f, 0.0f);
+        CHECK(step.Y == 1.5f);
+        CHECK(step.Yd == 0.0f);
+        CHECK(queue.depth() == 0);
+        CHECK(queue.underrun_count_ == 0);
+    }
+
+    TEST_CASE("push-limits") {
+        PvtQueue queue;
+        CHECK(!queue.push({1.0f, 0.0f, 0.0f}));
+        CHECK(!queue.push({1.0f, 0.0f, -1.0f}));
+        for (size_t i = 0; i < PvtQueue::kCapacity; ++i) {
+            CHECK(queue.push({1.0f, 0.0f, 1.0f}));
+        }
+        CHECK(!queue.push({1.0f, 0.0f, 1.0f}));
+        CHECK(queue.depth() == PvtQueue::kCapacity);
+
+        queue.reset();
+        CHECK(queue.depth() == 0);
+        CHECK(queue.push({1.0f, 0.0f, 1.0f}));
+    }
+
+    TEST_CASE("follow-sine") {
+        // Stream points of a sine wave (one period per second) and check that
+        // the interpolation passes through them with continuous velocity.
+        const float dt = 0.000125f;
+        const float point_dt = 0.01f;
+        const float two_pi = 2.0f * (float)M_PI;
+
+        PvtQueue queue;
+        float pos = 0.0f;
+        float vel = two_pi;
+        size_t n_points = 0;
+        size_t n_steps = 0;
+
+        while (n_points < 200 || queue.depth()) {
+            while (n_points < 200 && queue.depth() < 8) {
+                n_points++;
+                float tp = n_points * point_dt;
+                float vp = (n_points < 200) ? two_pi * std::cos(two_pi * tp) : 0.0f;
+                CHECK(queue.push({std::sin(two_pi * tp), vp, point_dt}));
+            }
+
+            PvtQueue::Step_t step = queue.step(dt, pos, vel);
+            float t = ++n_steps * dt;
+            if (t < 199 * point_dt) { // the last point stops
+                CHECK(step.Y == doctest::Approx(std::sin(two_pi * t)).epsilon(0.001));
+                CHECK(step.Yd == doctest::Approx(two_pi * std::cos(two_pi * t)).epsilon(0.01));
+                CHECK(std::abs(step.Y - pos) <= two_pi * dt * 1.01f);
+            }
+            CHECK(std::abs(step.Yd - vel) <= 1.0f); // no steps in velocity
+            pos = step.Y;
+            vel = step.Yd;
+        }
+
+        CHECK(pos == doctest::Approx(std::sin(two_pi * 2.0f)));
+        CHECK(vel == 0.0f);
+        CHECK(queue.underrun_count_ == 0);
+    }
+
+    TEST_CASE("segment-endpoints") {
+        PvtQueue queue;
+        queue.push({1.0f, 2.0f, 0.5f});
+        queue.push({3.0f, 0.0f, 1.0f});
+
+        PvtQueue::Step_t step = queue.step(0.25f, 0.0f, 0.0f);
+        CHECK(step.Y == doctest::Approx(0.375f)); // h01(0.5) * 1 + h11(0.5) * 0.5 * 2
+        step = queue.step(0.25f, step.Y, step.Yd);
+        CHECK(step.Y == doctest::Approx(1.0f));
+        CHECK(step.Yd == doctest::Approx(2.0f));
+        CHECK(queue.depth() == 1);
+        step = queue.step(1.0f, step.Y, step.Yd);
+        CHECK(step.Y == doctest::Approx(3.0f));
+        CHECK(step.Yd == 0.0f);
+        CHECK(queue.depth() == 0);
+        CHECK(queue.underrun_count_ == 0);
+    }
+
+    TEST_CASE("underrun") {
+        PvtQueue queue;
+        queue.push({1.0f, 1.0f, 1.0f});
+
+        PvtQueue::Step_t step = queue.step(0.5f, 0.0f, 0.0f);
+        CHECK(queue.underrun_count_ == 0);
+        step = queue.step(0.6f, step.Y, step.Yd);
+        CHECK(step.Y == 1.0f);
+        CHECK(step.Yd == 0.0f);
+        CHECK(queue.underrun_count_ == 1);
+
+        // Stays stopped and doesn't count again
+        step = queue.step(0.5f, step.Y, step.Yd);
+        CHECK(step.Y == 1.0f);
+        CHECK(queue.underrun_count_ == 1);
+
+        // The next point starts from the stopped position
+        queue.push({2.0f, 0.0f, 1.0f});
+        step = queue.step(0.5f, step.Y, step.Yd);
+        CHECK(step.Y == doctest::Approx(1.5f));
+    }
+}
@@ -0,0 +1,176 @@
+
+#include <doctest.h>
+#include <cmath>
+#include <algorithm>
+#include <stdint.h>
+
+// The planner has no dependencies on the rest of the firmware so the real
+// implementation is compiled into this test.
+#include "MotorControl/scurveTraj.cpp"
+
+
+void run_scurve_test(float goal, float position, float velocity, float accel,
+                     float Vmax, float Amax, float Dmax, float Jmax, int replan_interval) {
+    float dt = 0.000125f;
+    float t = 0.0f;
+    float Vmax_test = std::max(Vmax, std::abs(velocity) + accel * accel / (2.0f * Jmax));
+    float Amax_test = std::max({Amax, Dmax, std::abs(accel)});
+
+    SCurveTrajectory traj{};
+    REQUIRE(traj.planSCurve(goal, position, velocity, accel, Vmax, Amax, Dmax, Jmax));
+
+    int replan_counter = replan_interval;
+
+    do {
+        if (replan_counter <= 0) {
+            // Replan like the controller does: the running trajectory keeps
+            // going while the new one is planned. Handing over must not cause
+            // a jump in acceleration.
+            SCurveTrajectory::Step_t handover = traj.eval(t + SCurveTrajectory::kPlanningCycles * dt);
+            CHECK(traj.start_planning(goal, handover.Y, handover.Yd, handover.Ydd, Vmax, Amax, Dmax, Jmax));
+            replan_counter = replan_interval;
+        } else {
+            if (traj.is_planning() && traj.continue_planning()) {
+                t = 0.0f;
+            }
+            replan_counter--;
+        }
+
+        t += dt;
+        SCurveTrajectory::Step_t step = traj.eval(t);
+
+        // Check if jerk within bounds
+        CHECK(std::abs(step.Ydd - accel) / dt <= Jmax * 1.01f);
+        accel = step.Ydd;
+
+        // Check if acceleration within bounds
+        CHECK(std::abs(step.Ydd) <= Amax_test * 1.001f);
+        CHECK(std::abs(step.Yd - velocity) / dt <= Amax_test * 1.002f);
+
+        // Check if velocity within bounds
+        CHECK(std::abs(step.Yd) <= Vmax_test * 1.001f);
+        CHECK(std::abs(step.Y - position) / dt <= Vmax_test * 1.002f);
+        velocity = step.Yd;
+        position = step.Y;
+
+    } while (t <= traj.Tf_ || traj.is_planning());
+
+    CHECK(position == goal);
+    CHECK(velocity == 0.0f);
+    CHECK(accel == 0.0f);
+}
+
+void run_scurve_test(float goal, float position, float velocity, float accel,
+                     float Vmax, float Amax, float Dmax, float Jmax) {
+    run_scurve_test(goal, position, velocity, accel, Vmax, Amax, Dmax, Jmax, INT32_MAX);
+    run_scurve_test(goal, position, velocity, accel, Vmax, Amax, Dmax, Jmax, 10);
+    run_scurve_test(goal, position, velocity, accel, Vmax, Amax, Dmax, Jmax, 7);
+}
+
+
+TEST_SUITE("S-Curve Trajectory Planner") {
+    TEST_CASE("invalid-limits") {
+        SCurveTrajectory traj{};
+        CHECK(!traj.planSCurve(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f));
+        CHECK(!traj.planSCurve(1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f));
+    }
+
+    TEST_CASE("segment-durations") {
+        // Long move that reaches both the acceleration and the velocity limit:
+        // 0.2s jerk, 0.3s constant accel, 0.2s jerk, cruise, and the same for
+        // decel.
+        SCurveTrajectory traj{};
+        REQUIRE(traj.planSCurve(10.0f, 0.0f, 0.0f, 0.0f, 1.0f, 2.0f, 2.0f, 10.0f));
+        CHECK(traj.segments_[0].T == doctest::Approx(0.2f));
+        CHECK(traj.segments_[1].T == doctest::Approx(0.3f));
+        CHECK(traj.segments_[2].T == doctest::Approx(0.2f));
+        CHECK(traj.segments_[3].T == doctest::Approx(9.3f));
+        CHECK(traj.segments_[4].T == doctest::Approx(0.2f));
+        CHECK(traj.segments_[5].T == doctest::Approx(0.3f));
+        CHECK(traj.segments_[6].T == doctest::Approx(0.2f));
+        CHECK(traj.Tf_ == doctest::Approx(10.7f));
+        CHECK(traj.eval(traj.Tf_ / 2.0f).Y == doctest::Approx(5.0f));
+        CHECK(traj.eval(traj.Tf_ / 2.0f).Yd == doctest::Approx(1.0f));
+        CHECK(traj.eval(0.1f).Ydd == doctest::Approx(1.0f));
+    }
+
+    TEST_CASE("incremental-planning") {
+        // Spreading the planning over several cycles gives the same result
+        // and leaves the running trajectory alone until it's done
+        SCurveTrajectory whole{};
+        REQUIRE(whole.planSCurve(0.5f, 0.0f, 1.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f));
+
+        SCurveTrajectory traj{};
+        REQUIRE(traj.planSCurve(-1.0f, 0.0f, 0.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f));
+        float Tf_old = traj.Tf_;
+        REQUIRE(traj.start_planning(0.5f, 0.0f, 1.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f));
+        for (size_t i = 1; i < SCurveTrajectory::kPlanningCycles; ++i) {
+            CHECK(traj.is_planning());
+            CHECK(!traj.continue_planning());
+            CHECK(traj.Tf_ == Tf_old);
+        }
+        CHECK(traj.continue_planning());
+        CHECK(!traj.is_planning());
+        CHECK(traj.Tf_ == whole.Tf_);
+        CHECK(traj.Vr_ == whole.Vr_);
+        for (size_t i = 0; i < traj.segments_.size(); ++i) {
+            CHECK(traj.segments_[i].T == whole.segments_[i].T);
+            CHECK(traj.segments_[i].J == whole.segments_[i].J);
+        }
+    }
+
+    // reaches neither the acceleration nor the velocity limit
+    TEST_CASE("neg-dir-short") {
+        run_scurve_test(-0.01f, 0.01f, 0.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+    }
+    TEST_CASE("pos-dir-short") {
+        run_scurve_test(0.01f, -0.01f, 0.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+    }
+
+    // reaches the acceleration but not the velocity limit
+    TEST_CASE("neg-dir-triangle") {
+        run_scurve_test(-2.0f, 2.0f, 0.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+    }
+    TEST_CASE("pos-dir-triangle") {
+        run_scurve_test(2.0f, -2.0f, 0.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+    }
+
+    // reaches both limits
+    TEST_CASE("neg-dir-long") {
+        run_scurve_test(-10.0f, 10.0f, 0.0f, 0.0f, 20.0f, 50.0f, 30.0f, 1000.0f);
+    }
+    TEST_CASE("pos-dir-long") {
+        run_scurve_test(10.0f, -10.0f, 0.0f, 0.0f, 20.0f, 30.0f, 50.0f, 1000.0f);
+    }
+
+    TEST_CASE("initial-vel-towards-goal") {
+        run_scurve_test(10.0f, 0.0f, 10.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+        run_scurve_test(-10.0f, 0.0f, -10.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+    }
+
+    TEST_CASE("initial-vel-away-from-goal") {
+        run_scurve_test(2.0f, 0.0f, -10.0f, 0.0f, 20.0f, 50.0f, 30.0f, 1000.0f);
+        run_scurve_test(-2.0f, 0.0f, 10.0f, 0.0f, 20.0f, 30.0f, 50.0f, 1000.0f);
+    }
+
+    // v^2/(2*d) = 20^2 / (2*50) = 4 > 2
+    TEST_CASE("not-enough-braking-distance") {
+        run_scurve_test(2.0f, 0.0f, 20.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+        run_scurve_test(-2.0f, 0.0f, -20.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+    }
+
+    TEST_CASE("over-speed") {
+        run_scurve_test(10.0f, 0.0f, 30.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+        run_scurve_test(-10.0f, 0.0f, -30.0f, 0.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+    }
+
+    TEST_CASE("initial-accel") {
+        run_scurve_test(10.0f, 0.0f, 5.0f, 40.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+        run_scurve_test(10.0f, 0.0f, 5.0f, -40.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+        run_scurve_test(0.1f, 0.0f, 5.0f, 40.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+    }
+
+    TEST_CASE("initial-accel-above-limit") {
+        run_scurve_test(10.0f, 0.0f, 5.0f, 80.0f, 20.0f, 50.0f, 50.0f, 1000.0f);
+    }
+}
@@ -0,0 +1,53 @@
+
+#include <doctest.h>
+#include "MotorControl/task_timer_histogram.hpp"
+
+using H = TaskTimerHistogram;
+
+TEST_SUITE("Task Timer") {
+    TEST_CASE("histogram-bin") {
+        CHECK(H::get_histogram_bin(0) == 0);
+        CHECK(H::get_histogram_bin(1) == 1);
+        CHECK(H::get_histogram_bin(2) == 2);
+        CHECK(H::get_histogram_bin(3) == 3);
+        CHECK(H::get_histogram_bin(4) == 4);
+        CHECK(H::get_histogram_bin(5) == 4);
+        CHECK(H::get_histogram_bin(6) == 5);
+        CHECK(H::get_histogram_bin(7) == 5);
+
+        // Two bins per octave: 2^k starts the first one, 1.5 * 2^k the second
+        for (uint32_t k = 2; k < 16; ++k) {
+            uint32_t pow2 = 1u << k;
+            CHECK(H::get_histogram_bin(pow2 - 1) == 2 * k - 1);
+            CHECK(H::get_histogram_bin(pow2) == 2 * k);
+            CHECK(H::get_histogram_bin(pow2 + 1) == 2 * k);
+            CHECK(H::get_histogram_bin(pow2 + pow2 / 2 - 1) == 2 * k);
+            CHECK(H::get_histogram_bin(pow2 + pow2 / 2) == 2 * k + 1);
+        }
+
+        // Everything beyond the start of the last bin goes to the last bin
+        CHECK(H::get_histogram_bin(3u << 14) == H::kBins - 1);
+        CHECK(H::get_histogram_bin(1u << 16) == H::kBins - 1);
+        CHECK(H::get_histogram_bin(1u << 31) == H::kBins - 1);
+        CHECK(H::get_histogram_bin(UINT32_MAX - 1) == H::kBins - 1);
+        CHECK(H::get_histogram_bin(UINT32_MAX) == H::kBins - 1);
+    }
+
+    TEST_CASE("histogram-bin-start") {
+        CHECK(H::get_histogram_bin_start(0) == 0);
+        CHECK(H::get_histogram_bin_start(1) == 1);
+        CHECK(H::get_histogram_bin_start(2) == 2);
+        CHECK(H::get_histogram_bin_start(3) == 3);
+        CHECK(H::get_histogram_bin_start(4) == 4);
+        CHECK(H::get_histogram_bin_start(5) == 6);
+        CHECK(H::get_histogram_bin_start(H::kBins - 1) == 3u << 14);
+
+        // Consistent with get_histogram_bin()
+        for (size_t bin = 1; bin < H::kBins; ++bin) {
+            uint32_t start = H::get_histogram_bin_start(bin);
+            CHECK(start > H::get_histogram_bin_start(bin - 1));
+            CHECK(H::get_histogram_bin(start) == bin);
+            CHECK(H::get_histogram_bin(start - 1) == bin - 1);
+        }
+    }
+}
@@ -0,0 +1,185 @@
+
+#include <doctest.h>
+#include "fibre-cpp/platform_support/timer_wheel.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using fibre::EventLoopTimer;
+using fibre::TimerWheel;
+
+TEST_SUITE("Timer Wheel") {
+    TEST_CASE("empty") {
+        TimerWheel wheel;
+        wheel.reset(1000);
+        CHECK(wheel.size() == 0);
+        CHECK(wheel.get_next_wakeup() == UINT64_MAX);
+
+        size_t n_expired = 0;
+        wheel.advance(5000000, [&](EventLoopTimer*) { n_expired++; });
+        CHECK(n_expired == 0);
+        CHECK(wheel.get_now() == 5000000);
+    }
+
+    TEST_CASE("expiry") {
+        TimerWheel wheel;
+        wheel.reset(100);
+
+        EventLoopTimer timers[4];
+        wheel.add(&timers[0], 105);
+        wheel.add(&timers[1], 103);
+        wheel.add(&timers[2], 103);
+        wheel.add(&timers[3], 50); // in the past: expires on the next tick
+        CHECK(wheel.size() == 4);
+        CHECK(wheel.get_next_wakeup() == 101);
+
+        std::vector<EventLoopTimer*> expired;
+        auto on_expired = [&](EventLoopTimer* timer) { expired.push_back(timer); };
+
+        wheel.advance(102, on_expired);
+        CHECK(expired == std::vector<EventLoopTimer*>{&timers[3]});
+        CHECK(wheel.get_next_wakeup() == 103);
+
+        wheel.advance(104, on_expired);
+        CHECK(expired == std::vector<EventLoopTimer*>{&timers[3], &timers[1], &timers[2]});
+        CHECK(wheel.get_next_wakeup() == 105);
+
+        wheel.advance(105, on_expired);
+        CHECK(expired.size() == 4);
+        CHECK(expired.back() == &timers[0]);
+        CHECK(wheel.size() == 0);
+        CHECK(!wheel.remove(&timers[0]));
+    }
+
+    TEST_CASE("remove") {
+        TimerWheel wheel;
+        EventLoopTimer timers[3];
+        wheel.add(&timers[0], 10);
+        wheel.add(&timers[1], 10);
+        wheel.add(&timers[2], 100000);
+
+        CHECK(wheel.remove(&timers[0]));
+        CHECK(!wheel.remove(&timers[0]));
+        CHECK(wheel.remove(&timers[2]));
+        CHECK(wheel.size() == 1);
+        CHECK(wheel.get_next_wakeup() == 10);
+
+        CHECK(wheel.remove(&timers[1]));
+        CHECK(wheel.get_next_wakeup() == UINT64_MAX);
+    }
+
+    TEST_CASE("cascade") {
+        TimerWheel wheel;
+        wheel.reset(12345);
+
+        EventLoopTimer timer;
+        uint64_t expiry = 12345 + 3 * 65536 + 7 * 256 + 9;
+        wheel.add(&timer, expiry);
+
+        // The wheel wakes up at slot boundaries of the higher levels on its
+        // way to the expiry
+        std::vector<uint64_t> wakeups;
+        uint64_t expired_at = 0;
+        while (wheel.size()) {
+            uint64_t next = wheel.get_next_wakeup();
+            REQUIRE(next <= expiry);
+            wakeups.push_back(next);
+            wheel.advance(next, [&](EventLoopTimer*) { expired_at = wheel.get_now(); });
+        }
+        CHECK(expired_at == expiry);
+        CHECK(wakeups.size() <= TimerWheel::kLevels);
+    }
+
+    TEST_CASE("max delay") {
+        TimerWheel wheel;
+        wheel.reset(1);
+
+        EventLoopTimer timers[2];
+        wheel.add(&timers[0], 1 + TimerWheel::kMaxDelay);
+        wheel.add(&timers[1], UINT64_MAX); // clamped to kMaxDelay
+
+        size_t n_expired = 0;
+        wheel.advance(TimerWheel::kMaxDelay, [&](EventLoopTimer*) { n_expired++; });
+        CHECK(n_expired == 0);
+        wheel.advance(1 + TimerWheel::kMaxDelay, [&](EventLoopTimer*) { n_expired++; });
+        CHECK(n_expired == 2);
+    }
+
+    TEST_CASE("add and remove from callback") {
+        TimerWheel wheel;
+        EventLoopTimer timers[3];
+        wheel.add(&timers[0], 10);
+        wheel.add(&timers[1], 10);
+        wheel.add(&timers[2], 20);
+
+        std::vector<uint64_t> expired_at;
+        wheel.advance(1000, [&](EventLoopTimer* timer) {
+            expired_at.push_back(wheel.get_now());
+            if (timer == &timers[0]) {
+                CHECK(wheel.remove(&timers[1]));
+                CHECK(wheel.remove(&timers[2]));
+                wheel.add(&timers[2], 500);
+                wheel.add(&timers[1], 5); // in the past
+            }
+        });
+        CHECK(expired_at == std::vector<uint64_t>{10, 11, 500});
+    }
+
+    TEST_CASE("random") {
+        // Compares the wheel against a plain list of expiry ticks
+        std::mt19937 rng(42);
+        const size_t n_timers = 2000;
+        std::vector<EventLoopTimer> timers(n_timers);
+        std::vector<uint64_t> expected(n_timers, 0);
+
+        TimerWheel wheel;
+        uint64_t now = 999;
+        wheel.reset(now);
+
+        auto random_delay = [&]() -> uint64_t {
+            switch (rng() % 4) {
+                case 0: return rng() % 256;
+                case 1: return rng() % 65536;
+                case 2: return rng() % (1 << 24);
+                default: return rng() % TimerWheel::kMaxDelay;
+            }
+        };
+
+        for (size_t i = 0; i < n_timers; ++i) {
+            expected[i] = now + 1 + random_delay();
+            wheel.add(&timers[i], expected[i]);
+        }
+
+        for (size_t round = 0; round < 200 && wheel.size(); ++round) {
+            // Remove a few timers and re-add them with a new expiry
+            for (size_t j = 0; j < 5; ++j) {
+                size_t i = rng() % n_timers;
+                if (wheel.remove(&timers[i])) {
+                    expected[i] = now + 1 + random_delay();
+                    wheel.add(&timers[i], expected[i]);
+                }
+            }
+
+            uint64_t step = (round % 2) ? wheel.get_next_wakeup() - now : random_delay();
+            now += step;
+
+            bool ok = true;
+            wheel.advance(now, [&](EventLoopTimer* timer) {
+                size_t i = timer - timers.data();
+                ok = ok && (expected[i] == wheel.get_now());
+                expected[i] = 0;
+            });
+            CHECK(ok);
+
+            for (size_t i = 0; i < n_timers; ++i) {
+                if (expected[i] && expected[i] <= now) {
+                    FAIL("timer " << i << " did not expire at " << expected[i]);
+                }
+            }
+        }
+
+        size_t n_pending = std::count_if(expected.begin(), expected.end(), [](uint64_t e) { return e != 0; });
+        CHECK(wheel.size() == n_pending);
+    }
+}
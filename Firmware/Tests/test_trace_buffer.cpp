@@ -0,0 +1,86 @@
+
+#include <doctest.h>
+#include "MotorControl/trace_buffer.hpp"
+
+#include <vector>
+
+template<size_t kSize>
+static std::vector<uint32_t> read_all(const TraceBuffer<kSize>& buffer) {
+    std::vector<uint32_t> words(2 * kSize + 2);
+    uint32_t n = 0;
+    while (uint32_t got = buffer.read(n, words.data() + n, 3)) {
+        n += got;
+    }
+    words.resize(n);
+    return words;
+}
+
+TEST_SUITE("Trace Buffer") {
+    TEST_CASE("empty") {
+        TraceBuffer<8> buffer;
+        buffer.reset();
+        CHECK(!buffer.is_stopped());
+        CHECK(buffer.get_n_events() == 0);
+        buffer.stop_after(0);
+        CHECK(buffer.is_stopped());
+        CHECK(read_all(buffer).empty());
+    }
+
+    TEST_CASE("in-order") {
+        TraceBuffer<8> buffer;
+        buffer.reset();
+        for (uint32_t i = 0; i < 5; ++i) {
+            buffer.write(100 + i, i);
+        }
+        buffer.stop_after(0);
+        CHECK(buffer.get_n_events() == 5);
+        CHECK(read_all(buffer) == std::vector<uint32_t>{100, 0, 101, 1, 102, 2, 103, 3, 104, 4});
+    }
+
+    TEST_CASE("overwrite-oldest") {
+        TraceBuffer<4> buffer;
+        buffer.reset();
+        for (uint32_t i = 0; i < 10; ++i) {
+            buffer.write(100 + i, i);
+        }
+        buffer.stop_after(0);
+        CHECK(buffer.get_n_events() == 10);
+        CHECK(read_all(buffer) == std::vector<uint32_t>{106, 6, 107, 7, 108, 8, 109, 9});
+
+        // Partial reads start at the oldest event
+        uint32_t words[3];
+        CHECK(buffer.read(3, words, 3) == 3);
+        CHECK(words[0] == 7);
+        CHECK(words[1] == 108);
+        CHECK(words[2] == 8);
+        CHECK(buffer.read(8, words, 3) == 0);
+    }
+
+    TEST_CASE("stop-after") {
+        TraceBuffer<4> buffer;
+        buffer.reset();
+        buffer.write(100, 0);
+        buffer.stop_after(2);
+        buffer.stop_after(100); // the first stop index wins
+        CHECK(!buffer.is_stopped());
+        buffer.write(101, 1);
+        CHECK(!buffer.is_stopped());
+        buffer.write(102, 2);
+        CHECK(buffer.is_stopped());
+        buffer.write(103, 3); // dropped
+        CHECK(buffer.get_n_events() == 3);
+        CHECK(read_all(buffer) == std::vector<uint32_t>{100, 0, 101, 1, 102, 2});
+    }
+
+    TEST_CASE("reset") {
+        TraceBuffer<4> buffer;
+        buffer.reset();
+        buffer.write(100, 0);
+        buffer.stop_after(0);
+        buffer.reset();
+        CHECK(!buffer.is_stopped());
+        buffer.write(200, 1);
+        buffer.stop_after(0);
+        CHECK(read_all(buffer) == std::vector<uint32_t>{200, 1});
+    }
+}
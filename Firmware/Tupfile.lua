@@ -77,6 +77,7 @@ odrive_firmware_pkg = {
         'MotorControl/utils.cpp',
         'MotorControl/arm_sin_f32.c',
         'MotorControl/arm_cos_f32.c',
+        'MotorControl/arm_sin_cos_f32.c',
         'MotorControl/axis.cpp',
         'MotorControl/brake_resistor.cpp',
         'MotorControl/motor.cpp',
@@ -89,8 +90,12 @@ odrive_firmware_pkg = {
         'MotorControl/foc.cpp',
         'MotorControl/open_loop_controller.cpp',
         'MotorControl/oscilloscope.cpp',
+        'MotorControl/telemetry.cpp',
+        'MotorControl/trace.cpp',
         'MotorControl/sensorless_estimator.cpp',
         'MotorControl/trapTraj.cpp',
+        'MotorControl/scurveTraj.cpp',
+        'MotorControl/control_loop.cpp',
         'MotorControl/main.cpp',
         'Drivers/STM32/stm32_system.cpp',
         'Drivers/STM32/stm32_gpio.cpp',
@@ -447,7 +452,86 @@ end
 
 if tup.getconfig('DOCTEST') == 'true' then
     TEST_INCLUDES = '-I. -I./MotorControl -I./fibre-cpp/include -I./Drivers/DRV8301 -I./doctest'
-    tup.foreach_rule('Tests/*.cpp', 'g++ -O3 -std=c++17 '..TEST_INCLUDES..' -c %f -o %o', 'Tests/bin/%B.o')
+    -- Checks the LZSS decoder against the encoder in the interface generator
+    tup.frule{inputs={'Tests/lzss_test_vectors_template.j2'}, command=python_command..' interface_generator_stub.py --definitions odrive-interface.yaml --generate-endpoints '..root_interface..' --template %f --output %o', outputs='autogen/lzss_test_vectors.hpp'}
+    tup.foreach_rule({'Tests/*.cpp', extra_inputs={'autogen/lzss_test_vectors.hpp'}}, 'g++ -O3 -std=c++17 '..TEST_INCLUDES..' -c %f -o %o', 'Tests/bin/%B.o')
     tup.frule{inputs='Tests/bin/*.o', command='g++ %f -o %o', outputs='Tests/test_runner.exe'}
     tup.frule{inputs='Tests/test_runner.exe', command='%f'}
 end
+
+if tup.getconfig('SIMULATOR') == 'true' then
+    SIM_INCLUDES = '-IBoard/sim/Inc -I. -IMotorControl -Ifibre-cpp/include'
+    SIM_FILES = {
+        'Board/sim/board.cpp',
+        'Board/sim/cmsis_os.cpp',
+        'Board/sim/pmsm_model.cpp',
+        'Board/sim/sim_main.cpp',
+        'Board/sim/sin_table.c',
+        'MotorControl/utils.cpp',
+        'MotorControl/arm_sin_f32.c',
+        'MotorControl/arm_cos_f32.c',
+        'MotorControl/arm_sin_cos_f32.c',
+        'MotorControl/axis.cpp',
+        'MotorControl/motor.cpp',
+        'MotorControl/thermistor.cpp',
+        'MotorControl/encoder.cpp',
+        'MotorControl/endstop.cpp',
+        'MotorControl/brake_resistor.cpp',
+        'MotorControl/mechanical_brake.cpp',
+        'MotorControl/controller.cpp',
+        'MotorControl/foc.cpp',
+        'MotorControl/open_loop_controller.cpp',
+        'MotorControl/oscilloscope.cpp',
+        'MotorControl/telemetry.cpp',
+        'MotorControl/trace.cpp',
+        'MotorControl/sensorless_estimator.cpp',
+        'MotorControl/trapTraj.cpp',
+        'MotorControl/scurveTraj.cpp',
+        'MotorControl/acim_estimator.cpp',
+        'MotorControl/control_loop.cpp',
+        'autogen/version.c',
+    }
+    for _, src_file in pairs(SIM_FILES) do
+        compiler = (tup.ext(src_file) == 'c') and 'gcc -O2 -std=c99' or 'g++ -O2 -std=c++17 -Wno-register'
+        tup.frule{
+            inputs={src_file},
+            extra_inputs = {'autogen/interfaces.hpp', 'autogen/function_stubs.hpp', 'autogen/endpoints.hpp', 'autogen/type_info.hpp'},
+            command=compiler..' '..SIM_INCLUDES..' -c %f -o %o',
+            outputs={'build/sim/'..src_file:gsub("/","_"):gsub("%.","")..'.o'}
+        }
+    end
+    tup.frule{inputs='build/sim/*.o', command='g++ %f -o %o', outputs='build/odrive_sim.exe'}
+end
+
+if tup.getconfig('BENCHMARK') == 'true' then
+    -- Built against the simulator board support so that the hot path can be
+    -- timed on the host. Run build/benchmark_runner.exe --baseline
+    -- Benchmarks/baseline.txt to check for regressions.
+    BENCH_INCLUDES = '-IBoard/sim/Inc -I. -IMotorControl -Ifibre-cpp/include'
+    BENCH_FILES = {
+        'Benchmarks/benchmark_runner.cpp',
+        'Benchmarks/bench_anticogging.cpp',
+        'Benchmarks/bench_foc.cpp',
+        'Benchmarks/bench_math.cpp',
+        'Benchmarks/bench_traj.cpp',
+        'Board/sim/cmsis_os.cpp',
+        'Board/sim/sin_table.c',
+        'MotorControl/utils.cpp',
+        'MotorControl/arm_sin_f32.c',
+        'MotorControl/arm_cos_f32.c',
+        'MotorControl/arm_sin_cos_f32.c',
+        'MotorControl/foc.cpp',
+        'MotorControl/trapTraj.cpp',
+        'MotorControl/scurveTraj.cpp',
+    }
+    for _, src_file in pairs(BENCH_FILES) do
+        compiler = (tup.ext(src_file) == 'c') and 'gcc -O3 -std=c99' or 'g++ -O3 -std=c++17 -Wno-register'
+        tup.frule{
+            inputs={src_file},
+            extra_inputs = {'autogen/interfaces.hpp', 'autogen/function_stubs.hpp', 'autogen/endpoints.hpp', 'autogen/type_info.hpp'},
+            command=compiler..' '..BENCH_INCLUDES..' -c %f -o %o',
+            outputs={'build/bench/'..src_file:gsub("/","_"):gsub("%.","")..'.o'}
+        }
+    end
+    tup.frule{inputs='build/bench/*.o', command='g++ %f -o %o', outputs='build/benchmark_runner.exe'}
+end
@@ -71,7 +71,9 @@ void CANSimple::on_received(const can_Message_t& msg) {
 
     for (auto& axis : axes) {
         if ((axis.config_.can.node_id == nodeID) && (axis.config_.can.is_extended == msg.is_extended_id)) {
+            trace.begin(Trace::TRACE_SOURCE_CAN_MESSAGE, get_cmd_id(msg.id));
             do_command(axis, msg);
+            trace.end(Trace::TRACE_SOURCE_CAN_MESSAGE, get_cmd_id(msg.id));
             return;
         }
     }
@@ -185,6 +187,16 @@ void CANSimple::do_command(Axis& axis, const can_Message_t& msg) {
         case MSG_CLEAR_ERRORS:
             clear_errors_callback(axis, msg);
             break;
+        case MSG_SET_LINEAR_COUNT:
+            set_linear_count_callback(axis, msg);
+            break;
+        case MSG_PUSH_PVT_POINT:
+            push_pvt_point_callback(axis, msg);
+            break;
+        case MSG_GET_PVT_STATUS:
+            if (msg.rtr)
+                get_pvt_status_callback(axis, txmsg);
+            break;
         default:
             break;
     }
@@ -257,7 +269,7 @@ void CANSimple::get_iq_callback(const Axis& axis, can_Message_t& txmsg) {
     txmsg.is_extended_id = axis.config_.can.is_extended;
     txmsg.len = 8;
 
-    std::optional<float2D> Idq_setpoint = axis.motor_.current_control_.Idq_setpoint_;
+    std::optional<float2D> Idq_setpoint = axis.motor_.current_control_.setpoints_.read().Idq_setpoint;
     if (!Idq_setpoint.has_value()) {
         Idq_setpoint = {0.0f, 0.0f};
     }
@@ -291,6 +303,16 @@ void CANSimple::get_vbus_voltage_callback(const Axis& axis, can_Message_t& txmsg
     can_setSignal<float>(txmsg, odrv.vbus_voltage_, 0, 32, true);
 }
 
+void CANSimple::get_pvt_status_callback(const Axis& axis, can_Message_t& txmsg) {
+    txmsg.id = axis.config_.can.node_id << NUM_CMD_ID_BITS;
+    txmsg.id += MSG_GET_PVT_STATUS;
+    txmsg.is_extended_id = axis.config_.can.is_extended;
+    txmsg.len = 8;
+
+    can_setSignal<uint32_t>(txmsg, axis.controller_.pvt_queue_.depth(), 0, 32, true);
+    can_setSignal<uint32_t>(txmsg, axis.controller_.pvt_queue_.underrun_count_, 32, 32, true);
+}
+
 void CANSimple::set_axis_nodeid_callback(Axis& axis, const can_Message_t& msg) {
     axis.config_.can.node_id = can_getSignal<uint32_t>(msg, 0, 32, true);
 }
@@ -346,6 +368,12 @@ void CANSimple::set_linear_count_callback(Axis& axis, const can_Message_t& msg){
     axis.encoder_.set_linear_count(can_getSignal<int32_t>(msg, 0, 32, true));
 }
 
+void CANSimple::push_pvt_point_callback(Axis& axis, const can_Message_t& msg) {
+    axis.controller_.push_pvt(can_getSignal<float>(msg, 0, 32, true),
+                              can_getSignal<int16_t>(msg, 32, 16, true, 0.001f, 0),
+                              can_getSignal<uint16_t>(msg, 48, 16, true, 0.0001f, 0));
+}
+
 void CANSimple::estop_callback(Axis& axis, const can_Message_t& msg) {
     axis.error_ |= Axis::ERROR_ESTOP_REQUESTED;
 }
@@ -32,6 +32,9 @@ class CANSimple {
         MSG_RESET_ODRIVE,
         MSG_GET_VBUS_VOLTAGE,
         MSG_CLEAR_ERRORS,
+        MSG_SET_LINEAR_COUNT,
+        MSG_PUSH_PVT_POINT,
+        MSG_GET_PVT_STATUS,
         MSG_CO_HEARTBEAT_CMD = 0x700,  // CANOpen NMT Heartbeat  SEND
     };
 
@@ -67,6 +70,7 @@ class CANSimple {
     void get_iq_callback(const Axis& axis, can_Message_t& txmsg);
     void get_sensorless_estimates_callback(const Axis& axis, can_Message_t& txmsg);
     void get_vbus_voltage_callback(const Axis& axis, can_Message_t& txmsg);
+    void get_pvt_status_callback(const Axis& axis, can_Message_t& txmsg);
 
     // Set functions
     static void set_axis_nodeid_callback(Axis& axis, const can_Message_t& msg);
@@ -81,6 +85,7 @@ class CANSimple {
     static void set_traj_accel_limits_callback(Axis& axis, const can_Message_t& msg);
     static void set_traj_inertia_callback(Axis& axis, const can_Message_t& msg);
     static void set_linear_count_callback(Axis& axis, const can_Message_t& msg);
+    static void push_pvt_point_callback(Axis& axis, const can_Message_t& msg);
 
     // Other functions
     static void estop_callback(Axis& axis, const can_Message_t& msg);
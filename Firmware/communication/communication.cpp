@@ -90,6 +90,10 @@ int _write(int file, const char* data, int len) {
     return len; // Always pretend that we processed everything
 }
 
+void fibre::server_yield() {
+    osDelay(1);
+}
+
 
 #include "../autogen/function_stubs.hpp"
 
@@ -149,14 +149,56 @@ Stm32UsbTxStream usb_native_tx_stream(ODRIVE_IN_EP);
 Stm32UsbRxStream usb_cdc_rx_stream(CDC_OUT_EP);
 Stm32UsbRxStream usb_native_rx_stream(ODRIVE_OUT_EP);
 
+// Shared by fibre responses and telemetry frames
+fibre::AsyncStreamSinkMultiplexer<2> usb_native_tx_multiplexer(usb_native_tx_stream);
+
 LegacyProtocolStreamBased fibre_over_cdc(&usb_cdc_rx_stream, &usb_cdc_tx_stream);
-LegacyProtocolPacketBased fibre_over_usb(&usb_native_rx_stream, &usb_native_tx_stream, USB_TX_DATA_SIZE - 1); // See note on MTU above
+LegacyProtocolPacketBased fibre_over_usb(&usb_native_rx_stream, &usb_native_tx_multiplexer, USB_TX_DATA_SIZE - 1); // See note on MTU above
 
 fibre::AsyncStreamSinkMultiplexer<2> usb_cdc_tx_multiplexer(usb_cdc_tx_stream);
 fibre::BufferedStreamSink<64> usb_cdc_stdout_sink(usb_cdc_tx_multiplexer); // Used in communication.cpp
 AsciiProtocol ascii_over_cdc(&usb_cdc_rx_stream, &usb_cdc_tx_multiplexer);
 
 bool usb_cdc_stdout_pending = false;
+bool usb_telemetry_pending = false;
+bool usb_telemetry_sending = false;
+
+/**
+ * @brief Called from the control loop when a telemetry frame is ready or had
+ * to be dropped.
+ */
+void usb_notify_telemetry() {
+    if (!usb_telemetry_pending) {
+        usb_telemetry_pending = true;
+        if (osMessagePut(usb_event_queue, 8, 0) != osOK) {
+            usb_telemetry_pending = false; // try again with the next frame
+        }
+    }
+}
+
+static void on_telemetry_frame_sent(void*, WriteResult result);
+
+// Sends the telemetry frames directly from the buffers that the control loop
+// wrote them to, one at a time.
+static void send_telemetry_frame() {
+    if (usb_telemetry_sending) {
+        return;
+    }
+    cbufptr_t frame = odrv.telemetry_.get_frame();
+    if (frame.size()) {
+        usb_telemetry_sending = true;
+        usb_native_tx_multiplexer.start_write(frame, nullptr, {on_telemetry_frame_sent, nullptr});
+    }
+}
+
+static void on_telemetry_frame_sent(void*, WriteResult result) {
+    usb_telemetry_sending = false;
+    odrv.telemetry_.release_frame();
+
+    // Don't start the next frame right away so that a pending fibre response
+    // gets the endpoint first.
+    usb_notify_telemetry();
+}
 
 static void usb_server_thread(void * ctx) {
     (void) ctx;
@@ -169,6 +211,7 @@ static void usb_server_thread(void * ctx) {
         }
 
         usb_stats_.rx_cnt++;
+        trace.begin(Trace::TRACE_SOURCE_USB_EVENT, event.value.v);
 
         switch (event.value.v) {
             case 1: { // USB connected event
@@ -188,6 +231,7 @@ static void usb_server_thread(void * ctx) {
             } break;
 
             case 2: { // USB disconnected event
+                odrv.telemetry_.stop(); // nobody is listening anymore
                 usb_cdc_tx_stream.connected_ = false;
                 usb_native_tx_stream.connected_ = false;
                 usb_cdc_rx_stream.connected_ = false;
@@ -218,7 +262,14 @@ static void usb_server_thread(void * ctx) {
                 usb_cdc_stdout_pending = false;
                 usb_cdc_stdout_sink.maybe_start_async_write();
             } break;
+
+            case 8: { // telemetry frame ready
+                usb_telemetry_pending = false;
+                send_telemetry_frame();
+            } break;
         }
+
+        trace.end(Trace::TRACE_SOURCE_USB_EVENT, event.value.v);
     }
 }
 
@@ -32,6 +32,7 @@ void start_usb_server(void);
 #include <fibre/../../stream_utils.hpp>
 extern fibre::BufferedStreamSink<64> usb_cdc_stdout_sink;
 extern bool usb_cdc_stdout_pending;
+void usb_notify_telemetry();
 #endif
 
 #endif // __INTERFACE_USB_HPP
@@ -41,15 +41,18 @@ machine = fibre_run_now(CXX..' -dumpmachine') -- works with both clang and GCC
 
 BUILD_TYPE='-shared'
 enable_tcp = true
+enable_event_loop = false -- provides the worker threads of libfibre_open_sharded()
 
 if string.find(machine, "x86_64.*%-linux%-.*") then
     outname = 'libfibre-linux-amd64.so'
     LDFLAGS += '-lpthread -Wl,--version-script=libfibre.version -Wl,--gc-sections'
     STRIP = not DEBUG
+    enable_event_loop = true
 elseif string.find(machine, "arm.*%-linux%-.*") then
     outname = 'libfibre-linux-armhf.so'
     LDFLAGS += '-lpthread -Wl,--version-script=libfibre.version -Wl,--gc-sections'
     STRIP = false
+    enable_event_loop = true
 elseif string.find(machine, "x86_64.*-mingw.*") then
     outname = 'libfibre-windows-amd64.dll'
     LDFLAGS += '-lpthread -Wl,--version-script=libfibre.version'
@@ -98,6 +101,7 @@ pkg = get_fibre_package({
     enable_tcp_server_backend=get_bool_config("ENABLE_TCP_SERVER_BACKEND", enable_tcp),
     enable_tcp_client_backend=get_bool_config("ENABLE_TCP_CLIENT_BACKEND", enable_tcp),
     enable_libusb_backend=get_bool_config("ENABLE_LIBUSB_BACKEND", true),
+    enable_event_loop=enable_event_loop,
     allow_heap=true,
     pkgconf=(tup.getconfig("USE_PKGCONF") != "") and tup.getconfig("USE_PKGCONF") or nil
 })
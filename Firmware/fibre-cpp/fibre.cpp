@@ -86,6 +86,10 @@ bool fibre::launch_event_loop(Callback<void, EventLoop*> on_started) {
 struct BackendInitializer {
     template<typename T>
     bool operator()(T& backend) {
+        if (!ctx->n_shards) {
+            return true;
+        }
+        backend.set_shard(ctx->shard, ctx->n_shards);
         if (!backend.init(ctx->event_loop)) {
             return false;
         }
@@ -97,6 +101,9 @@ struct BackendInitializer {
 struct BackendDeinitializer {
     template<typename T>
     bool operator()(T& backend) {
+        if (!ctx->n_shards) {
+            return true;
+        }
         ctx->deregister_backend(backend.get_name());
         return backend.deinit();
     }
@@ -114,7 +121,7 @@ bool all(std::tuple<T...> args) {
     return all(args, std::make_index_sequence<sizeof...(T)>());
 }
 
-Context* fibre::open(EventLoop* event_loop) {
+Context* fibre::open(EventLoop* event_loop, size_t shard, size_t n_shards) {
     Context* ctx = my_alloc<Context>();
     if (!ctx) {
         FIBRE_LOG(E) << "already opened";
@@ -122,6 +129,8 @@ Context* fibre::open(EventLoop* event_loop) {
     }
 
     ctx->event_loop = event_loop;
+    ctx->shard = shard;
+    ctx->n_shards = n_shards;
     auto static_backends_good = for_each_in_tuple(BackendInitializer{ctx},
             ctx->static_backends);
 
@@ -257,10 +266,14 @@ void Domain::on_found_root_object(LegacyObjectClient* obj_client, std::shared_pt
 }
 
 void Domain::on_lost_root_object(LegacyObjectClient* obj_client) {
-    auto root_object = root_object_;
-    root_object_ = nullptr;
-    root_intf_ = nullptr;
-    on_lost_object_.invoke(reinterpret_cast<Object*>(root_object));
+    // With several devices on this domain, root_object_ may belong to another
+    // device.
+    auto root_object = reinterpret_cast<Object*>(obj_client->root_obj_.get());
+    if (root_object == root_object_) {
+        root_object_ = nullptr;
+        root_intf_ = nullptr;
+    }
+    on_lost_object_.invoke(root_object);
 }
 #endif
 
@@ -24,9 +24,28 @@ public:
         Callback<void, ChannelDiscoveryResult> on_found_channels) = 0;
     virtual int stop_channel_discovery(ChannelDiscoveryContext* handle) = 0;
 
+    /**
+     * @brief Restricts this discoverer to the channels of one out of n_shards
+     * shards. This is used to spread devices over several event loops, each of
+     * which runs its own instance of the discoverer.
+     *
+     * Discoverers that don't support sharding ignore this.
+     */
+    void set_shard(size_t shard, size_t n_shards) {
+        shard_ = shard;
+        n_shards_ = n_shards;
+    }
+
 protected:
+    // Returns true if the channel with the given key (e.g. a USB address)
+    // belongs to the shard of this discoverer.
+    bool is_in_shard(size_t key) const { return key % n_shards_ == shard_; }
+
     bool try_parse_key(const char* begin, const char* end, const char* key, const char** val_begin, const char** val_end);
     bool try_parse_key(const char* begin, const char* end, const char* key, int* val);
+
+    size_t shard_ = 0;
+    size_t n_shards_ = 1;
 };
 
 }
@@ -18,6 +18,8 @@ struct EventLoopTimer;
  */
 class EventLoop {
 public:
+    virtual ~EventLoop() = default;
+
     /**
      * @brief Registers a callback for immediate execution on the event loop
      * thread.
@@ -49,6 +49,8 @@ struct StaticBackend {
 struct Context {
     size_t n_domains = 0;
     EventLoop* event_loop;
+    size_t shard = 0; // shard of the built-in backends
+    size_t n_shards = 1; // 0 if the built-in backends are not used
 
     std::tuple<
 #if FIBRE_ENABLE_LIBUSB_BACKEND
@@ -126,9 +128,14 @@ private:
  * 
  * If FIBRE_ALLOW_HEAP=0 only one Fibre context can be open at a time.
  * 
+ * @param shard, n_shards: The built-in backends of this context only open the
+ *        channels of devices in the specified shard (see
+ *        ChannelDiscoverer::set_shard()). This allows several contexts to share
+ *        the devices between them, each on its own event loop. If n_shards is 0
+ *        the built-in backends are not used at all.
  * @returns: A non-null pointer on success, null otherwise.
  */
-Context* open(EventLoop* event_loop);
+Context* open(EventLoop* event_loop, size_t shard = 0, size_t n_shards = 1);
 
 void close(Context*);
 
@@ -7,7 +7,8 @@
  * tasks on the event loop.
  * 
  * Some general things to note:
- *  - None of the library's functions are blocking.
+ *  - None of the library's functions are blocking (except for
+ *    libfibre_open_sharded()).
  *  - None of the library's functions can be expected to be thread-safe, they
  *    should not be invoked from any other thread than the one that runs the
  *    event loop.
@@ -161,6 +162,38 @@ typedef void (*on_lost_object_cb_t)(void*, LibFibreObject* obj);
 
 typedef void (*on_stopped_cb_t)(void*, LibFibreStatus);
 
+/**
+ * @brief on_stream_packet callback type for libfibre_subscribe_to_stream_packets().
+ * @param buf: Payload of the stream packet (without marker and sequence number).
+ *        Only valid for the duration of the callback.
+ * @param length: Length of the payload.
+ * @param n_lost: Number of stream packets that were lost between the previous
+ *        packet and this one.
+ */
+typedef void (*on_stream_packet_cb_t)(void* ctx, const uint8_t* buf, size_t length, uint32_t n_lost);
+
+/**
+ * @brief One property access in a call to libfibre_run_batch().
+ * 
+ * Values are in the encoding that is used on the wire, i.e. little endian
+ * with the size of the property's codec.
+ */
+struct LibFibreBatchItem {
+    LibFibreObject* obj; //!< Property object (e.g. obtained from libfibre_get_attribute()).
+    const unsigned char* tx_buf; //!< New value to write or NULL to only read the property.
+    size_t tx_len; //!< Zero or the size of the property.
+    unsigned char* rx_buf; //!< Receives the value of the property before the write.
+    size_t rx_len; //!< At most the size of the property.
+    unsigned char* rx_end; //!< Set by libfibre to the end of the received data.
+};
+
+/**
+ * @brief on_completed callback type for libfibre_run_batch().
+ * @param status: kFibreOk if all items completed, otherwise the status of the
+ *        first item that failed. The items after that one did not run.
+ */
+typedef void (*on_batch_completed_cb_t)(void* ctx, LibFibreStatus status);
+
 typedef void (*on_attribute_added_cb_t)(void*, LibFibreAttribute*, const char* name, size_t name_length, LibFibreInterface*, const char* intf_name, size_t intf_name_length);
 typedef void (*on_attribute_removed_cb_t)(void*, LibFibreAttribute*);
 
@@ -295,7 +328,40 @@ FIBRE_PUBLIC const struct LibFibreVersion* libfibre_get_version();
 FIBRE_PUBLIC struct LibFibreCtx* libfibre_open(LibFibreEventLoop event_loop);
 
 /**
- * @brief Closes a context that was previously opened with libfibre_open().
+ * @brief Opens a Fibre context that spreads the devices over internal worker
+ * threads.
+ * 
+ * Each worker runs its own event loop with its own instance of the built-in
+ * backends (USB, TCP). A worker only opens the devices of its shard. USB
+ * devices are assigned by bus number and address, TCP devices by address.
+ * 
+ * This is experimental. Every call and every result is handed over between
+ * two threads, which adds overhead to each call. Whether that pays off depends
+ * on the number of devices and CPU cores and should be measured for the
+ * application at hand (see test/sharding_benchmark.cpp).
+ * 
+ * For the application nothing else changes: all libfibre functions must still
+ * be called on the application's event loop and all callbacks still run on it.
+ * Results are handed over between the threads with `event_loop.post`. Calls on
+ * an object that was lost fail with kFibreHostUnreachable. The handles of a
+ * lost object remain valid until on_lost_object was invoked for it.
+ * 
+ * Backends registered with libfibre_register_backend() and channels added with
+ * libfibre_add_channels() run on the application's event loop.
+ * 
+ * Unlike the other libfibre functions, this blocks until the workers started.
+ * 
+ * @param event_loop: See libfibre_open().
+ * @param n_workers: Number of worker threads. 0 is the same as calling
+ *        libfibre_open().
+ * @returns: NULL if worker threads are not supported on this platform or if a
+ *           worker failed to start.
+ */
+FIBRE_PUBLIC struct LibFibreCtx* libfibre_open_sharded(LibFibreEventLoop event_loop, size_t n_workers);
+
+/**
+ * @brief Closes a context that was previously opened with libfibre_open() or
+ * libfibre_open_sharded().
  *
  * This function must not be invoked before all ongoing discovery processes
  * are stopped and all channels are closed.
@@ -429,6 +495,40 @@ FIBRE_PUBLIC void libfibre_subscribe_to_interface(LibFibreInterface* interface,
  */
 FIBRE_PUBLIC LibFibreStatus libfibre_get_attribute(LibFibreObject* parent_obj, LibFibreAttribute* attr, LibFibreObject** child_obj_ptr);
 
+/**
+ * @brief Subscribes to the stream packets that the remote device sends on the
+ * channel of the specified object without being asked (e.g. telemetry).
+ * 
+ * There can be one subscriber per channel. A new subscription replaces the
+ * previous one.
+ * 
+ * @param obj: Any object handle of the remote device.
+ * @param on_stream_packet: Invoked on the event loop thread for each stream
+ *        packet. NULL to unsubscribe.
+ * @param cb_ctx: Arbitrary user data passed to the callback.
+ * @returns: kFibreOk or kFibreInvalidArgument
+ */
+FIBRE_PUBLIC LibFibreStatus libfibre_subscribe_to_stream_packets(LibFibreObject* obj, on_stream_packet_cb_t on_stream_packet, void* cb_ctx);
+
+/**
+ * @brief Reads or writes several properties of the same remote device in as
+ * few request packets as possible.
+ * 
+ * The items run in the order in which they are listed. If the remote device
+ * doesn't support batch requests, libfibre falls back to one request per item.
+ * 
+ * @param items: The property accesses to run. All objects must belong to the
+ *        same remote device. The array and all buffers must remain valid until
+ *        on_completed is invoked.
+ * @param n_items: Number of items.
+ * @param on_completed: Invoked once when all items completed or one failed.
+ *        Not invoked unless this function returns kFibreBusy.
+ * @param cb_ctx: Arbitrary user data passed to the callback.
+ * @returns: kFibreBusy, or kFibreInvalidArgument if an item is not a property
+ *        with a plain value type or if the objects belong to different devices.
+ */
+FIBRE_PUBLIC LibFibreStatus libfibre_run_batch(struct LibFibreBatchItem* items, size_t n_items, on_batch_completed_cb_t on_completed, void* cb_ctx);
+
 /**
  * @brief Starts a remote coroutine call or continues or cancels an ongoing call.
  * 
@@ -0,0 +1,213 @@
+#ifndef __FIBRE_JSON_HPP
+#define __FIBRE_JSON_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <ctype.h>
+#include <string.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fibre {
+
+enum JsonType : uint8_t {
+    kJsonString,
+    kJsonInt,
+    kJsonList,
+    kJsonDict,
+};
+
+/**
+ * @brief Reference to a string in the parsed buffer (std::string_view is not
+ * available in C++11).
+ */
+struct JsonStr {
+    const char* ptr;
+    size_t len;
+
+    bool operator==(const char* str) const { return strlen(str) == len && memcmp(ptr, str, len) == 0; }
+    bool operator!=(const char* str) const { return !(*this == str); }
+    bool contains(char c) const { return memchr(ptr, c, len) != nullptr; }
+    std::string to_string() const { return {ptr, ptr + len}; }
+};
+
+/**
+ * @brief Node of a parsed JSON document.
+ *
+ * Strings and dict keys point into the buffer that was parsed, so the buffer
+ * must outlive the nodes. The items of a list or dict are a singly linked list
+ * starting at `first_child`. For dict items, `key` is the key under which the
+ * item is stored.
+ */
+struct JsonNode {
+    JsonType type;
+    int integer;
+    JsonStr str;
+    JsonStr key;
+    const JsonNode* first_child;
+    const JsonNode* next;
+
+    bool is_str() const { return type == kJsonString; }
+    bool is_int() const { return type == kJsonInt; }
+    bool is_list() const { return type == kJsonList; }
+    bool is_dict() const { return type == kJsonDict; }
+
+    bool is_str(const char* val) const { return is_str() && str == val; }
+
+    // Returns the item with the given key or nullptr if this is not a dict or
+    // has no such key.
+    const JsonNode* find(const char* key) const {
+        if (is_dict()) {
+            for (const JsonNode* item = first_child; item; item = item->next) {
+                if (item->key == key) {
+                    return item;
+                }
+            }
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * @brief Allocates JsonNodes in blocks of increasing size and frees them all
+ * at once when the arena is destroyed.
+ */
+class JsonArena {
+public:
+    JsonNode* alloc() {
+        if (used_ == block_size_) {
+            block_size_ = block_size_ ? 2 * block_size_ : 64;
+            blocks_.emplace_back(new JsonNode[block_size_]);
+            used_ = 0;
+        }
+        return &blocks_.back()[used_++];
+    }
+
+private:
+    std::vector<std::unique_ptr<JsonNode[]>> blocks_;
+    size_t block_size_ = 0;
+    size_t used_ = 0;
+};
+
+struct JsonError {
+    const char* ptr;
+    const char* str;
+};
+
+inline void json_skip_whitespace(const char** begin, const char* end) {
+    while (*begin < end && isspace((unsigned char)**begin)) {
+        (*begin)++;
+    }
+}
+
+inline bool json_comp(const char* begin, const char* end, char c) {
+    return begin < end && *begin == c;
+}
+
+inline JsonNode* json_error(JsonError* error, const char* ptr, const char* str) {
+    *error = {ptr, str};
+    return nullptr;
+}
+
+/**
+ * @brief Parses the JSON value at *begin and advances *begin past it.
+ *
+ * Supports the subset of JSON that the interface generator emits: dicts,
+ * lists, strings without escape sequences and non-negative integers. Returns
+ * nullptr and fills in `error` if the input is invalid.
+ */
+inline JsonNode* json_parse(JsonArena* arena, const char** begin, const char* end, JsonError* error) {
+    if (*begin >= end) {
+        return json_error(error, *begin, "expected value but got EOF");
+    }
+
+    JsonNode* node = arena->alloc();
+    *node = {};
+
+    if (json_comp(*begin, end, '{') || json_comp(*begin, end, '[')) {
+        bool is_dict = **begin == '{';
+        char closing = is_dict ? '}' : ']';
+        node->type = is_dict ? kJsonDict : kJsonList;
+        (*begin)++; // consume leading '{' or '['
+        const JsonNode** tail = &node->first_child;
+        bool expect_comma = false;
+
+        json_skip_whitespace(begin, end);
+        while (!json_comp(*begin, end, closing)) {
+            if (expect_comma) {
+                if (!json_comp(*begin, end, ',')) {
+                    return json_error(error, *begin, is_dict ? "expected ',' or '}'" : "expected ',' or ']'");
+                }
+                (*begin)++; // consume comma
+                json_skip_whitespace(begin, end);
+            }
+            expect_comma = true;
+
+            JsonStr key = {nullptr, 0};
+            if (is_dict) {
+                JsonNode* key_node = json_parse(arena, begin, end, error);
+                if (!key_node) return nullptr;
+                if (!key_node->is_str()) {
+                    return json_error(error, *begin, "expected string as key");
+                }
+                key = key_node->str;
+                json_skip_whitespace(begin, end);
+                if (!json_comp(*begin, end, ':')) {
+                    return json_error(error, *begin, "expected :");
+                }
+                (*begin)++;
+                json_skip_whitespace(begin, end);
+            }
+
+            JsonNode* item = json_parse(arena, begin, end, error);
+            if (!item) return nullptr;
+            item->key = key;
+            *tail = item;
+            tail = &item->next;
+
+            json_skip_whitespace(begin, end);
+        }
+
+        (*begin)++; // consume trailing '}' or ']'
+
+    } else if (json_comp(*begin, end, '"')) {
+        node->type = kJsonString;
+        (*begin)++; // consume leading '"'
+        const char* str_begin = *begin;
+
+        while (!json_comp(*begin, end, '"')) {
+            if (*begin >= end) {
+                return json_error(error, *begin, "expected '\"' but got EOF");
+            }
+            if (json_comp(*begin, end, '\\')) {
+                return json_error(error, *begin, "escaped strings not supported");
+            }
+            (*begin)++;
+        }
+
+        node->str = {str_begin, (size_t)(*begin - str_begin)};
+        (*begin)++; // consume trailing '"'
+
+    } else if (isdigit((unsigned char)**begin)) {
+        node->type = kJsonInt;
+        while (*begin < end && isdigit((unsigned char)**begin)) {
+            int digit = **begin - '0';
+            if (node->integer > (INT_MAX - digit) / 10) {
+                return json_error(error, *begin, "integer too large");
+            }
+            node->integer = node->integer * 10 + digit;
+            (*begin)++;
+        }
+
+    } else {
+        return json_error(error, *begin, "unexpected character");
+    }
+
+    return node;
+}
+
+}
+
+#endif // __FIBRE_JSON_HPP
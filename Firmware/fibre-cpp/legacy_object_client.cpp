@@ -5,170 +5,23 @@
 #include "logging.hpp"
 #include "print_utils.hpp"
 #include "crc.hpp"
-#include <variant>
+#include "lzss.hpp"
+#include "json.hpp"
 #include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 DEFINE_LOG_TOPIC(LEGACY_OBJ);
 USE_LOG_TOPIC(LEGACY_OBJ);
 
 using namespace fibre;
 
-struct json_error {
-    const char* ptr;
-    std::string str;
-};
-
-struct json_value;
-using json_list = std::vector<std::shared_ptr<json_value>>;
-using json_dict = std::vector<std::pair<std::shared_ptr<json_value>, std::shared_ptr<json_value>>>;
-using json_value_variant = std::variant<std::string, int, json_list, json_dict, json_error>;
-
-struct json_value : json_value_variant {
-    //json_value(const json_value_variant& v) : json_value_variant{v} {}
-    template<typename T> json_value(T&& arg) : json_value_variant{std::forward<T>(arg)} {}
-    //json_value_variant v;
-};
-
-// helper functions
-bool json_is_str(json_value val) { return val.index() == 0; }
-bool json_is_int(json_value val) { return val.index() == 1; }
-bool json_is_list(json_value val) { return val.index() == 2; }
-bool json_is_dict(json_value val) { return val.index() == 3; }
-bool json_is_err(json_value val) { return val.index() == 4; }
-std::string json_as_str(json_value val) { return std::get<0>(val); }
-int json_as_int(json_value val) { return std::get<1>(val); }
-json_list json_as_list(json_value val) { return std::get<2>(val); }
-json_dict json_as_dict(json_value val) { return std::get<3>(val); }
-json_error json_as_err(json_value val) { return std::get<4>(val); }
-
-json_value json_make_error(const char* ptr, std::string str) {
-    return {json_error{ptr, str}};
-}
-
-
-void json_skip_whitespace(const char** begin, const char* end) {
-    while (*begin < end && std::isspace(**begin)) {
-        (*begin)++;
-    }
-}
-
-bool json_comp(const char* begin, const char* end, char c) {
-    return begin < end && *begin == c;
-}
-
-json_value json_parse(const char** begin, const char* end) {
-    // skip whitespace
-
-    if (*begin >= end) {
-        return json_make_error(*begin, "expected value but got EOF");
-    }
-
-    if (json_comp(*begin, end, '{')) {
-        // parse dict
-        (*begin)++; // consume leading '{'
-        json_dict dict;
-        bool expect_comma = false;
-
-        json_skip_whitespace(begin, end);
-        while (!json_comp(*begin, end, '}')) {
-            if (expect_comma) {
-                if (!json_comp(*begin, end, ',')) {
-                    return json_make_error(*begin, "expected ',' or '}'");
-                }
-                (*begin)++; // consume comma
-                json_skip_whitespace(begin, end);
-            }
-            expect_comma = true;
-
-            // Parse key-value pair
-            json_value key = json_parse(begin, end);
-            if (json_is_err(key)) return key;
-            json_skip_whitespace(begin, end);
-            if (!json_comp(*begin, end, ':')) {
-                return json_make_error(*begin, "expected :");
-            }
-            (*begin)++;
-            json_value val = json_parse(begin, end);
-            if (json_is_err(val)) return val;
-            dict.push_back({std::make_shared<json_value>(key), std::make_shared<json_value>(val)});
-
-            json_skip_whitespace(begin, end);
-        }
-
-        (*begin)++;
-        return {dict};
-
-    } else if (json_comp(*begin, end, '[')) {
-        // parse list
-        (*begin)++; // consume leading '['
-        json_list list;
-        bool expect_comma = false;
-
-        json_skip_whitespace(begin, end);
-        while (!json_comp(*begin, end, ']')) {
-            if (expect_comma) {
-                if (!json_comp(*begin, end, ',')) {
-                    return json_make_error(*begin, "expected ',' or ']'");
-                }
-                (*begin)++; // consume comma
-                json_skip_whitespace(begin, end);
-            }
-            expect_comma = true;
-
-            // Parse item
-            json_value val = json_parse(begin, end);
-            if (json_is_err(val)) return val;
-            list.push_back(std::make_shared<json_value>(val));
-
-            json_skip_whitespace(begin, end);
-        }
-
-        (*begin)++; // consume trailing ']'
-        return {list};
-
-    } else if (json_comp(*begin, end, '"')) {
-        // parse string
-        (*begin)++; // consume leading '"'
-        std::string str;
-
-        while (!json_comp(*begin, end, '"')) {
-            if (*begin >= end) {
-                return json_make_error(*begin, "expected '\"' but got EOF");
-            }
-            if (json_comp(*begin, end, '\\')) {
-                return json_make_error(*begin, "escaped strings not supported");
-            }
-            str.push_back(**begin);
-            (*begin)++;
-        }
-
-        (*begin)++; // consume trailing '"'
-        return {str};
-
-    } else if (std::isdigit(**begin)) {
-        // parse int
-
-        std::string str;
-        while (*begin < end && std::isdigit(**begin)) {
-            str.push_back(**begin);
-            (*begin)++;
-        }
-
-        return {std::stoi(str)}; // note: this can throw an exception if the int is too long
-
-    } else {
-        return json_make_error(*begin, "unexpected character '" + std::string(*begin, *begin + 1) + "'");
-    }
-}
-
-json_value json_dict_find(json_dict dict, std::string key) {
-    auto it = std::find_if(dict.begin(), dict.end(),
-        [&](std::pair<std::shared_ptr<json_value>, std::shared_ptr<json_value>>& kv){
-            return json_is_str(*kv.first) && json_as_str(*kv.first) == key;
-        });
-    return (it == dict.end()) ? json_make_error(nullptr, "key not found") : *it->second;
-}
-
 // not sure if this function exists in the STL
 template<typename TIt, typename TFunc, typename TNum = decltype(std::declval<TFunc>()(*std::declval<TIt>()))>
 TNum calc_sum(TIt begin, TIt end, TFunc func) {
@@ -198,45 +51,157 @@ size_t get_codec_size(std::string codec) {
     return (it == codecs.end()) ? 0 : it->second;
 }
 
-std::vector<LegacyFibreArg> parse_arglist(const json_value& list_val) {
+size_t LegacyFunction::get_block_element_size() const {
+    if (outputs.size() != 1) {
+        return 0;
+    }
+    const std::string& codec = outputs[0].protocol_codec;
+    if (codec.size() < 2 || codec.compare(codec.size() - 2, 2, "[]") != 0) {
+        return 0;
+    }
+    return get_codec_size(codec.substr(0, codec.size() - 2));
+}
+
+std::vector<LegacyFibreArg> parse_arglist(const JsonNode* list_val) {
     std::vector<LegacyFibreArg> arglist;
 
-    for (auto& arg : json_is_list(list_val) ? json_as_list(list_val) : json_list()) {
-        if (!json_is_dict(*arg)) {
-            FIBRE_LOG(W) << "arglist is invalid";
-            continue;
-        }
-        auto dict = json_as_dict(*arg);
-        
-        json_value name_val = json_dict_find(dict, "name");
-        json_value id_val = json_dict_find(dict, "id");
-        json_value type_val = json_dict_find(dict, "type");
+    for (const JsonNode* arg = (list_val && list_val->is_list()) ? list_val->first_child : nullptr; arg; arg = arg->next) {
+        const JsonNode* name_val = arg->find("name");
+        const JsonNode* id_val = arg->find("id");
+        const JsonNode* type_val = arg->find("type");
 
-        if (!json_is_str(name_val) || !json_is_int(id_val) || ((int)(size_t)json_as_int(id_val) != json_as_int(id_val)) || !json_is_str(type_val)) {
+        if (!name_val || !name_val->is_str() || !id_val || !id_val->is_int() || !type_val || !type_val->is_str()) {
             FIBRE_LOG(W) << "arglist is invalid";
             continue;
         }
 
+        std::string type = type_val->str.to_string();
 
         arglist.push_back({
-            json_as_str(name_val),
-            json_as_str(type_val),
-            (json_as_str(type_val) == "endpoint_ref") ? "object_ref" : json_as_str(type_val),
-            get_codec_size(json_as_str(type_val)),
-            (json_as_str(type_val) == "endpoint_ref") ? sizeof(uintptr_t) : get_codec_size(json_as_str(type_val)),
-            (size_t)json_as_int(id_val),
+            name_val->str.to_string(),
+            type,
+            (type == "endpoint_ref") ? "object_ref" : type,
+            get_codec_size(type),
+            (type == "endpoint_ref") ? sizeof(uintptr_t) : get_codec_size(type),
+            (size_t)id_val->integer,
         });
     }
 
     return arglist;
 }
 
+// Returns the directory in which the JSON definitions of known devices are
+// cached or an empty string if caching is disabled.
+static std::string get_json_cache_dir() {
+#if defined(EMSCRIPTEN)
+    return "";
+#else
+    if (const char* dir = getenv("FIBRE_CACHE_DIR")) {
+        return dir;
+    }
+#  if defined(_WIN32) || defined(_WIN64)
+    const char* base = getenv("LOCALAPPDATA");
+    return base ? std::string{base} + "\\fibre" : "";
+#  else
+    if (const char* base = getenv("XDG_CACHE_HOME")) {
+        return std::string{base} + "/fibre";
+    }
+    const char* home = getenv("HOME");
+    return home ? std::string{home} + "/.cache/fibre" : "";
+#  endif
+#endif
+}
+
+static std::string get_json_cache_path(uint32_t version_id) {
+    std::string dir = get_json_cache_dir();
+    if (dir.empty()) {
+        return "";
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "/json-%08x.json", (unsigned int)version_id);
+    return dir + name;
+}
+
+// Creates the directory and its parent if they don't exist yet
+static void make_cache_dir(std::string path) {
+    size_t sep = path.find_last_of("/\\");
+    for (std::string dir: {path.substr(0, sep == std::string::npos ? 0 : sep), path}) {
+        if (dir.empty()) {
+            continue;
+        }
+#if defined(_WIN32) || defined(_WIN64)
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+    }
+}
+
+// Same as json_version_id_ on the server
+static uint32_t calc_json_version_id(const std::vector<uint8_t>& json) {
+    uint16_t crc = calc_crc16<CANONICAL_CRC16_POLYNOMIAL>(PROTOCOL_VERSION, json.data(), json.size());
+    return ((uint32_t)crc << 16) | calc_crc16<CANONICAL_CRC16_POLYNOMIAL>(crc, json.data(), json.size());
+}
+
+static bool load_cached_json(uint32_t version_id, std::vector<uint8_t>* json) {
+    std::string path = get_json_cache_path(version_id);
+    FILE* file = path.empty() ? nullptr : fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    std::vector<uint8_t> buf;
+    uint8_t chunk[4096];
+    while (size_t n_read = fread(chunk, 1, sizeof(chunk), file)) {
+        buf.insert(buf.end(), chunk, chunk + n_read);
+    }
+    fclose(file);
+
+    if (calc_json_version_id(buf) != version_id) {
+        FIBRE_LOG(W) << "ignoring corrupt cache file " << path;
+        return false;
+    }
+
+    *json = std::move(buf);
+    return true;
+}
+
+static void store_cached_json(uint32_t version_id, const std::vector<uint8_t>& json) {
+    std::string path = get_json_cache_path(version_id);
+    if (path.empty()) {
+        return;
+    }
+    make_cache_dir(get_json_cache_dir());
+
+    // Write to a temporary file first so that other processes never see a
+    // partial file. The name is unique per client so that two clients which
+    // download the same definition at the same time don't share the file.
+    std::string tmp_path = path + "." + std::to_string(reinterpret_cast<uintptr_t>(&json)) + ".tmp";
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if (!file) {
+        FIBRE_LOG(D) << "cannot write cache file " << tmp_path;
+        return;
+    }
+
+    bool ok = fwrite(json.data(), 1, json.size(), file) == json.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+    }
+}
+
 void LegacyObjectClient::start(Callback<void, LegacyObjectClient*, std::shared_ptr<LegacyObject>> on_found_root_object, Callback<void, LegacyObjectClient*> on_lost_root_object) {
     FIBRE_LOG(D) << "start";
     on_found_root_object_ = on_found_root_object;
     on_lost_root_object_ = on_lost_root_object;
     json_.clear();
-    receive_more_json();
+    version_id_ = std::nullopt;
+    compression_ = std::nullopt;
+
+    // Ask for the JSON version ID first. If the JSON is in the cache, this and
+    // the batch probe are the only requests before the object tree is ready.
+    write_le<uint32_t>(0xffffffff, tx_buf_);
+    protocol_->start_endpoint_operation(0, tx_buf_, version_buf_, &op_handle_, MEMBER_CB(this, on_received_version));
 }
 
 std::shared_ptr<FibreInterface> LegacyObjectClient::get_property_interfaces(std::string codec, bool write) {
@@ -267,10 +232,8 @@ std::shared_ptr<FibreInterface> LegacyObjectClient::get_property_interfaces(std:
     return intf_ptr;
 }
 
-std::shared_ptr<LegacyObject> LegacyObjectClient::load_object(json_value list_val) {
-    
-
-    if (!json_is_list(list_val)) {
+std::shared_ptr<LegacyObject> LegacyObjectClient::load_object(const JsonNode* list_val) {
+    if (!list_val || !list_val->is_list()) {
         FIBRE_LOG(W) << "interface members must be a list";
         return nullptr;
     }
@@ -284,50 +247,48 @@ std::shared_ptr<LegacyObject> LegacyObjectClient::load_object(json_value list_va
     auto obj_ptr = std::make_shared<LegacyObject>(obj);
     FibreInterface& intf = *obj_ptr->intf;
 
-    for (auto& item: json_as_list(list_val)) {
-        if (!json_is_dict(*item)) {
+    for (const JsonNode* item = list_val->first_child; item; item = item->next) {
+        if (!item->is_dict()) {
             FIBRE_LOG(W) << "expected dict";
             continue;
         }
-        auto dict = json_as_dict(*item);
 
-        json_value type = json_dict_find(dict, "type");
-        json_value name_val = json_dict_find(dict, "name");
-        std::string name = json_is_str(name_val) ? json_as_str(name_val) : "[anonymous]";
+        const JsonNode* type = item->find("type");
+        const JsonNode* name_val = item->find("name");
+        std::string name = (name_val && name_val->is_str()) ? name_val->str.to_string() : "[anonymous]";
 
-        if (json_is_str(type) && json_as_str(type) == "object") {
-            std::shared_ptr<LegacyObject> subobj = load_object(json_dict_find(dict, "members"));
+        if (type && type->is_str("object")) {
+            std::shared_ptr<LegacyObject> subobj = load_object(item->find("members"));
             intf.attributes[name] = {subobj};
 
-        } else if (json_is_str(type) && json_as_str(type) == "function") {
-            json_value id = json_dict_find(dict, "id");
-            if (!json_is_int(id) || ((int)(size_t)json_as_int(id) != json_as_int(id))) {
+        } else if (type && type->is_str("function")) {
+            const JsonNode* id = item->find("id");
+            if (!id || !id->is_int()) {
                 continue;
             }
             intf.functions.emplace(name, LegacyFunction{
-                (size_t)json_as_int(id),
+                (size_t)id->integer,
                 obj_ptr.get(),
-                parse_arglist(json_dict_find(dict, "inputs")),
-                parse_arglist(json_dict_find(dict, "outputs"))
+                parse_arglist(item->find("inputs")),
+                parse_arglist(item->find("outputs"))
             });
 
-        } else if (json_is_str(type) && json_as_str(type) == "json") {
+        } else if (type && type->is_str("json")) {
             // Ignore
 
-        } else if (json_is_str(type)) {
-            std::string type_str = json_as_str(type);
-            json_value access = json_dict_find(dict, "access");
-            std::string access_str = json_is_str(access) ? json_as_str(access) : "r";
-            bool can_write = access_str.find('w') != std::string::npos;
+        } else if (type && type->is_str()) {
+            std::string type_str = type->str.to_string();
+            const JsonNode* access = item->find("access");
+            bool can_write = access && access->is_str() && access->str.contains('w');
 
-            json_value id = json_dict_find(dict, "id");
-            if (!json_is_int(id) || ((int)(size_t)json_as_int(id) != json_as_int(id))) {
+            const JsonNode* id = item->find("id");
+            if (!id || !id->is_int()) {
                 continue;
             }
 
             LegacyObject subobj{
                 .client = this,
-                .ep_num = (size_t)json_as_int(id),
+                .ep_num = (size_t)id->integer,
                 .intf = get_property_interfaces(type_str, can_write),
                 .known_to_application = false
             };
@@ -344,8 +305,66 @@ std::shared_ptr<LegacyObject> LegacyObjectClient::load_object(json_value list_va
     return obj_ptr;
 }
 
+void LegacyObjectClient::on_received_version(EndpointOperationResult result) {
+    op_handle_ = 0;
+
+    if (result.status == kStreamCancelled) {
+        return;
+    } else if (result.status == kStreamClosed) {
+        return;
+    } else if (result.status != kStreamOk) {
+        FIBRE_LOG(W) << "JSON version read operation failed";
+        return;
+    }
+
+    cbufptr_t version_buf = {version_buf_, result.rx_end};
+    version_id_ = read_le<uint32_t>(&version_buf);
+
+    if (version_id_.has_value()) {
+        FIBRE_LOG(D) << "JSON version ID is " << as_hex(*version_id_);
+
+        if (load_cached_json(*version_id_, &json_)) {
+            FIBRE_LOG(D) << "loaded JSON from cache";
+            on_received_all_json();
+            return;
+        }
+    }
+
+    // Servers without JSON compression return an empty response
+    write_le<uint32_t>(JSON_COMPRESSION_INFO_OFFSET, tx_buf_);
+    protocol_->start_endpoint_operation(0, tx_buf_, compression_info_buf_, &op_handle_, MEMBER_CB(this, on_received_compression_info));
+}
+
+void LegacyObjectClient::on_received_compression_info(EndpointOperationResult result) {
+    op_handle_ = 0;
+
+    if (result.status == kStreamCancelled) {
+        return;
+    } else if (result.status == kStreamClosed) {
+        return;
+    } else if (result.status != kStreamOk) {
+        FIBRE_LOG(W) << "JSON compression info read operation failed";
+        return;
+    }
+
+    cbufptr_t info_buf = {compression_info_buf_, result.rx_end};
+    std::optional<uint32_t> length = read_le<uint32_t>(&info_buf);
+    std::optional<uint32_t> compressed_length = read_le<uint32_t>(&info_buf);
+    std::optional<uint8_t> window_bits = read_le<uint8_t>(&info_buf);
+    std::optional<uint8_t> lookahead_bits = read_le<uint8_t>(&info_buf);
+
+    if (lookahead_bits.has_value() && *window_bits <= 16 && *lookahead_bits <= 16) {
+        FIBRE_LOG(D) << "downloading compressed JSON";
+        compression_ = JsonCompression{*length, *compressed_length, *window_bits, *lookahead_bits};
+    } else {
+        compression_ = std::nullopt;
+    }
+
+    receive_more_json();
+}
+
 void LegacyObjectClient::receive_more_json() {
-    write_le<uint32_t>(json_.size(), tx_buf_);
+    write_le<uint32_t>(json_.size() | (compression_.has_value() ? JSON_COMPRESSED_FLAG : 0), tx_buf_);
     json_.resize(json_.size() + 1024);
     bufptr_t rx_buf = {json_.data() + json_.size() - 1024, json_.data() + json_.size()};
     protocol_->start_endpoint_operation(0, tx_buf_, rx_buf, &op_handle_, MEMBER_CB(this, on_received_json));
@@ -368,35 +387,101 @@ void LegacyObjectClient::on_received_json(EndpointOperationResult result) {
     size_t n_received = result.rx_end - json_.data() - json_.size() + 1024;
     json_.resize(json_.size() - 1024 + n_received);
 
-    if (n_received) {
+    // With compression, the length is known and the last (empty) read can be
+    // skipped
+    bool done = compression_.has_value() ? (!n_received || json_.size() >= compression_->compressed_length) : !n_received;
+
+    if (!done) {
         receive_more_json();
 
     } else {
+        if (compression_.has_value() && !decompress_json()) {
+            return;
+        }
 
         FIBRE_LOG(D) << "received JSON of length " << json_.size();
-        //FIBRE_LOG(D) << "JSON: " << str{json_.data(), json_.data() + json_.size()};
-
-        const char *begin = reinterpret_cast<const char*>(json_.data());
-        auto val = json_parse(&begin, begin + json_.size());
 
-        if (json_is_err(val)) {
-            size_t pos = json_as_err(val).ptr - reinterpret_cast<const char*>(json_.data());
-            FIBRE_LOG(E) << "JSON parsing error: " << json_as_err(val).str << " at position " << pos;
-            return;
-        } else if (!json_is_list(val)) {
-            FIBRE_LOG(E) << "JSON data must be a list";
-            return;
+        if (version_id_.has_value() && calc_json_version_id(json_) == *version_id_) {
+            store_cached_json(*version_id_, json_);
         }
 
-        FIBRE_LOG(D) << "sucessfully parsed JSON";
-        root_obj_ = load_object(val);
-        json_crc_ = calc_crc16<CANONICAL_CRC16_POLYNOMIAL>(PROTOCOL_VERSION, json_.data(), json_.size());
-        if (root_obj_) {
-            on_found_root_object_.invoke_and_clear(this, root_obj_);
-        }
+        on_received_all_json();
     }
 }
 
+bool LegacyObjectClient::decompress_json() {
+    std::vector<uint8_t> window((size_t)1 << compression_->window_bits);
+    LzssDecoder decoder{json_.data(), json_.size(), window.data(), compression_->window_bits, compression_->lookahead_bits};
+
+    std::vector<uint8_t> json;
+    json.reserve(compression_->length);
+    uint8_t byte;
+    while (json.size() < compression_->length && decoder.get(&byte)) {
+        json.push_back(byte);
+    }
+
+    if (json.size() != compression_->length) {
+        FIBRE_LOG(E) << "compressed JSON ended after " << json.size() << " of " << compression_->length << " bytes";
+        return false;
+    }
+
+    json_ = std::move(json);
+    return true;
+}
+
+void LegacyObjectClient::on_received_all_json() {
+    //FIBRE_LOG(D) << "JSON: " << str{json_.data(), json_.data() + json_.size()};
+
+    const char *begin = reinterpret_cast<const char*>(json_.data());
+    JsonArena arena;
+    JsonError error;
+    const JsonNode* val = json_parse(&arena, &begin, begin + json_.size(), &error);
+
+    if (!val) {
+        size_t pos = error.ptr - reinterpret_cast<const char*>(json_.data());
+        FIBRE_LOG(E) << "JSON parsing error: " << error.str << " at position " << pos;
+        return;
+    } else if (!val->is_list()) {
+        FIBRE_LOG(E) << "JSON data must be a list";
+        return;
+    }
+
+    FIBRE_LOG(D) << "sucessfully parsed JSON";
+    root_obj_ = load_object(val);
+    json_crc_ = calc_crc16<CANONICAL_CRC16_POLYNOMIAL>(PROTOCOL_VERSION, json_.data(), json_.size());
+    if (!root_obj_) {
+        return;
+    }
+
+    // Find out if the server supports batch requests before the application
+    // can start any. The probe is one entry for the call endpoint without
+    // inputs, which has no effect on any server. A server with batch support
+    // answers with the entry's output length, all others with an empty
+    // response. An empty response to a later batch request can't tell these
+    // apart because the server also skips entries that it can't run.
+    write_le<uint16_t>(CALL_ENDPOINT_ID, batch_probe_tx_buf_);
+    batch_probe_tx_buf_[2] = 0; // input length
+    batch_probe_tx_buf_[3] = 0; // expected output length
+    protocol_->start_endpoint_operation(BATCH_ENDPOINT_ID, batch_probe_tx_buf_, batch_probe_rx_buf_, &op_handle_, MEMBER_CB(this, on_received_batch_probe));
+}
+
+void LegacyObjectClient::on_received_batch_probe(EndpointOperationResult result) {
+    op_handle_ = 0;
+
+    if (result.status == kStreamCancelled) {
+        return;
+    } else if (result.status == kStreamClosed) {
+        return;
+    } else if (result.status != kStreamOk) {
+        FIBRE_LOG(W) << "batch probe failed";
+        return;
+    }
+
+    batch_supported_ = result.rx_end != batch_probe_rx_buf_;
+    FIBRE_LOG(D) << "server " << (batch_supported_ ? "supports" : "does not support") << " batch requests";
+    on_found_root_object_.invoke_and_clear(this, root_obj_);
+}
+
 
 std::optional<CallBufferRelease> LegacyFunction::call(void** call_handle,
         CallBuffers buffers,
@@ -538,6 +623,133 @@ bool LegacyObjectClient::transcode(cbufptr_t src, bufptr_t dst, std::string src_
     return true;
 }
 
+void LegacyObjectClient::start_batch(LegacyBatchItem* items, size_t n_items, Callback<void, StreamStatus> callback) {
+    LegacyBatchContext* ctx = new LegacyBatchContext();
+    ctx->client_ = this;
+    ctx->items_ = items;
+    ctx->n_items_ = n_items;
+    ctx->callback_ = callback;
+    ctx->send_next();
+}
+
+void LegacyBatchContext::send_next() {
+    if (pos_ == n_items_) {
+        complete(kStreamOk);
+        return;
+    }
+
+    // A batch of one item would only add overhead
+    n_packed_ = client_->batch_supported_ ? pack() : 0;
+
+    if (n_packed_ >= 2) {
+        client_->protocol_->start_endpoint_operation(BATCH_ENDPOINT_ID, tx_buf_, rx_buf_, &op_handle_, MEMBER_CB(this, on_batch_finished));
+    } else {
+        send_single();
+    }
+}
+
+void LegacyBatchContext::send_single() {
+    LegacyBatchItem& item = items_[pos_];
+    client_->protocol_->start_endpoint_operation(item.ep_num, item.tx_buf, item.rx_buf, &op_handle_, MEMBER_CB(this, on_single_finished));
+}
+
+/**
+ * @brief Encodes as many items as fit into one request, starting at pos_, and
+ * returns their number.
+ */
+size_t LegacyBatchContext::pack() {
+    size_t mtu = client_->protocol_->tx_mtu_;
+    size_t max_request_size = std::max(mtu, (size_t)8) - 8; // seqno, endpoint ID, length, trailer
+    size_t max_response_size = std::max(mtu, (size_t)2) - 2; // seqno
+
+    tx_buf_.clear();
+    size_t response_size = 0;
+    size_t n_packed = 0;
+
+    for (; pos_ + n_packed < n_items_; ++n_packed) {
+        LegacyBatchItem& item = items_[pos_ + n_packed];
+        if (item.ep_num == 0 || item.ep_num == BATCH_ENDPOINT_ID
+            || item.tx_buf.size() > UINT8_MAX || item.rx_buf.size() > UINT8_MAX
+            || tx_buf_.size() + 4 + item.tx_buf.size() > max_request_size
+            || response_size + 1 + item.rx_buf.size() > max_response_size) {
+            break;
+        }
+
+        size_t pos = tx_buf_.size();
+        tx_buf_.resize(pos + 4 + item.tx_buf.size());
+        write_le<uint16_t>(item.ep_num, tx_buf_.data() + pos);
+        tx_buf_[pos + 2] = (uint8_t)item.tx_buf.size();
+        tx_buf_[pos + 3] = (uint8_t)item.rx_buf.size();
+        std::copy(item.tx_buf.begin(), item.tx_buf.end(), tx_buf_.begin() + pos + 4);
+        response_size += 1 + item.rx_buf.size();
+    }
+
+    rx_buf_.resize(response_size);
+    return n_packed;
+}
+
+void LegacyBatchContext::on_single_finished(EndpointOperationResult result) {
+    op_handle_ = 0;
+
+    if (result.status != kStreamOk) {
+        complete(result.status);
+        return;
+    }
+
+    LegacyBatchItem& item = items_[pos_++];
+    item.tx_buf = {result.tx_end, item.tx_buf.end()};
+    item.rx_buf = {result.rx_end, item.rx_buf.end()};
+    send_next();
+}
+
+void LegacyBatchContext::on_batch_finished(EndpointOperationResult result) {
+    op_handle_ = 0;
+
+    if (result.status != kStreamOk) {
+        complete(result.status);
+        return;
+    }
+
+    cbufptr_t response = {rx_buf_.data(), result.rx_end};
+    size_t n_done = 0;
+
+    for (; n_done < n_packed_; ++n_done) {
+        std::optional<uint8_t> length = read_le<uint8_t>(&response);
+        if (!length.has_value()) {
+            break; // the server left the remaining items for the next request
+        }
+
+        LegacyBatchItem& item = items_[pos_ + n_done];
+        if (*length > item.rx_buf.size() || *length > response.size()) {
+            FIBRE_LOG(W) << "malformed batch response";
+            complete(kStreamError);
+            return;
+        }
+
+        std::copy_n(response.begin(), *length, item.rx_buf.begin());
+        item.tx_buf = item.tx_buf.skip(item.tx_buf.size());
+        item.rx_buf = item.rx_buf.skip(*length);
+        response = response.skip(*length);
+    }
+
+    if (!n_done) {
+        // The server didn't run the first entry, for example because its
+        // output didn't fit into the server's smaller response buffer.
+        FIBRE_LOG(D) << "batch request made no progress";
+        send_single();
+        return;
+    }
+
+    pos_ += n_done;
+    send_next();
+}
+
+void LegacyBatchContext::complete(StreamStatus status) {
+    Callback<void, StreamStatus> callback = callback_;
+    delete this;
+    callback.invoke(status);
+}
+
 
 std::variant<LegacyCallContext::ContinueWithApp, LegacyCallContext::ContinueWithProtocol, LegacyCallContext::InternalError> LegacyCallContext::get_next_task(std::variant<ResultFromApp, ResultFromProtocol> continue_from) {
     if (progress == 0) {
@@ -577,9 +789,29 @@ std::variant<LegacyCallContext::ContinueWithApp, LegacyCallContext::ContinueWith
             return ContinueWithApp{kFibreInternalError, app_tx_end_, app_rx_buf_.begin()};
         }
 
-        tx_pos_ = result_from_protocol.tx_end - tx_buf_.data();
-        if (result_from_protocol.rx_end) {
-            rx_pos_ = result_from_protocol.rx_end - rx_buf_.data();
+        if (calling_) {
+            calling_ = false;
+            size_t n_received = result_from_protocol.rx_end ? result_from_protocol.rx_end - call_rx_buf_.data() : 0;
+
+            if (!n_received) {
+                // Servers without the call endpoint return an empty response.
+                // From now on functions are called with one endpoint operation
+                // per argument.
+                FIBRE_LOG(D) << "server does not support call requests";
+                obj_->client->call_supported_ = false;
+                progress = 1;
+                return get_next_operation();
+            } else if (call_rx_buf_[0] != 1 || n_received != call_rx_buf_.size()) {
+                FIBRE_LOG(W) << "call request failed";
+                return ContinueWithApp{kFibreInternalError, app_tx_end_, app_rx_buf_.begin()};
+            }
+
+            std::copy(call_rx_buf_.begin() + 1, call_rx_buf_.end(), rx_buf_.begin());
+        } else {
+            tx_pos_ = result_from_protocol.tx_end - tx_buf_.data();
+            if (result_from_protocol.rx_end) {
+                rx_pos_ = result_from_protocol.rx_end - rx_buf_.data();
+            }
         }
 
     } else if (progress == func_->inputs.size() + 2 + func_->outputs.size()) {
@@ -620,12 +852,30 @@ std::variant<LegacyCallContext::ContinueWithApp, LegacyCallContext::ContinueWith
                     arg.app_codec, arg.protocol_codec)) {
                 return ContinueWithApp{kFibreInternalError, app_tx_end_, app_rx_buf_.begin()};
             }
+            tx_pos_ += arg.app_size;
             transcoded_pos += arg.protocol_size;
         }
 
         tx_buf_ = transcoded;
         tx_pos_ = 0;
 
+        if (size_t element_size = func_->get_block_element_size()) {
+            // The last input is the number of elements to read. The device
+            // may return fewer elements than requested.
+            if (tx_buf_.size() < 4) {
+                return ContinueWithApp{kFibreInternalError, app_tx_end_, app_rx_buf_.begin()};
+            }
+            cbufptr_t count_buf = cbufptr_t{tx_buf_}.skip(tx_buf_.size() - 4);
+            uint32_t count = *read_le<uint32_t>(&count_buf);
+            rx_buf_.resize(std::min<size_t>((size_t)count * element_size, UINT16_MAX / element_size * element_size));
+        }
+
+    } else if (progress == func_->inputs.size() + 1 + func_->outputs.size() && func_->get_block_element_size()) {
+        // Block outputs use the same encoding on both sides. Only keep the
+        // elements that were actually received.
+        rx_buf_.resize(rx_pos_ / func_->get_block_element_size() * func_->get_block_element_size());
+        rx_pos_ = 0;
+
     } else if (progress == func_->inputs.size() + 1 + func_->outputs.size()) {
         // Transcode from protocol codec to application codec
 
@@ -646,6 +896,7 @@ std::variant<LegacyCallContext::ContinueWithApp, LegacyCallContext::ContinueWith
                     arg.protocol_codec, arg.app_codec)) {
                 return ContinueWithApp{kFibreInternalError, app_tx_end_, app_rx_buf_.begin()};
             }
+            rx_pos_ += arg.protocol_size;
             transcoded_pos += arg.app_size;
         }
 
@@ -654,12 +905,31 @@ std::variant<LegacyCallContext::ContinueWithApp, LegacyCallContext::ContinueWith
     }
 
     progress++;
+    return get_next_operation();
+}
 
+std::variant<LegacyCallContext::ContinueWithApp, LegacyCallContext::ContinueWithProtocol, LegacyCallContext::InternalError> LegacyCallContext::get_next_operation() {
     if (progress == 1 && obj_->ep_num) {
         // Single Endpoint Function - exchange everything in one go
         progress = func_->inputs.size() + 1 + func_->outputs.size();
         return ContinueWithProtocol{obj_->client->protocol_, obj_->ep_num, tx_buf_, rx_buf_};
 
+    } else if (progress == 1 && func_->get_block_element_size()) {
+        // Block read functions are also served by a single endpoint
+        progress = func_->inputs.size() + 1 + func_->outputs.size();
+        return ContinueWithProtocol{obj_->client->protocol_, func_->ep_num, tx_buf_, rx_buf_};
+
+    } else if (progress == 1 && obj_->client->call_supported_ && (func_->inputs.size() || func_->outputs.size())
+            && 8 + 2 + tx_buf_.size() <= obj_->client->protocol_->tx_mtu_ && 2 + 1 + rx_buf_.size() <= obj_->client->protocol_->tx_mtu_) {
+        // Send all inputs and receive all outputs with one call request
+        progress = func_->inputs.size() + 1 + func_->outputs.size();
+        calling_ = true;
+        call_tx_buf_.resize(2);
+        write_le<uint16_t>((uint16_t)func_->ep_num, call_tx_buf_.data());
+        call_tx_buf_.insert(call_tx_buf_.end(), tx_buf_.begin(), tx_buf_.end());
+        call_rx_buf_.resize(1 + rx_buf_.size());
+        return ContinueWithProtocol{obj_->client->protocol_, CALL_ENDPOINT_ID, call_tx_buf_, call_rx_buf_};
+
     } else if (progress <= func_->inputs.size()) {
         // send arg
         auto arg = func_->inputs[progress - 1];
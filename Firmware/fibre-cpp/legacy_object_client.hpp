@@ -10,10 +10,10 @@
 #include <fibre/cpp_utils.hpp> // std::variant and std::optional C++ backport
 #include <fibre/fibre.hpp>
 
-struct json_value;
-
 namespace fibre {
 
+struct JsonNode;
+
 struct EndpointOperationResult {
     StreamStatus status;
     const uint8_t* tx_end;
@@ -46,6 +46,10 @@ struct LegacyFunction : Function {
     std::optional<CallBufferRelease>
     call(void**, CallBuffers, Callback<std::optional<CallBuffers>, CallBufferRelease>) final;
 
+    // Block read functions have one variable-length output (codec "T[]").
+    // Returns the size of one element or 0 for all other functions.
+    size_t get_block_element_size() const;
+
     size_t ep_num; // 0 for property read/write/exchange functions
     LegacyObject* obj_; // null for property read/write/exchange functions (all other functions are associated with one object only)
     std::vector<LegacyFibreArg> inputs;
@@ -88,6 +92,10 @@ struct LegacyCallContext {
     std::vector<uint8_t> rx_buf_;
     size_t rx_pos_ = 0;
 
+    bool calling_ = false; //!< waiting for the response to a call request
+    std::vector<uint8_t> call_tx_buf_;
+    std::vector<uint8_t> call_rx_buf_;
+
     const uint8_t* app_tx_end_;
     bufptr_t app_rx_buf_;
 
@@ -115,6 +123,44 @@ struct LegacyCallContext {
 
     // Returns control either to the application or to the next endpoint operation
     std::variant<ContinueWithApp, ContinueWithProtocol, InternalError> get_next_task(std::variant<ResultFromApp, ResultFromProtocol> continue_from);
+
+private:
+    std::variant<ContinueWithApp, ContinueWithProtocol, InternalError> get_next_operation();
+};
+
+struct LegacyBatchItem {
+    size_t ep_num;
+    cbufptr_t tx_buf; // advanced past the sent data when the batch completes
+    bufptr_t rx_buf; // advanced past the received data when the batch completes
+};
+
+/**
+ * @brief Runs the endpoint operations of several LegacyBatchItems in order,
+ * packing as many of them as possible into one request to the batch endpoint
+ * of the server (see docs/protocol.md).
+ *
+ * Items that don't fit into a batch request, items that the server didn't run
+ * and all items on servers without batch support are sent as individual
+ * endpoint operations.
+ */
+struct LegacyBatchContext {
+    LegacyObjectClient* client_;
+    LegacyBatchItem* items_;
+    size_t n_items_;
+    Callback<void, StreamStatus> callback_;
+
+    size_t pos_ = 0; //!< first item that did not complete yet
+    size_t n_packed_ = 0; //!< number of items in the ongoing batch request
+    EndpointOperationHandle op_handle_ = 0;
+    std::vector<uint8_t> tx_buf_;
+    std::vector<uint8_t> rx_buf_;
+
+    void send_next();
+    void send_single();
+    size_t pack();
+    void on_single_finished(EndpointOperationResult result);
+    void on_batch_finished(EndpointOperationResult result);
+    void complete(StreamStatus status);
 };
 
 class LegacyObjectClient {
@@ -124,6 +170,10 @@ public:
     void start(Callback<void, LegacyObjectClient*, std::shared_ptr<LegacyObject>> on_found_root_object, Callback<void, LegacyObjectClient*> on_lost_root_object);
     bool transcode(cbufptr_t src, bufptr_t dst, std::string src_codec, std::string dst_codec);
 
+    // Runs the items in order with as few requests as possible. The items and
+    // their buffers must remain valid until the callback is invoked.
+    void start_batch(LegacyBatchItem* items, size_t n_items, Callback<void, StreamStatus> callback);
+
     // For direct access by LegacyProtocolPacketBased and libfibre.cpp
     uint16_t json_crc_ = 0;
     Callback<void, LegacyObjectClient*> on_lost_root_object_;
@@ -131,15 +181,35 @@ public:
     std::vector<std::shared_ptr<LegacyObject>> objects_;
     void* user_data_; // used by libfibre to store the libfibre context pointer
     LegacyProtocolPacketBased* protocol_;
+    bool batch_supported_ = false; // set when the server answers the batch probe on connect
+    bool call_supported_ = true; // cleared when the server ignores a call request
 
 private:
     std::shared_ptr<FibreInterface> get_property_interfaces(std::string codec, bool write);
-    std::shared_ptr<LegacyObject> load_object(json_value list_val);
+    std::shared_ptr<LegacyObject> load_object(const JsonNode* list_val);
+    void on_received_version(EndpointOperationResult result);
+    void on_received_compression_info(EndpointOperationResult result);
     void receive_more_json();
     void on_received_json(EndpointOperationResult result);
+    bool decompress_json();
+    void on_received_all_json();
+    void on_received_batch_probe(EndpointOperationResult result);
 
     Callback<void, LegacyObjectClient*, std::shared_ptr<LegacyObject>> on_found_root_object_;
     uint8_t tx_buf_[4] = {0xff, 0xff, 0xff, 0xff};
+    uint8_t version_buf_[4];
+    std::optional<uint32_t> version_id_; // JSON version ID reported by the server
+
+    struct JsonCompression {
+        uint32_t length; // uncompressed
+        uint32_t compressed_length;
+        uint8_t window_bits;
+        uint8_t lookahead_bits;
+    };
+    uint8_t compression_info_buf_[10];
+    uint8_t batch_probe_tx_buf_[4];
+    uint8_t batch_probe_rx_buf_[1];
+    std::optional<JsonCompression> compression_; // set while downloading the compressed JSON
     EndpointOperationHandle op_handle_ = 0;
     std::vector<uint8_t> json_;
     //std::vector<LegacyCallContext*> pending_calls_;
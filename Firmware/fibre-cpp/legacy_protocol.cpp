@@ -4,9 +4,11 @@
 
 #include "protocol.hpp"
 #include "crc.hpp"
+#include "lzss.hpp"
 #include "logging.hpp"
 #include "print_utils.hpp"
 #include <fibre/async_stream.hpp>
+#include <atomic>
 #include <memory>
 #include <stdlib.h>
 
@@ -199,42 +201,73 @@ void PacketUnwrapper::complete(ReadResult result) {
  *        ongoing operation. If the completer is invoked directly from within
  *        this function then the handle is not set later than invoking the
  *        completer.
+ *
+ * If kMaxWaiting operations are already waiting for a place in the window, the
+ * operation fails right away with kStreamError.
  */
 void LegacyProtocolPacketBased::start_endpoint_operation(uint16_t endpoint_id, cbufptr_t tx_buf, bufptr_t rx_buf, EndpointOperationHandle* handle, Callback<void, EndpointOperationResult> callback) {
-    outbound_seq_no_ = ((outbound_seq_no_ + 1) & 0x7fff);
+    if (n_waiting_ >= kMaxWaiting) {
+        FIBRE_LOG(W) << "too many endpoint operations waiting";
+        if (handle) {
+            *handle = 0;
+        }
+        callback.invoke({kStreamError, tx_buf.begin(), rx_buf.begin()});
+        return;
+    }
 
-    EndpointOperation op = {
-        .seqno = (uint16_t)(outbound_seq_no_ | 0x0080), // FIXME: we hardwire one bit of the seq-no to 1 to avoid conflicts with the ODrive ASCII protocol
-        .endpoint_id = endpoint_id,
-        .tx_buf = tx_buf,
-        .rx_buf = rx_buf,
-        .callback = callback
-    };
+    outbound_seq_no_ = next_counter(outbound_seq_no_);
+
+    EndpointOperation op;
+    op.counter = outbound_seq_no_;
+    op.seqno = (uint16_t)(outbound_seq_no_ | 0x0080); // FIXME: we hardwire one bit of the seq-no to 1 to avoid conflicts with the ODrive ASCII protocol
+    op.endpoint_id = endpoint_id;
+    op.tx_buf = tx_buf;
+    op.rx_buf = rx_buf;
+    op.busy = true;
+    op.callback = callback;
 
     if (handle) {
-        *handle = op.seqno | 0xffff0000;
+        *handle = to_handle(op);
+    }
+
+    EndpointOperation& slot = window_[op.counter & (kWindow - 1)];
+
+    if (n_waiting_ || slot.busy) {
+        // Control is returned to this operation once the operations before it
+        // completed.
+        FIBRE_LOG(D) << "window full. Enqueuing endpoint operation.";
+        waiting_operation(n_waiting_++) = op;
+        return;
     }
 
+    slot = op;
+    send_next_operation();
+}
+
+/**
+ * @brief Sends the next operation in the window that wasn't sent yet, unless
+ * the TX channel is busy. In that case this is called again when TX finishes.
+ */
+void LegacyProtocolPacketBased::send_next_operation() {
     if (tx_handle_) {
-        FIBRE_LOG(D) << "Endpoint operation already in progress. Enqueuing this one.";
-
-        // A TX operation is already in progress
-        if (pending_operation_.has_value()) {
-            // Previous endpoint operation was not yet sent. We don't support
-            // enqueuing multiple endpoint operations while the first didn't send yet.
-            FIBRE_LOG(E) << "previous endpoint operation still not sent";
-            callback.invoke_and_clear({kStreamError, tx_buf.begin(), rx_buf.begin()});
-        } else {
-            // Control is returned to start_endpoint_operation once TX completes
-            pending_operation_ = op;
-        }
         return;
     }
 
-    start_endpoint_operation(op);
+    // All operations before the first waiting one are in the window
+    uint16_t end = n_waiting_ ? waiting_operation(0).counter : next_counter(outbound_seq_no_);
+
+    while (tx_counter_ != end) {
+        EndpointOperation& op = window_[tx_counter_ & (kWindow - 1)];
+        bool is_unsent = op.busy && op.counter == tx_counter_; // the operation might have been cancelled
+        tx_counter_ = next_counter(tx_counter_);
+        if (is_unsent) {
+            send_operation(op);
+            return;
+        }
+    }
 }
 
-void LegacyProtocolPacketBased::start_endpoint_operation(EndpointOperation op) {
+void LegacyProtocolPacketBased::send_operation(EndpointOperation& op) {
     write_le<uint16_t>(op.seqno, tx_buf_);
     write_le<uint16_t>(op.endpoint_id | 0x8000, tx_buf_ + 2);
     write_le<uint16_t>(op.rx_buf.size(), tx_buf_ + 4);
@@ -249,47 +282,79 @@ void LegacyProtocolPacketBased::start_endpoint_operation(EndpointOperation op) {
 
     write_le<uint16_t>(trailer, tx_buf_ + 6 + n_payload);
 
-    expected_acks_[op.seqno] = op;
-    transmitting_op_ = op.seqno | 0xffff0000;
+    transmitting_op_ = to_handle(op);
     tx_channel_->start_write(cbufptr_t{tx_buf_}.take(8 + n_payload), &tx_handle_, MEMBER_CB(this, on_write_finished));
 }
 
+/**
+ * @brief Removes the i-th waiting operation and closes the gap.
+ */
+void LegacyProtocolPacketBased::pop_waiting_operation(size_t i) {
+    if (i == 0) {
+        waiting_head_ = (waiting_head_ + 1) % kMaxWaiting;
+    } else {
+        for (; i + 1 < n_waiting_; ++i) {
+            waiting_operation(i) = waiting_operation(i + 1);
+        }
+    }
+    n_waiting_--;
+}
+
+/**
+ * @brief Frees the window slot of the operation, moves waiting operations into
+ * the window and then invokes the operation's callback.
+ *
+ * Waiting operations enter the window before the callback runs so that they
+ * stay ahead of any operation that the callback starts.
+ */
+void LegacyProtocolPacketBased::complete_operation(EndpointOperation& op, EndpointOperationResult result) {
+    Callback<void, EndpointOperationResult> callback = op.callback;
+    op.busy = false;
+    op.callback = nullptr;
+
+    while (n_waiting_) {
+        EndpointOperation& slot = window_[waiting_operation(0).counter & (kWindow - 1)];
+        if (slot.busy) {
+            break;
+        }
+        slot = waiting_operation(0);
+        pop_waiting_operation(0);
+    }
+
+    callback.invoke(result);
+}
 
 void LegacyProtocolPacketBased::cancel_endpoint_operation(EndpointOperationHandle handle) {
     if (!handle) {
         return;
     }
 
-    uint16_t seqno = static_cast<uint16_t>(handle & 0xffff);
-
-    Callback<void, EndpointOperationResult> callback;
-    const uint8_t* tx_end = nullptr;
-    uint8_t* rx_end = nullptr;
+    uint16_t counter = static_cast<uint16_t>(handle & 0xffff);
 
-    if (pending_operation_.has_value() && pending_operation_->seqno == seqno) {
-        callback = pending_operation_->callback;
-        tx_end = pending_operation_->tx_buf.begin();
-        rx_end = pending_operation_->rx_buf.begin();
-        pending_operation_ = std::nullopt;
+    for (size_t i = 0; i < n_waiting_; ++i) {
+        if (waiting_operation(i).counter == counter) {
+            EndpointOperation op = waiting_operation(i);
+            pop_waiting_operation(i);
+            op.callback.invoke_and_clear({kStreamCancelled, op.tx_buf.begin(), op.rx_buf.begin()});
+            return;
+        }
     }
 
-    auto it = expected_acks_.find(seqno);
-
-    if (it != expected_acks_.end()) {
-        callback = it->second.callback;
-        tx_end = it->second.tx_buf.begin();
-        rx_end = it->second.rx_buf.begin();
-        expected_acks_.erase(it);
+    EndpointOperation& op = window_[counter & (kWindow - 1)];
+    if (!op.busy || op.counter != counter) {
+        return; // already completed
     }
 
     if (transmitting_op_ == handle) {
         // Cancel the TX task because it belongs to the endpoint operation that
-        // is being cancelled.
+        // is being cancelled. The operation completes once TX finished.
+        op.cancelled = true;
         tx_channel_->cancel_write(tx_handle_);
     } else {
         // Either we're waiting for an ack on this operation or it has not yet
         // been sent. In both cases we can just complete immediately.
-        callback.invoke_and_clear({kStreamCancelled, tx_end, rx_end});
+        complete_operation(op, {kStreamCancelled, op.tx_buf.begin(), op.rx_buf.begin()});
+        send_next_operation();
     }
 }
 
@@ -297,6 +362,17 @@ void LegacyProtocolPacketBased::cancel_endpoint_operation(EndpointOperationHandl
 
 #if FIBRE_ENABLE_SERVER
 
+// Decoder for clients that read the uncompressed JSON (libfibre before JSON
+// compression). Reads are usually sequential, so the decoder continues where
+// the previous read ended. That needs the window to outlive the read, so it is
+// allocated statically. All interfaces share it, so a read from one interface
+// waits until the read from another one is done. Clients that read at the same
+// time make each other restart from the beginning, so concurrent downloads are
+// slow.
+static std::atomic<bool> json_decoder_busy{false};
+static uint8_t json_decoder_window[1 << JSON_WINDOW_BITS];
+static LzssDecoder json_decoder{embedded_json_compressed, embedded_json_compressed_length, json_decoder_window, JSON_WINDOW_BITS, JSON_LOOKAHEAD_BITS};
+
 // Returns part of the JSON interface definition.
 bool fibre::endpoint0_handler(fibre::cbufptr_t* input_buffer, fibre::bufptr_t* output_buffer) {
     // The request must contain a 32 bit integer to specify an offset
@@ -305,19 +381,96 @@ bool fibre::endpoint0_handler(fibre::cbufptr_t* input_buffer, fibre::bufptr_t* o
     if (!offset.has_value()) {
         // Didn't receive any offset
         return false;
-    } else if (*offset == 0xffffffff) {
+    } else if (*offset == JSON_VERSION_ID_OFFSET) {
         // If the offset is special value 0xFFFFFFFF, send back the JSON version ID instead
         return write_le<uint32_t>(json_version_id_, output_buffer);
+    } else if (*offset == JSON_COMPRESSION_INFO_OFFSET) {
+        return write_le<uint32_t>(embedded_json_length, output_buffer)
+            && write_le<uint32_t>(embedded_json_compressed_length, output_buffer)
+            && write_le<uint8_t>(JSON_WINDOW_BITS, output_buffer)
+            && write_le<uint8_t>(JSON_LOOKAHEAD_BITS, output_buffer);
+    } else if (*offset & JSON_COMPRESSED_FLAG) {
+        // Return part of the compressed JSON
+        size_t compressed_offset = *offset & ~JSON_COMPRESSED_FLAG;
+        if (compressed_offset < embedded_json_compressed_length) {
+            size_t n_copy = std::min(output_buffer->size(), embedded_json_compressed_length - compressed_offset);
+            memcpy(output_buffer->begin(), embedded_json_compressed + compressed_offset, n_copy);
+            *output_buffer = output_buffer->skip(n_copy);
+        }
+        return true;
     } else if (*offset >= embedded_json_length) {
         // Attempt to read beyond the buffer end - return empty response
         return true;
-    } else {
-        // Return part of the json file
-        size_t n_copy = std::min(output_buffer->size(), embedded_json_length - (size_t)*offset);
-        memcpy(output_buffer->begin(), embedded_json + *offset, n_copy);
-        *output_buffer = output_buffer->skip(n_copy);
-        return true;
     }
+
+    // Return part of the uncompressed JSON
+    while (json_decoder_busy.exchange(true)) {
+        server_yield(); // In use by a read on another interface
+    }
+
+    uint8_t byte;
+    if (json_decoder.get_position() > *offset) {
+        json_decoder.reset();
+    }
+    while (json_decoder.get_position() < *offset && json_decoder.get(&byte)) {
+    }
+    while (output_buffer->size() && json_decoder.get_position() < embedded_json_length && json_decoder.get(&byte)) {
+        *output_buffer->begin() = byte;
+        *output_buffer = output_buffer->skip(1);
+    }
+
+    json_decoder_busy = false;
+    return true;
+}
+
+// Runs the endpoint operations that the client packed into one request. Each
+// entry of the request is [endpoint_id (u16), input length (u8), expected
+// output length (u8), input] and produces [output length (u8), output] in the
+// response. Entries whose output doesn't fit into the response anymore are not
+// run. The client sends them again in the next request.
+bool fibre::batch_endpoint_handler(fibre::cbufptr_t* input_buffer, fibre::bufptr_t* output_buffer) {
+    while (input_buffer->size()) {
+        std::optional<uint16_t> endpoint_id = read_le<uint16_t>(input_buffer);
+        std::optional<uint8_t> input_length = read_le<uint8_t>(input_buffer);
+        std::optional<uint8_t> output_length = read_le<uint8_t>(input_buffer);
+
+        if (!output_length.has_value() || *input_length > input_buffer->size()) {
+            return false; // malformed entry
+        } else if (*endpoint_id == 0 || *endpoint_id == BATCH_ENDPOINT_ID) {
+            return false; // these endpoints use a different trailer or would recurse
+        } else if (output_buffer->size() < 1 + (size_t)*output_length) {
+            return true;
+        }
+
+        fibre::cbufptr_t input = input_buffer->take(*input_length);
+        fibre::bufptr_t output = output_buffer->skip(1).take(*output_length);
+        *input_buffer = input_buffer->skip(*input_length);
+
+        endpoint_handler(*endpoint_id, &input, &output);
+
+        size_t n_written = *output_length - output.size();
+        (*output_buffer)[0] = (uint8_t)n_written;
+        *output_buffer = output_buffer->skip(1 + n_written);
+    }
+    return true;
+}
+
+// Runs a function with the inputs from the request instead of the values of its
+// argument properties. The request is [function endpoint ID (u16), inputs] and
+// the response is [status (u8), outputs], where the status is 1 on success.
+// The outputs are not stored in the output properties of the function.
+bool fibre::call_endpoint_handler(fibre::cbufptr_t* input_buffer, fibre::bufptr_t* output_buffer) {
+    std::optional<uint16_t> endpoint_id = read_le<uint16_t>(input_buffer);
+    if (!endpoint_id.has_value() || !output_buffer->size()) {
+        return false;
+    }
+
+    fibre::bufptr_t outputs = output_buffer->skip(1);
+    bool success = function_call_handler(*endpoint_id, input_buffer, &outputs);
+
+    (*output_buffer)[0] = success ? 1 : 0;
+    *output_buffer = success ? outputs : output_buffer->skip(1);
+    return success;
 }
 
 #endif
@@ -332,29 +485,25 @@ void LegacyProtocolPacketBased::on_write_finished(WriteResult result) {
 
 #if FIBRE_ENABLE_CLIENT
     if (transmitting_op_) {
-        uint16_t seqno = transmitting_op_ & 0xffff;
+        EndpointOperation& op = window_[transmitting_op_ & (kWindow - 1)];
         transmitting_op_ = 0;
 
-        auto it = expected_acks_.find(seqno);
-
         size_t n_sent = std::max((size_t)(result.end - tx_buf_), (size_t)8) - 8;
-        it->second.tx_buf = it->second.tx_buf.skip(n_sent);
-        it->second.tx_done = true;
+        op.tx_buf = op.tx_buf.skip(n_sent);
+        op.tx_done = true;
 
-        if (it->second.rx_done) {
+        if (op.cancelled) {
+            complete_operation(op, {kStreamCancelled, op.tx_buf.begin(), op.rx_buf.begin()});
+        } else if (op.rx_done) {
             // It's possible that the RX operation completes before the TX operation
-            auto op = it->second;
-            expected_acks_.erase(it);
-            op.callback.invoke_and_clear({kStreamOk, op.tx_buf.begin(), op.rx_buf.begin()});
+            complete_operation(op, {kStreamOk, op.tx_buf.begin(), op.rx_buf.begin()});
         } else if (result.status != kStreamOk) {
             // If the TX task was a remote endpoint operation but didn't succeed
             // we terminate that operation
-            auto op = it->second;
-            expected_acks_.erase(it);
-            op.callback.invoke_and_clear({result.status, result.end, op.rx_buf.begin()});
+            complete_operation(op, {result.status, result.end, op.rx_buf.begin()});
         }
 
-        if (transmitting_op_) {
+        if (tx_handle_) {
             return;
         }
     }
@@ -369,25 +518,15 @@ void LegacyProtocolPacketBased::on_write_finished(WriteResult result) {
         uint8_t* rx_end = rx_end_;
         rx_end_ = nullptr;
         on_read_finished({kStreamOk, rx_end});
-#if FIBRE_ENABLE_CLIENT
-        if (transmitting_op_) {
+        if (tx_handle_) {
             return;
         }
-#endif
     }
 #endif
 
 #if FIBRE_ENABLE_CLIENT
-    if (pending_operation_.has_value()) {
-        // There is a write operation pending from the client side (i.e. an
-        // outgoing remote endpoint operation).
-        EndpointOperation op = *pending_operation_;
-        pending_operation_ = std::nullopt;
-        start_endpoint_operation(op);
-        if (transmitting_op_) {
-            return;
-        }
-    }
+    // Send the next outgoing remote endpoint operation, if any
+    send_next_operation();
 #endif
 }
 
@@ -423,22 +562,22 @@ void LegacyProtocolPacketBased::on_read_finished(ReadResult result) {
 
 #if FIBRE_ENABLE_CLIENT
         
-        auto it = expected_acks_.find(*seq_no & 0x7fff);
+        uint16_t seqno = *seq_no & 0x7fff;
+        EndpointOperation& op = window_[seqno & (kWindow - 1)];
 
-        if (it == expected_acks_.end()) {
-            FIBRE_LOG(W) << "received unexpected ACK: " << (*seq_no & 0x7fff);
+        if (!op.busy || op.seqno != seqno || op.rx_done) {
+            FIBRE_LOG(W) << "received unexpected ACK: " << seqno;
         } else {
-            size_t n_copy = std::min((size_t)(result.end - rx_buf.begin()), it->second.rx_buf.size());
-            memcpy(it->second.rx_buf.begin(), rx_buf.begin(), n_copy);
-            it->second.rx_buf = it->second.rx_buf.skip(n_copy);
-            it->second.rx_done = true;
-            FIBRE_LOG(T) << "received ACK: " << (*seq_no & 0x7fff);
+            size_t n_copy = std::min((size_t)(result.end - rx_buf.begin()), op.rx_buf.size());
+            memcpy(op.rx_buf.begin(), rx_buf.begin(), n_copy);
+            op.rx_buf = op.rx_buf.skip(n_copy);
+            op.rx_done = true;
+            FIBRE_LOG(T) << "received ACK: " << seqno;
 
             // It's possible that the RX operation completes before the TX operation
-            if (it->second.tx_done) {
-                auto op = it->second;
-                expected_acks_.erase(it);
-                op.callback.invoke_and_clear({kStreamOk, op.tx_buf.begin(), op.rx_buf.begin()});
+            if (op.tx_done) {
+                complete_operation(op, {kStreamOk, op.tx_buf.begin(), op.rx_buf.begin()});
+                send_next_operation();
             }
         }
 
@@ -446,6 +585,11 @@ void LegacyProtocolPacketBased::on_read_finished(ReadResult result) {
         FIBRE_LOG(W) << "received ack but client support is not compiled in";
 #endif
 
+#if FIBRE_ENABLE_CLIENT
+    } else if (*seq_no == STREAM_PACKET_MARKER) {
+        on_stream_packet(rx_buf);
+#endif
+
     } else {
 
 #if FIBRE_ENABLE_SERVER
@@ -510,6 +654,20 @@ void LegacyProtocolPacketBased::on_read_finished(ReadResult result) {
     rx_channel_->start_read(rx_buf_, &dummy, MEMBER_CB(this, on_read_finished));
 }
 
+#if FIBRE_ENABLE_CLIENT
+void LegacyProtocolPacketBased::on_stream_packet(cbufptr_t packet) {
+    std::optional<uint16_t> seqno = read_le<uint16_t>(&packet);
+    if (!seqno.has_value()) {
+        FIBRE_LOG(W) << "stream packet too short";
+        return;
+    }
+
+    uint32_t n_lost = stream_seqno_.has_value() ? (uint16_t)(*seqno - *stream_seqno_ - 1) : 0;
+    stream_seqno_ = seqno;
+    on_stream_packet_.invoke(packet, n_lost);
+}
+#endif
+
 void LegacyProtocolPacketBased::on_rx_closed(StreamStatus status) {
     if (tx_handle_) {
         // TX operation still in progress - cancel TX operation and defer closing
@@ -525,24 +683,26 @@ void LegacyProtocolPacketBased::on_rx_closed(StreamStatus status) {
 void LegacyProtocolPacketBased::on_rx_tx_closed(StreamStatus status) {
 
 #if FIBRE_ENABLE_CLIENT
-    // Cancel pending endpoint operation
-    if (pending_operation_.has_value()) {
-        pending_operation_->callback.invoke_and_clear({status, pending_operation_->tx_buf.begin(), pending_operation_->rx_buf.begin()});
-        pending_operation_ = std::nullopt;
+    // Cancel all waiting and ongoing endpoint operations. Operations that the
+    // callbacks start are left alone.
+    for (size_t n = n_waiting_; n && n_waiting_; --n) {
+        EndpointOperation op = waiting_operation(0);
+        pop_waiting_operation(0);
+        op.callback.invoke_and_clear({status, op.tx_buf.begin(), op.rx_buf.begin()});
     }
-
-    // Cancel all ongoing endpoint operations
-    for (auto& item: expected_acks_) {
-        if (item.second.callback) {
-            item.second.callback.invoke_and_clear({status, item.second.tx_buf.begin(), item.second.rx_buf.begin()});
+    for (auto& op: window_) {
+        if (op.busy) {
+            op.busy = false;
+            op.callback.invoke_and_clear({status, op.tx_buf.begin(), op.rx_buf.begin()});
         }
     }
-    expected_acks_.clear();
 
     // Report that the root object was lost
+    // root_obj_ is only cleared afterwards so that the callback can tell
+    // which object was lost.
     if (client_.on_lost_root_object_ && client_.root_obj_) {
-        client_.root_obj_ = nullptr;
         client_.on_lost_root_object_.invoke(&client_);
+        client_.root_obj_ = nullptr;
     }
 #endif
     on_stopped_.invoke_and_clear(this, status);
@@ -5,10 +5,23 @@
 
 #ifdef FIBRE_ENABLE_CLIENT
 #include "legacy_object_client.hpp"
-#include <unordered_map>
+#include <array>
 #include <optional>
 #endif
 
+#ifndef FIBRE_LEGACY_PROTOCOL_WINDOW
+// Maximum number of endpoint operations that the client side of one
+// connection keeps in flight. Further operations wait until an earlier one
+// completes. Must be a power of two and at most 64.
+#  define FIBRE_LEGACY_PROTOCOL_WINDOW 8
+#endif
+
+#ifndef FIBRE_LEGACY_PROTOCOL_MAX_WAITING
+// Maximum number of endpoint operations that wait for a place in the window.
+// Starting an operation while this many are waiting fails.
+#  define FIBRE_LEGACY_PROTOCOL_MAX_WAITING 64
+#endif
+
 namespace fibre {
 
 // Default CRC-8 Polynomial: x^8 + x^5 + x^4 + x^2 + x + 1
@@ -28,6 +41,32 @@ constexpr uint8_t CANONICAL_PREFIX = 0xAA;
 
 constexpr uint16_t PROTOCOL_VERSION = 1;
 
+// First two bytes of a stream packet, i.e. a packet that the server sends
+// without a request (see docs/protocol.md). The MSB and bit 7 are clear so
+// this can't be mistaken for a response or for a request from a client.
+constexpr uint16_t STREAM_PACKET_MARKER = 0x5354;
+
+// Endpoint that runs several endpoint operations in one request (see
+// batch_endpoint_handler() and docs/protocol.md). Servers that don't know it
+// return an empty response.
+constexpr uint16_t BATCH_ENDPOINT_ID = 0x7fff;
+
+// Endpoint that runs a function with all of its inputs and returns all of its
+// outputs in one request (see call_endpoint_handler() and docs/protocol.md).
+// Servers that don't know it return an empty response.
+constexpr uint16_t CALL_ENDPOINT_ID = 0x7ffe;
+
+// Parameters of the LZSS compression of the JSON definition (see lzss.hpp).
+// The server keeps one window of 2^JSON_WINDOW_BITS bytes for clients that
+// read the uncompressed JSON.
+constexpr uint8_t JSON_WINDOW_BITS = 10;
+constexpr uint8_t JSON_LOOKAHEAD_BITS = 5;
+
+// Special offsets for read requests on endpoint 0
+constexpr uint32_t JSON_VERSION_ID_OFFSET = 0xffffffff;
+constexpr uint32_t JSON_COMPRESSION_INFO_OFFSET = 0xfffffffe;
+constexpr uint32_t JSON_COMPRESSED_FLAG = 0x80000000;
+
 
 class PacketWrapper : public AsyncStreamSink {
 public:
@@ -111,6 +150,11 @@ public:
     void cancel_endpoint_operation(EndpointOperationHandle handle);
 
     LegacyObjectClient client_{this};
+
+    // Invoked for each stream packet with the payload that follows the
+    // sequence number and the number of packets that were lost before this
+    // one (according to the sequence number).
+    Callback<void, cbufptr_t, uint32_t> on_stream_packet_;
 #endif
 
 #if FIBRE_ENABLE_CLIENT
@@ -122,22 +166,53 @@ public:
 private:
 
 #if FIBRE_ENABLE_CLIENT
+    static constexpr size_t kWindow = FIBRE_LEGACY_PROTOCOL_WINDOW;
+    static_assert(kWindow && !(kWindow & (kWindow - 1)) && kWindow <= 64, "invalid window size");
+    static constexpr size_t kMaxWaiting = FIBRE_LEGACY_PROTOCOL_MAX_WAITING;
+
     struct EndpointOperation {
-        uint16_t seqno;
-        uint16_t endpoint_id;
-        cbufptr_t tx_buf;
-        bool tx_done;
-        bufptr_t rx_buf;
-        bool rx_done;
+        uint16_t counter = 0; // increments by one for each operation
+        uint16_t seqno = 0; // sequence number on the wire
+        uint16_t endpoint_id = 0;
+        cbufptr_t tx_buf = {nullptr, nullptr};
+        bool tx_done = false;
+        bufptr_t rx_buf = {nullptr, nullptr};
+        bool rx_done = false;
+        bool busy = false; // the slot in window_ is in use
+        bool cancelled = false; // cancelled while it was being sent
         Callback<void, EndpointOperationResult> callback;
     };
 
-    void start_endpoint_operation(EndpointOperation op);
+    static uint16_t next_counter(uint16_t counter) { return (counter + 1) & 0x7fff; }
+    static EndpointOperationHandle to_handle(const EndpointOperation& op) { return op.counter | 0xffff0000; }
+
+    EndpointOperation& waiting_operation(size_t i) { return waiting_operations_[(waiting_head_ + i) % kMaxWaiting]; }
+    void pop_waiting_operation(size_t i);
+
+    void send_next_operation();
+    void send_operation(EndpointOperation& op);
+    void complete_operation(EndpointOperation& op, EndpointOperationResult result);
 
-    uint16_t outbound_seq_no_ = 0;
-    std::optional<EndpointOperation> pending_operation_ = std::nullopt; // operation that is waiting for TX
+    uint16_t outbound_seq_no_ = 0; // counter of the last operation that was started
+    uint16_t tx_counter_ = 1; // counter of the next operation to send
     EndpointOperationHandle transmitting_op_ = 0; // operation that is in TX
-    std::unordered_map<uint16_t, EndpointOperation> expected_acks_; // operations that are waiting for RX
+
+    // Operations that are waiting for TX or RX, indexed by the lower bits of
+    // their counter. Since the counters are consecutive, an operation can
+    // only enter the window once the operation kWindow places before it
+    // completed.
+    std::array<EndpointOperation, kWindow> window_;
+
+    // Operations that didn't fit into the window yet, in the order in which
+    // they were started. This is a ring buffer of n_waiting_ operations
+    // starting at waiting_head_.
+    std::array<EndpointOperation, kMaxWaiting> waiting_operations_;
+    size_t waiting_head_ = 0;
+    size_t n_waiting_ = 0;
+
+    std::optional<uint16_t> stream_seqno_ = std::nullopt; // sequence number of the last stream packet
+
+    void on_stream_packet(cbufptr_t packet);
 #endif
 
     void on_write_finished(WriteResult result);
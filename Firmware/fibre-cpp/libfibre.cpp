@@ -7,6 +7,18 @@
 #include "legacy_object_client.hpp" // TODO: remove this include
 #include <algorithm>
 
+#if FIBRE_ENABLE_EVENT_LOOP
+#include "platform_support/epoll_event_loop.hpp"
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
 DEFINE_LOG_TOPIC(LIBFIBRE);
 USE_LOG_TOPIC(LIBFIBRE);
 
@@ -160,13 +172,44 @@ fibre::StreamStatus convert_status(LibFibreStatus status) {
     }
 }
 
+#if FIBRE_ENABLE_EVENT_LOOP
+struct LibFibreWorker;
+struct ShardedDevice;
+#endif
+
 struct FIBRE_PRIVATE LibFibreCtx {
     ExternalEventLoop* event_loop;
     //size_t n_discoveries = 0;
     fibre::Context* fibre_ctx;
     //std::unordered_map<std::string, std::shared_ptr<fibre::ChannelDiscoverer>> discoverers;
+#if FIBRE_ENABLE_EVENT_LOOP
+    std::vector<LibFibreWorker*> workers; // empty unless opened with libfibre_open_sharded()
+    std::atomic<bool> closing{false}; // set once libfibre_close() starts
+#endif
+};
+
+struct FIBRE_PRIVATE LibFibreDomain {
+    LibFibreCtx* ctx;
+    fibre::Domain* domain; // runs on the application's event loop
+#if FIBRE_ENABLE_EVENT_LOOP
+    std::vector<fibre::Domain*> shard_domains; // element i is only accessed by worker i
+    std::atomic<size_t> n_open_shards;
+#endif
 };
 
+struct LibFibreDiscoveryCtx;
+
+#if FIBRE_ENABLE_EVENT_LOOP
+// The part of a discovery that runs on one worker
+struct FIBRE_PRIVATE ShardDiscovery {
+    void on_found_object(fibre::Object* obj, fibre::Interface* intf);
+    void on_lost_object(fibre::Object* obj);
+
+    LibFibreDiscoveryCtx* parent;
+    LibFibreWorker* worker;
+};
+#endif
+
 struct FIBRE_PRIVATE LibFibreDiscoveryCtx {
     void on_found_object(fibre::Object* obj, fibre::Interface* intf);
     void on_lost_object(fibre::Object* obj);
@@ -174,7 +217,18 @@ struct FIBRE_PRIVATE LibFibreDiscoveryCtx {
     on_found_object_cb_t on_found_object_;
     on_lost_object_cb_t on_lost_object_;
     void* cb_ctx_;
-    fibre::Domain* domain_;
+    LibFibreDomain* domain_;
+
+#if FIBRE_ENABLE_EVENT_LOOP
+    void on_found_sharded_object(std::shared_ptr<ShardedDevice> device, fibre::Object* obj, fibre::Interface* intf);
+    void on_lost_sharded_object(std::shared_ptr<ShardedDevice> device, fibre::Object* obj);
+    void on_shard_stopped();
+
+    std::vector<ShardDiscovery> shards_;
+    size_t n_running_shards_ = 0;
+    bool stopping_ = false; // libfibre_stop_discovery() was called
+    std::unordered_set<fibre::Object*> announced_; // sharded objects that the application was told about
+#endif
 };
 
 struct LibFibreTxStream {
@@ -216,12 +270,6 @@ fibre::Function* from_c(LibFibreFunction* ptr) {
 void** from_c(LibFibreCallContext** ptr) {
     return reinterpret_cast<void**>(ptr);
 }
-LibFibreDomain* to_c(fibre::Domain* ptr) {
-    return reinterpret_cast<LibFibreDomain*>(ptr);
-}
-fibre::Domain* from_c(LibFibreDomain* ptr) {
-    return reinterpret_cast<fibre::Domain*>(ptr);
-}
 LibFibreObject* to_c(fibre::Object* ptr) {
     return reinterpret_cast<LibFibreObject*>(ptr);
 }
@@ -241,6 +289,369 @@ fibre::Status from_c(LibFibreStatus status) {
     return static_cast<fibre::Status>(status);
 }
 
+#if FIBRE_ENABLE_EVENT_LOOP
+
+/*
+ * Sharding (see libfibre_open_sharded())
+ *
+ * Each worker runs its own fibre::Context whose built-in backends only open
+ * the devices of the worker's shard. Everything that touches the protocol of a
+ * device runs on the worker's event loop. The application only ever sees
+ * callbacks on its own event loop. The two sides communicate exclusively
+ * through EventLoop::post().
+ */
+
+template<typename TFunc>
+struct FIBRE_PRIVATE PostedTask {
+    static void run(void* ctx) {
+        TFunc* func = reinterpret_cast<TFunc*>(ctx);
+        (*func)();
+        delete func;
+    }
+};
+
+/**
+ * @brief Runs a copy of func on the specified event loop.
+ * @returns: false if the event loop did not accept the task.
+ */
+template<typename TFunc>
+static bool post_task(fibre::EventLoop* event_loop, TFunc func) {
+    TFunc* task = new TFunc(func);
+    if (!event_loop->post({&PostedTask<TFunc>::run, task})) {
+        delete task;
+        return false;
+    }
+    return true;
+}
+
+struct FIBRE_PRIVATE ShardedDevice : std::enable_shared_from_this<ShardedDevice> {
+    static void on_stream_packet_on_worker(void* ctx, fibre::cbufptr_t payload, uint32_t n_lost);
+
+    LibFibreWorker* worker;
+    fibre::LegacyObject* root;
+
+    // Keeps the object tree alive until the application processed the loss of
+    // the device, even if the worker already deleted the client.
+    std::vector<std::shared_ptr<fibre::LegacyObject>> objects;
+
+    // Only accessed on the worker thread
+    fibre::LegacyObjectClient* client;
+    bool alive;
+
+    // Only accessed on the application's event loop
+    on_stream_packet_cb_t on_stream_packet;
+    void* stream_packet_ctx;
+};
+
+struct FIBRE_PRIVATE LibFibreWorker {
+    void run();
+    void on_started();
+    void on_keepalive(uint32_t) {}
+    void shutdown();
+
+    LibFibreCtx* ctx;
+    size_t shard;
+    size_t n_shards;
+    std::thread thread;
+    std::promise<bool> started;
+    std::atomic<bool> running{true};
+    std::unique_ptr<fibre::EpollEventLoop> event_loop{new fibre::EpollEventLoop()};
+
+    // Only accessed on the worker thread
+    fibre::Context* fibre_ctx = nullptr;
+    int keepalive_fd = -1;
+    bool reported_start = false;
+    std::unordered_map<fibre::LegacyObjectClient*, std::shared_ptr<ShardedDevice>> devices;
+};
+
+/**
+ * @brief Runs a copy of func on the worker thread.
+ *
+ * Unlike post_task() this waits for space in the worker's queue. Used for
+ * tasks that must not get lost, such as starting and stopping discoveries.
+ */
+template<typename TFunc>
+static bool post_to_worker(LibFibreWorker* worker, TFunc func) {
+    while (!post_task(worker->event_loop.get(), func)) {
+        if (!worker->running) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+/**
+ * @brief Runs a copy of func on the application's event loop.
+ *
+ * Like post_to_worker() this waits for space in the queue. Used for results
+ * that the application must receive exactly once. Gives up only once
+ * libfibre_close() started, after which the application expects no more
+ * callbacks.
+ */
+template<typename TFunc>
+static bool post_to_app(LibFibreWorker* worker, TFunc func) {
+    while (!post_task(worker->ctx->event_loop, func)) {
+        if (worker->ctx->closing) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+// Maps the objects and functions of all sharded devices and all ongoing calls
+// on them to their device. This is how the API functions tell the handles of
+// sharded devices apart from the handles of channels that run on the
+// application's event loop.
+static std::mutex sharded_handles_mutex;
+static std::unordered_map<const void*, std::shared_ptr<ShardedDevice>> sharded_handles;
+static std::atomic<size_t> n_sharded_ctxs{0};
+
+static std::shared_ptr<ShardedDevice> find_sharded_device(const void* handle) {
+    if (!n_sharded_ctxs.load(std::memory_order_relaxed)) {
+        return nullptr; // don't lock if no sharded context exists
+    }
+    std::unique_lock<std::mutex> lock(sharded_handles_mutex);
+    auto it = sharded_handles.find(handle);
+    return it == sharded_handles.end() ? nullptr : it->second;
+}
+
+static void register_sharded_handles(const std::shared_ptr<ShardedDevice>& device) {
+    std::unique_lock<std::mutex> lock(sharded_handles_mutex);
+    for (auto& obj: device->objects) {
+        sharded_handles[obj.get()] = device;
+        for (auto& func: obj->intf->functions) {
+            sharded_handles[&func.second] = device;
+        }
+    }
+}
+
+static void deregister_sharded_handles(const std::shared_ptr<ShardedDevice>& device) {
+    std::unique_lock<std::mutex> lock(sharded_handles_mutex);
+
+    // The handle may already belong to a device that was found later
+    auto erase = [&](const void* handle) {
+        auto it = sharded_handles.find(handle);
+        if (it != sharded_handles.end() && it->second == device) {
+            sharded_handles.erase(it);
+        }
+    };
+
+    for (auto& obj: device->objects) {
+        erase(obj.get());
+        for (auto& func: obj->intf->functions) {
+            erase(&func.second);
+        }
+    }
+}
+
+void ShardedDevice::on_stream_packet_on_worker(void* ctx, fibre::cbufptr_t payload, uint32_t n_lost) {
+    std::shared_ptr<ShardedDevice> device = reinterpret_cast<ShardedDevice*>(ctx)->shared_from_this();
+    std::vector<uint8_t> data{payload.begin(), payload.end()};
+
+    post_task(device->worker->ctx->event_loop, [device, data, n_lost]() {
+        if (device->on_stream_packet) {
+            (*device->on_stream_packet)(device->stream_packet_ctx, data.data(), data.size(), n_lost);
+        }
+    });
+}
+
+void LibFibreWorker::run() {
+    // The event loop only keeps running while it has events registered
+    keepalive_fd = eventfd(0, EFD_CLOEXEC);
+    if (keepalive_fd < 0 || !event_loop->start(MEMBER_CB(this, on_started))) {
+        FIBRE_LOG(E) << "worker " << shard << " failed";
+    }
+    running = false;
+
+    if (!reported_start) {
+        started.set_value(false);
+    }
+    if (keepalive_fd >= 0) {
+        close(keepalive_fd);
+    }
+}
+
+void LibFibreWorker::on_started() {
+    if (event_loop->register_event(keepalive_fd, EPOLLIN, MEMBER_CB(this, on_keepalive))) {
+        fibre_ctx = fibre::open(event_loop.get(), shard, n_shards);
+    }
+    if (!fibre_ctx) {
+        event_loop->stop();
+    }
+    reported_start = true;
+    started.set_value(fibre_ctx != nullptr);
+}
+
+void LibFibreWorker::shutdown() {
+    for (auto& it: devices) {
+        it.second->alive = false;
+    }
+    devices.clear();
+    if (fibre_ctx) { // null if the worker failed to start
+        fibre::close(fibre_ctx);
+        fibre_ctx = nullptr;
+        event_loop->deregister_event(keepalive_fd);
+    }
+    event_loop->stop();
+}
+
+void ShardDiscovery::on_found_object(fibre::Object* obj, fibre::Interface* intf) {
+    fibre::LegacyObject* root = reinterpret_cast<fibre::LegacyObject*>(obj);
+    std::shared_ptr<ShardedDevice>& record = worker->devices[root->client];
+
+    if (!record || record->root != root) {
+        if (record) {
+            record->alive = false;
+        }
+        record = std::make_shared<ShardedDevice>();
+        record->worker = worker;
+        record->root = root;
+        record->objects = root->client->objects_;
+        record->client = root->client;
+        record->alive = true;
+        record->on_stream_packet = nullptr;
+        record->stream_packet_ctx = nullptr;
+    }
+
+    LibFibreDiscoveryCtx* parent = this->parent;
+    std::shared_ptr<ShardedDevice> device = record;
+    post_to_app(worker, [parent, device, obj, intf]() {
+        parent->on_found_sharded_object(device, obj, intf);
+    });
+}
+
+void ShardDiscovery::on_lost_object(fibre::Object* obj) {
+    fibre::LegacyObject* root = reinterpret_cast<fibre::LegacyObject*>(obj);
+    std::shared_ptr<ShardedDevice> device;
+
+    auto it = worker->devices.find(root->client);
+    if (it != worker->devices.end() && it->second->root == root) {
+        device = it->second;
+        worker->devices.erase(it);
+
+        auto& cb = device->client->protocol_->on_stream_packet_;
+        if (cb.get_ctx() == device.get()) {
+            cb = nullptr;
+        }
+        device->alive = false;
+    }
+
+    LibFibreDiscoveryCtx* parent = this->parent;
+    post_to_app(worker, [parent, device, obj]() {
+        parent->on_lost_sharded_object(device, obj);
+    });
+}
+
+void LibFibreDiscoveryCtx::on_found_sharded_object(std::shared_ptr<ShardedDevice> device, fibre::Object* obj, fibre::Interface* intf) {
+    if (stopping_) {
+        return;
+    }
+    register_sharded_handles(device);
+    announced_.insert(obj);
+    on_found_object(obj, intf);
+}
+
+void LibFibreDiscoveryCtx::on_lost_sharded_object(std::shared_ptr<ShardedDevice> device, fibre::Object* obj) {
+    if (device) {
+        deregister_sharded_handles(device);
+    }
+    if (announced_.erase(obj)) {
+        on_lost_object(obj);
+    }
+}
+
+void LibFibreDiscoveryCtx::on_shard_stopped() {
+    if (--n_running_shards_ == 0) {
+        delete this;
+    }
+}
+
+/**
+ * @brief A call on a function of a sharded device.
+ *
+ * The call is forwarded to the worker and every buffer release is forwarded
+ * back to the application. The handle that the application holds points to
+ * this object.
+ */
+struct FIBRE_PRIVATE ShardedCall {
+    bool start(fibre::CallBuffers buffers);
+    void run(fibre::CallBuffers buffers);
+    std::optional<fibre::CallBuffers> on_release(fibre::CallBufferRelease release);
+    void post_release(fibre::CallBufferRelease release);
+    void complete(fibre::CallBufferRelease release);
+
+    std::shared_ptr<ShardedDevice> device;
+    fibre::Function* func;
+    void* inner_handle; // only accessed on the worker thread
+    libfibre_call_cb_t callback;
+    void* cb_ctx;
+};
+
+bool ShardedCall::start(fibre::CallBuffers buffers) {
+    ShardedCall* call = this;
+    return post_task(device->worker->event_loop.get(), [call, buffers]() {
+        call->run(buffers);
+    });
+}
+
+void ShardedCall::run(fibre::CallBuffers buffers) {
+    if (!device->alive) {
+        post_release({fibre::kFibreHostUnreachable, buffers.tx_buf.begin(), buffers.rx_buf.begin()});
+        return;
+    }
+
+    auto response = func->call(&inner_handle, buffers, MEMBER_CB(this, on_release));
+    if (response.has_value()) {
+        post_release(*response);
+    }
+}
+
+std::optional<fibre::CallBuffers> ShardedCall::on_release(fibre::CallBufferRelease release) {
+    post_release(release);
+    return std::nullopt; // resumed in complete()
+}
+
+void ShardedCall::post_release(fibre::CallBufferRelease release) {
+    ShardedCall* call = this;
+    if (!post_to_app(device->worker, [call, release]() { call->complete(release); })
+            && release.status != fibre::kFibreOk) {
+        // The context is being closed, so the result can't be delivered. If
+        // the call is still running, it gets a final release once the worker
+        // closes the device.
+        {
+            std::unique_lock<std::mutex> lock(sharded_handles_mutex);
+            sharded_handles.erase(this);
+        }
+        delete this;
+    }
+}
+
+void ShardedCall::complete(fibre::CallBufferRelease release) {
+    const unsigned char* tx_buf;
+    size_t tx_len;
+    unsigned char* rx_buf;
+    size_t rx_len;
+    LibFibreStatus status = (*callback)(cb_ctx, to_c(release.status), release.tx_end, release.rx_end, &tx_buf, &tx_len, &rx_buf, &rx_len);
+
+    if (release.status != fibre::kFibreOk) {
+        // The call is finished
+        {
+            std::unique_lock<std::mutex> lock(sharded_handles_mutex);
+            sharded_handles.erase(this);
+        }
+        delete this;
+    } else if (status != kFibreBusy) {
+        if (!start({from_c(status), {tx_buf, tx_len}, {rx_buf, rx_len}})) {
+            // Already on the application's event loop
+            complete({fibre::kFibreInternalError, tx_buf, rx_buf});
+        }
+    }
+}
+
+#endif
+
 void LibFibreDiscoveryCtx::on_found_object(fibre::Object* obj, fibre::Interface* intf) {
     if (on_found_object_) {
         FIBRE_LOG(D) << "discovered object " << fibre::as_hex(reinterpret_cast<uintptr_t>(obj));
@@ -274,12 +685,88 @@ LibFibreCtx* libfibre_open(LibFibreEventLoop event_loop) {
     return ctx;
 }
 
+LibFibreCtx* libfibre_open_sharded(LibFibreEventLoop event_loop, size_t n_workers) {
+    if (!n_workers) {
+        return libfibre_open(event_loop);
+    }
+
+#if FIBRE_ENABLE_EVENT_LOOP
+    LibFibreCtx* ctx = new LibFibreCtx();
+    ctx->event_loop = new ExternalEventLoop(event_loop);
+    ctx->fibre_ctx = fibre::open(ctx->event_loop, 0, 0); // the built-in backends run on the workers
+
+    if (!ctx->fibre_ctx) {
+        FIBRE_LOG(E) << "fibre::open failed";
+        delete ctx->event_loop;
+        delete ctx;
+        return nullptr;
+    }
+
+    n_sharded_ctxs++;
+
+    std::vector<std::future<bool>> started;
+    for (size_t i = 0; i < n_workers; ++i) {
+        LibFibreWorker* worker = new LibFibreWorker();
+        worker->ctx = ctx;
+        worker->shard = i;
+        worker->n_shards = n_workers;
+        started.push_back(worker->started.get_future());
+        ctx->workers.push_back(worker);
+    }
+
+    for (LibFibreWorker* worker: ctx->workers) {
+        worker->thread = std::thread(&LibFibreWorker::run, worker);
+    }
+
+    bool ok = true;
+    for (auto& future: started) {
+        ok = future.get() && ok;
+    }
+
+    if (!ok) {
+        FIBRE_LOG(E) << "some workers failed to start";
+        libfibre_close(ctx);
+        return nullptr;
+    }
+
+    return ctx;
+#else
+    FIBRE_LOG(E) << "worker threads are not supported on this platform";
+    return nullptr;
+#endif
+}
+
 void libfibre_close(LibFibreCtx* ctx) {
     if (!ctx) {
         FIBRE_LOG(E) << "invalid argument";
         return;
     }
 
+#if FIBRE_ENABLE_EVENT_LOOP
+    ctx->closing = true;
+    for (LibFibreWorker* worker: ctx->workers) {
+        post_to_worker(worker, [worker]() { worker->shutdown(); });
+    }
+    for (LibFibreWorker* worker: ctx->workers) {
+        worker->thread.join();
+    }
+
+    if (ctx->workers.size()) {
+        std::unique_lock<std::mutex> lock(sharded_handles_mutex);
+        for (auto it = sharded_handles.begin(); it != sharded_handles.end();) {
+            it = it->second->worker->ctx == ctx ? sharded_handles.erase(it) : std::next(it);
+        }
+    }
+
+    for (LibFibreWorker* worker: ctx->workers) {
+        delete worker;
+    }
+    if (ctx->workers.size()) {
+        n_sharded_ctxs--;
+    }
+    ctx->workers.clear();
+#endif
+
     fibre::close(ctx->fibre_ctx);
     ctx->fibre_ctx = nullptr;
 
@@ -298,15 +785,55 @@ void libfibre_register_backend(LibFibreCtx* ctx, const char* name, size_t name_l
     ctx->fibre_ctx->register_backend({name, name + name_length}, disc);
 }
 
+#if FIBRE_ENABLE_EVENT_LOOP
+/**
+ * @brief Splits a domain spec string into the parts that are handled by the
+ * backends on the application's event loop and the parts for the workers.
+ */
+static void split_specs(LibFibreCtx* ctx, std::string specs, std::string* app_specs, std::string* worker_specs) {
+    std::string::iterator prev_delim = specs.begin();
+    while (prev_delim < specs.end()) {
+        auto next_delim = std::find(prev_delim, specs.end(), ';');
+        auto colon = std::find(prev_delim, next_delim, ':');
+        std::string& dst = ctx->fibre_ctx->discoverers.count({prev_delim, colon}) ? *app_specs : *worker_specs;
+        dst += (dst.size() ? ";" : "") + std::string{prev_delim, next_delim};
+        prev_delim = std::min(next_delim + 1, specs.end());
+    }
+}
+#endif
+
 FIBRE_PUBLIC LibFibreDomain* libfibre_open_domain(LibFibreCtx* ctx,
     const char* specs, size_t specs_len) {
     if (!ctx) {
         FIBRE_LOG(E) << "invalid context";
         return nullptr;
-    } else {
-        FIBRE_LOG(D) << "opening domain";
-        return to_c(ctx->fibre_ctx->create_domain({specs, specs_len}));
     }
+
+    FIBRE_LOG(D) << "opening domain";
+    LibFibreDomain* domain = new LibFibreDomain(); // deleted in libfibre_close_domain()
+    domain->ctx = ctx;
+
+#if FIBRE_ENABLE_EVENT_LOOP
+    if (ctx->workers.size()) {
+        std::string app_specs;
+        std::string worker_specs;
+        split_specs(ctx, {specs, specs_len}, &app_specs, &worker_specs);
+        domain->domain = ctx->fibre_ctx->create_domain(app_specs);
+        domain->shard_domains.resize(ctx->workers.size());
+        domain->n_open_shards = ctx->workers.size();
+
+        for (size_t i = 0; i < ctx->workers.size(); ++i) {
+            LibFibreWorker* worker = ctx->workers[i];
+            post_to_worker(worker, [worker, domain, i, worker_specs]() {
+                domain->shard_domains[i] = worker->fibre_ctx->create_domain(worker_specs);
+            });
+        }
+        return domain;
+    }
+#endif
+
+    domain->domain = ctx->fibre_ctx->create_domain({specs, specs_len});
+    return domain;
 }
 
 void libfibre_close_domain(LibFibreDomain* domain) {
@@ -316,7 +843,27 @@ void libfibre_close_domain(LibFibreDomain* domain) {
     }
     FIBRE_LOG(D) << "closing domain";
 
-    from_c(domain)->ctx->close_domain(from_c(domain));
+    LibFibreCtx* ctx = domain->ctx;
+    ctx->fibre_ctx->close_domain(domain->domain);
+
+#if FIBRE_ENABLE_EVENT_LOOP
+    if (ctx->workers.size()) {
+        // The last worker to close its part deletes the domain, so the domain
+        // must not be accessed after the last post.
+        for (size_t i = 0; i < ctx->workers.size(); ++i) {
+            LibFibreWorker* worker = ctx->workers[i];
+            post_to_worker(worker, [worker, domain, i]() {
+                worker->fibre_ctx->close_domain(domain->shard_domains[i]);
+                if (--domain->n_open_shards == 0) {
+                    delete domain;
+                }
+            });
+        }
+        return;
+    }
+#endif
+
+    delete domain;
 }
 
 void libfibre_add_channels(LibFibreDomain* domain, LibFibreRxStream** tx_channel, LibFibreTxStream** rx_channel, size_t mtu) {
@@ -351,7 +898,7 @@ void libfibre_add_channels(LibFibreDomain* domain, LibFibreRxStream** tx_channel
     }
 
     fibre::ChannelDiscoveryResult result = {fibre::kFibreOk, rx_link, tx_link, mtu};
-    from_c(domain)->on_found_channels(result);
+    domain->domain->on_found_channels(result);
 }
 
 void libfibre_start_discovery(LibFibreDomain* domain, LibFibreDiscoveryCtx** handle,
@@ -370,13 +917,29 @@ void libfibre_start_discovery(LibFibreDomain* domain, LibFibreDiscoveryCtx** han
     discovery_ctx->on_found_object_ = on_found_object;
     discovery_ctx->on_lost_object_ = on_lost_object;
     discovery_ctx->cb_ctx_ = cb_ctx;
-    discovery_ctx->domain_ = from_c(domain);
+    discovery_ctx->domain_ = domain;
 
     if (handle) {
         *handle = discovery_ctx;
     }
 
-    from_c(domain)->start_discovery(MEMBER_CB(discovery_ctx, on_found_object),
+#if FIBRE_ENABLE_EVENT_LOOP
+    std::vector<LibFibreWorker*>& workers = domain->ctx->workers;
+    discovery_ctx->shards_.resize(workers.size());
+    discovery_ctx->n_running_shards_ = workers.size();
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        ShardDiscovery* shard = &discovery_ctx->shards_[i];
+        shard->parent = discovery_ctx;
+        shard->worker = workers[i];
+        post_to_worker(workers[i], [domain, i, shard]() {
+            domain->shard_domains[i]->start_discovery(MEMBER_CB(shard, on_found_object),
+                MEMBER_CB(shard, on_lost_object));
+        });
+    }
+#endif
+
+    domain->domain->start_discovery(MEMBER_CB(discovery_ctx, on_found_object),
         MEMBER_CB(discovery_ctx, on_lost_object));
 }
 
@@ -386,7 +949,26 @@ void libfibre_stop_discovery(LibFibreDiscoveryCtx* handle) {
         return;
     }
 
-    handle->domain_->stop_discovery();
+    LibFibreDomain* domain = handle->domain_;
+    domain->domain->stop_discovery();
+
+#if FIBRE_ENABLE_EVENT_LOOP
+    if (handle->shards_.size()) {
+        // The lost objects that the workers report during stop_discovery()
+        // are still delivered. The discovery context is deleted once all
+        // workers acknowledged the stop.
+        handle->stopping_ = true;
+        for (size_t i = 0; i < handle->shards_.size(); ++i) {
+            LibFibreWorker* worker = domain->ctx->workers[i];
+            post_to_worker(worker, [worker, domain, i, handle]() {
+                domain->shard_domains[i]->stop_discovery();
+                post_to_app(worker, [handle]() { handle->on_shard_stopped(); });
+            });
+        }
+        return;
+    }
+#endif
+
     delete handle;
 }
 
@@ -480,6 +1062,140 @@ LibFibreStatus libfibre_get_attribute(LibFibreObject* parent_obj, LibFibreAttrib
     return kFibreOk;
 }
 
+struct StreamPacketSubscription {
+    on_stream_packet_cb_t callback;
+    void* ctx;
+
+    static void on_stream_packet(void* ctx, fibre::cbufptr_t payload, uint32_t n_lost) {
+        auto sub = reinterpret_cast<StreamPacketSubscription*>(ctx);
+        (*sub->callback)(sub->ctx, payload.begin(), payload.size(), n_lost);
+    }
+};
+
+LibFibreStatus libfibre_subscribe_to_stream_packets(LibFibreObject* obj, on_stream_packet_cb_t on_stream_packet, void* cb_ctx) {
+    if (!obj) {
+        return kFibreInvalidArgument;
+    }
+
+#if FIBRE_ENABLE_EVENT_LOOP
+    std::shared_ptr<ShardedDevice> device = find_sharded_device(obj);
+    if (device) {
+        // The packets are copied on the worker and handed over to the
+        // application's event loop.
+        device->on_stream_packet = on_stream_packet;
+        device->stream_packet_ctx = cb_ctx;
+        fibre::Callback<void, fibre::cbufptr_t, uint32_t> cb = on_stream_packet
+            ? fibre::Callback<void, fibre::cbufptr_t, uint32_t>{&ShardedDevice::on_stream_packet_on_worker, device.get()}
+            : nullptr;
+        post_to_worker(device->worker, [device, cb]() {
+            if (device->alive) {
+                device->client->protocol_->on_stream_packet_ = cb;
+            }
+        });
+        return kFibreOk;
+    }
+#endif
+
+    fibre::LegacyObject* obj_cast = reinterpret_cast<fibre::LegacyObject*>(obj);
+    auto& cb = obj_cast->client->protocol_->on_stream_packet_;
+
+    if (cb.get_ptr() == &StreamPacketSubscription::on_stream_packet) {
+        delete reinterpret_cast<StreamPacketSubscription*>(cb.get_ctx());
+    }
+    cb = on_stream_packet
+       ? fibre::Callback<void, fibre::cbufptr_t, uint32_t>{&StreamPacketSubscription::on_stream_packet, new StreamPacketSubscription{on_stream_packet, cb_ctx}}
+       : nullptr;
+
+    return kFibreOk;
+}
+
+struct FIBRE_PRIVATE Batch {
+    LibFibreBatchItem* items;
+    std::vector<fibre::LegacyBatchItem> legacy_items;
+    on_batch_completed_cb_t on_completed;
+    void* ctx;
+
+    void on_finished(fibre::StreamStatus status) {
+        for (size_t i = 0; i < legacy_items.size(); ++i) {
+            items[i].rx_end = legacy_items[i].rx_buf.begin();
+        }
+        (*on_completed)(ctx, status == fibre::kStreamClosed ? kFibreHostUnreachable : convert_status(status));
+        delete this;
+    }
+
+#if FIBRE_ENABLE_EVENT_LOOP
+    std::shared_ptr<ShardedDevice> device; // null unless the batch runs on a worker
+
+    void start_on_worker() {
+        if (device->alive) {
+            device->client->start_batch(legacy_items.data(), legacy_items.size(), MEMBER_CB(this, on_finished_on_worker));
+        } else {
+            on_finished_on_worker(fibre::kStreamClosed);
+        }
+    }
+
+    void on_finished_on_worker(fibre::StreamStatus status) {
+        Batch* batch = this;
+        if (!post_to_app(device->worker, [batch, status]() { batch->on_finished(status); })) {
+            delete this; // The context is being closed
+        }
+    }
+#endif
+};
+
+LibFibreStatus libfibre_run_batch(LibFibreBatchItem* items, size_t n_items, on_batch_completed_cb_t on_completed, void* cb_ctx) {
+    if (!n_items || !items || !on_completed) {
+        return kFibreInvalidArgument;
+    }
+
+    fibre::LegacyObjectClient* client = nullptr;
+    std::vector<fibre::LegacyBatchItem> legacy_items;
+
+    for (size_t i = 0; i < n_items; ++i) {
+        LibFibreBatchItem& item = items[i];
+        fibre::LegacyObject* obj = reinterpret_cast<fibre::LegacyObject*>(item.obj);
+        if (!obj || !obj->ep_num || (client && obj->client != client)) {
+            return kFibreInvalidArgument;
+        }
+        client = obj->client;
+
+        // Only properties have an endpoint of their own. Object references
+        // would have to be transcoded.
+        auto read_func = obj->intf->functions.find("read");
+        if (read_func == obj->intf->functions.end() || read_func->second.outputs.size() != 1) {
+            return kFibreInvalidArgument;
+        }
+        const fibre::LegacyFibreArg& value = read_func->second.outputs[0];
+        bool can_write = obj->intf->functions.count("exchange");
+
+        if (value.protocol_codec == "endpoint_ref"
+            || (item.tx_len && (!can_write || item.tx_len != value.protocol_size))
+            || (item.tx_len && !item.tx_buf)
+            || (item.rx_len && !item.rx_buf)
+            || item.rx_len > value.protocol_size) {
+            return kFibreInvalidArgument;
+        }
+
+        legacy_items.push_back({obj->ep_num, {item.tx_buf, item.tx_len}, {item.rx_buf, item.rx_len}});
+    }
+
+    Batch* batch = new Batch{items, std::move(legacy_items), on_completed, cb_ctx};
+
+#if FIBRE_ENABLE_EVENT_LOOP
+    batch->device = find_sharded_device(items[0].obj);
+    if (batch->device) {
+        if (!post_task(batch->device->worker->event_loop.get(), [batch]() { batch->start_on_worker(); })) {
+            delete batch;
+            return kFibreInternalError;
+        }
+        return kFibreBusy;
+    }
+#endif
+
+    client->start_batch(batch->legacy_items.data(), batch->legacy_items.size(), MEMBER_CB(batch, on_finished));
+    return kFibreBusy;
+}
+
 /**
  * @brief Inserts or removes the specified number of elements
  * @param delta: Positive value: insert elements, negative value: remove elements
@@ -510,6 +1226,36 @@ LibFibreStatus libfibre_call(LibFibreFunction* func, LibFibreCallContext** handl
         return kFibreInvalidArgument;
     }
 
+#if FIBRE_ENABLE_EVENT_LOOP
+    std::shared_ptr<ShardedDevice> device = find_sharded_device(*handle ? (void*)*handle : (void*)func);
+    if (device) {
+        ShardedCall* call = reinterpret_cast<ShardedCall*>(*handle);
+        bool is_new = !call;
+        if (is_new) {
+            call = new ShardedCall{device, from_c(func), nullptr, callback, cb_ctx};
+            std::unique_lock<std::mutex> lock(sharded_handles_mutex);
+            sharded_handles[call] = device;
+        } else {
+            call->callback = callback;
+            call->cb_ctx = cb_ctx;
+        }
+
+        if (!call->start({from_c(status), {tx_buf, tx_len}, {rx_buf, rx_len}})) {
+            if (is_new) {
+                std::unique_lock<std::mutex> lock(sharded_handles_mutex);
+                sharded_handles.erase(call);
+                delete call;
+            }
+            *tx_end = tx_buf;
+            *rx_end = rx_buf;
+            return kFibreInternalError;
+        }
+
+        *handle = reinterpret_cast<LibFibreCallContext*>(call);
+        return kFibreBusy;
+    }
+#endif
+
     struct Ctx { libfibre_call_cb_t callback; void* ctx; };
     struct Ctx* ctx = new Ctx{callback, cb_ctx};
 
@@ -0,0 +1,103 @@
+#ifndef __FIBRE_LZSS_HPP
+#define __FIBRE_LZSS_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace fibre {
+
+/**
+ * @brief Decoder for the LZSS bitstream that the interface generator uses to
+ * compress the JSON definition (see docs/protocol.md).
+ *
+ * The stream is read MSB first. A 1 bit is followed by a literal byte. A 0 bit
+ * is followed by a back reference: (offset - 1) in window_bits bits and
+ * (length - 1) in lookahead_bits bits. This is the same bitstream as
+ * heatshrink uses.
+ *
+ * The decoder produces one byte at a time and only keeps the last
+ * 2^window_bits bytes of output in the window buffer that the caller provides.
+ * The stream has no end marker, so the caller must stop after the known
+ * number of decompressed bytes.
+ */
+class LzssDecoder {
+public:
+    LzssDecoder(const uint8_t* input, size_t input_length, uint8_t* window, uint8_t window_bits, uint8_t lookahead_bits)
+        : input_(input), input_length_(input_length), window_(window),
+          window_bits_(window_bits), lookahead_bits_(lookahead_bits) {
+        reset();
+    }
+
+    // Restarts decoding at the beginning of the input.
+    void reset() {
+        bit_pos_ = 0;
+        position_ = 0;
+        n_pending_ = 0;
+        memset(window_, 0, (size_t)1 << window_bits_);
+    }
+
+    // Decodes the next byte. Returns false at the end of the input.
+    bool get(uint8_t* byte) {
+        size_t mask = ((size_t)1 << window_bits_) - 1;
+        uint8_t value;
+
+        if (n_pending_) {
+            value = window_[(position_ - offset_) & mask];
+            n_pending_--;
+        } else {
+            uint16_t tag, bits, count;
+            if (!read_bits(1, &tag)) {
+                return false;
+            } else if (tag) {
+                if (!read_bits(8, &bits)) {
+                    return false;
+                }
+                value = (uint8_t)bits;
+            } else {
+                if (!read_bits(window_bits_, &bits) || !read_bits(lookahead_bits_, &count)) {
+                    return false;
+                }
+                offset_ = (size_t)bits + 1;
+                n_pending_ = count; // the first of count + 1 bytes is returned now
+                value = window_[(position_ - offset_) & mask];
+            }
+        }
+
+        window_[position_ & mask] = value;
+        position_++;
+        *byte = value;
+        return true;
+    }
+
+    // Number of bytes decoded since the last reset().
+    size_t get_position() const { return position_; }
+
+private:
+    bool read_bits(uint8_t n_bits, uint16_t* value) {
+        if (bit_pos_ + n_bits > 8 * input_length_) {
+            return false;
+        }
+        uint16_t result = 0;
+        for (uint8_t i = 0; i < n_bits; ++i, ++bit_pos_) {
+            result = (result << 1) | ((input_[bit_pos_ >> 3] >> (7 - (bit_pos_ & 7))) & 1);
+        }
+        *value = result;
+        return true;
+    }
+
+    const uint8_t* input_;
+    size_t input_length_;
+    uint8_t* window_;
+    uint8_t window_bits_;
+    uint8_t lookahead_bits_;
+
+    size_t bit_pos_;
+    size_t position_;
+    size_t offset_ = 0; // distance of the ongoing back reference
+    size_t n_pending_; // remaining bytes of the ongoing back reference
+};
+
+}
+
+#endif // __FIBRE_LZSS_HPP
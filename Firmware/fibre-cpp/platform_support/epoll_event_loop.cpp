@@ -5,14 +5,41 @@
 #include <sys/epoll.h>
 #include <sys/types.h>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
 #include <unistd.h>
 #include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <new>
 
 using namespace fibre;
 
 DEFINE_LOG_TOPIC(EVENT_LOOP);
 USE_LOG_TOPIC(EVENT_LOOP);
 
+static uint64_t get_monotonic_time_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Returns the last tick (millisecond) that has fully started
+static uint64_t get_current_tick() {
+    return get_monotonic_time_ns() / 1000000;
+}
+
+void* EpollEventLoop::operator new(size_t size) {
+    void* ptr;
+    if (posix_memalign(&ptr, alignof(EpollEventLoop), size) != 0) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void EpollEventLoop::operator delete(void* ptr) {
+    free(ptr);
+}
 
 bool EpollEventLoop::start(Callback<void> on_started) {
     if (epoll_fd_ >= 0) {
@@ -27,6 +54,7 @@ bool EpollEventLoop::start(Callback<void> on_started) {
     }
 
     bool ok = true;
+    stop_requested_ = false;
 
     post_fd_ = eventfd(0, 0);
 
@@ -39,9 +67,20 @@ bool EpollEventLoop::start(Callback<void> on_started) {
         ok = false;
     }
 
-    // Run for as long as there are callbacks pending posted or there's at least
-    // one file descriptor other than post_fd_ registerd.
-    while (pending_callbacks_.size() || (context_map_.size() > 1)) {
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    bool timer_fd_ok = (timer_fd_ >= 0)
+            && register_event(timer_fd_, EPOLLIN, MEMBER_CB(this, run_timers));
+
+    if (!timer_fd_ok) {
+        FIBRE_LOG(E) << "failed to create a timer file descriptor";
+        ok = false;
+    }
+    size_t n_internal_fds = (post_fd_ >= 0 ? 1 : 0) + (timer_fd_ >= 0 ? 1 : 0);
+
+    // Run for as long as there are callbacks pending posted, timers pending or
+    // at least one file descriptor other than post_fd_ and timer_fd_ registerd.
+    while (!stop_requested_ && (!pending_callbacks_.empty() || timer_wheel_.size() || (context_map_.size() > n_internal_fds))) {
         iterations_++;
 
         do {
@@ -74,6 +113,27 @@ bool EpollEventLoop::start(Callback<void> on_started) {
 
     FIBRE_LOG(D) << "epoll loop exited";
 
+    // Drop whatever is left if the loop was stopped
+    timer_wheel_.advance(timer_wheel_.get_now() + TimerWheel::kMaxDelay, [](EventLoopTimer* timer) {
+        delete timer;
+    });
+    Callback<void> dropped_callback;
+    while (pending_callbacks_.pop(&dropped_callback)) {
+    }
+    wakeup_pending_ = false;
+
+    if ((timer_fd_ >= 0) && !deregister_event(timer_fd_)) {
+        FIBRE_LOG(E) << "deregister_event() failed";
+        ok = false;
+    }
+
+    if ((timer_fd_ >= 0) && close(timer_fd_) != 0) {
+        FIBRE_LOG(E) << "close() failed: " << sys_err();
+        ok = false;
+    }
+    timer_fd_ = -1;
+    armed_tick_ = UINT64_MAX;
+
     if ((post_fd_ >= 0) && !deregister_event(post_fd_)) {
         FIBRE_LOG(E) << "deregister_event() failed";
         ok = false;
@@ -85,6 +145,11 @@ bool EpollEventLoop::start(Callback<void> on_started) {
     }
     post_fd_ = -1;
 
+    for (auto& it: context_map_) {
+        delete it.second;
+    }
+    context_map_.clear();
+
     if (close(epoll_fd_) != 0) {
         FIBRE_LOG(E) << "close() failed: " << sys_err();
         ok = false;
@@ -100,9 +165,15 @@ bool EpollEventLoop::post(Callback<void> callback) {
         return false;
     }
 
-    {
-        std::unique_lock<std::mutex> lock(pending_callbacks_mutex_);
-        pending_callbacks_.push_back(callback);
+    if (!pending_callbacks_.push(callback)) {
+        FIBRE_LOG(E) << "too many pending callbacks";
+        return false;
+    }
+
+    // If a wakeup is already pending, the event loop will see this callback
+    // when it handles that wakeup.
+    if (wakeup_pending_.exchange(true, std::memory_order_acq_rel)) {
+        return true;
     }
 
     const uint64_t val = 1;
@@ -155,8 +226,6 @@ bool EpollEventLoop::deregister_event(int event_fd) {
         result = false;
     }
 
-    EventContext* callback = context_map_[event_fd];
-
     auto it = context_map_.find(event_fd);
     if (it == context_map_.end()) {
         FIBRE_LOG(E) << "event context not found";
@@ -169,19 +238,90 @@ bool EpollEventLoop::deregister_event(int event_fd) {
         }
     }
 
+    delete it->second;
     context_map_.erase(it);
     
     return result;
 }
 
 struct EventLoopTimer* EpollEventLoop::call_later(float delay, Callback<void> callback) {
-    FIBRE_LOG(E) << "not implemented"; // TODO: implement
-    return nullptr;
+    if (timer_fd_ < 0) {
+        FIBRE_LOG(E) << "not started";
+        return nullptr;
+    }
+
+    float delay_ns = delay * 1e9f;
+    uint64_t max_delay_ns = TimerWheel::kMaxDelay * 1000000ULL;
+    uint64_t deadline_ns = get_monotonic_time_ns();
+    deadline_ns += !(delay_ns > 0.0f) ? 0
+            : (delay_ns >= (float)max_delay_ns) ? max_delay_ns
+            : (uint64_t)delay_ns;
+
+    // Round up so that the callback never runs early
+    uint64_t expiry = (deadline_ns + 999999) / 1000000;
+
+    timer_wheel_.reset(get_current_tick()); // only has an effect if the wheel is empty
+
+    EventLoopTimer* timer = new EventLoopTimer();
+    timer->callback = callback;
+    timer_wheel_.add(timer, expiry);
+
+    uint64_t next = timer_wheel_.get_next_wakeup();
+    if (next < armed_tick_) {
+        arm_timer_fd(next);
+    }
+
+    return timer;
 }
 
 bool EpollEventLoop::cancel_timer(EventLoopTimer* timer) {
-    FIBRE_LOG(E) << "not implemented"; // TODO: implement
-    return false;
+    if (!timer || timer == running_timer_) {
+        // Cancelling a timer from within its own callback is a no-op
+        return false;
+    }
+
+    if (!timer_wheel_.remove(timer)) {
+        FIBRE_LOG(E) << "timer not found";
+        return false;
+    }
+    delete timer;
+
+    // timer_fd_ stays armed. If it fires early, run_timers() only rearms it.
+    return true;
+}
+
+void EpollEventLoop::arm_timer_fd(uint64_t tick) {
+    struct itimerspec spec = {};
+    if (tick != UINT64_MAX) {
+        // A zero it_value would disarm the timer
+        spec.it_value.tv_sec = (time_t)(tick / 1000);
+        spec.it_value.tv_nsec = (long)(tick % 1000) * 1000000 + 1;
+    }
+
+    if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+        FIBRE_LOG(E) << "timerfd_settime() failed: " << sys_err();
+    }
+    armed_tick_ = tick;
+}
+
+void EpollEventLoop::run_timers(uint32_t) {
+    uint64_t val;
+    if (read(timer_fd_, &val, sizeof(val)) != sizeof(val) && errno != EAGAIN) {
+        FIBRE_LOG(E) << "failed to read from timer file descriptor";
+    }
+    armed_tick_ = UINT64_MAX;
+
+    timer_wheel_.advance(get_current_tick(), [this](EventLoopTimer* timer) {
+        running_timer_ = timer;
+        timer->callback.invoke();
+        running_timer_ = nullptr;
+        delete timer;
+    });
+
+    uint64_t next = timer_wheel_.get_next_wakeup();
+    if (next != armed_tick_) {
+        arm_timer_fd(next);
+    }
 }
 
 void EpollEventLoop::run_callbacks(uint32_t) {
@@ -191,14 +331,25 @@ void EpollEventLoop::run_callbacks(uint32_t) {
         FIBRE_LOG(E) << "failed to read from post file descriptor";
     }
 
-    std::vector<Callback<void>> pending_callbacks;
-
-    {
-        std::unique_lock<std::mutex> lock(pending_callbacks_mutex_);
-        std::swap(pending_callbacks, pending_callbacks_);
+    // Clear the flag before looking at the queue so that a post() which
+    // finishes after this point wakes up the event loop again. The acquire
+    // makes the callbacks of the posts that found the flag set visible.
+    wakeup_pending_.exchange(false, std::memory_order_acq_rel);
+
+    // Run at most one queue worth of callbacks per iteration so that a
+    // callback which posts itself can't starve the other events.
+    for (size_t i = 0; i < kPostQueueCapacity; ++i) {
+        Callback<void> cb;
+        if (!pending_callbacks_.pop(&cb)) {
+            return;
+        }
+        cb.invoke();
     }
 
-    for (auto& cb: pending_callbacks) {
-        cb.invoke();
+    if (!pending_callbacks_.empty() && !wakeup_pending_.exchange(true, std::memory_order_acq_rel)) {
+        const uint64_t val = 1;
+        if (write(post_fd_, &val, sizeof(val)) != sizeof(val)) {
+            FIBRE_LOG(E) << "write() failed" << sys_err();
+        }
     }
 }
@@ -4,11 +4,12 @@
 //#include <thread>
 #include <sys/epoll.h>
 #include <unordered_map>
-#include <vector>
-#include <mutex>
+#include <atomic>
 //#include <algorithm>
 
 #include <fibre/event_loop.hpp>
+#include "mpsc_queue.hpp"
+#include "timer_wheel.hpp"
 
 namespace fibre {
 
@@ -20,9 +21,19 @@ namespace fibre {
  * loop, that means register_event() and deregister_event() can be called from
  * within an event callback (which executes on the event loop thread), provided
  * those calls are properly synchronized with calls from other threads.
+ * post() is thread-safe with respect to all other functions. It neither locks
+ * nor allocates.
+ *
+ * Timers are kept in a TimerWheel with a resolution of 1ms. A single timerfd
+ * is armed for the next tick at which the wheel needs attention, so the
+ * number of active timers doesn't affect the cost of an epoll iteration.
  */
 class EpollEventLoop : public EventLoop {
 public:
+    // The post queue is cache line aligned, which the default operator new
+    // only respects as of C++17.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
 
     /**
      * @brief Starts the event loop on the current thread and places the
@@ -33,6 +44,14 @@ public:
      */
     bool start(Callback<void> on_started);
 
+    /**
+     * @brief Makes start() return after the current iteration even if events
+     * are still registered. Pending timers and posted callbacks are dropped.
+     *
+     * Must be called on the event loop thread.
+     */
+    void stop() { stop_requested_ = true; }
+
     bool post(Callback<void> callback) final;
     bool register_event(int fd, uint32_t events, Callback<void, uint32_t> callback) final;
     bool deregister_event(int fd) final;
@@ -46,10 +65,14 @@ private:
     };
 
     void run_callbacks(uint32_t);
+    void run_timers(uint32_t);
+    void arm_timer_fd(uint64_t tick);
 
     int epoll_fd_ = -1;
     int post_fd_ = -1;
+    int timer_fd_ = -1;
     unsigned int iterations_ = 0;
+    bool stop_requested_ = false;
 
     std::unordered_map<int, EventContext*> context_map_; // required to deregister callbacks
 
@@ -57,11 +80,18 @@ private:
     int n_triggered_events_ = 0;
     struct epoll_event triggered_events_[max_triggered_events_];
 
-    // List of callbacks that were submitted through post().
-    std::vector<Callback<void>> pending_callbacks_;
+    // Callbacks that were submitted through post(). post() fails when this
+    // is full.
+    static constexpr size_t kPostQueueCapacity = 1024;
+    MpscQueue<Callback<void>, kPostQueueCapacity> pending_callbacks_;
+
+    // Set by the first post() after the event loop started running the
+    // pending callbacks. Only that post() writes to post_fd_.
+    std::atomic<bool> wakeup_pending_{false};
 
-    // Mutex to protect pending_callbacks_
-    std::mutex pending_callbacks_mutex_;
+    TimerWheel timer_wheel_; // ticks are milliseconds of CLOCK_MONOTONIC
+    uint64_t armed_tick_ = UINT64_MAX; // tick for which timer_fd_ is armed
+    EventLoopTimer* running_timer_ = nullptr; // timer whose callback is running
 };
 
 }
@@ -320,6 +320,10 @@ int LibusbDiscoverer::on_hotplug(struct libusb_device *dev,
                                  libusb_hotplug_event event) {
     uint8_t bus_number = libusb_get_bus_number(dev);
     uint8_t dev_number = libusb_get_device_address(dev);
+
+    if (!is_in_shard(bus_number << 8 | dev_number)) {
+        return 0; // handled by the discoverer of another shard
+    }
     
     if (LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED == event) {
         FIBRE_LOG(D) << "device arrived: bus " << (int)bus_number << ", " << (int)dev_number;
@@ -392,7 +396,7 @@ void LibusbDiscoverer::poll_devices_now() {
                 // To avoid this, we reinspect the all unopened devices on
                 // every polling iteration.
                 auto it = known_devices_.find(dev.first);
-                if (it->second.handle == nullptr) {
+                if (it != known_devices_.end() && it->second.handle == nullptr) {
                     known_devices_.erase(it);
                 }
             }
@@ -0,0 +1,100 @@
+#ifndef __FIBRE_MPSC_QUEUE_HPP
+#define __FIBRE_MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <stddef.h>
+
+namespace fibre {
+
+/**
+ * @brief Bounded lock-free queue with multiple producers and a single
+ * consumer.
+ *
+ * Each slot carries a sequence number which tells whether the slot is free
+ * for the producer that claimed position `pos` (sequence == pos) or holds the
+ * item for the consumer (sequence == pos + 1). Producers claim positions with
+ * a compare-and-swap on the write position, the consumer owns the read
+ * position. Neither side ever blocks or allocates.
+ *
+ * Thread safety: push() can be called from any thread. pop() and empty() must
+ * only be called from the consumer thread.
+ *
+ * @tparam Capacity: Maximum number of items in the queue. Must be a power of
+ *         two.
+ */
+template<typename T, size_t Capacity>
+class MpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscQueue() {
+        for (size_t i = 0; i < Capacity; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * @brief Appends an item to the queue. Returns false if the queue is full.
+     */
+    bool push(const T& item) {
+        size_t pos = write_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[pos & (Capacity - 1)];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t)sequence - (ptrdiff_t)pos;
+            if (diff == 0) {
+                if (write_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.item = item;
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+                // pos was updated by compare_exchange_weak()
+            } else if (diff < 0) {
+                return false; // the consumer didn't yet pop the item from one round ago
+            } else {
+                pos = write_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Removes the oldest item from the queue. Returns false if the
+     * queue is empty or if the oldest item is still being pushed.
+     */
+    bool pop(T* item) {
+        Slot& slot = slots_[read_pos_ & (Capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != read_pos_ + 1) {
+            return false;
+        }
+        *item = slot.item;
+        slot.sequence.store(read_pos_ + Capacity, std::memory_order_release);
+        read_pos_++;
+        return true;
+    }
+
+    /**
+     * @brief Returns true if no item was pushed that wasn't popped yet.
+     */
+    bool empty() const {
+        return write_pos_.load(std::memory_order_acquire) == read_pos_;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    // The positions are on separate cache lines so that the consumer doesn't
+    // slow down the producers.
+    alignas(64) std::atomic<size_t> write_pos_{0};
+    alignas(64) size_t read_pos_ = 0;
+    alignas(64) Slot slots_[Capacity];
+};
+
+}
+
+#endif // __FIBRE_MPSC_QUEUE_HPP
@@ -58,6 +58,10 @@ void PosixTcpBackend::start_channel_discovery(const char* specs, size_t specs_le
 
     n_discoveries_++;
 
+    if (!is_in_shard(std::hash<std::string>{}(std::string{specs, specs_len}))) {
+        return; // the backend of another shard connects to this address
+    }
+
     TcpChannelDiscoveryContext* ctx = new TcpChannelDiscoveryContext(); // TODO: free
     ctx->parent = this;
     ctx->address = {{address_begin, address_end}, port};
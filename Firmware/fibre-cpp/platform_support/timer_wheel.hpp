@@ -0,0 +1,231 @@
+#ifndef __FIBRE_TIMER_WHEEL_HPP
+#define __FIBRE_TIMER_WHEEL_HPP
+
+#include <fibre/callback.hpp>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace fibre {
+
+struct EventLoopTimer {
+    EventLoopTimer* prev = nullptr;
+    EventLoopTimer* next = nullptr; // null while the timer is not in a TimerWheel
+    uint64_t expiry = 0; // [ticks]
+    uint16_t slot = 0;
+    Callback<void> callback;
+};
+
+/**
+ * @brief Hierarchical timer wheel with O(1) insertion and removal.
+ *
+ * The wheel has kLevels levels of kSlots slots each. A timer that expires
+ * less than kSlots ticks from now goes into the slot of its expiry tick on
+ * level 0. Timers further in the future go into a slot on a higher level,
+ * which covers kSlots times as many ticks per slot as the level below. When
+ * the time reaches the beginning of such a slot, its timers are moved down
+ * to the level that matches their remaining time ("cascading").
+ *
+ * The wheel doesn't have a clock of its own. The owner calls advance() with
+ * the current tick, ideally at the tick returned by get_next_wakeup().
+ * advance() skips over empty slots, so its cost depends on the number of
+ * timers that expire or cascade, not on the elapsed time.
+ *
+ * The timers are intrusive list nodes which the caller allocates and which
+ * must stay valid while they are in the wheel.
+ */
+class TimerWheel {
+public:
+    static constexpr unsigned kSlotBits = 8;
+    static constexpr size_t kSlots = (size_t)1 << kSlotBits;
+    static constexpr unsigned kLevels = 4;
+    static constexpr uint64_t kMaxDelay = ((uint64_t)1 << (kSlotBits * kLevels)) - 1; // [ticks]
+
+    TimerWheel() {
+        for (size_t i = 0; i < kLevels * kSlots; ++i) {
+            slots_[i].prev = slots_[i].next = &slots_[i];
+        }
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    size_t size() const { return n_timers_; }
+    uint64_t get_now() const { return now_; }
+
+    /**
+     * @brief Sets the current tick. Only allowed while the wheel is empty.
+     */
+    void reset(uint64_t now) {
+        if (!n_timers_) {
+            now_ = now;
+        }
+    }
+
+    /**
+     * @brief Adds a timer that expires at the given tick. Timers that expire
+     * at or before the current tick expire at the next tick. Expiry ticks
+     * more than kMaxDelay ticks in the future are clamped.
+     */
+    void add(EventLoopTimer* timer, uint64_t expiry) {
+        if (expiry <= now_) {
+            expiry = now_ + 1;
+        } else if (expiry > now_ + kMaxDelay) {
+            expiry = now_ + kMaxDelay;
+        }
+        timer->expiry = expiry;
+        link(timer);
+        n_timers_++;
+    }
+
+    /**
+     * @brief Removes a timer from the wheel. Returns false if it was not in
+     * the wheel (e.g. because it already expired).
+     */
+    bool remove(EventLoopTimer* timer) {
+        if (!timer->next) {
+            return false;
+        }
+        unlink(timer);
+        n_timers_--;
+        return true;
+    }
+
+    /**
+     * @brief Returns the tick at which advance() should be called next or
+     * UINT64_MAX if the wheel is empty.
+     *
+     * This is either the expiry of the next timer or an earlier tick at which
+     * timers cascade to a lower level.
+     */
+    uint64_t get_next_wakeup() const {
+        uint64_t next = UINT64_MAX;
+        if (size_t distance = next_occupied(0, now_ & (kSlots - 1))) {
+            next = now_ + distance;
+        }
+        for (unsigned level = 1; level < kLevels; ++level) {
+            unsigned shift = kSlotBits * level;
+            if (size_t distance = next_occupied(level, (now_ >> shift) & (kSlots - 1))) {
+                uint64_t cascade_time = ((now_ >> shift) + distance) << shift;
+                next = cascade_time < next ? cascade_time : next;
+            }
+        }
+        return next;
+    }
+
+    /**
+     * @brief Advances the current tick to `now` and calls on_expired(timer)
+     * for each timer that expired on the way, in the order of expiry.
+     *
+     * A timer is removed from the wheel before on_expired() is called for
+     * it. on_expired() may add and remove timers.
+     */
+    template<typename TFunc>
+    void advance(uint64_t now, TFunc on_expired) {
+        while (now_ < now) {
+            uint64_t next = get_next_wakeup();
+            if (next > now) {
+                now_ = now; // nothing happens before `now`
+                break;
+            }
+            now_ = next;
+
+            for (unsigned level = kLevels - 1; level > 0; --level) {
+                unsigned shift = kSlotBits * level;
+                if (!(now_ & (((uint64_t)1 << shift) - 1))) {
+                    cascade(level, (now_ >> shift) & (kSlots - 1));
+                }
+            }
+
+            EventLoopTimer expired;
+            take_slot(0, now_ & (kSlots - 1), &expired);
+            while (expired.next != &expired) {
+                EventLoopTimer* timer = expired.next;
+                unlink(timer);
+                n_timers_--;
+                on_expired(timer);
+            }
+        }
+    }
+
+private:
+    // The expiry can be equal to now_ when a timer cascades at its expiry tick.
+    // It then goes into the level 0 slot that advance() expires next.
+    void link(EventLoopTimer* timer) {
+        uint64_t expiry = timer->expiry;
+        uint64_t delta = expiry - now_;
+        unsigned level = 0;
+        while (level < kLevels - 1 && delta >= ((uint64_t)1 << (kSlotBits * (level + 1)))) {
+            level++;
+        }
+        size_t index = (expiry >> (kSlotBits * level)) & (kSlots - 1);
+
+        EventLoopTimer* head = &slots_[level * kSlots + index];
+        timer->slot = (uint16_t)(level * kSlots + index);
+        timer->prev = head->prev;
+        timer->next = head;
+        head->prev->next = timer;
+        head->prev = timer;
+        occupied_[level][index / 64] |= (uint64_t)1 << (index % 64);
+    }
+
+    void unlink(EventLoopTimer* timer) {
+        timer->prev->next = timer->next;
+        timer->next->prev = timer->prev;
+        timer->prev = timer->next = nullptr;
+
+        // The timer might be in a list that was taken out of its slot
+        EventLoopTimer* head = &slots_[timer->slot];
+        if (head->next == head) {
+            occupied_[timer->slot / kSlots][(timer->slot % kSlots) / 64] &= ~((uint64_t)1 << (timer->slot % 64));
+        }
+    }
+
+    // Moves all timers of a slot into the list that starts at `list`
+    void take_slot(unsigned level, size_t index, EventLoopTimer* list) {
+        EventLoopTimer* head = &slots_[level * kSlots + index];
+        if (head->next == head) {
+            list->prev = list->next = list;
+        } else {
+            list->next = head->next;
+            list->prev = head->prev;
+            list->next->prev = list;
+            list->prev->next = list;
+            head->prev = head->next = head;
+        }
+        occupied_[level][index / 64] &= ~((uint64_t)1 << (index % 64));
+    }
+
+    void cascade(unsigned level, size_t index) {
+        EventLoopTimer list;
+        take_slot(level, index, &list);
+        while (list.next != &list) {
+            EventLoopTimer* timer = list.next;
+            unlink(timer);
+            link(timer);
+        }
+    }
+
+    // Returns the distance in slots from `index` to the next occupied slot of
+    // the given level (1 to kSlots) or 0 if all slots are empty.
+    size_t next_occupied(unsigned level, size_t index) const {
+        size_t distance = 1;
+        while (distance <= kSlots) {
+            size_t i = (index + distance) & (kSlots - 1);
+            uint64_t word = occupied_[level][i / 64] >> (i % 64);
+            if (word) {
+                return distance + __builtin_ctzll(word);
+            }
+            distance += 64 - i % 64;
+        }
+        return 0;
+    }
+
+    uint64_t now_ = 0; // [ticks]
+    size_t n_timers_ = 0;
+    EventLoopTimer slots_[kLevels * kSlots]; // list heads
+    uint64_t occupied_[kLevels][kSlots / 64] = {};
+};
+
+}
+
+#endif // __FIBRE_TIMER_WHEEL_HPP
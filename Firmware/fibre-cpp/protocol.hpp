@@ -5,6 +5,7 @@ see protocol.md for the protocol specification
 #ifndef __PROTOCOL_HPP
 #define __PROTOCOL_HPP
 
+#include <algorithm>
 #include <functional>
 #include <limits>
 #include <cmath>
@@ -23,17 +24,28 @@ typedef struct {
     uint16_t endpoint_id;
 } endpoint_ref_t;
 
+class Introspectable;
+
 
 namespace fibre {
 // These symbols are defined in the autogenerated endpoints.hpp
-extern const unsigned char embedded_json[];
+extern const unsigned char embedded_json_compressed[];
+extern const size_t embedded_json_compressed_length;
 extern const size_t embedded_json_length;
 extern const uint16_t json_crc_;
 extern const uint32_t json_version_id_;
 bool endpoint_handler(int idx, cbufptr_t* input_buffer, bufptr_t* output_buffer);
 bool endpoint0_handler(cbufptr_t* input_buffer, bufptr_t* output_buffer);
+bool batch_endpoint_handler(cbufptr_t* input_buffer, bufptr_t* output_buffer);
+bool call_endpoint_handler(cbufptr_t* input_buffer, bufptr_t* output_buffer);
+bool function_call_handler(int idx, cbufptr_t* input_buffer, bufptr_t* output_buffer);
 bool is_endpoint_ref_valid(endpoint_ref_t endpoint_ref);
+// Defined by the application. Called in a loop while a request waits for a
+// resource that a request from another interface holds, so it must let lower
+// priority threads run (e.g. osDelay(1)).
+void server_yield();
 bool set_endpoint_from_float(endpoint_ref_t endpoint_ref, float value);
+bool get_endpoint_property(endpoint_ref_t endpoint_ref, Introspectable* property);
 }
 
 
@@ -110,6 +122,35 @@ template<> struct Codec<endpoint_ref_t> {
             && SimpleSerializer<uint16_t, false>::write(value.json_crc, &(buffer->begin()), buffer->end());
     }
 };
+
+/**
+ * @brief Encodes up to `count` elements starting at `offset` into the buffer.
+ *
+ * This is used by block read functions. The elements are fetched in small
+ * chunks with `read(offset, values, count)` which must return how many
+ * elements it wrote. Encoding stops when the buffer is full or when `read`
+ * returns fewer elements than requested (end of the block).
+ */
+template<typename T, typename TRead>
+bool encode_block(uint32_t offset, uint32_t count, bufptr_t* buffer, TRead read) {
+    T chunk[16];
+    while (count) {
+        uint32_t n_chunk = std::min<uint32_t>(std::min<uint32_t>(count, sizeof(chunk) / sizeof(T)), buffer->size() / sizeof(T));
+        if (!n_chunk) {
+            break;
+        }
+        uint32_t n_read = read(offset, chunk, n_chunk);
+        for (uint32_t i = 0; i < n_read; ++i) {
+            Codec<T>::encode(chunk[i], buffer);
+        }
+        if (n_read < n_chunk) {
+            break;
+        }
+        offset += n_read;
+        count -= n_read;
+    }
+    return true;
+}
 }
 
 
@@ -251,6 +292,18 @@ template<typename T>
 bool set_from_float(float value, T* property) {
     return set_from_float_ex<T>(value, property, 0);
 }
+template<typename T, typename = std::enable_if_t<std::is_arithmetic<T>::value>>
+bool get_as_float_ex(T value, float* result, int) {
+    return *result = static_cast<float>(value), true;
+}
+template<typename T>
+bool get_as_float_ex(T value, float* result, ...) {
+    return false;
+}
+template<typename T>
+bool get_as_float(T value, float* result) {
+    return get_as_float_ex<T>(value, result, 0);
+}
 }
 
 
@@ -0,0 +1,319 @@
+/*
+* @brief Compares the arena JSON parser (json.hpp) against the previous
+* parser of LegacyObjectClient, which allocated every node in a shared_ptr and
+* copied subtrees whenever it inspected them.
+*
+* Both parsers parse the JSON definition and then visit it the way
+* LegacyObjectClient::load_object() does. The benchmark reports the time and
+* the number of heap allocations for each.
+*
+* Usage:
+*   g++ -std=c++17 -O2 -I.. json_benchmark.cpp -o json_benchmark
+*   ./json_benchmark [FILE]
+*
+* FILE is a JSON definition, e.g. one from the JSON cache of libfibre (see
+* README.md). Without FILE a synthetic definition with the size of the ODrive
+* definition is used.
+*/
+
+#include "json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <variant>
+#include <vector>
+
+static size_t n_allocations = 0;
+
+void* operator new(size_t size) {
+    n_allocations++;
+    if (void* ptr = malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+
+// The parser that LegacyObjectClient used before json.hpp, reduced to the
+// parts that the benchmark exercises.
+namespace legacy {
+
+struct json_error {
+    const char* ptr;
+    std::string str;
+};
+
+struct json_value;
+using json_list = std::vector<std::shared_ptr<json_value>>;
+using json_dict = std::vector<std::pair<std::shared_ptr<json_value>, std::shared_ptr<json_value>>>;
+using json_value_variant = std::variant<std::string, int, json_list, json_dict, json_error>;
+
+struct json_value : json_value_variant {
+    template<typename T> json_value(T&& arg) : json_value_variant{std::forward<T>(arg)} {}
+};
+
+bool json_is_str(json_value val) { return val.index() == 0; }
+bool json_is_int(json_value val) { return val.index() == 1; }
+bool json_is_list(json_value val) { return val.index() == 2; }
+bool json_is_dict(json_value val) { return val.index() == 3; }
+bool json_is_err(json_value val) { return val.index() == 4; }
+std::string json_as_str(json_value val) { return std::get<0>(val); }
+int json_as_int(json_value val) { return std::get<1>(val); }
+json_list json_as_list(json_value val) { return std::get<2>(val); }
+json_dict json_as_dict(json_value val) { return std::get<3>(val); }
+
+json_value json_make_error(const char* ptr, std::string str) {
+    return {json_error{ptr, str}};
+}
+
+json_value json_parse(const char** begin, const char* end) {
+    if (*begin >= end) {
+        return json_make_error(*begin, "expected value but got EOF");
+    }
+
+    if (fibre::json_comp(*begin, end, '{')) {
+        (*begin)++;
+        json_dict dict;
+        bool expect_comma = false;
+        fibre::json_skip_whitespace(begin, end);
+        while (!fibre::json_comp(*begin, end, '}')) {
+            if (expect_comma) {
+                if (!fibre::json_comp(*begin, end, ',')) {
+                    return json_make_error(*begin, "expected ',' or '}'");
+                }
+                (*begin)++;
+                fibre::json_skip_whitespace(begin, end);
+            }
+            expect_comma = true;
+            json_value key = json_parse(begin, end);
+            if (json_is_err(key)) return key;
+            fibre::json_skip_whitespace(begin, end);
+            if (!fibre::json_comp(*begin, end, ':')) {
+                return json_make_error(*begin, "expected :");
+            }
+            (*begin)++;
+            json_value val = json_parse(begin, end);
+            if (json_is_err(val)) return val;
+            dict.push_back({std::make_shared<json_value>(key), std::make_shared<json_value>(val)});
+            fibre::json_skip_whitespace(begin, end);
+        }
+        (*begin)++;
+        return {dict};
+
+    } else if (fibre::json_comp(*begin, end, '[')) {
+        (*begin)++;
+        json_list list;
+        bool expect_comma = false;
+        fibre::json_skip_whitespace(begin, end);
+        while (!fibre::json_comp(*begin, end, ']')) {
+            if (expect_comma) {
+                if (!fibre::json_comp(*begin, end, ',')) {
+                    return json_make_error(*begin, "expected ',' or ']'");
+                }
+                (*begin)++;
+                fibre::json_skip_whitespace(begin, end);
+            }
+            expect_comma = true;
+            json_value val = json_parse(begin, end);
+            if (json_is_err(val)) return val;
+            list.push_back(std::make_shared<json_value>(val));
+            fibre::json_skip_whitespace(begin, end);
+        }
+        (*begin)++;
+        return {list};
+
+    } else if (fibre::json_comp(*begin, end, '"')) {
+        (*begin)++;
+        std::string str;
+        while (!fibre::json_comp(*begin, end, '"')) {
+            if (*begin >= end) {
+                return json_make_error(*begin, "expected '\"' but got EOF");
+            }
+            str.push_back(**begin);
+            (*begin)++;
+        }
+        (*begin)++;
+        return {str};
+
+    } else if (isdigit((unsigned char)**begin)) {
+        std::string str;
+        while (*begin < end && isdigit((unsigned char)**begin)) {
+            str.push_back(**begin);
+            (*begin)++;
+        }
+        return {std::stoi(str)};
+
+    } else {
+        return json_make_error(*begin, "unexpected character");
+    }
+}
+
+json_value json_dict_find(json_dict dict, std::string key) {
+    auto it = std::find_if(dict.begin(), dict.end(),
+        [&](std::pair<std::shared_ptr<json_value>, std::shared_ptr<json_value>>& kv){
+            return json_is_str(*kv.first) && json_as_str(*kv.first) == key;
+        });
+    return (it == dict.end()) ? json_make_error(nullptr, "key not found") : *it->second;
+}
+
+size_t visit_arglist(const json_value& list_val) {
+    size_t n = 0;
+    for (auto& arg : json_is_list(list_val) ? json_as_list(list_val) : json_list()) {
+        auto dict = json_as_dict(*arg);
+        n += json_as_str(json_dict_find(dict, "name")).size() + json_as_int(json_dict_find(dict, "id"))
+           + json_as_str(json_dict_find(dict, "type")).size();
+    }
+    return n;
+}
+
+// Same accesses as the old LegacyObjectClient::load_object()
+size_t visit(json_value list_val) {
+    size_t n = 0;
+    for (auto& item: json_as_list(list_val)) {
+        auto dict = json_as_dict(*item);
+        json_value type = json_dict_find(dict, "type");
+        json_value name_val = json_dict_find(dict, "name");
+        n += json_is_str(name_val) ? json_as_str(name_val).size() : 0;
+
+        if (json_as_str(type) == "object") {
+            n += visit(json_dict_find(dict, "members"));
+        } else if (json_as_str(type) == "function") {
+            n += json_as_int(json_dict_find(dict, "id"));
+            n += visit_arglist(json_dict_find(dict, "inputs"));
+            n += visit_arglist(json_dict_find(dict, "outputs"));
+        } else if (json_as_str(type) != "json") {
+            json_value access = json_dict_find(dict, "access");
+            n += json_is_str(access) ? json_as_str(access).size() : 0;
+            n += json_as_int(json_dict_find(dict, "id")) + json_as_str(type).size();
+        }
+    }
+    return n;
+}
+
+}
+
+static size_t visit_arglist(const fibre::JsonNode* list_val) {
+    size_t n = 0;
+    for (const fibre::JsonNode* arg = list_val ? list_val->first_child : nullptr; arg; arg = arg->next) {
+        n += arg->find("name")->str.len + arg->find("id")->integer + arg->find("type")->str.len;
+    }
+    return n;
+}
+
+// Same accesses as LegacyObjectClient::load_object()
+static size_t visit(const fibre::JsonNode* list_val) {
+    size_t n = 0;
+    for (const fibre::JsonNode* item = list_val->first_child; item; item = item->next) {
+        const fibre::JsonNode* type = item->find("type");
+        const fibre::JsonNode* name_val = item->find("name");
+        n += name_val ? name_val->str.len : 0;
+
+        if (type->is_str("object")) {
+            n += visit(item->find("members"));
+        } else if (type->is_str("function")) {
+            n += item->find("id")->integer;
+            n += visit_arglist(item->find("inputs"));
+            n += visit_arglist(item->find("outputs"));
+        } else if (!type->is_str("json")) {
+            const fibre::JsonNode* access = item->find("access");
+            n += access ? access->str.len : 0;
+            n += item->find("id")->integer + type->str.len;
+        }
+    }
+    return n;
+}
+
+// Generates a definition with roughly the shape and size of the ODrive one.
+static std::string make_definition() {
+    int id = 1;
+    auto property = [&](std::string name, const char* type, const char* access) {
+        return "{\"name\":\"" + name + "\",\"id\":" + std::to_string(id++) + ",\"type\":\"" + type + "\",\"access\":\"" + access + "\"}";
+    };
+    auto function = [&](std::string name) {
+        std::string in = "{\"name\":\"obj\",\"id\":" + std::to_string(id++) + ",\"type\":\"uint32\",\"access\":\"rw\"}";
+        std::string out = "{\"name\":\"result\",\"id\":" + std::to_string(id++) + ",\"type\":\"float\",\"access\":\"r\"}";
+        return "{\"name\":\"" + name + "\",\"id\":" + std::to_string(id++) + ",\"type\":\"function\",\"inputs\":[" + in + "],\"outputs\":[" + out + "]}";
+    };
+    auto object = [&](std::string name, int depth, auto& self) -> std::string {
+        std::string members = property("error", "uint32", "rw");
+        for (int i = 0; i < 12; ++i) {
+            members += "," + property("property_" + std::to_string(i), i % 3 ? "float" : "bool", i % 2 ? "r" : "rw");
+        }
+        members += "," + function("function");
+        for (int i = 0; depth && i < 4; ++i) {
+            members += "," + self("object_" + std::to_string(i), depth - 1, self);
+        }
+        return "{\"name\":\"" + name + "\",\"type\":\"object\",\"members\":[" + members + "]}";
+    };
+
+    std::string json = "[{\"name\":\"\",\"id\":0,\"type\":\"json\",\"access\":\"r\"}";
+    for (int i = 0; i < 3; ++i) {
+        json += "," + object("axis" + std::to_string(i), 2, object);
+    }
+    return json + "]";
+}
+
+template<typename TFunc>
+static void measure(const char* name, size_t n_runs, TFunc func) {
+    double best_us = 1e12;
+    size_t allocations = 0;
+    size_t result = 0;
+    for (size_t i = 0; i < n_runs; ++i) {
+        size_t allocations_before = n_allocations;
+        auto start = std::chrono::steady_clock::now();
+        result = func();
+        auto end = std::chrono::steady_clock::now();
+        allocations = n_allocations - allocations_before;
+        best_us = std::min(best_us, std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    printf("%-24s %10.1f us %10zu allocations (checksum %zu)\n", name, best_us, allocations, result);
+}
+
+int main(int argc, char** argv) {
+    std::string json;
+    if (argc > 1) {
+        std::ifstream file(argv[1], std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "failed to open %s\n", argv[1]);
+            return 1;
+        }
+        json.assign(std::istreambuf_iterator<char>(file), {});
+    } else {
+        json = make_definition();
+    }
+    printf("JSON definition: %zu bytes\n", json.size());
+
+    const size_t n_runs = 20;
+
+    measure("shared_ptr parse+visit", n_runs, [&]() {
+        const char* begin = json.data();
+        legacy::json_value val = legacy::json_parse(&begin, json.data() + json.size());
+        if (!legacy::json_is_list(val)) {
+            fprintf(stderr, "parse error\n");
+            exit(1);
+        }
+        return legacy::visit(val);
+    });
+
+    measure("arena parse+visit", n_runs, [&]() {
+        const char* begin = json.data();
+        fibre::JsonArena arena;
+        fibre::JsonError error;
+        const fibre::JsonNode* val = fibre::json_parse(&arena, &begin, json.data() + json.size(), &error);
+        if (!val || !val->is_list()) {
+            fprintf(stderr, "parse error at position %zu: %s\n", (size_t)(error.ptr - json.data()), val ? "not a list" : error.str);
+            exit(1);
+        }
+        return visit(val);
+    });
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+* @brief Measures EpollEventLoop::post() with 8 producer threads against the
+* previous implementation, which appended to a std::vector under a mutex and
+* wrote to the eventfd on every post.
+*
+* Each producer posts n_posts callbacks and keeps at most `window` of them
+* pending (the bounded queue would refuse more). The event loop thread runs
+* the callbacks. The benchmark reports the throughput and how many eventfd
+* writes the posts caused.
+*
+* Usage:
+*   g++ -std=c++17 -O2 -I.. -I../include -DFIBRE_MAX_LOG_VERBOSITY=5 post_benchmark.cpp ../platform_support/epoll_event_loop.cpp ../logging.cpp -lpthread -o post_benchmark
+*   ./post_benchmark
+*/
+
+#include "platform_support/epoll_event_loop.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace fibre;
+
+static const size_t n_producers = 8;
+static const size_t n_posts = 200000; // per producer
+static const size_t window = 64; // per producer
+
+static std::atomic<size_t> n_eventfd_writes{0};
+
+// Replaces write() of libc to count the eventfd writes of both
+// implementations
+extern "C" ssize_t write(int fd, const void* buf, size_t count) {
+    n_eventfd_writes.fetch_add(1, std::memory_order_relaxed);
+    return syscall(SYS_write, fd, buf, count);
+}
+
+struct Producer {
+    std::atomic<size_t> n_completed{0};
+    static void on_posted(void* ctx) {
+        ((Producer*)ctx)->n_completed.fetch_add(1, std::memory_order_release);
+    }
+};
+
+// The previous implementation of EpollEventLoop::post() and run_callbacks()
+class MutexPostQueue {
+public:
+    MutexPostQueue() : post_fd_(eventfd(0, 0)) {}
+    ~MutexPostQueue() { close(post_fd_); }
+
+    bool post(Callback<void> callback) {
+        {
+            std::unique_lock<std::mutex> lock(pending_callbacks_mutex_);
+            pending_callbacks_.push_back(callback);
+        }
+
+        const uint64_t val = 1;
+        return write(post_fd_, &val, sizeof(val)) == sizeof(val);
+    }
+
+    void run_callbacks() {
+        uint64_t val;
+        if (read(post_fd_, &val, sizeof(val)) != sizeof(val)) {
+            return;
+        }
+
+        std::vector<Callback<void>> pending_callbacks;
+
+        {
+            std::unique_lock<std::mutex> lock(pending_callbacks_mutex_);
+            std::swap(pending_callbacks, pending_callbacks_);
+        }
+
+        for (auto& cb: pending_callbacks) {
+            cb.invoke();
+        }
+    }
+
+    int post_fd_;
+    std::vector<Callback<void>> pending_callbacks_;
+    std::mutex pending_callbacks_mutex_;
+};
+
+template<typename TPost>
+static void run_producers(const char* name, TPost post) {
+    std::vector<Producer> producers(n_producers);
+    std::vector<std::thread> threads;
+    size_t writes_before = n_eventfd_writes.load();
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto& producer: producers) {
+        threads.emplace_back([&producer, &post]() {
+            for (size_t i = 0; i < n_posts; ++i) {
+                while (i - producer.n_completed.load(std::memory_order_relaxed) >= window) {
+                    std::this_thread::yield();
+                }
+                while (!post(Callback<void>(&Producer::on_posted, &producer))) {
+                    std::this_thread::yield();
+                }
+            }
+            while (producer.n_completed.load() < n_posts) {
+                std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    size_t total = n_producers * n_posts;
+    printf("%-26s %8.2f M posts/s %10zu eventfd writes (%.3f per post)\n", name,
+           total / seconds * 1e-6, n_eventfd_writes.load() - writes_before,
+           (double)(n_eventfd_writes.load() - writes_before) / total);
+}
+
+int main() {
+    {
+        MutexPostQueue queue;
+        std::atomic<bool> done{false};
+        std::thread consumer([&]() {
+            while (!done.load()) {
+                queue.run_callbacks();
+            }
+        });
+        run_producers("mutex + std::vector", [&](Callback<void> cb) { return queue.post(cb); });
+        done = true;
+        queue.post(nullptr); // unblock the consumer
+        consumer.join();
+    }
+
+    {
+        EpollEventLoop loop;
+        std::atomic<bool> started{false};
+
+        // The loop runs until keepalive_fd is signalled
+        int keepalive_fd = eventfd(0, 0);
+        auto on_keepalive = [&](uint32_t) { loop.deregister_event(keepalive_fd); };
+        auto on_started = [&]() {
+            loop.register_event(keepalive_fd, EPOLLIN, on_keepalive);
+            started = true;
+        };
+
+        std::thread consumer([&]() { loop.start(on_started); });
+        while (!started) {
+            std::this_thread::yield();
+        }
+        run_producers("EpollEventLoop::post()", [&](Callback<void> cb) { return loop.post(cb); });
+        const uint64_t val = 1;
+        write(keepalive_fd, &val, sizeof(val));
+        consumer.join();
+        close(keepalive_fd);
+    }
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+/*
+* @brief Measures the throughput of libfibre with many devices for different
+* numbers of worker threads passed to libfibre_open_sharded().
+*
+* The devices are simulated in-process. Each one is a thread that serves the
+* legacy protocol on a TCP port on localhost and has a single float property.
+* libfibre discovers all devices and then keeps one read of that property in
+* flight per device for a fixed time. 0 workers means libfibre_open(), where
+* everything runs on the application's event loop.
+*
+* Usage:
+*   g++ -std=c++17 -O2 -I.. -I../include -DFIBRE_COMPILE -DFIBRE_ENABLE_CLIENT=1 -DFIBRE_ENABLE_EVENT_LOOP=1 -DFIBRE_ENABLE_TCP_CLIENT_BACKEND=1 -DFIBRE_ALLOW_HEAP=1 -DFIBRE_MAX_LOG_VERBOSITY=5 sharding_benchmark.cpp ../libfibre.cpp ../fibre.cpp ../channel_discoverer.cpp ../legacy_protocol.cpp ../legacy_object_client.cpp ../logging.cpp ../platform_support/epoll_event_loop.cpp ../platform_support/posix_tcp_backend.cpp ../platform_support/posix_socket.cpp -lpthread -lanl -o sharding_benchmark
+*   ./sharding_benchmark [n_devices] [seconds]
+*/
+
+#include <fibre/libfibre.h>
+#include "platform_support/epoll_event_loop.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const char json[] = "[{\"name\":\"value\",\"id\":1,\"type\":\"float\",\"access\":\"r\"}]";
+
+// Serves one connection at a time until the socket is shut down
+struct FakeDevice {
+    int listen_fd = -1;
+    int port = 0;
+    std::atomic<int> conn_fd{-1};
+    std::thread thread;
+
+    bool open() {
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addr_len = sizeof(addr);
+        if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+            || listen(listen_fd, 1) != 0 || getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len) != 0) {
+            return false;
+        }
+        port = ntohs(addr.sin_port);
+        thread = std::thread([this]() { serve(); });
+        return true;
+    }
+
+    void serve() {
+        for (;;) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                return;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            conn_fd = fd;
+
+            // The client never has more than one request in flight, so each
+            // read returns exactly one request.
+            uint8_t req[1024];
+            uint8_t resp[1024];
+            ssize_t n;
+            while ((n = read(fd, req, sizeof(req))) >= 8) {
+                uint16_t endpoint_id = (req[2] | (req[3] << 8)) & 0x7fff;
+                size_t max_len = std::min<size_t>(req[4] | (req[5] << 8), sizeof(resp) - 2);
+                size_t len = 0;
+
+                if (endpoint_id == 0) {
+                    // JSON version ID and compression info are not supported
+                    // and return nothing
+                    uint32_t offset = req[6] | (req[7] << 8) | (req[8] << 16) | ((uint32_t)req[9] << 24);
+                    if (offset < sizeof(json) - 1) {
+                        len = std::min(max_len, sizeof(json) - 1 - offset);
+                        memcpy(resp + 2, json + offset, len);
+                    }
+                } else if (endpoint_id == 1) {
+                    float value = 1.0f;
+                    len = std::min(max_len, sizeof(value));
+                    memcpy(resp + 2, &value, len);
+                }
+
+                resp[0] = req[0];
+                resp[1] = req[1] | 0x80;
+                if (write(fd, resp, 2 + len) != (ssize_t)(2 + len)) {
+                    break;
+                }
+            }
+
+            conn_fd = -1;
+            close(fd);
+        }
+    }
+
+    // Disconnects the current client
+    void disconnect() {
+        int fd = conn_fd;
+        if (fd >= 0) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+
+    void close_and_join() {
+        disconnect();
+        shutdown(listen_fd, SHUT_RDWR);
+        thread.join();
+        close(listen_fd);
+    }
+};
+
+// The application's event loop
+static fibre::EpollEventLoop* app_loop;
+
+static int app_post(void (*callback)(void*), void* ctx) {
+    return app_loop->post({callback, ctx}) ? 0 : -1;
+}
+static int app_register_event(int fd, uint32_t events, void (*callback)(void*, uint32_t), void* ctx) {
+    return app_loop->register_event(fd, events, {callback, ctx}) ? 0 : -1;
+}
+static int app_deregister_event(int fd) {
+    return app_loop->deregister_event(fd) ? 0 : -1;
+}
+static ::EventLoopTimer* app_call_later(float delay, void (*callback)(void*), void* ctx) {
+    return reinterpret_cast<::EventLoopTimer*>(app_loop->call_later(delay, {callback, ctx}));
+}
+static int app_cancel_timer(::EventLoopTimer* timer) {
+    return app_loop->cancel_timer(reinterpret_cast<fibre::EventLoopTimer*>(timer)) ? 0 : -1;
+}
+
+struct Run;
+
+struct Device {
+    Run* run;
+    LibFibreObject* root;
+    LibFibreObject* value = nullptr;
+    LibFibreBatchItem item;
+    unsigned char rx_buf[4];
+};
+
+struct Run {
+    size_t n_workers;
+    size_t n_devices;
+    double seconds;
+    std::string specs;
+    int keepalive_fd;
+
+    LibFibreCtx* ctx = nullptr;
+    LibFibreDomain* domain = nullptr;
+    LibFibreDiscoveryCtx* discovery = nullptr;
+    std::vector<Device*> devices;
+    size_t n_running = 0;
+    size_t n_reads = 0;
+    size_t n_errors = 0;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+    std::chrono::steady_clock::time_point finished;
+};
+
+static void start_read(Device* dev) {
+    dev->item = {dev->value, nullptr, 0, dev->rx_buf, sizeof(dev->rx_buf), nullptr};
+    LibFibreStatus status = libfibre_run_batch(&dev->item, 1, [](void* ctx, LibFibreStatus status) {
+        Device* dev = (Device*)ctx;
+        Run* run = dev->run;
+        run->n_reads++;
+        run->n_errors += (status != kFibreOk);
+
+        if (std::chrono::steady_clock::now() < run->end) {
+            start_read(dev);
+        } else if (--run->n_running == 0) {
+            run->finished = std::chrono::steady_clock::now();
+            libfibre_stop_discovery(run->discovery);
+            libfibre_close_domain(run->domain);
+            libfibre_close(run->ctx);
+
+            // libfibre leaves the TCP connections registered on the event
+            // loop. Give the workers' last callbacks some time to arrive.
+            app_loop->deregister_event(run->keepalive_fd);
+            app_loop->call_later(0.1f, {[](void*) { app_loop->stop(); }, nullptr});
+        }
+    }, dev);
+
+    if (status != kFibreBusy) {
+        fprintf(stderr, "libfibre_run_batch() failed with %d\n", (int)status);
+    }
+}
+
+static void on_found_object(void* ctx, LibFibreObject* obj, LibFibreInterface* intf) {
+    Run* run = (Run*)ctx;
+    Device* dev = new Device{run, obj};
+    run->devices.push_back(dev);
+
+    libfibre_subscribe_to_interface(intf, [](void* ctx, LibFibreAttribute* attr, const char* name, size_t name_length, LibFibreInterface*, const char*, size_t) {
+        Device* dev = (Device*)ctx;
+        if (std::string{name, name_length} == "value") {
+            libfibre_get_attribute(dev->root, attr, &dev->value);
+        }
+    }, nullptr, nullptr, nullptr, dev);
+
+    if (run->devices.size() == run->n_devices) {
+        run->start = std::chrono::steady_clock::now();
+        run->end = run->start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(run->seconds));
+        run->n_running = run->n_devices;
+        for (Device* dev: run->devices) {
+            start_read(dev);
+        }
+    }
+}
+
+static void run_benchmark(Run* run) {
+    LibFibreEventLoop event_loop = {};
+    event_loop.post = app_post;
+    event_loop.register_event = app_register_event;
+    event_loop.deregister_event = app_deregister_event;
+    event_loop.call_later = app_call_later;
+    event_loop.cancel_timer = app_cancel_timer;
+
+    app_loop = new fibre::EpollEventLoop();
+    run->keepalive_fd = eventfd(0, 0); // keeps the event loop running
+
+    app_loop->start([run, event_loop]() {
+        app_loop->register_event(run->keepalive_fd, EPOLLIN, {[](void*, uint32_t) {}, nullptr});
+        run->ctx = libfibre_open_sharded(event_loop, run->n_workers);
+        if (!run->ctx) {
+            fprintf(stderr, "libfibre_open_sharded() failed\n");
+            app_loop->deregister_event(run->keepalive_fd);
+            return;
+        }
+        run->domain = libfibre_open_domain(run->ctx, run->specs.data(), run->specs.size());
+        libfibre_start_discovery(run->domain, &run->discovery, on_found_object, [](void*, LibFibreObject*) {}, nullptr, run);
+    });
+
+    close(run->keepalive_fd);
+    delete app_loop;
+    for (Device* dev: run->devices) {
+        delete dev;
+    }
+}
+
+int main(int argc, const char** argv) {
+    size_t n_devices = argc > 1 ? atoi(argv[1]) : 16;
+    double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+
+    std::vector<FakeDevice> devices(n_devices);
+    std::string specs;
+    for (auto& device: devices) {
+        if (!device.open()) {
+            fprintf(stderr, "failed to open fake device\n");
+            return 1;
+        }
+        specs += (specs.size() ? ";" : "") + std::string{"tcp-client:address=127.0.0.1,port="} + std::to_string(device.port);
+    }
+
+    printf("%zu devices, %u CPU cores\n", n_devices, std::thread::hardware_concurrency());
+
+    for (size_t n_workers: {0, 1, 2, 4}) {
+        Run run;
+        run.n_workers = n_workers;
+        run.n_devices = n_devices;
+        run.seconds = seconds;
+        run.specs = specs;
+        run_benchmark(&run);
+
+        double elapsed = std::chrono::duration<double>(run.finished - run.start).count();
+        printf("%zu workers: %10.0f reads/s (%zu errors)\n", n_workers, run.n_reads / elapsed, run.n_errors);
+
+        // libfibre leaves the connections of closed domains open
+        for (auto& device: devices) {
+            device.disconnect();
+        }
+    }
+
+    for (auto& device: devices) {
+        device.close_and_join();
+    }
+    return 0;
+}
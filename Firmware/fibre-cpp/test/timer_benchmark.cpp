@@ -0,0 +1,133 @@
+/*
+* @brief Measures the timer wheel (platform_support/timer_wheel.hpp) and the
+* timers of EpollEventLoop with 100k active timers.
+*
+* The first part measures insertion, cancellation and expiry on a bare
+* TimerWheel. The second part starts 100k timers with random delays of up to
+* one second on an EpollEventLoop, cancels every tenth of them and reports how
+* late the others ran.
+*
+* Usage:
+*   g++ -std=c++17 -O2 -I.. -I../include -DFIBRE_MAX_LOG_VERBOSITY=5 timer_benchmark.cpp ../platform_support/epoll_event_loop.cpp ../logging.cpp -lpthread -o timer_benchmark
+*   ./timer_benchmark
+*/
+
+#include "platform_support/timer_wheel.hpp"
+#include "platform_support/epoll_event_loop.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace fibre;
+
+static const size_t n_timers = 100000;
+
+template<typename TFunc>
+static void measure(const char* name, TFunc func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("%-32s %10.1f ns per timer\n", name, ns / n_timers);
+}
+
+static void benchmark_wheel() {
+    std::mt19937 rng(1);
+    std::vector<uint64_t> delays(n_timers);
+    for (auto& delay: delays) {
+        delay = 1 + rng() % 100000;
+    }
+    std::vector<EventLoopTimer> timers(n_timers);
+    TimerWheel wheel;
+
+    measure("TimerWheel::add()", [&]() {
+        for (size_t i = 0; i < n_timers; ++i) {
+            wheel.add(&timers[i], delays[i]);
+        }
+    });
+
+    measure("TimerWheel::remove()", [&]() {
+        for (size_t i = 0; i < n_timers; ++i) {
+            wheel.remove(&timers[i]);
+        }
+    });
+
+    for (size_t i = 0; i < n_timers; ++i) {
+        wheel.add(&timers[i], delays[i]);
+    }
+
+    size_t n_expired = 0;
+    size_t n_wakeups = 0;
+    measure("TimerWheel::advance()", [&]() {
+        while (wheel.size()) {
+            wheel.advance(wheel.get_next_wakeup(), [&](EventLoopTimer*) { n_expired++; });
+            n_wakeups++;
+        }
+    });
+    printf("  %zu timers expired in %zu wakeups\n", n_expired, n_wakeups);
+}
+
+struct EventLoopBenchmark {
+    EpollEventLoop loop;
+    std::mt19937 rng{2};
+    std::vector<EventLoopTimer*> handles;
+    std::vector<std::chrono::steady_clock::time_point> deadlines;
+    std::vector<double> lateness_ms;
+    std::vector<std::pair<EventLoopBenchmark*, size_t>> contexts;
+    size_t n_cancelled = 0;
+
+    static void on_timer(void* ctx) {
+        auto* pair = (std::pair<EventLoopBenchmark*, size_t>*)ctx;
+        EventLoopBenchmark* self = pair->first;
+        auto now = std::chrono::steady_clock::now();
+        self->lateness_ms.push_back(std::chrono::duration<double, std::milli>(now - self->deadlines[pair->second]).count());
+    }
+
+    void on_started() {
+        handles.resize(n_timers);
+        deadlines.resize(n_timers);
+        contexts.resize(n_timers);
+
+        measure("EpollEventLoop::call_later()", [&]() {
+            for (size_t i = 0; i < n_timers; ++i) {
+                float delay = (float)(rng() % 1000) * 0.001f;
+                deadlines[i] = std::chrono::steady_clock::now() + std::chrono::microseconds((int64_t)(delay * 1e6f));
+                contexts[i] = {this, i};
+                handles[i] = loop.call_later(delay, Callback<void>(&on_timer, &contexts[i]));
+            }
+        });
+
+        measure("EpollEventLoop::cancel_timer()", [&]() {
+            for (size_t i = 0; i < n_timers; i += 10) {
+                n_cancelled += loop.cancel_timer(handles[i]) ? 1 : 0;
+            }
+        });
+    }
+
+    void run() {
+        auto start = std::chrono::steady_clock::now();
+        loop.start(MEMBER_CB(this, on_started));
+        auto end = std::chrono::steady_clock::now();
+
+        std::sort(lateness_ms.begin(), lateness_ms.end());
+        size_t n = lateness_ms.size();
+        printf("  %zu timers ran, %zu cancelled, loop ran for %.0f ms\n", n, n_cancelled,
+               std::chrono::duration<double, std::milli>(end - start).count());
+        if (n) {
+            printf("  lateness: min %.3f ms, median %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                   lateness_ms[0], lateness_ms[n / 2], lateness_ms[n * 99 / 100], lateness_ms[n - 1]);
+        }
+    }
+};
+
+int main() {
+    benchmark_wheel();
+
+    EventLoopBenchmark benchmark;
+    benchmark.run();
+
+    return 0;
+}
@@ -3,6 +3,8 @@
 
 #include <fibre/callback.hpp>
 #include <stdint.h>
+#include <array>
+#include <optional>
 
 using timestamp_t = uint32_t;
 
@@ -76,6 +76,7 @@ definitions:
         properties:
           in: {type: object}
           out: {type: object}
+          block: {type: string}
           brief: {type: string}
           doc: {type: string}
           __line__: {type: object}
@@ -212,6 +213,12 @@ def regularize_func(path, name, elem, prepend_args):
         elem = {}
     elem['name'] = name
     elem['fullname'] = path = join_name(path, name)
+    if 'block' in elem:
+        # Block read functions take a range of elements and return as many of
+        # them as fit into one response.
+        elem['block'] = regularize_valuetype(path, 'block', elem['block'])
+        elem['in'] = OrderedDict([('offset', 'uint32'), ('count', 'uint32')])
+        elem['out'] = OrderedDict()
     elem['in'] = OrderedDict((n, regularize_arg(path, n, arg))
                              for n, arg in (*prepend_args.items(), *get_dict(elem, 'in').items()))
     elem['out'] = OrderedDict((n, regularize_arg(path, n, arg))
@@ -506,6 +513,25 @@ def generate_endpoint_table(intf, bindto, idx):
             cnt += inner_cnt
 
     for k, func in intf.get_all_functions().items():
+        if 'block' in func:
+            # Block read functions are served by a single endpoint which takes
+            # all inputs and returns a variable number of elements.
+            endpoints.append({
+                'id': idx + cnt,
+                'function': func,
+                'in_bindings': OrderedDict([('obj', bindto)]),
+                'out_bindings': OrderedDict(),
+            })
+            endpoint_definitions.append({
+                'name': k,
+                'id': idx + cnt,
+                'type': 'function',
+                'inputs': [{'name': k_arg, 'id': idx + cnt, 'type': map_to_fibre01_type(arg['type'])} for k_arg, arg in list(func['in'].items())[1:]],
+                'outputs': [{'name': 'values', 'id': idx + cnt, 'type': map_to_fibre01_type(func['block']) + '[]'}]
+            })
+            cnt += 1
+            continue
+
         endpoints.append({
             'id': idx + cnt,
             'function': func,
@@ -619,6 +645,8 @@ for _, item in list(interfaces.items()):
             arg['type'] = resolve_valuetype(item.fullname, arg['type'])
         for _, arg in func['out'].items():
             arg['type'] = resolve_valuetype(item.fullname, arg['type'])
+        if 'block' in func:
+            func['block'] = resolve_valuetype(item.fullname, func['block'])
 
 # Attach interfaces to their parents
 toplevel_interfaces = []
@@ -652,6 +680,74 @@ else:
     endpoints = None
 
 
+def calc_crc16(remainder, data, polynomial=0x3d65):
+    """Same as calc_crc16<CANONICAL_CRC16_POLYNOMIAL>() in fibre-cpp/crc.hpp"""
+    for byte in data:
+        remainder ^= byte << 8
+        for _ in range(8):
+            remainder = ((remainder << 1) ^ polynomial) if remainder & 0x8000 else (remainder << 1)
+        remainder &= 0xffff
+    return remainder
+
+def lzss_compress(data, window_bits, lookahead_bits):
+    """
+    Compresses data into the LZSS bitstream that fibre::LzssDecoder
+    (fibre-cpp/lzss.hpp) reads.
+    """
+    window = 1 << window_bits
+    max_len = 1 << lookahead_bits
+    min_len = (1 + window_bits + lookahead_bits) // 9 + 1 # shorter matches are cheaper as literals
+    output = bytearray()
+    acc = 0
+    n_acc = 0
+
+    def put(value, n_bits):
+        nonlocal acc, n_acc
+        acc = (acc << n_bits) | value
+        n_acc += n_bits
+        while n_acc >= 8:
+            n_acc -= 8
+            output.append((acc >> n_acc) & 0xff)
+        acc &= (1 << n_acc) - 1
+
+    # Positions of all 3-byte sequences so far, to find match candidates quickly
+    chains = {}
+    def insert(i):
+        chains.setdefault(data[i:i+3], []).append(i)
+
+    pos = 0
+    while pos < len(data):
+        best_len = 0
+        best_offset = 0
+        for candidate in reversed(chains.get(data[pos:pos+3], [])[-256:]):
+            if pos - candidate > window:
+                break
+            length = 0
+            while length < max_len and pos + length < len(data) and data[candidate + length] == data[pos + length]:
+                length += 1
+            if length > best_len:
+                best_len, best_offset = length, pos - candidate
+                if length == max_len:
+                    break
+
+        if best_len >= min_len:
+            put(0, 1)
+            put(best_offset - 1, window_bits)
+            put(best_len - 1, lookahead_bits)
+        else:
+            best_len = 1
+            put(1, 1)
+            put(data[pos], 8)
+
+        for i in range(pos, pos + best_len):
+            insert(i)
+        pos += best_len
+
+    if n_acc:
+        put(0, 8 - n_acc)
+    return bytes(output)
+
+
 # Render template
 
 env = jinja2.Environment(
@@ -712,6 +808,10 @@ env.filters['to_kebab_case'] = to_kebab_case
 env.filters['first'] = lambda x: next(iter(x))
 env.filters['skip_first'] = lambda x: list(x)[1:]
 env.filters['to_c_string'] = lambda x: '\n'.join(('"' + line.replace('"', '\\"') + '"') for line in json.dumps(x, separators=(',', ':')).replace('{"name"', '\n{"name"').split('\n'))
+env.filters['to_json_bytes'] = lambda x: json.dumps(x, separators=(',', ':')).encode('ascii')
+env.filters['to_c_bytes'] = lambda x: '\n'.join('    ' + ' '.join('0x{:02x},'.format(b) for b in x[i:i+16]) for i in range(0, len(x), 16))
+env.filters['crc16'] = lambda x, init: calc_crc16(init, x)
+env.filters['lzss_compress'] = lzss_compress
 env.filters['tokenize'] = tokenize
 env.filters['diagonalize'] = lambda lst: [lst[:i + 1] for i in range(len(lst))]
 env.filters['debug'] = lambda x: print(x)
@@ -56,6 +56,43 @@ ENCODER_MODE_SPI_ABS_AEAT                = 258
 ENCODER_MODE_SPI_ABS_RLS                 = 259
 ENCODER_MODE_SPI_ABS_MA732               = 260
 
+# ODrive.Oscilloscope.OscilloscopeState
+OSCILLOSCOPE_STATE_IDLE                  = 0
+OSCILLOSCOPE_STATE_ARMED                 = 1
+OSCILLOSCOPE_STATE_TRIGGERED             = 2
+OSCILLOSCOPE_STATE_DONE                  = 3
+
+# ODrive.Oscilloscope.OscilloscopeTriggerMode
+OSCILLOSCOPE_TRIGGER_MODE_IMMEDIATE      = 0
+OSCILLOSCOPE_TRIGGER_MODE_RISING         = 1
+OSCILLOSCOPE_TRIGGER_MODE_FALLING        = 2
+OSCILLOSCOPE_TRIGGER_MODE_LEVEL          = 3
+
+# ODrive.Trace.TraceEventType
+TRACE_EVENT_TYPE_BEGIN                   = 0
+TRACE_EVENT_TYPE_END                     = 1
+TRACE_EVENT_TYPE_INSTANT                 = 2
+TRACE_EVENT_TYPE_OVERRUN                 = 3
+
+# ODrive.Trace.TraceSource
+TRACE_SOURCE_CONTROL_LOOP                = 0
+TRACE_SOURCE_USB_EVENT                   = 1
+TRACE_SOURCE_CAN_MESSAGE                 = 2
+TRACE_SOURCE_AXIS0_STATE                 = 3
+TRACE_SOURCE_AXIS1_STATE                 = 4
+TRACE_SOURCE_TASK_TIMERS                 = 256
+
+# ODrive.Telemetry.TelemetrySignal
+TELEMETRY_SIGNAL_AXIS0_POS               = 0x00000001
+TELEMETRY_SIGNAL_AXIS0_VEL               = 0x00000002
+TELEMETRY_SIGNAL_AXIS0_IQ                = 0x00000004
+TELEMETRY_SIGNAL_AXIS0_ERROR             = 0x00000008
+TELEMETRY_SIGNAL_AXIS1_POS               = 0x00000010
+TELEMETRY_SIGNAL_AXIS1_VEL               = 0x00000020
+TELEMETRY_SIGNAL_AXIS1_IQ                = 0x00000040
+TELEMETRY_SIGNAL_AXIS1_ERROR             = 0x00000080
+TELEMETRY_SIGNAL_VBUS                    = 0x00000100
+
 # ODrive.Controller.ControlMode
 CONTROL_MODE_VOLTAGE_CONTROL             = 0
 CONTROL_MODE_TORQUE_CONTROL              = 1
@@ -72,6 +109,8 @@ INPUT_MODE_TRAP_TRAJ                     = 5
 INPUT_MODE_TORQUE_RAMP                   = 6
 INPUT_MODE_MIRROR                        = 7
 INPUT_MODE_TUNING                        = 8
+INPUT_MODE_SCURVE_TRAJ                   = 9
+INPUT_MODE_PVT                           = 10
 
 # ODrive.Motor.MotorType
 MOTOR_TYPE_HIGH_CURRENT                  = 0
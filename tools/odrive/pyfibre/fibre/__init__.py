@@ -1,4 +1,4 @@
 
-from .utils import Event, Logger, TimeoutError
+from .utils import Event, Logger, TimeoutError, read_block
 from .shell import launch_shell
-from .libfibre import Domain, ObjectLostError
+from .libfibre import Domain, ObjectLostError, subscribe_to_stream_packets, run_batch
@@ -1,6 +1,7 @@
 #!/bin/python
 
 from ctypes import *
+import array
 import asyncio
 import os
 from itertools import count, takewhile
@@ -92,6 +93,8 @@ OnFunctionRemovedSignature = CFUNCTYPE(None, c_void_p, c_void_p)
 OnCallCompletedSignature = CFUNCTYPE(c_int, c_void_p, c_int, c_void_p, c_void_p, POINTER(c_void_p), POINTER(c_size_t), POINTER(c_void_p), POINTER(c_size_t))
 OnTxCompletedSignature = CFUNCTYPE(None, c_void_p, c_void_p, c_int, c_void_p)
 OnRxCompletedSignature = CFUNCTYPE(None, c_void_p, c_void_p, c_int, c_void_p)
+OnStreamPacketSignature = CFUNCTYPE(None, c_void_p, c_void_p, c_size_t, c_uint32)
+OnBatchCompletedSignature = CFUNCTYPE(None, c_void_p, c_int)
 
 kFibreOk = 0
 kFibreBusy = 1
@@ -112,6 +115,16 @@ class LibFibreVersion(Structure):
     def __repr__(self):
         return "{}.{}.{}".format(self.major, self.minor, self.patch)
 
+class LibFibreBatchItem(Structure):
+    _fields_ = [
+        ("obj", c_void_p),
+        ("tx_buf", c_void_p),
+        ("tx_len", c_size_t),
+        ("rx_buf", c_void_p),
+        ("rx_len", c_size_t),
+        ("rx_end", c_void_p),
+    ]
+
 class LibFibreEventLoop(Structure):
     _fields_ = [
         ("post", PostSignature),
@@ -133,6 +146,12 @@ libfibre_open = lib.libfibre_open
 libfibre_open.argtypes = [LibFibreEventLoop]
 libfibre_open.restype = c_void_p
 
+# Not available in older versions of libfibre
+libfibre_open_sharded = getattr(lib, 'libfibre_open_sharded', None)
+if libfibre_open_sharded:
+    libfibre_open_sharded.argtypes = [LibFibreEventLoop, c_size_t]
+    libfibre_open_sharded.restype = c_void_p
+
 libfibre_close = lib.libfibre_close
 libfibre_close.argtypes = [c_void_p]
 libfibre_close.restype = None
@@ -161,6 +180,18 @@ libfibre_get_attribute = lib.libfibre_get_attribute
 libfibre_get_attribute.argtypes = [c_void_p, c_void_p, POINTER(c_void_p)]
 libfibre_get_attribute.restype = c_int
 
+# Not present in libfibre builds that predate stream packets
+libfibre_subscribe_to_stream_packets = getattr(lib, 'libfibre_subscribe_to_stream_packets', None)
+if libfibre_subscribe_to_stream_packets:
+    libfibre_subscribe_to_stream_packets.argtypes = [c_void_p, OnStreamPacketSignature, c_void_p]
+    libfibre_subscribe_to_stream_packets.restype = c_int
+
+# Not available in older versions of libfibre
+libfibre_run_batch = getattr(lib, 'libfibre_run_batch', None)
+if libfibre_run_batch:
+    libfibre_run_batch.argtypes = [POINTER(LibFibreBatchItem), c_size_t, OnBatchCompletedSignature, c_void_p]
+    libfibre_run_batch.restype = c_int
+
 libfibre_call = lib.libfibre_call
 libfibre_call.argtypes = [c_void_p, POINTER(c_void_p), c_int, c_void_p, c_size_t, c_void_p, c_size_t, POINTER(c_void_p), POINTER(c_void_p), OnCallCompletedSignature, c_void_p]
 libfibre_call.restype = c_int
@@ -243,6 +274,24 @@ class ObjectPtrCodec():
         handle = struct.unpack("P", buffer)[0]
         return None if handle == 0 else libfibre._objects[handle]
 
+class BlockCodec():
+    """
+    Deserializer for the variable-length output of block read functions.
+
+    The result is an array.array which supports the buffer protocol, so it can
+    be wrapped by numpy.frombuffer() without copying.
+    """
+    def __init__(self, typecode):
+        self._typecode = typecode
+    def get_length(self):
+        return array.array(self._typecode).itemsize
+    def serialize(self, libfibre, value):
+        raise TypeError("block codecs can only be used for outputs")
+    def deserialize(self, libfibre, buffer):
+        value = array.array(self._typecode, buffer)
+        if sys.byteorder != 'little':
+            value.byteswap()
+        return value
 
 codecs = {
     'int8': StructCodec("<b", int),
@@ -255,7 +304,9 @@ codecs = {
     'uint64': StructCodec("<Q", int),
     'bool': StructCodec("<?", bool),
     'float': StructCodec("<f", float),
-    'object_ref': ObjectPtrCodec()
+    'object_ref': ObjectPtrCodec(),
+    'float[]': BlockCodec('f'),
+    'uint32[]': BlockCodec('I'),
 }
 
 def decode_arg_list(arg_names, codec_names):
@@ -519,6 +570,7 @@ class RemoteFunction(object):
         self._inputs = inputs
         self._outputs = outputs
         self._rx_size = sum(codec.get_length() for _, _, codec in self._outputs)
+        self._is_block = len(self._outputs) == 1 and isinstance(self._outputs[0][2], BlockCodec)
 
     async def async_call(self, args, cancellation_token):
         #print("making call on " + hex(args[0]._obj_handle))
@@ -527,6 +579,10 @@ class RemoteFunction(object):
             tx_buf += arg[2].serialize(self._libfibre, args[i])
         rx_buf = bytes()
 
+        # Block read functions take the number of elements as last argument
+        # and may return fewer elements than that.
+        rx_size = args[-1] * self._rx_size if self._is_block else self._rx_size
+
         agen = Call(self)
         
         if not cancellation_token is None:
@@ -537,13 +593,16 @@ class RemoteFunction(object):
 
             is_closed = False
             while not is_closed:
-                tx_buf, rx_chunk, is_closed = await agen.asend((tx_buf, self._rx_size - len(rx_buf), True))
+                tx_buf, rx_chunk, is_closed = await agen.asend((tx_buf, rx_size - len(rx_buf), True))
                 rx_buf += rx_chunk
 
         finally:
             if not cancellation_token is None:
                 cancellation_token.remove_done_callback(agen.cancel)
 
+        if self._is_block:
+            return self._outputs[0][2].deserialize(self._libfibre, rx_buf)
+
         assert(len(rx_buf) == self._rx_size)
 
         outputs = []
@@ -723,6 +782,94 @@ class RemoteObject(object):
         on_lost.set_result(True)
 
 
+class StreamPacketSubscription():
+    """
+    Receives the stream packets that a remote device sends without being asked
+    (e.g. telemetry). Use subscribe_to_stream_packets() to create one.
+    """
+    def __init__(self, obj, callback):
+        self._libfibre = obj._libfibre
+        self._obj_handle = obj._obj_handle
+        self._c_on_stream_packet = OnStreamPacketSignature(
+            lambda ctx, buf, length, n_lost: callback(string_at(buf, length), n_lost))
+        run_coroutine_threadsafe(self._libfibre.loop, lambda:
+            libfibre_subscribe_to_stream_packets(self._obj_handle, self._c_on_stream_packet, None))
+
+    def cancel(self):
+        if self._c_on_stream_packet is None:
+            return
+        run_coroutine_threadsafe(self._libfibre.loop, lambda:
+            libfibre_subscribe_to_stream_packets(self._obj_handle, None, None))
+        self._c_on_stream_packet = None
+
+def subscribe_to_stream_packets(obj, callback):
+    """
+    Subscribes to the stream packets of the device that obj belongs to. There
+    can be only one subscription per device.
+
+    callback(payload, n_lost) is invoked on the libfibre thread with the packet
+    payload (bytes) and the number of packets that were lost before this one.
+    Returns a StreamPacketSubscription which must be cancelled to unsubscribe.
+    """
+    if libfibre_subscribe_to_stream_packets is None:
+        raise NotImplementedError("this version of libfibre does not support stream packets")
+    return StreamPacketSubscription(obj, callback)
+
+
+class Batch():
+    """
+    Reads and writes several properties of one device with as few requests as
+    possible. Use run_batch() to create one.
+    """
+    def __init__(self, items):
+        self._libfibre = items[0][0]._libfibre
+        self._codecs = [prop.__class__.read._outputs[0][2] for prop, _ in items]
+        self._tx_bufs = [None if value is None else codec.serialize(self._libfibre, value)
+                         for (_, value), codec in zip(items, self._codecs)]
+        self._rx_bufs = [create_string_buffer(codec.get_length()) for codec in self._codecs]
+        self._items = (LibFibreBatchItem * len(items))()
+        for i, (prop, _) in enumerate(items):
+            self._items[i].obj = prop._obj_handle
+            self._items[i].tx_buf = None if self._tx_bufs[i] is None else cast(self._tx_bufs[i], c_void_p)
+            self._items[i].tx_len = 0 if self._tx_bufs[i] is None else len(self._tx_bufs[i])
+            self._items[i].rx_buf = cast(self._rx_bufs[i], c_void_p)
+            self._items[i].rx_len = len(self._rx_bufs[i])
+        self._c_on_completed = OnBatchCompletedSignature(self._on_completed)
+        self._future = self._libfibre.loop.create_future()
+
+    def _on_completed(self, ctx, status):
+        if status != kFibreOk:
+            self._future.set_exception(_get_exception(status))
+        else:
+            self._future.set_result([codec.deserialize(self._libfibre, rx_buf.raw)
+                                     for codec, rx_buf in zip(self._codecs, self._rx_bufs)])
+
+    async def run(self):
+        status = libfibre_run_batch(self._items, len(self._items), self._c_on_completed, None)
+        if status != kFibreBusy:
+            raise _get_exception(status)
+        return await self._future
+
+def run_batch(items):
+    """
+    Reads or writes several properties of the same device with as few requests
+    as possible. Firmware without batch support gets one request per property.
+
+    items is a list of (prop, value) tuples where prop is a property object
+    such as odrv0.axis0.encoder._pos_estimate_property and value is the value
+    to write or None to only read the property. The properties are accessed in
+    the listed order.
+    Returns a list with the value of each property before the write.
+    """
+    if libfibre_run_batch is None:
+        raise NotImplementedError("this version of libfibre does not support batch requests")
+    if len(items) == 0:
+        return []
+    if threading.current_thread() != libfibre_thread:
+        return run_coroutine_threadsafe(items[0][0]._libfibre.loop, lambda: run_batch(items))
+    return asyncio.ensure_future(Batch(items).run(), loop=items[0][0]._libfibre.loop)
+
+
 class LibFibre():
     def __init__(self):
         self.loop = asyncio.get_event_loop()
@@ -757,7 +904,14 @@ class LibFibre():
         event_loop.call_later = self.c_call_later
         event_loop.cancel_timer = self.c_cancel_timer
 
-        self.ctx = c_void_p(libfibre_open(event_loop))
+        # Setting FIBRE_WORKER_THREADS spreads the devices over that many
+        # threads inside libfibre. This is experimental and adds overhead to
+        # every call, so only use it if it measurably helps with your setup.
+        n_workers = int(os.environ.get('FIBRE_WORKER_THREADS', '0'))
+        if n_workers and libfibre_open_sharded:
+            self.ctx = c_void_p(libfibre_open_sharded(event_loop, n_workers))
+        else:
+            self.ctx = c_void_p(libfibre_open(event_loop))
         assert(self.ctx)
 
     def _post(self, callback, ctx):
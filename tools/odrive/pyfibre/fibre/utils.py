@@ -123,6 +123,24 @@ def wait_any(timeout=None, *events):
     raise TimeoutError()
 
 
+## Function utils ##
+
+def read_block(func, offset, count):
+    """
+    Reads count elements with a block read function (such as
+    odrv0.oscilloscope.read_block) by calling it repeatedly with an increasing
+    offset. Stops early if the device has fewer elements.
+    Returns an array.array which can be passed to numpy.frombuffer() without
+    copying.
+    """
+    result = func(offset, count)
+    while len(result) < count:
+        chunk = func(offset + len(result), count - len(result))
+        if not len(chunk):
+            break
+        result.extend(chunk)
+    return result
+
 ## Log utils ##
 
 class Logger():
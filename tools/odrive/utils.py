@@ -6,7 +6,9 @@ import threading
 import platform
 import subprocess
 import os
-from fibre.utils import Event
+import collections
+import struct
+from fibre.utils import Event, read_block
 import odrive.enums
 from odrive.enums import *
 
@@ -125,12 +127,112 @@ def dump_errors(odrv, clear=False, printfunc = print):
         for name, obj, path, errorcodes in module_decode_map:
             dump_errors_for_module("  ", name, obj, path, errorcodes)
 
-def oscilloscope_dump(odrv, num_vals, filename='oscilloscope.csv'):
+def oscilloscope_dump(odrv, num_vals=None, filename='oscilloscope.csv'):
+    """
+    Writes the last oscilloscope capture to a CSV file with one row per record
+    and one column per channel.
+    """
+    n_channels = max(odrv.oscilloscope.n_channels, 1)
+    if num_vals is None:
+        num_vals = odrv.oscilloscope.size
+    values = get_oscilloscope_values(odrv, num_vals)
     with open(filename, 'w') as f:
-        for x in range(num_vals):
-            f.write(str(odrv.oscilloscope.get_val(x)))
+        for x in range(0, len(values), n_channels):
+            f.write(','.join(str(v) for v in values[x:x + n_channels]))
             f.write('\n')
 
+def get_oscilloscope_values(odrv, num_vals=None):
+    """
+    Returns the values of the last oscilloscope capture, interleaved by channel.
+    """
+    if num_vals is None:
+        num_vals = odrv.oscilloscope.size
+    if hasattr(odrv.oscilloscope, 'read_block'):
+        return read_block(odrv.oscilloscope.read_block, 0, num_vals)
+    else:
+        # Older firmware: one value per round trip
+        return [odrv.oscilloscope.get_val(i) for i in range(num_vals)]
+
+class TelemetryStream():
+    """
+    Receives the samples that odrv.telemetry streams from the control loop.
+
+    signals is a combination of TELEMETRY_SIGNAL_* flags. Each sample is a
+    tuple (timestamp [s], value of each selected signal in ascending flag
+    order). The samples are buffered until they are fetched with
+    get_samples(). If more than max_samples are buffered, the oldest ones are
+    discarded.
+
+    Drop counters:
+     - n_lost: frames that didn't arrive, either because the ODrive dropped
+       them (see odrv.telemetry.n_dropped) or because they got lost on the way
+     - n_overflow: samples that were discarded because get_samples() wasn't
+       called often enough
+    """
+    def __init__(self, odrv, signals, decimation=None, max_samples=100000):
+        self._odrv = odrv
+        self._signals = signals
+        self._decimation = decimation
+        self._samples = collections.deque()
+        self._max_samples = max_samples
+        self._lock = threading.Lock()
+        self._subscription = None
+        self._last_timestamp = None
+        self._timestamp_offset = 0
+        self.n_frames = 0
+        self.n_lost = 0
+        self.n_overflow = 0
+
+    @staticmethod
+    def is_supported(odrv):
+        import fibre.libfibre
+        return hasattr(odrv, 'telemetry') and not fibre.libfibre.libfibre_subscribe_to_stream_packets is None
+
+    def start(self):
+        from fibre import subscribe_to_stream_packets
+        self._odrv.telemetry.config.signals = self._signals
+        if not self._decimation is None:
+            self._odrv.telemetry.config.decimation = self._decimation
+        self._subscription = subscribe_to_stream_packets(self._odrv, self._on_frame)
+        if not self._odrv.telemetry.start():
+            self.stop()
+            raise Exception("failed to start telemetry")
+
+    def stop(self):
+        try:
+            self._odrv.telemetry.stop()
+        finally:
+            if self._subscription:
+                self._subscription.cancel()
+                self._subscription = None
+
+    def get_samples(self):
+        with self._lock:
+            samples = list(self._samples)
+            self._samples.clear()
+        return samples
+
+    def _on_frame(self, payload, n_lost):
+        timestamp, signals, interval = struct.unpack_from('<IHH', payload)
+        fmt = '<' + ''.join('I' if (bit in (TELEMETRY_SIGNAL_AXIS0_ERROR, TELEMETRY_SIGNAL_AXIS1_ERROR)) else 'f'
+                            for bit in (1 << i for i in range(16)) if signals & bit)
+        sample_size = struct.calcsize(fmt)
+
+        # Extend the 32-bit microsecond timestamp
+        if not self._last_timestamp is None and timestamp < self._last_timestamp:
+            self._timestamp_offset += 1 << 32
+        self._last_timestamp = timestamp
+        t0 = (timestamp + self._timestamp_offset) * 1e-6
+
+        with self._lock:
+            self.n_frames += 1
+            self.n_lost += n_lost
+            for i, values in enumerate(struct.iter_unpack(fmt, payload[8:8 + (len(payload) - 8) // sample_size * sample_size])):
+                self._samples.append((t0 + i * interval * 1e-6,) + values)
+            while len(self._samples) > self._max_samples:
+                self._samples.popleft()
+                self.n_overflow += 1
+
 data_rate = 200
 plot_rate = 10
 num_samples = 500
@@ -138,6 +240,8 @@ def start_liveplotter(get_var_callback):
     """
     Starts a liveplotter.
     The variable that is plotted is retrieved from get_var_callback.
+    get_var_callback can also be a TelemetryStream, in which case the ODrive
+    streams the values instead of being polled.
     This function returns immediately and the liveplotter quits when
     the user closes it.
     """
@@ -162,6 +266,19 @@ def start_liveplotter(get_var_callback):
                 vals = vals[-num_samples:]
             time.sleep(1/data_rate)
 
+    def fetch_telemetry():
+        global vals
+        telemetry = get_var_callback
+        telemetry.start()
+        try:
+            while not cancellation_token.is_set():
+                vals.extend(sample[1:] for sample in telemetry.get_samples())
+                if len(vals) > num_samples:
+                    vals = vals[-num_samples:]
+                time.sleep(1/plot_rate)
+        finally:
+            telemetry.stop()
+
     # TODO: use animation for better UI performance, see:
     # https://matplotlib.org/examples/animation/simple_anim.html
     def plot_data():
@@ -182,7 +299,7 @@ def start_liveplotter(get_var_callback):
             fig.canvas.draw()
             fig.canvas.start_event_loop(1/plot_rate)
 
-    fetch_t = threading.Thread(target=fetch_data)
+    fetch_t = threading.Thread(target=fetch_telemetry if isinstance(get_var_callback, TelemetryStream) else fetch_data)
     fetch_t.daemon = True
     fetch_t.start()
     
@@ -315,13 +432,13 @@ def print_drv_regs(name, motor):
     print("Control Reg 2: " + str(ctrl_reg_2) + " (" + format(ctrl_reg_2, '#09b') + ")")
 
 def show_oscilloscope(odrv):
-    size = 18000
-    values = []
-    for i in range(size):
-        values.append(odrv.oscilloscope.get_val(i))
+    n_channels = max(odrv.oscilloscope.n_channels, 1)
+    values = get_oscilloscope_values(odrv)
 
     import matplotlib.pyplot as plt
-    plt.plot(values)
+    for channel in range(n_channels):
+        plt.plot(values[channel::n_channels], label='channel {}'.format(channel))
+    plt.legend()
     plt.show()
 
 def rate_test(device):
@@ -587,20 +704,70 @@ def dump_dma(odrv):
                      ("(" + ch_name + ")").ljust(30),
                      "*" if (status & 0x80000000) else " "))
 
-def dump_timing(odrv, n_samples=100, path='/tmp/timings.png'):
-    import matplotlib.pyplot as plt
+def get_task_timers(odrv):
+    """
+    Returns the names and objects of all task timers as a list of tuples.
+    """
     import re
-    
-    timings = []
-    
+    timers = []
     for attr in dir(odrv.task_times):
         if not attr.startswith('_'):
-            timings.append((attr, getattr(odrv.task_times, attr), [], [])) # (name, obj, start_times, lengths)
+            timers.append((attr, getattr(odrv.task_times, attr)))
     for k in dir(odrv):
         if re.match(r'axis[0-9]+', k):
             for attr in dir(getattr(odrv, k).task_times):
                 if not attr.startswith('_'):
-                    timings.append((k + '.' + attr, getattr(getattr(odrv, k).task_times, attr), [], [])) # (name, obj, start_times, lengths)
+                    timers.append((k + '.' + attr, getattr(getattr(odrv, k).task_times, attr)))
+    return timers
+
+def get_timing_histogram(timer):
+    """
+    Returns the histogram of a TaskTimer as a list of (bin start, bin end, count).
+    The end of the last bin is None because it also counts all longer
+    measurements.
+    """
+    counts = read_block(timer.read_histogram, 0, 32)
+    starts = [i if i < 2 else (2 + i % 2) << (i // 2 - 1) for i in range(len(counts) + 1)]
+    return [(starts[i], starts[i + 1] if i + 1 < len(counts) else None, counts[i]) for i in range(len(counts))]
+
+def get_timing_percentile(histogram, q):
+    """
+    Estimates the q-th percentile (0...100) of a histogram returned by
+    get_timing_histogram() by interpolating within the bin. Returns None if the
+    histogram is empty.
+    """
+    total = sum(count for start, end, count in histogram)
+    if not total:
+        return None
+    rank = q / 100 * total
+    for start, end, count in histogram:
+        if count and rank <= count:
+            return start if end is None else start + (end - start) * rank / count
+        rank -= count
+    return histogram[-1][0]
+
+def dump_timing(odrv, n_samples=100, path='/tmp/timings.png'):
+    """
+    Prints the length distribution of all task timers since the last
+    reset_histogram() and plots the timing of a few control loop iterations
+    to path. All times are in ticks of the control loop counter.
+    """
+    import matplotlib.pyplot as plt
+    import numpy as np
+
+    timings = [(name, obj, [], []) for name, obj in get_task_timers(odrv)] # (name, obj, start_times, lengths)
+
+    if hasattr(odrv.task_times.sampling, 'read_histogram'):
+        print("| Name                                 |   Count |    p50 |    p99 |  p99.9 |    Max | Overruns |")
+        print("|--------------------------------------|---------|--------|--------|--------|--------|----------|")
+        for name, obj, start_times, lengths in timings:
+            histogram = get_timing_histogram(obj)
+            percentiles = [get_timing_percentile(histogram, q) for q in (50, 99, 99.9)]
+            print("| {} | {} | {} | {} |".format(
+                name.ljust(36),
+                str(sum(count for start, end, count in histogram)).rjust(7),
+                " | ".join(("-" if p is None else "{:.0f}".format(p)).rjust(6) for p in percentiles + [obj.max_length]),
+                ("{}".format(obj.n_overruns) if obj.budget else "-").rjust(8)))
 
     # Take a couple of samples
     print("sampling...")
@@ -629,3 +796,77 @@ def dump_timing(odrv, n_samples=100, path='/tmp/timings.png'):
         tick_label = [name for name, obj, start_times, lengths in timings], # labels
     )
     plt.savefig(path, bbox_inches='tight')
+
+def convert_trace(words, timestamp_hz, source_names):
+    """
+    Converts the words read from odrv.trace.read_block() into a list of events
+    in the Chrome trace format.
+    source_names maps the sources to names. Sources that are not in this map
+    are named by their number.
+    """
+    # The device only keeps the lower 32 bits of the timestamps. The events are
+    # dense enough that consecutive events are never more than 2^31 ticks apart.
+    events = []
+    timestamp = 0
+    last_raw = words[0] if len(words) else 0
+    for i in range(0, len(words) - 1, 2):
+        delta = (words[i] - last_raw) & 0xffffffff
+        timestamp += delta - (1 << 32) if delta >= (1 << 31) else delta
+        last_raw = words[i]
+        info = words[i + 1]
+        events.append((timestamp, i, info & 0xffff, (info >> 16) & 0xff, info >> 24))
+    events.sort() # writers that preempt each other can store events out of order
+
+    axis_states = {v: k[len('AXIS_STATE_'):] for k, v in globals().items() if k.startswith('AXIS_STATE_')}
+    tracks = {
+        TRACE_SOURCE_USB_EVENT: 1,
+        TRACE_SOURCE_CAN_MESSAGE: 2,
+        TRACE_SOURCE_AXIS0_STATE: 3,
+        TRACE_SOURCE_AXIS1_STATE: 4,
+    } # everything else runs in interrupts
+    track_names = ['interrupts', 'usb thread', 'can thread', 'axis0', 'axis1']
+    result = [{'name': 'thread_name', 'ph': 'M', 'pid': 0, 'tid': i, 'args': {'name': name}}
+              for i, name in enumerate(track_names)]
+
+    open_spans = {} # source => stack of begin events
+    for timestamp, _, source, event_type, arg in events:
+        name = source_names.get(source, str(source))
+        event = {'pid': 0, 'tid': tracks.get(source, 0), 'ts': timestamp * 1e6 / timestamp_hz}
+        if event_type == TRACE_EVENT_TYPE_BEGIN:
+            open_spans.setdefault(source, []).append((timestamp, arg))
+            continue
+        elif event_type == TRACE_EVENT_TYPE_END:
+            if not open_spans.get(source):
+                continue # started before the oldest event in the buffer
+            begin, arg = open_spans[source].pop()
+            event.update(name=name, ph='X', ts=begin * 1e6 / timestamp_hz, dur=(timestamp - begin) * 1e6 / timestamp_hz)
+            if source in (TRACE_SOURCE_USB_EVENT, TRACE_SOURCE_CAN_MESSAGE):
+                event['args'] = {'arg': arg}
+        elif event_type == TRACE_EVENT_TYPE_OVERRUN:
+            event.update(name=name + ' overrun', ph='i', s='g')
+        elif source in (TRACE_SOURCE_AXIS0_STATE, TRACE_SOURCE_AXIS1_STATE):
+            event.update(name=axis_states.get(arg, str(arg)), ph='i', s='t')
+        else:
+            event.update(name=name, ph='i', s='t', args={'arg': arg})
+        result.append(event)
+    return result
+
+def dump_trace(odrv, path='/tmp/trace.json'):
+    """
+    Stops the event trace (odrv.trace) if it's still running, downloads it and
+    writes it to path in the Chrome trace format. Open the file in
+    chrome://tracing or https://ui.perfetto.dev.
+    """
+    import json
+
+    odrv.trace.stop()
+    n_events = odrv.trace.n_events
+    words = read_block(odrv.trace.read_block, 0, 2 * n_events)
+    print("{} of {} events".format(len(words) // 2, n_events))
+
+    source_names = {v: k[len('TRACE_SOURCE_'):].lower() for k, v in globals().items() if k.startswith('TRACE_SOURCE_')}
+    source_names.update({obj.trace_id: name for name, obj in get_task_timers(odrv)})
+
+    with open(path, 'w') as fp:
+        json.dump({'traceEvents': convert_trace(words, odrv.trace.timestamp_hz, source_names)}, fp)
+    print("trace written to " + path)